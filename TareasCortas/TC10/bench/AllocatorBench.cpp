@@ -0,0 +1,172 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file AllocatorBench.cpp
+ * @brief Throughput and heap fragmentation over many TLS connection cycles
+ * with OpenSSL allocating through glibc malloc and through SlabAllocator.
+ *
+ * Usage: bin/AllocatorBench [--cert file] [--cycles n] [--live n]
+ *                           [--allocator malloc|slab] [--port n]
+ *
+ * A cycle connects over loopback, resumes the last TLS 1.3 session, sends
+ * a request, reads the answer and closes the client. The server keeps the
+ * last live connections open and closes a random one of them per cycle, so
+ * connections of very different ages share the heap as in a real server.
+ * Every tenth of the cycles prints the rate and the memory: resident set,
+ * bytes in use and bytes held by the allocators (glibc heap and mmapped
+ * blocks, slabs); what is held but not in use is the fragmentation.
+ * CRYPTO_set_mem_functions only works before OpenSSL allocates, so each
+ * allocator runs in a fresh process.
+ */
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "SlabAllocator.hpp"
+#include "Socket.hpp"
+
+// rows printed per case
+#define REPORTS 10
+
+static const char kRequest[] = "GET /lego/figure=elephant HTTP/1.1\r\n\r\n";
+static const char kResponse[] =
+    "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+
+/**
+ * @brief resident set of the process in bytes
+ */
+static double residentBytes() {
+  long pages = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm != nullptr) {
+    if (fscanf(statm, "%*d %ld", &pages) != 1) {
+      pages = 0;
+    }
+    fclose(statm);
+  }
+  return static_cast<double>(pages) * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief server side: answers cycles connections, keeping live of them
+ */
+static void serve(Socket* listener, long cycles, long live) {
+  std::vector<std::unique_ptr<Socket>> open(live);
+  std::mt19937 random(2023);
+  for (long cycle = 0; cycle < cycles; ++cycle) {
+    std::unique_ptr<Socket> client(listener->Accept());
+    try {
+      client->SetNoDelay();
+      client->SSLCreate(listener);
+      client->SSLAccept();
+      char buffer[256];
+      client->SSLRead(buffer, sizeof(buffer));
+      client->SSLWrite(kResponse, sizeof(kResponse) - 1);
+    } catch (const SocketException& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    // the one it replaces was opened any number of cycles ago; accepted
+    // sockets are closed explicitly, as FigureServer does
+    std::unique_ptr<Socket>& slot = open[random() % live];
+    if (slot != nullptr) {
+      slot->Close();
+    }
+    slot = std::move(client);
+  }
+}
+
+/**
+ * @brief prints one row of memory and rate
+ */
+static void report(long cycle, double seconds, long cycles) {
+  struct mallinfo2 heap = mallinfo2();
+  SlabStats slabs = SlabAllocator::Stats();
+  double held = heap.arena + heap.hblkhd + slabs.reserved;
+  double used = heap.uordblks + heap.hblkhd + slabs.inUse;
+  printf("%8ld cycles %8.0f /s %8.1f MB RSS %8.1f MB held %8.1f MB in use "
+         "%5.1f%% fragmentation\n",
+         cycle, cycles / seconds, residentBytes() / 1e6, held / 1e6,
+         used / 1e6, held > 0 ? 100 * (held - used) / held : 0);
+}
+
+/**
+ * @brief one allocator: runs the cycles in this process
+ */
+static void runCase(const char* allocator, const char* cert, int port,
+                    long cycles, long live) {
+  if (strcmp(allocator, "slab") == 0 && !SlabAllocator::InstallForOpenSsl()) {
+    std::cerr << "OpenSSL allocated before CRYPTO_set_mem_functions"
+              << std::endl;
+    return;
+  }
+  printf("%s: %ld cycles, %ld live connections\n", allocator, cycles, live);
+  Socket listener('s', port, cert, cert);
+  std::thread server(serve, &listener, cycles, live);
+  TlsSession session;
+  char buffer[256];
+  long step = std::max<long>(cycles / REPORTS, 1);
+  Stopwatch total;
+  Stopwatch stopwatch;
+  for (long cycle = 1; cycle <= cycles; ++cycle) {
+    std::unique_ptr<Socket> client(new Socket('s', false, true));
+    // the request must not wait behind the client's Finished (Nagle)
+    client->SetNoDelay();
+    if (session.Resumable()) {
+      client->SSLResume(session);
+    }
+    client->SSLConnect("127.0.0.1", port);
+    client->SSLWrite(kRequest, sizeof(kRequest) - 1);
+    client->SSLRead(buffer, sizeof(buffer));
+    // every resumption brings new tickets, keep the last one
+    TlsSession next = client->SSLSession();
+    if (next.Resumable()) {
+      session = std::move(next);
+    }
+    client->Close();
+    client.reset();
+    if (cycle % step == 0) {
+      report(cycle, stopwatch.Seconds(), step);
+      stopwatch.Reset();
+    }
+  }
+  server.join();
+  printf("%s: %.0f cycles/s overall\n", allocator, cycles / total.Seconds());
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long cycles = options.GetInt("cycles", 1000000);
+  long live = std::max<long>(options.GetInt("live", 256), 1);
+  const char* only = options.Get("allocator", nullptr);
+  int port = options.GetInt("port", BenchDefaultPort());
+  for (const char* allocator : {"malloc", "slab"}) {
+    if (only != nullptr && strcmp(only, allocator) != 0) {
+      continue;
+    }
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0) {
+      try {
+        runCase(allocator, cert, port, cycles, live);
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::quick_exit(1);
+      }
+      std::cout.flush();
+      // leaves the live connections as they are
+      std::quick_exit(0);
+    }
+    waitpid(child, nullptr, 0);
+    // the previous case's connections are in TIME_WAIT on its port
+    ++port;
+  }
+  return 0;
+}
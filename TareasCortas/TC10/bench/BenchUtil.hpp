@@ -0,0 +1,106 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file BenchUtil.hpp
+ * @brief Small helpers shared by the benchmark programs in bench/: command
+ * line options, a stopwatch and loopback defaults.
+ */
+#ifndef BENCH_UTIL_HPP
+#define BENCH_UTIL_HPP
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief Options given as "--name value" pairs, unknown names are ignored.
+ */
+class BenchOptions {
+ public:
+  BenchOptions(int argc, char** argv) : argc(argc), argv(argv) {}
+  /**
+   * @brief value of an option, or fallback if it was not given
+   */
+  const char* Get(const char* name, const char* fallback) const {
+    for (int index = 1; index + 1 < this->argc; ++index) {
+      if (this->argv[index][0] == '-' && this->argv[index][1] == '-' &&
+          strcmp(this->argv[index] + 2, name) == 0) {
+        return this->argv[index + 1];
+      }
+    }
+    return fallback;
+  }
+  /**
+   * @brief integer value of an option, or fallback if it was not given
+   */
+  long GetInt(const char* name, long fallback) const {
+    const char* value = this->Get(name, nullptr);
+    return value ? std::strtol(value, nullptr, 10) : fallback;
+  }
+
+ private:
+  int argc;
+  char** argv;
+};
+
+/**
+ * @brief Wall clock stopwatch based on a monotonic clock.
+ */
+class Stopwatch {
+ public:
+  Stopwatch() : start(std::chrono::steady_clock::now()) {}
+  /**
+   * @brief restarts the measurement
+   */
+  void Reset() { this->start = std::chrono::steady_clock::now(); }
+  /**
+   * @brief seconds elapsed since construction or the last Reset()
+   */
+  double Seconds() const {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - this->start;
+    return elapsed.count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief port to listen on when none is given. It depends on the process id
+ *  so consecutive runs don't collide with connections still in TIME_WAIT.
+ */
+inline int BenchDefaultPort() { return 20000 + getpid() % 20000; }
+
+/**
+ * @brief certificate used by the TLS benchmarks when none is given. The key
+ *  in certs/ci0123.pem has a pass phrase ("1234"), OpenSSL asks for it.
+ */
+inline const char* BenchDefaultCert() { return "certs/ci0123.pem"; }
+
+/**
+ * @brief builds an HTML page similar to a Lego figure parts list
+ * @param size approximate page size in bytes
+ */
+inline std::string BenchFigurePage(size_t size) {
+  static const char* const kParts[] = {"brick 2x4", "plate 1x2", "slope 45",
+                                       "tile 2x2", "eye", "tail", "trunk"};
+  std::string page =
+      "<!DOCTYPE html>\n<html>\n<head><title>Lego figure</title></head>\n"
+      "<body>\n<h1>Lego figure</h1>\n<table border=\"1\">\n"
+      "<tr><th>Part</th><th>Color</th><th>Amount</th></tr>\n";
+  char row[160];
+  for (unsigned index = 0; page.size() < size; ++index) {
+    snprintf(row, sizeof(row),
+             "<tr><td><img src=\"/lego/img/%u.jpg\"/>%s</td>"
+             "<td>color %u</td><td>%u</td></tr>\n",
+             index, kParts[index % 7], index % 13, 1 + index % 5);
+    page += row;
+  }
+  page += "</table>\n</body>\n</html>\n";
+  return page;
+}
+#endif  // BENCH_UTIL_HPP
@@ -0,0 +1,116 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file CipherBench.cpp
+ * @brief Handshake time and bulk transfer MB/s of each TLS cipher suite over
+ * loopback, to see which AEAD this CPU runs fastest.
+ *
+ * Usage: bin/CipherBench [--cert file] [--megabytes n] [--port n]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "Socket.hpp"
+#include "TlsPolicy.hpp"
+
+// size of each SSLWrite, one full TLS record
+#define CHUNK_SIZE 16384
+
+/**
+ * @brief one suite to measure: a named policy, optionally held to TLS 1.2
+ */
+struct CipherCase {
+  const char* label;
+  const char* policy;
+  bool tls12;
+};
+
+/**
+ * @brief accepts one connection per case, reads everything the client
+ *  sends and answers with one byte once it has it all
+ */
+static void serve(Socket* server, size_t bytes, size_t cases) {
+  std::vector<char> buffer(CHUNK_SIZE);
+  for (size_t index = 0; index < cases; ++index) {
+    Socket* client = server->Accept();
+    try {
+      client->SSLCreate(server);
+      client->SSLAccept();
+      size_t received = 0;
+      while (received < bytes) {
+        int read = client->SSLRead(buffer.data(), buffer.size());
+        if (read <= 0) {
+          break;
+        }
+        received += read;
+      }
+      client->SSLWrite("k", 1);
+    } catch (const SocketException& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    client->Close();
+    delete client;
+  }
+}
+
+/**
+ * @brief connects with the case's policy, sends bytes and prints one row
+ */
+static void runCase(const CipherCase& cipherCase, int port, size_t bytes) {
+  TlsPolicy policy;
+  if (!TlsPolicy::Named(cipherCase.policy, policy)) {
+    return;
+  }
+  if (cipherCase.tls12) {
+    policy.minVersion = policy.maxVersion = TLS1_2_VERSION;
+  }
+  std::vector<char> chunk(CHUNK_SIZE, 'x');
+  Socket client('s', false, true);
+  client.SSLSetPolicy(policy);
+  Stopwatch handshake;
+  client.SSLConnect("127.0.0.1", port);
+  double handshakeSeconds = handshake.Seconds();
+  Stopwatch transfer;
+  for (size_t sent = 0; sent < bytes; sent += chunk.size()) {
+    client.SSLWrite(chunk.data(), chunk.size());
+  }
+  char ack = 0;
+  client.SSLRead(&ack, 1);
+  double seconds = transfer.Seconds();
+  printf("%-10s %-8s %-30s %8.2f ms %10.1f MB/s\n", cipherCase.label,
+         client.SSLGetVersion(), client.SSLGetCipher(),
+         handshakeSeconds * 1e3, bytes / seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long megabytes = options.GetInt("megabytes", 256);
+  int port = options.GetInt("port", BenchDefaultPort());
+  const CipherCase cases[] = {
+      {"default", "default", false}, {"aes128", "aes128", false},
+      {"aes256", "aes256", false},   {"chacha20", "chacha20", false},
+      {"aes128", "aes128", true},    {"aes256", "aes256", true},
+      {"chacha20", "chacha20", true},
+  };
+  const size_t caseCount = sizeof(cases) / sizeof(cases[0]);
+  // whole chunks, so the server knows when the client is done
+  size_t bytes = (megabytes * 1000000 + CHUNK_SIZE - 1) / CHUNK_SIZE *
+                 CHUNK_SIZE;
+  printf("AES hardware: %s, %ld MB per suite\n",
+         TlsPolicy::HasAesHardware() ? "yes" : "no", megabytes);
+  try {
+    Socket server('s', port, cert, cert);
+    std::thread serverThread(serve, &server, bytes, caseCount);
+    for (const CipherCase& cipherCase : cases) {
+      runCase(cipherCase, port, bytes);
+    }
+    serverThread.join();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
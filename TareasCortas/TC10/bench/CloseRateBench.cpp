@@ -0,0 +1,130 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file CloseRateBench.cpp
+ * @brief Cost of noticing that the peer closed the connection: Read throwing
+ * SocketException (with and without formatting what()) against TryRead
+ * returning 0, first on a socketpair and then with short TCP connections
+ * opened and closed as fast as loopback allows.
+ *
+ * Usage: bin/CloseRateBench [--closes n] [--connections n] [--port n]
+ */
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include "BenchUtil.hpp"
+#include "Socket.hpp"
+
+enum class Detect { kThrow, kThrowWhat, kResult };
+
+static const char* const kDetectNames[] = {"Read throw", "Read throw+what",
+                                           "TryRead"};
+
+/**
+ * @brief reads until the peer closes, returns the bytes read
+ */
+static size_t drain(Socket* socket, Detect detect, size_t& messageBytes) {
+  char buffer[512];
+  size_t bytes = 0;
+  if (detect == Detect::kResult) {
+    Result<int> read = 0;
+    while ((read = socket->TryRead(buffer, sizeof(buffer))) && *read > 0) {
+      bytes += *read;
+    }
+    return bytes;
+  }
+  try {
+    while (true) {
+      bytes += socket->Read(buffer, sizeof(buffer));
+    }
+  } catch (const SocketException& e) {
+    if (detect == Detect::kThrowWhat) {
+      messageBytes += strlen(e.what());
+    }
+  }
+  return bytes;
+}
+
+/**
+ * @brief the close path alone: the peer already shut down its side, so every
+ *  read returns 0 at once
+ */
+static void benchDetect(long closes) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    perror("socketpair");
+    return;
+  }
+  shutdown(fds[1], SHUT_WR);
+  Socket reader(fds[0]);
+  for (Detect detect : {Detect::kThrow, Detect::kThrowWhat, Detect::kResult}) {
+    size_t messageBytes = 0;
+    Stopwatch stopwatch;
+    for (long close = 0; close < closes; ++close) {
+      drain(&reader, detect, messageBytes);
+    }
+    double seconds = stopwatch.Seconds();
+    printf("detect %-16s %12.0f closes/s %8.1f ns/close\n",
+           kDetectNames[static_cast<int>(detect)], closes / seconds,
+           seconds * 1e9 / closes);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/**
+ * @brief short connections: connect, send a request, close; the server
+ *  drains each one until it sees the close
+ */
+static void benchConnections(Socket* server, int port, long connections,
+                             Detect detect) {
+  size_t received = 0, messageBytes = 0;
+  std::thread acceptor([&] {
+    for (long connection = 0; connection < connections; ++connection) {
+      Socket* client = server->Accept();
+      received += drain(client, detect, messageBytes);
+      client->Close();
+      delete client;
+    }
+  });
+  char request[64] = "GET /lego/figure=elephant HTTP/1.0\r\n\r\n";
+  Stopwatch stopwatch;
+  for (long connection = 0; connection < connections; ++connection) {
+    Socket client('s');
+    client.Connect("127.0.0.1", port);
+    client.Write(request, sizeof(request));
+    client.Shutdown(SHUT_WR);
+    // wait for the server to close too, so connections do not pile up in
+    // the listen queue
+    char answer[16];
+    client.TryRead(answer, sizeof(answer));
+    client.Close();
+  }
+  acceptor.join();
+  double seconds = stopwatch.Seconds();
+  printf("conns  %-16s %12.0f conns/s  (%zu bytes received)\n",
+         kDetectNames[static_cast<int>(detect)], connections / seconds,
+         received);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  long closes = options.GetInt("closes", 1000000);
+  long connections = options.GetInt("connections", 5000);
+  int port = options.GetInt("port", BenchDefaultPort());
+  try {
+    benchDetect(closes);
+    Socket server('s', port);
+    for (Detect detect :
+         {Detect::kThrow, Detect::kThrowWhat, Detect::kResult}) {
+      benchConnections(&server, port, connections, detect);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file EarlyDataBench.cpp
+ * @brief Time to first response of the Lego figure server for a full
+ * handshake, a resumed one and a resumed one with the request sent as TLS
+ * 1.3 early data, over loopback with an artificial round trip time.
+ *
+ * Usage: bin/EarlyDataBench [--cert file] [--connections n]
+ *                           [--delay-ms n] [--port n]
+ *
+ * Every byte goes through a relay that holds it delay-ms in each direction.
+ * With --delay-ms 0 the client connects directly, e.g. to measure under
+ * "tc qdisc add dev lo root netem delay 10ms" instead.
+ */
+#include <signal.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "FigureServer.hpp"
+#include "PageCache.hpp"
+#include "Socket.hpp"
+
+/**
+ * @class DelayProxy
+ * @brief TCP relay that holds every chunk for a fixed time in each
+ *  direction, an in-process stand-in for netem on loopback
+ */
+class DelayProxy {
+ public:
+  DelayProxy(int port, int target, int delayMs)
+      : listener('s', port), target(target), delay(delayMs) {}
+  /**
+   * @brief relays every connection accepted, never returns
+   */
+  void Run() {
+    while (true) {
+      Socket* client = this->listener.Accept();
+      std::thread(&DelayProxy::relay, this, client).detach();
+    }
+  }
+
+ private:
+  /// bytes read and when they are due at the other side, empty at the end
+  struct Chunk {
+    std::chrono::steady_clock::time_point due;
+    std::string data;
+  };
+  Socket listener;                  ///< where clients connect
+  int target;                       ///< port of the real server
+  std::chrono::milliseconds delay;  ///< added in each direction
+
+  void relay(Socket* client) {
+    try {
+      Socket server('s');
+      server.Connect("127.0.0.1", this->target);
+      server.SetNoDelay();
+      client->SetNoDelay();
+      std::thread upstream(&DelayProxy::pump, this, client, &server);
+      this->pump(&server, client);
+      upstream.join();
+    } catch (const SocketException& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    delete client;
+  }
+
+  /**
+   * @brief copies from into to until from ends, each chunk delay late
+   */
+  void pump(Socket* from, Socket* to) {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Chunk> chunks;
+    std::thread writer([&] {
+      bool open = true;
+      while (true) {
+        Chunk chunk;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [&] { return !chunks.empty(); });
+          chunk = std::move(chunks.front());
+          chunks.pop_front();
+        }
+        if (chunk.data.empty()) {
+          break;
+        }
+        std::this_thread::sleep_until(chunk.due);
+        for (size_t sent = 0; open && sent < chunk.data.size();) {
+          Result<int> bytes = to->TryWrite(chunk.data.data() + sent,
+                                           chunk.data.size() - sent);
+          open = static_cast<bool>(bytes);
+          sent += open ? *bytes : 0;
+        }
+      }
+      try {
+        to->Shutdown(SHUT_WR);
+      } catch (const SocketException& e) {
+        // the other side is already gone
+      }
+    });
+    char buffer[16384];
+    while (true) {
+      Result<int> bytes = from->TryRead(buffer, sizeof(buffer));
+      Chunk chunk{std::chrono::steady_clock::now() + this->delay, {}};
+      if (bytes && *bytes > 0) {
+        chunk.data.assign(buffer, *bytes);
+      }
+      bool end = chunk.data.empty();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.push_back(std::move(chunk));
+      }
+      ready.notify_one();
+      if (end) {
+        break;
+      }
+    }
+    writer.join();
+  }
+};
+
+/**
+ * @brief how a case connects
+ */
+enum class Handshake { kFull, kResumed, kEarly };
+
+/**
+ * @brief one connection: sends request, reads the whole response
+ * @param session resumed if not empty, replaced by the new session
+ * @param early set to true if the request went as accepted early data
+ * @return seconds from connecting to the first byte of the response
+ */
+static double fetch(int port, Handshake handshake, const char* request,
+                    TlsSession& session, bool& early) {
+  Socket client('s', false, true);
+  // the request must not wait behind the client's Finished (Nagle)
+  client.SetNoDelay();
+  if (handshake != Handshake::kFull && session.Resumable()) {
+    client.SSLResume(session);
+  }
+  Stopwatch stopwatch;
+  early = false;
+  if (handshake == Handshake::kEarly) {
+    early = client.SSLConnectEarly("127.0.0.1", port, request,
+                                   strlen(request));
+  } else {
+    client.SSLConnect("127.0.0.1", port);
+    client.SSLWrite(request, strlen(request));
+  }
+  char buffer[16384];
+  int bytes = client.SSLRead(buffer, sizeof(buffer));
+  double seconds = stopwatch.Seconds();
+  // the server closes after the response, the session tickets come before
+  while (bytes > 0) {
+    bytes = client.SSLRead(buffer, sizeof(buffer));
+  }
+  TlsSession next = client.SSLSession();
+  if (next.Resumable()) {
+    session = std::move(next);
+  }
+  return seconds;
+}
+
+/**
+ * @brief runs connections one after the other and prints one row
+ */
+static void runCase(const char* label, int port, Handshake handshake,
+                    const char* request, long connections) {
+  TlsSession session;
+  bool early = false;
+  // the first connection gets the session the others resume
+  fetch(port, Handshake::kFull, request, session, early);
+  std::vector<double> times;
+  long accepted = 0;
+  for (long index = 0; index < connections; ++index) {
+    times.push_back(fetch(port, handshake, request, session, early));
+    accepted += early;
+  }
+  std::sort(times.begin(), times.end());
+  printf("%-12s %8.2f ms p50 %8.2f ms p90 %5ld/%ld early\n", label,
+         times[times.size() / 2] * 1e3, times[times.size() * 9 / 10] * 1e3,
+         accepted, connections);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long connections = options.GetInt("connections", 20);
+  int delayMs = options.GetInt("delay-ms", 10);
+  int port = options.GetInt("port", BenchDefaultPort());
+  const char* get =
+      "GET /lego/figure=elephant HTTP/1.1\r\nHost: localhost\r\n"
+      "Connection: close\r\n\r\n";
+  const char* post =
+      "POST /lego/figure=elephant HTTP/1.1\r\nHost: localhost\r\n"
+      "Connection: close\r\n\r\n";
+  // the relay writes to connections the server may have closed already
+  signal(SIGPIPE, SIG_IGN);
+  try {
+    PageCache cache;
+    cache.Insert("elephant", BenchFigurePage(4096));
+    Socket server('s', port, cert, cert);
+    EarlyDataGuard guard;
+    guard.AllowHttpMethod("GET");
+    server.SSLEnableEarlyData(guard);
+    FigureServer figureServer(&server, &cache);
+    std::thread(&FigureServer::Run, &figureServer, -1).detach();
+    int clientPort = port;
+    std::unique_ptr<DelayProxy> proxy;
+    if (delayMs > 0) {
+      clientPort = port + 1;
+      proxy = std::make_unique<DelayProxy>(clientPort, port, delayMs);
+      std::thread(&DelayProxy::Run, proxy.get()).detach();
+    }
+    printf("round trip %d ms, %ld connections per case\n", 2 * delayMs,
+           connections);
+    runCase("full", clientPort, Handshake::kFull, get, connections);
+    runCase("resumed", clientPort, Handshake::kResumed, get, connections);
+    runCase("0-RTT GET", clientPort, Handshake::kEarly, get, connections);
+    // not allowed early: the server waits for the handshake to answer
+    runCase("0-RTT POST", clientPort, Handshake::kEarly, post, connections);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout.flush();
+  // the accept loops never return, leave without waiting for them
+  std::quick_exit(0);
+}
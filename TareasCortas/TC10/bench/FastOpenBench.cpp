@@ -0,0 +1,325 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file FastOpenBench.cpp
+ * @brief Time to first response with and without TCP Fast Open, for a
+ * plain request and for the Lego figure server over TLS, with an artificial
+ * round trip time.
+ *
+ * Usage: bin/FastOpenBench [--cert file] [--connections n]
+ *                          [--delay-ms n] [--port n]
+ *
+ * The relay of EarlyDataBench can't delay a SYN, so the delay is put under
+ * TCP instead: the benchmark moves into a network namespace of its own
+ * (root only; the host's net.ipv4.tcp_fastopen is not touched), turns Fast
+ * Open on for clients and servers there and sends every packet to a tun
+ * device. A thread holds each packet delay-ms and writes it back with the
+ * addresses swapped, so a connection to 10.77.0.2 comes back to a listener
+ * on 10.77.0.1 and the answers go back the same way. Without root it runs
+ * over 127.0.0.1 with no delay and the host's setting.
+ */
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <net/if.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "FigureServer.hpp"
+#include "PageCache.hpp"
+#include "Socket.hpp"
+
+// addresses of the tun device and of the peer it reflects
+#define LOCAL_ADDRESS "10.77.0.1"
+#define REFLECTED_ADDRESS "10.77.0.2"
+// connections with data in the SYN the listeners let wait for accept
+#define FAST_OPEN_QUEUE 64
+
+/**
+ * @class DelayLine
+ * @brief holds every IPv4 packet routed to a tun device for a fixed time
+ *  and writes it back with source and destination swapped, an in-process
+ *  stand-in for netem
+ * @details swapping the two addresses leaves both checksums as they are:
+ *  they are sums, and the TCP one covers the addresses only through them.
+ */
+class DelayLine {
+ public:
+  DelayLine(int tun, int delayMs) : tun(tun), delay(delayMs) {}
+  /**
+   * @brief forwards packets, never returns
+   */
+  void Run() {
+    std::vector<char> buffer(65536);
+    while (true) {
+      this->wait();
+      ssize_t bytes = 0;
+      while ((bytes = read(this->tun, buffer.data(), buffer.size())) > 0) {
+        // IPv6 neighbour discovery and such are dropped
+        if (bytes < 20 || (buffer[0] & 0xf0) != 0x40) {
+          continue;
+        }
+        Packet packet{std::chrono::steady_clock::now() + this->delay,
+                      std::string(buffer.data(), bytes)};
+        std::swap_ranges(&packet.data[12], &packet.data[16], &packet.data[16]);
+        this->packets.push_back(std::move(packet));
+      }
+      auto now = std::chrono::steady_clock::now();
+      while (!this->packets.empty() && this->packets.front().due <= now) {
+        const std::string& data = this->packets.front().data;
+        if (write(this->tun, data.data(), data.size()) == -1) {
+          perror("DelayLine write");
+        }
+        this->packets.pop_front();
+      }
+    }
+  }
+
+ private:
+  /// a packet and when it is due back
+  struct Packet {
+    std::chrono::steady_clock::time_point due;
+    std::string data;
+  };
+  int tun;                          ///< non-blocking tun descriptor
+  std::chrono::milliseconds delay;  ///< added to every packet
+  std::deque<Packet> packets;       ///< in the order they are due
+
+  /**
+   * @brief waits for a packet, or until the first one held is due
+   */
+  void wait() {
+    struct pollfd ready = {this->tun, POLLIN, 0};
+    if (this->packets.empty()) {
+      ppoll(&ready, 1, nullptr, nullptr);
+      return;
+    }
+    auto left = this->packets.front().due - std::chrono::steady_clock::now();
+    long nanoseconds = std::max<long>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(left).count());
+    struct timespec timeout = {nanoseconds / 1000000000,
+                               nanoseconds % 1000000000};
+    ppoll(&ready, 1, &timeout, nullptr);
+  }
+};
+
+/**
+ * @brief sets an IPv4 address, a /24 netmask or the up flag of interface
+ */
+static void configure(int control, struct ifreq* request, unsigned long call,
+                      const char* address) {
+  struct sockaddr_in* in =
+      reinterpret_cast<struct sockaddr_in*>(&request->ifr_addr);
+  if (address != nullptr) {
+    memset(in, 0, sizeof(*in));
+    in->sin_family = AF_INET;
+    inet_pton(AF_INET, address, &in->sin_addr);
+  }
+  if (ioctl(control, call, request) == -1) {
+    throw SocketException("Error configuring tun device", "configure", errno,
+                          false);
+  }
+}
+
+/**
+ * @brief moves the process to a network namespace of its own, with Fast
+ *  Open on for clients and servers and a tun device at LOCAL_ADDRESS/24
+ * @return the tun descriptor, or -1 if there are no privileges for it
+ */
+static int isolate() {
+  if (unshare(CLONE_NEWNET) == -1) {
+    return -1;
+  }
+  // /proc/sys/net belongs to the namespace of whoever opens it
+  FILE* sysctl = fopen("/proc/sys/net/ipv4/tcp_fastopen", "w");
+  if (sysctl == nullptr || fputs("3", sysctl) == EOF || fclose(sysctl) != 0) {
+    throw SocketException("Error setting net.ipv4.tcp_fastopen", "isolate",
+                          errno, false);
+  }
+  int tun = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  struct ifreq request;
+  memset(&request, 0, sizeof(request));
+  strncpy(request.ifr_name, "tfo0", IFNAMSIZ - 1);
+  request.ifr_flags = IFF_TUN | IFF_NO_PI;
+  if (tun == -1 || ioctl(tun, TUNSETIFF, &request) == -1) {
+    throw SocketException("Error creating tun device", "isolate", errno,
+                          false);
+  }
+  int control = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  configure(control, &request, SIOCSIFADDR, LOCAL_ADDRESS);
+  configure(control, &request, SIOCSIFNETMASK, "255.255.255.0");
+  configure(control, &request, SIOCGIFFLAGS, nullptr);
+  request.ifr_flags |= IFF_UP | IFF_RUNNING;
+  configure(control, &request, SIOCSIFFLAGS, nullptr);
+  close(control);
+  return tun;
+}
+
+/**
+ * @brief answers every request on listener with a short page, one
+ *  connection after the other, never returns
+ */
+static void serve(Socket* listener) {
+  const char* response =
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+  while (true) {
+    Socket* client = listener->Accept();
+    try {
+      std::string request;
+      char buffer[4096];
+      while (request.find("\r\n\r\n") == std::string::npos) {
+        request.append(buffer, client->Read(buffer, sizeof(buffer)));
+      }
+      client->Write(response);
+    } catch (const SocketException& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    // accepted sockets are closed explicitly, as FigureServer does
+    client->Close();
+    delete client;
+  }
+}
+
+/**
+ * @brief true if the SYN of client carried data and the server took it
+ */
+static bool synData(const Socket& client) {
+  struct tcp_info info;
+  socklen_t length = sizeof(info);
+  return getsockopt(client.GetIDSocket(), IPPROTO_TCP, TCP_INFO, &info,
+                    &length) == 0 &&
+         (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+}
+
+/**
+ * @brief how a case connects
+ */
+enum class Case { kTcp, kTcpFastOpen, kTls, kTlsFastOpen };
+
+/**
+ * @brief one connection: sends request, reads the whole response
+ * @param fastOpen set to true if the request went in the SYN
+ * @return seconds from connecting to the first byte of the response
+ */
+static double fetch(const char* host, int port, Case how,
+                    const char* request, bool& fastOpen) {
+  bool tls = how == Case::kTls || how == Case::kTlsFastOpen;
+  Socket client('s', false, tls);
+  // the request must not wait behind the client's Finished (Nagle)
+  client.SetNoDelay();
+  if (how == Case::kTlsFastOpen) {
+    SocketOptions options;
+    options.fastOpenConnect = true;
+    client.SetOptions(options);
+  }
+  char buffer[16384];
+  Stopwatch stopwatch;
+  int bytes = 0;
+  if (tls) {
+    client.SSLConnect(host, port);
+    client.SSLWrite(request, strlen(request));
+    bytes = client.SSLRead(buffer, sizeof(buffer));
+  } else {
+    if (how == Case::kTcpFastOpen) {
+      int sent = client.ConnectFast(host, port, request, strlen(request));
+      if (sent < static_cast<int>(strlen(request))) {
+        client.Write(request + sent, strlen(request) - sent);
+      }
+    } else {
+      client.Connect(host, port);
+      client.Write(request);
+    }
+    bytes = client.Read(buffer, sizeof(buffer));
+  }
+  double seconds = stopwatch.Seconds();
+  fastOpen = synData(client);
+  while (bytes > 0) {
+    if (tls) {
+      bytes = client.SSLRead(buffer, sizeof(buffer));
+    } else {
+      Result<int> more = client.TryRead(buffer, sizeof(buffer));
+      bytes = more ? *more : 0;
+    }
+  }
+  return seconds;
+}
+
+/**
+ * @brief runs connections one after the other and prints one row
+ */
+static void runCase(const char* label, const char* host, int port, Case how,
+                    const char* request, long connections) {
+  bool fastOpen = false;
+  // the first connection gets the cookie the others show
+  fetch(host, port, how, request, fastOpen);
+  std::vector<double> times;
+  long accepted = 0;
+  for (long index = 0; index < connections; ++index) {
+    times.push_back(fetch(host, port, how, request, fastOpen));
+    accepted += fastOpen;
+  }
+  std::sort(times.begin(), times.end());
+  printf("%-14s %8.2f ms p50 %8.2f ms p90 %5ld/%ld in SYN\n", label,
+         times[times.size() / 2] * 1e3, times[times.size() * 9 / 10] * 1e3,
+         accepted, connections);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long connections = options.GetInt("connections", 20);
+  int delayMs = options.GetInt("delay-ms", 10);
+  int port = options.GetInt("port", BenchDefaultPort());
+  const char* get =
+      "GET /lego/figure=elephant HTTP/1.1\r\nHost: localhost\r\n"
+      "Connection: close\r\n\r\n";
+  signal(SIGPIPE, SIG_IGN);
+  try {
+    const char* host = REFLECTED_ADDRESS;
+    int tun = isolate();
+    if (tun == -1) {
+      printf("no network namespace (%s), over 127.0.0.1 without delay\n",
+             strerror(errno));
+      host = "127.0.0.1";
+      delayMs = 0;
+    } else {
+      std::thread(&DelayLine::Run, new DelayLine(tun, delayMs)).detach();
+    }
+    SocketOptions fastOpen;
+    fastOpen.fastOpen = FAST_OPEN_QUEUE;
+    Socket plain('s', port);
+    plain.SetOptions(fastOpen);
+    std::thread(serve, &plain).detach();
+    PageCache cache;
+    cache.Insert("elephant", BenchFigurePage(4096));
+    Socket secure('s', port + 1, cert, cert);
+    secure.SetOptions(fastOpen);
+    FigureServer figureServer(&secure, &cache);
+    std::thread(&FigureServer::Run, &figureServer, -1).detach();
+    printf("round trip %d ms, %ld connections per case\n", 2 * delayMs,
+           connections);
+    runCase("tcp", host, port, Case::kTcp, get, connections);
+    runCase("tcp fast open", host, port, Case::kTcpFastOpen, get,
+            connections);
+    runCase("tls", host, port + 1, Case::kTls, get, connections);
+    runCase("tls fast open", host, port + 1, Case::kTlsFastOpen, get,
+            connections);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout.flush();
+  // the accept loops never return, leave without waiting for them
+  std::quick_exit(0);
+}
@@ -0,0 +1,86 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file FigureIndexBench.cpp
+ * @brief Cost of looking up a figure page: open/read of the page file (the
+ * filesystem data model) against a probe in the mapped FigureIndex.
+ *
+ * Usage: bin/FigureIndexBench [--figures n] [--page-size bytes]
+ *                             [--lookups n] [--dir path]
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "FigureIndex.hpp"
+#include "PageCache.hpp"
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  long figures = options.GetInt("figures", 1000);
+  long pageSize = options.GetInt("page-size", 16384);
+  long lookups = options.GetInt("lookups", 200000);
+  std::string dir = options.Get("dir", "/tmp/FigureIndexBench");
+  try {
+    // one page file per figure, as the server keeps them today
+    mkdir(dir.c_str(), 0755);
+    std::string page = BenchFigurePage(pageSize);
+    std::vector<std::string> names;
+    for (long figure = 0; figure < figures; ++figure) {
+      names.push_back("figure" + std::to_string(figure));
+      FILE* file = fopen((dir + "/" + names.back() + ".htm").c_str(), "w");
+      fwrite(page.data(), 1, page.size(), file);
+      fclose(file);
+    }
+    Stopwatch stopwatch;
+    PageCache cache(false);
+    cache.LoadDirectory(dir);
+    std::string indexFile = dir + ".idx";
+    FigureIndex::Build(cache, indexFile);
+    printf("%ld figures, index built in %.2f ms\n", figures,
+           stopwatch.Seconds() * 1e3);
+    FigureIndex index(indexFile);
+    // the same random sequence of names for every path
+    std::vector<uint32_t> sequence(lookups);
+    std::mt19937 random(42);
+    for (uint32_t& name : sequence) {
+      name = random() % figures;
+    }
+    std::vector<char> buffer(pageSize * 2);
+    size_t checksum = 0;
+    // path resolution, open, fstat, read and close for every request
+    stopwatch.Reset();
+    for (uint32_t name : sequence) {
+      std::string path = dir + "/" + names[name] + ".htm";
+      int fd = open(path.c_str(), O_RDONLY);
+      struct stat status;
+      fstat(fd, &status);
+      checksum += read(fd, buffer.data(), status.st_size);
+      close(fd);
+    }
+    double fileSeconds = stopwatch.Seconds();
+    // the same bytes through the index: a hash probe and a view
+    stopwatch.Reset();
+    CachedPage found;
+    for (uint32_t name : sequence) {
+      index.Find(names[name], found);
+      checksum += found.identity.size() + found.identity.back();
+    }
+    double indexSeconds = stopwatch.Seconds();
+    printf("%-10s %12.0f lookups/s %10.1f ns/lookup\n", "open/read",
+           lookups / fileSeconds, fileSeconds / lookups * 1e9);
+    printf("%-10s %12.0f lookups/s %10.1f ns/lookup\n", "index",
+           lookups / indexSeconds, indexSeconds / lookups * 1e9);
+    printf("checksum %zu\n", checksum);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file HdrHistogram.hpp
+ * @brief High dynamic range histogram of latencies: fixed memory, values
+ * kept with a configurable number of significant digits from 1 ns to
+ * minutes, and histograms of several threads can be added together.
+ */
+#ifndef HDR_HISTOGRAM_HPP
+#define HDR_HISTOGRAM_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * @class HdrHistogram
+ * @brief Log-linear buckets as in Gil Tene's HdrHistogram: each power of two
+ *  range is split in the same number of linear sub-buckets, so the relative
+ *  error is the same for every value.
+ */
+class HdrHistogram {
+ public:
+  /**
+   * @brief Constructor for HdrHistogram
+   * @param highest largest value tracked, larger values are clamped to it
+   * @param digits significant decimal digits kept (1 to 4)
+   */
+  explicit HdrHistogram(uint64_t highest = 600000000000ull, int digits = 3)
+      : highest(highest) {
+    uint64_t largestSingleUnit =
+        2 * static_cast<uint64_t>(std::pow(10, digits));
+    while ((1ull << this->subBucketBits) < largestSingleUnit) {
+      ++this->subBucketBits;
+    }
+    this->subBucketHalfBits = this->subBucketBits - 1;
+    this->subBucketHalfCount = 1ull << this->subBucketHalfBits;
+    this->subBucketMask = (1ull << this->subBucketBits) - 1;
+    int buckets = 1;
+    for (uint64_t range = 1ull << this->subBucketBits; range <= highest;
+         range <<= 1) {
+      ++buckets;
+    }
+    this->counts.resize((buckets + 1) * this->subBucketHalfCount);
+  }
+  /**
+   * @brief adds one value
+   */
+  void Record(uint64_t value) noexcept(true) {
+    if (value > this->highest) {
+      value = this->highest;
+    }
+    ++this->counts[this->index(value)];
+    ++this->total;
+    this->min = value < this->min ? value : this->min;
+    this->max = value > this->max ? value : this->max;
+    this->sum += value;
+  }
+  /**
+   * @brief adds every value of other, built with the same parameters
+   */
+  void Add(const HdrHistogram& other) noexcept(true) {
+    for (size_t slot = 0; slot < this->counts.size(); ++slot) {
+      this->counts[slot] += other.counts[slot];
+    }
+    this->total += other.total;
+    this->min = other.min < this->min ? other.min : this->min;
+    this->max = other.max > this->max ? other.max : this->max;
+    this->sum += other.sum;
+  }
+  uint64_t Count() const noexcept(true) { return this->total; }
+  uint64_t Min() const noexcept(true) { return this->total ? this->min : 0; }
+  uint64_t Max() const noexcept(true) { return this->max; }
+  double Mean() const noexcept(true) {
+    return this->total ? static_cast<double>(this->sum) / this->total : 0;
+  }
+  /**
+   * @brief smallest value such that percentile % of the values are lower or
+   *  equivalent to it
+   */
+  uint64_t ValueAtPercentile(double percentile) const noexcept(true) {
+    uint64_t wanted = static_cast<uint64_t>(
+        std::ceil(percentile / 100.0 * static_cast<double>(this->total)));
+    wanted = wanted == 0 ? 1 : wanted;
+    uint64_t seen = 0;
+    for (size_t slot = 0; slot < this->counts.size(); ++slot) {
+      seen += this->counts[slot];
+      if (seen >= wanted) {
+        uint64_t value = this->highestEquivalent(slot);
+        return value < this->max ? value : this->max;
+      }
+    }
+    return this->max;
+  }
+  /**
+   * @brief prints the usual percentile table
+   * @param unit divisor applied to the values (e.g. 1000 for ns -> us)
+   */
+  void PrintPercentiles(FILE* out, double unit, const char* unitName) const {
+    static const double kPercentiles[] = {50,   75,    90,     95,    99,
+                                          99.9, 99.99, 99.999, 100};
+    fprintf(out, "%12s %10s\n", unitName, "percentile");
+    for (double percentile : kPercentiles) {
+      fprintf(out, "%12.2f %10.3f\n",
+              this->ValueAtPercentile(percentile) / unit, percentile);
+    }
+    fprintf(out, "#[Mean = %.2f, Min = %.2f, Max = %.2f, Count = %lu]\n",
+            this->Mean() / unit, this->Min() / unit, this->Max() / unit,
+            static_cast<unsigned long>(this->total));
+  }
+
+ private:
+  uint64_t highest;                ///< largest value tracked
+  int subBucketBits{1};            ///< log2 of sub-buckets per power of two
+  int subBucketHalfBits{0};        ///< subBucketBits - 1
+  uint64_t subBucketHalfCount{0};  ///< half of the sub-buckets
+  uint64_t subBucketMask{0};       ///< values below it go to bucket 0
+  std::vector<uint64_t> counts;    ///< values per slot
+  uint64_t total{0};               ///< values recorded
+  uint64_t min{UINT64_MAX};        ///< smallest value recorded
+  uint64_t max{0};                 ///< largest value recorded
+  uint64_t sum{0};                 ///< sum of the values, for the mean
+
+  /**
+   * @brief slot of a value
+   */
+  size_t index(uint64_t value) const noexcept(true) {
+    int bucket = 64 - __builtin_clzll(value | this->subBucketMask) -
+                 this->subBucketBits;
+    uint64_t subBucket = value >> bucket;
+    return ((static_cast<size_t>(bucket) + 1) << this->subBucketHalfBits) +
+           (subBucket - this->subBucketHalfCount);
+  }
+  /**
+   * @brief largest value that falls in the same slot
+   */
+  uint64_t highestEquivalent(size_t slot) const noexcept(true) {
+    int bucket = static_cast<int>(slot >> this->subBucketHalfBits) - 1;
+    uint64_t subBucket =
+        (slot & (this->subBucketHalfCount - 1)) + this->subBucketHalfCount;
+    if (bucket < 0) {
+      subBucket -= this->subBucketHalfCount;
+      bucket = 0;
+    }
+    return (subBucket << bucket) + (1ull << bucket) - 1;
+  }
+};
+#endif  // HDR_HISTOGRAM_HPP
@@ -0,0 +1,207 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file IdleMemoryBench.cpp
+ * @brief Memory per idle keep-alive TLS connection of the Lego figure
+ * server, with and without Socket::SSLSetMemoryLean. Every connection gets
+ * one response and then stays open doing nothing.
+ *
+ * Usage: bin/IdleMemoryBench [--cert file] [--connections n] [--lean 0|1]
+ *                            [--port n]
+ *
+ * Each case runs the server in its own process and the clients in another,
+ * so the resident set (RSS) and the heap (mallinfo2) of each side only grow
+ * by its connections. Both processes need two descriptors per connection
+ * or so (ulimit -n); the clients use one listening port per 25000
+ * connections, the ephemeral port range of one destination.
+ */
+#include <malloc.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "BufferPool.hpp"
+#include "FigureServer.hpp"
+#include "PageCache.hpp"
+#include "Socket.hpp"
+
+// connections per listening port
+#define PORT_CONNECTIONS 25000
+
+/**
+ * @brief what one process uses: resident set and heap bytes
+ */
+struct Usage {
+  double rss{0};
+  double heap{0};
+};
+
+static Usage currentUsage() {
+  Usage usage;
+  long pages = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm != nullptr) {
+    if (fscanf(statm, "%*d %ld", &pages) != 1) {
+      pages = 0;
+    }
+    fclose(statm);
+  }
+  usage.rss = static_cast<double>(pages) * sysconf(_SC_PAGESIZE);
+  struct mallinfo2 heap = mallinfo2();
+  usage.heap = heap.uordblks + heap.hblkhd;
+  return usage;
+}
+
+/**
+ * @brief lets the process open as many descriptors as it may
+ */
+static void raiseDescriptorLimit() {
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+/**
+ * @brief client process: opens the connections, reads one response on
+ *  each, writes its usage per connection to done and waits to be killed
+ */
+static void runClients(int port, long connections, bool lean, int done) {
+  const char* request =
+      "GET /lego/figure=elephant HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  std::vector<std::unique_ptr<Socket>> clients;
+  Usage before = currentUsage();
+  char buffer[16384];
+  for (long index = 0; index < connections; ++index) {
+    clients.emplace_back(new Socket('s', false, true));
+    Socket& client = *clients.back();
+    client.SSLSetMemoryLean(lean);
+    client.SSLConnect("127.0.0.1", port + index / PORT_CONNECTIONS);
+    client.SSLWrite(request, strlen(request));
+    std::string response;
+    while (true) {
+      size_t headEnd = response.find("\r\n\r\n");
+      if (headEnd != std::string::npos) {
+        size_t field = response.find("Content-Length: ");
+        if (response.size() >=
+            headEnd + 4 + std::strtoul(&response[field + 16], nullptr, 10)) {
+          break;
+        }
+      }
+      int bytes = client.SSLRead(buffer, sizeof(buffer));
+      if (bytes <= 0) {
+        throw SocketException("Connection closed by server", "runClients",
+                              ECONNRESET, false);
+      }
+      response.append(buffer, bytes);
+    }
+  }
+  Usage after = currentUsage();
+  Usage each{(after.rss - before.rss) / connections,
+             (after.heap - before.heap) / connections};
+  if (write(done, &each, sizeof(each)) != sizeof(each)) {
+    std::quick_exit(1);
+  }
+  pause();
+}
+
+/**
+ * @brief server process: serves connections until the clients report, then
+ *  prints one row
+ */
+static void runServer(const char* cert, int port, long connections,
+                      bool lean) {
+  raiseDescriptorLimit();
+  PageCache cache;
+  cache.Insert("elephant", BenchFigurePage(4096));
+  std::vector<std::unique_ptr<Socket>> listeners;
+  for (long first = 0; first < connections; first += PORT_CONNECTIONS) {
+    listeners.emplace_back(new Socket(
+        's', port + first / PORT_CONNECTIONS, cert, cert));
+    listeners.back()->SSLSetMemoryLean(lean);
+  }
+  int done[2];
+  if (pipe(done) != 0) {
+    perror("pipe");
+    std::quick_exit(1);
+  }
+  // forked before any thread starts, connecting waits in the listen backlog
+  pid_t clients = fork();
+  if (clients == 0) {
+    try {
+      runClients(port, connections, lean, done[1]);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    std::quick_exit(1);
+  }
+  // only the clients write, a failed client ends the read below
+  close(done[1]);
+  Usage before = currentUsage();
+  std::vector<std::unique_ptr<FigureServer>> servers;
+  for (size_t index = 0; index < listeners.size(); ++index) {
+    long count = std::min<long>(PORT_CONNECTIONS,
+                                connections - index * PORT_CONNECTIONS);
+    // the idle connections must outlive the measurement
+    servers.emplace_back(
+        new FigureServer(listeners[index].get(), &cache, 3600));
+    std::thread(&FigureServer::Run, servers.back().get(), count).detach();
+  }
+  Usage client;
+  if (read(done[0], &client, sizeof(client)) != sizeof(client)) {
+    std::cerr << "clients failed" << std::endl;
+    kill(clients, SIGKILL);
+    std::quick_exit(1);
+  }
+  // let the last connections reach their idle wait
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  Usage after = currentUsage();
+  printf("%-6s %8.1f KB RSS %8.1f KB heap per server connection, "
+         "%8.1f KB RSS %8.1f KB heap per client, %zu pool blocks in use\n",
+         lean ? "lean" : "normal",
+         (after.rss - before.rss) / connections / 1024,
+         (after.heap - before.heap) / connections / 1024, client.rss / 1024,
+         client.heap / 1024, BufferPool::Shared().InUse());
+  std::cout.flush();
+  kill(clients, SIGKILL);
+  waitpid(clients, nullptr, 0);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long connections = options.GetInt("connections", 100000);
+  long lean = options.GetInt("lean", -1);
+  int port = options.GetInt("port", BenchDefaultPort());
+  raiseDescriptorLimit();
+  printf("%ld idle keep-alive connections per case\n", connections);
+  std::cout.flush();
+  for (int mode = 0; mode < 2; ++mode) {
+    if (lean >= 0 && lean != mode) {
+      continue;
+    }
+    pid_t server = fork();
+    if (server == 0) {
+      try {
+        runServer(cert, port, connections, mode == 1);
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::quick_exit(1);
+      }
+      // the connection threads never return, leave without waiting for them
+      std::quick_exit(0);
+    }
+    waitpid(server, nullptr, 0);
+    // the next case listens on other ports, this one's are in TIME_WAIT
+    port += (connections + PORT_CONNECTIONS - 1) / PORT_CONNECTIONS;
+  }
+  return 0;
+}
@@ -0,0 +1,291 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file LoadGen.cpp
+ * @brief Load generator built on Socket. Each connection runs in its own
+ * thread, either closed loop (next request as soon as the answer arrives) or
+ * open loop (requests at a constant total rate, latency measured from the
+ * time the request should have been sent, so a stalled server is not hidden).
+ * Reports throughput and an HDR histogram of the latencies.
+ *
+ * Usage: bin/LoadGen [--host addr] [--port n] [--ipv6 0|1] [--tls 0|1]
+ *                    [--protocol echo|http] [--path target] [--payload bytes]
+ *                    [--connections n] [--duration seconds] [--rate req/s]
+ *                    [--reconnect 0|1]
+ *
+ * TC9 echo server (answers once and closes, so --reconnect 1):
+ *   bin/LoadGen --port 5678 --protocol echo --payload 64 --reconnect 1
+ * TC10 Lego figure server (HTTPS, keep-alive):
+ *   bin/LoadGen --port 8080 --tls 1 --protocol http --rate 2000
+ */
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "HdrHistogram.hpp"
+#include "Socket.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief what to run, from the command line
+ */
+struct LoadConfig {
+  std::string host;
+  int port{8080};
+  bool ipv6{false};
+  bool tls{false};
+  bool http{false};
+  bool reconnect{false};
+  std::string path;
+  long payload{64};
+  long connections{4};
+  double duration{10};
+  double rate{0};  ///< total requests/s, 0 means closed loop
+};
+
+/**
+ * @brief results of one connection, added together at the end
+ */
+struct LoadStats {
+  HdrHistogram latencies;
+  uint64_t requests{0};
+  uint64_t errors{0};
+  uint64_t bytes{0};
+};
+
+/**
+ * @brief one client connection, plain or TLS
+ */
+class LoadClient {
+ public:
+  explicit LoadClient(const LoadConfig& config) : config(config) {
+    if (config.http) {
+      this->request = "GET " + config.path +
+                      " HTTP/1.1\r\nHost: localhost\r\n"
+                      "Accept-Encoding: gzip\r\n";
+      if (config.reconnect) {
+        this->request += "Connection: close\r\n";
+      }
+      this->request += "\r\n";
+    } else {
+      // no 0 bytes: the TC9 echo server answers with Write(const char*)
+      for (long index = 0; index < config.payload; ++index) {
+        this->request += static_cast<char>('a' + index % 26);
+      }
+    }
+  }
+  /**
+   * @brief sends one request and waits for its whole answer
+   * @return bytes received
+   * @throws SocketException if the connection fails or closes early
+   */
+  size_t Exchange() {
+    if (!this->socket) {
+      this->open();
+    }
+    this->write(this->request.data(), this->request.size());
+    size_t received = this->config.http ? this->readHttpResponse()
+                                        : this->readEcho();
+    if (this->config.reconnect || this->serverClosing) {
+      this->Reset();
+    }
+    return received;
+  }
+  /**
+   * @brief drops the connection, the next Exchange opens a new one
+   */
+  void Reset() {
+    if (this->socket) {
+      try {
+        this->socket->Close();
+      } catch (const SocketException& e) {
+        // the connection is being dropped anyway
+      }
+      this->socket.reset();
+    }
+    this->pending.clear();
+    this->serverClosing = false;
+  }
+
+ private:
+  const LoadConfig& config;
+  std::unique_ptr<Socket> socket;
+  std::string request;
+  std::string pending;        ///< bytes received past the last answer
+  bool serverClosing{false};  ///< the last answer had "Connection: close"
+
+  void open() {
+    this->socket =
+        std::make_unique<Socket>('s', this->config.ipv6, this->config.tls);
+    if (this->config.tls) {
+      this->socket->SSLConnect(this->config.host.c_str(), this->config.port);
+    } else {
+      this->socket->Connect(this->config.host.c_str(), this->config.port);
+    }
+    this->socket->SetNoDelay();
+  }
+  void write(const char* data, size_t size) {
+    if (this->config.tls) {
+      this->socket->SSLWrite(data, size);
+    } else {
+      this->socket->Write(data, size);
+    }
+  }
+  /**
+   * @brief appends what arrives to pending
+   */
+  void receive() {
+    char buffer[16384];
+    Result<int> bytes = this->config.tls
+                            ? this->socket->TrySSLRead(buffer, sizeof(buffer))
+                            : this->socket->TryRead(buffer, sizeof(buffer));
+    if (!bytes || *bytes == 0) {
+      throw SocketException("Connection closed by server", "LoadClient",
+                            bytes ? ECONNRESET : bytes.Error().value(), false);
+    }
+    this->pending.append(buffer, *bytes);
+  }
+  size_t readEcho() {
+    while (this->pending.size() < this->request.size()) {
+      this->receive();
+    }
+    size_t received = this->pending.size();
+    this->pending.clear();
+    return received;
+  }
+  size_t readHttpResponse() {
+    while (true) {
+      size_t headEnd = this->pending.find("\r\n\r\n");
+      if (headEnd != std::string::npos) {
+        size_t field = this->pending.find("Content-Length: ");
+        if (field == std::string::npos || field > headEnd) {
+          throw SocketException("Response without Content-Length",
+                                "LoadClient", EPROTO, false);
+        }
+        size_t end = headEnd + 4 +
+                     std::strtoul(&this->pending[field + 16], nullptr, 10);
+        if (this->pending.size() >= end) {
+          // e.g. the server's limit of requests per connection
+          size_t close = this->pending.find("Connection: close");
+          this->serverClosing = close != std::string::npos && close < headEnd;
+          this->pending.erase(0, end);
+          return end;
+        }
+      }
+      this->receive();
+    }
+  }
+};
+
+/**
+ * @brief one connection's share of the load
+ */
+static void runConnection(const LoadConfig& config, int id,
+                          Clock::time_point start, Clock::time_point end,
+                          LoadStats& stats) {
+  LoadClient client(config);
+  std::chrono::nanoseconds interval(0);
+  Clock::time_point next = start;
+  if (config.rate > 0) {
+    interval = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 * config.connections / config.rate));
+    // connections take turns instead of all sending at the same instant
+    next += interval * id / config.connections;
+  }
+  while (true) {
+    Clock::time_point intended = Clock::now();
+    if (config.rate > 0) {
+      if (next >= end) {
+        break;
+      }
+      std::this_thread::sleep_until(next);
+      intended = next;
+      next += interval;
+    } else if (intended >= end) {
+      break;
+    }
+    try {
+      stats.bytes += client.Exchange();
+    } catch (const SocketException& e) {
+      ++stats.errors;
+      client.Reset();
+      continue;
+    }
+    stats.latencies.Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             intended)
+            .count());
+    ++stats.requests;
+  }
+  client.Reset();
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  // a server closing the connection must be an error, not kill the process
+  signal(SIGPIPE, SIG_IGN);
+  LoadConfig config;
+  config.ipv6 = options.GetInt("ipv6", 0) != 0;
+  config.host = options.Get("host", config.ipv6 ? "::1" : "127.0.0.1");
+  config.port = options.GetInt("port", 8080);
+  config.tls = options.GetInt("tls", 0) != 0;
+  config.http = strcmp(options.Get("protocol", "echo"), "http") == 0;
+  config.path = options.Get("path", "/lego/figure=elephant");
+  config.payload = options.GetInt("payload", 64);
+  config.connections = options.GetInt("connections", 4);
+  config.duration = atof(options.Get("duration", "10"));
+  config.rate = atof(options.Get("rate", "0"));
+  config.reconnect = options.GetInt("reconnect", 0) != 0;
+  if (config.connections < 1 || config.payload < 1) {
+    std::cerr << "--connections and --payload must be positive" << std::endl;
+    return 1;
+  }
+  printf("%s:%d %s %s %s, %ld connections%s, %s",
+         config.host.c_str(), config.port, config.ipv6 ? "ipv6" : "ipv4",
+         config.tls ? "tls" : "tcp", config.http ? "http" : "echo",
+         config.connections, config.reconnect ? " (new per request)" : "",
+         config.rate > 0 ? "open loop" : "closed loop");
+  if (config.rate > 0) {
+    printf(" at %.0f req/s", config.rate);
+  }
+  if (!config.http) {
+    printf(", %ld B payload", config.payload);
+  }
+  printf("\n");
+
+  std::vector<LoadStats> stats(config.connections);
+  std::vector<std::thread> workers;
+  Clock::time_point start = Clock::now();
+  Clock::time_point end =
+      start + std::chrono::nanoseconds(
+                  static_cast<int64_t>(config.duration * 1e9));
+  for (int id = 0; id < config.connections; ++id) {
+    workers.emplace_back(runConnection, std::cref(config), id, start, end,
+                         std::ref(stats[id]));
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  LoadStats total;
+  for (const LoadStats& connection : stats) {
+    total.latencies.Add(connection.latencies);
+    total.requests += connection.requests;
+    total.errors += connection.errors;
+    total.bytes += connection.bytes;
+  }
+  printf("requests %lu errors %lu in %.2f s\n",
+         static_cast<unsigned long>(total.requests),
+         static_cast<unsigned long>(total.errors), seconds);
+  printf("throughput %.1f req/s %.2f MB/s received\n",
+         total.requests / seconds, total.bytes / seconds / 1e6);
+  total.latencies.PrintPercentiles(stdout, 1000.0, "latency(us)");
+  return 0;
+}
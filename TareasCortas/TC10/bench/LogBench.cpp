@@ -0,0 +1,91 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file LogBench.cpp
+ * @brief Cost of logging from several worker threads at once: the
+ * synchronous std::cout/printf lines the servers used to print against
+ * Logger. The log goes to stdout, redirect it to a file or /dev/null; the
+ * results are printed to stderr.
+ *
+ * A pause (sleep) between messages stands for the wait of a request on the
+ * network; without it the workers outrun any writer and Logger drops what
+ * does not fit in the rings, which is reported.
+ *
+ * Usage: bin/LogBench [--sink cout|printf|logger] [--threads n]
+ *                     [--messages per thread] [--pause us] > /tmp/log.txt
+ */
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "HdrHistogram.hpp"
+#include "Logger.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief one worker: a line like the "Client msg" of the TC10 server per
+ *  message, each call timed
+ */
+static void worker(const char* sink, int id, long messages, long pause,
+                   HdrHistogram& latencies) {
+  const char* message = "<Body><UserName>piro</UserName></Body>";
+  for (long index = 0; index < messages; ++index) {
+    Clock::time_point start = Clock::now();
+    if (sink[0] == 'c') {
+      std::cout << "Client msg: \"" << message << "\" worker " << id
+                << " request " << index << std::endl;
+    } else if (sink[0] == 'p') {
+      printf("Client msg: \"%s\" worker %d request %ld\n", message, id, index);
+      fflush(stdout);
+    } else {
+      Logger::Info("Client msg: \"%s\" worker %d request %ld", message, id,
+                   index);
+    }
+    latencies.Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             start)
+            .count());
+    if (pause > 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(pause));
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* sink = options.Get("sink", "logger");
+  int threads = options.GetInt("threads", 4);
+  long messages = options.GetInt("messages", 100000);
+  long pause = options.GetInt("pause", 0);
+
+  std::vector<HdrHistogram> latencies(threads);
+  std::vector<std::thread> workers;
+  Stopwatch stopwatch;
+  for (int id = 0; id < threads; ++id) {
+    workers.emplace_back(worker, sink, id, messages, pause,
+                         std::ref(latencies[id]));
+  }
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  double calls = stopwatch.Seconds();
+  // the logger is done when the writer has written everything
+  Logger::Flush();
+  double written = stopwatch.Seconds();
+  HdrHistogram total;
+  for (const HdrHistogram& histogram : latencies) {
+    total.Add(histogram);
+  }
+  fprintf(stderr, "%s: %d threads x %ld messages, pause %ld us\n", sink,
+          threads, messages, pause);
+  fprintf(stderr, "calls done in %.3f s (%.0f msg/s), written in %.3f s\n",
+          calls, threads * messages / calls, written);
+  if (sink[0] == 'l') {
+    fprintf(stderr, "dropped %lu\n",
+            static_cast<unsigned long>(Logger::Dropped()));
+  }
+  total.PrintPercentiles(stderr, 1.0, "call(ns)");
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file PageCacheBench.cpp
+ * @brief Requests/sec and bytes on the wire of the Lego figure server with
+ * and without precompressed page variants, over TLS on loopback.
+ *
+ * Usage: bin/PageCacheBench [--cert file] [--requests n] [--clients n]
+ *                           [--page-size bytes] [--port n]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "FigureServer.hpp"
+#include "PageCache.hpp"
+#include "Socket.hpp"
+
+/**
+ * @brief fetches one figure over a new TLS connection
+ * @return response bytes received (head and body)
+ */
+static size_t fetchFigure(int port, const char* acceptEncoding) {
+  char request[256];
+  int length = snprintf(request, sizeof(request),
+                        "GET /lego/figure=elephant HTTP/1.1\r\n"
+                        "Host: localhost\r\n%s%s%s\r\n",
+                        acceptEncoding ? "Accept-Encoding: " : "",
+                        acceptEncoding ? acceptEncoding : "",
+                        acceptEncoding ? "\r\n" : "");
+  Socket client('s', false, true);
+  client.SSLConnect("127.0.0.1", port);
+  client.SSLWrite(request, length);
+  // read the head, then exactly Content-Length bytes of body
+  std::string response;
+  char buffer[16384];
+  size_t headEnd = std::string::npos, expected = 0;
+  while (headEnd == std::string::npos || response.size() < expected) {
+    int bytes = client.SSLRead(buffer, sizeof(buffer));
+    if (bytes <= 0) {
+      break;
+    }
+    response.append(buffer, bytes);
+    if (headEnd == std::string::npos &&
+        (headEnd = response.find("\r\n\r\n")) != std::string::npos) {
+      size_t field = response.find("Content-Length: ");
+      expected = headEnd + 4 + std::strtoul(&response[field + 16], nullptr, 10);
+    }
+  }
+  return response.size();
+}
+
+/**
+ * @brief runs the requests split among the clients and prints one row
+ */
+static void runCase(const char* label, int port, const char* acceptEncoding,
+                    long requests, long clients) {
+  std::vector<std::thread> threads;
+  std::vector<size_t> bytes(clients, 0);
+  Stopwatch stopwatch;
+  for (long index = 0; index < clients; ++index) {
+    threads.emplace_back([&, index] {
+      for (long request = index; request < requests; request += clients) {
+        bytes[index] += fetchFigure(port, acceptEncoding);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double seconds = stopwatch.Seconds();
+  size_t total = 0;
+  for (size_t clientBytes : bytes) {
+    total += clientBytes;
+  }
+  printf("%-10s %10.0f req/s %10zu bytes/req %12.2f MB/s\n", label,
+         requests / seconds, total / requests, total / seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long requests = options.GetInt("requests", 2000);
+  long clients = options.GetInt("clients", 4);
+  long pageSize = options.GetInt("page-size", 16384);
+  int port = options.GetInt("port", BenchDefaultPort());
+  try {
+    PageCache cache;
+    Stopwatch build;
+    cache.Insert("elephant", BenchFigurePage(pageSize));
+    CachedPage page;
+    cache.Find("elephant", page);
+    printf("page %zu bytes, gzip %zu, br %zu, built in %.2f ms\n",
+           page.identity.size(), page.gzip.size(), page.brotli.size(),
+           build.Seconds() * 1e3);
+    Socket server('s', port, cert, cert);
+    FigureServer figureServer(&server, &cache);
+    std::thread(&FigureServer::Run, &figureServer, -1).detach();
+    runCase("identity", port, nullptr, requests, clients);
+    runCase("gzip", port, "gzip", requests, clients);
+    runCase("br", port, "gzip, deflate, br", requests, clients);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout.flush();
+  // the accept loop never returns, leave without waiting for it
+  std::quick_exit(0);
+}
@@ -0,0 +1,125 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file PipelineBench.cpp
+ * @brief Requests/sec of the Lego figure server with a new TLS connection per
+ * request against persistent connections with 1, 8 and 32 pipelined requests.
+ *
+ * Usage: bin/PipelineBench [--cert file] [--requests n] [--clients n]
+ *                          [--page-size bytes] [--port n]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "FigureServer.hpp"
+#include "PageCache.hpp"
+#include "Socket.hpp"
+
+/**
+ * @brief reads responses until count of them are complete
+ * @param pending bytes already received, what is left of the last response
+ *  stays there
+ */
+static void readResponses(Socket& client, std::string& pending, int count) {
+  char buffer[16384];
+  while (count > 0) {
+    size_t headEnd = pending.find("\r\n\r\n");
+    if (headEnd != std::string::npos) {
+      size_t field = pending.find("Content-Length: ");
+      size_t end =
+          headEnd + 4 + std::strtoul(&pending[field + 16], nullptr, 10);
+      if (pending.size() >= end) {
+        pending.erase(0, end);
+        --count;
+        continue;
+      }
+    }
+    int bytes = client.SSLRead(buffer, sizeof(buffer));
+    if (bytes <= 0) {
+      throw SocketException("Connection closed by server", "readResponses",
+                            ECONNRESET, false);
+    }
+    pending.append(buffer, bytes);
+  }
+}
+
+/**
+ * @brief runs requests on one client. depth 0 means a new connection per
+ *  request, otherwise one persistent connection with depth requests in flight
+ */
+static void runClient(int port, int depth, long requests) {
+  const char* request =
+      "GET /lego/figure=elephant HTTP/1.1\r\n"
+      "Host: localhost\r\nAccept-Encoding: gzip\r\n\r\n";
+  const char* closeRequest =
+      "GET /lego/figure=elephant HTTP/1.1\r\n"
+      "Host: localhost\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n";
+  std::string pending;
+  if (depth == 0) {
+    for (long sent = 0; sent < requests; ++sent) {
+      Socket client('s', false, true);
+      client.SSLConnect("127.0.0.1", port);
+      client.SSLWrite(closeRequest, strlen(closeRequest));
+      pending.clear();
+      readResponses(client, pending, 1);
+    }
+    return;
+  }
+  Socket client('s', false, true);
+  client.SSLConnect("127.0.0.1", port);
+  // a whole batch goes in one write, as a pipelining client does
+  std::string batch;
+  for (int index = 0; index < depth; ++index) {
+    batch += request;
+  }
+  for (long sent = 0; sent < requests; sent += depth) {
+    client.SSLWrite(batch.data(), batch.size());
+    readResponses(client, pending, depth);
+  }
+}
+
+static void runCase(const char* label, int port, int depth, long requests,
+                    long clients) {
+  std::vector<std::thread> threads;
+  Stopwatch stopwatch;
+  for (long index = 0; index < clients; ++index) {
+    threads.emplace_back(runClient, port, depth, requests / clients);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double seconds = stopwatch.Seconds();
+  printf("%-16s %10.0f req/s\n", label, requests / seconds);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long requests = options.GetInt("requests", 64000);
+  long clients = options.GetInt("clients", 4);
+  long pageSize = options.GetInt("page-size", 16384);
+  int port = options.GetInt("port", BenchDefaultPort());
+  try {
+    PageCache cache;
+    cache.Insert("elephant", BenchFigurePage(pageSize));
+    Socket server('s', port, cert, cert);
+    // no request limit per connection, the benchmark sets the lengths
+    FigureServer figureServer(&server, &cache, 5, 1 << 30);
+    std::thread(&FigureServer::Run, &figureServer, -1).detach();
+    // connection setup dominates the first case, keep it short
+    runCase("close/request", port, 0, requests / 32, clients);
+    runCase("keep-alive x1", port, 1, requests, clients);
+    runCase("pipeline x8", port, 8, requests, clients);
+    runCase("pipeline x32", port, 32, requests, clients);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout.flush();
+  // the accept loop never returns, leave without waiting for it
+  std::quick_exit(0);
+}
@@ -0,0 +1,98 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file ReadSyscallBench.cpp
+ * @brief System calls SSLRead makes to receive a TLS stream over loopback,
+ * per megabyte and per SSLRead, for several caller buffer sizes. The server
+ * writes full records as fast as it can, the client counts its read and
+ * wait (select/poll) calls with Socket::Stats.
+ *
+ * Usage: bin/ReadSyscallBench [--cert file] [--megabytes n] [--port n]
+ */
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "Socket.hpp"
+
+// bytes given to each write of the server, one full TLS record
+#define CHUNK_SIZE 16384
+
+/**
+ * @brief accepts one client and sends it bytes
+ */
+static void serve(Socket* server, size_t bytes) {
+  Socket* client = server->Accept();
+  try {
+    client->SSLCreate(server);
+    client->SSLAccept();
+    std::vector<char> chunk(CHUNK_SIZE, 'x');
+    for (size_t sent = 0; sent < bytes; sent += chunk.size()) {
+      client->SSLWrite(chunk.data(), chunk.size());
+    }
+    client->Close();
+  } catch (const SocketException& e) {
+    std::cerr << e.what() << std::endl;
+  }
+  delete client;
+}
+
+/**
+ * @brief receives bytes with reads of bufferSize and prints one row
+ */
+static void runCase(Socket& server, int port, size_t bytes, int bufferSize) {
+  std::thread sender(serve, &server, bytes);
+  Socket client('s', false, true);
+  client.SSLConnect("127.0.0.1", port);
+  // the handshake is not part of the count
+  SocketStats before = client.Stats();
+  std::vector<char> buffer(bufferSize);
+  size_t received = 0;
+  uint64_t calls = 0;
+  Stopwatch stopwatch;
+  while (received < bytes) {
+    int read = client.SSLRead(buffer.data(), buffer.size());
+    if (read <= 0) {
+      break;
+    }
+    received += read;
+    ++calls;
+  }
+  double seconds = stopwatch.Seconds();
+  sender.join();
+  const SocketStats& after = client.Stats();
+  double megabytes = received / 1e6;
+  auto delta = [&](SocketCounter counter) {
+    return static_cast<double>(after[counter] - before[counter]);
+  };
+  auto perMegabyte = [&](SocketCounter counter) {
+    return delta(counter) / megabytes;
+  };
+  printf("%5d KB %8.1f MB/s %8.1f SSLRead %8.1f SSL_read %8.1f read "
+         "%8.1f wait /MB %6.2f syscalls/SSLRead\n",
+         bufferSize / 1024, megabytes / seconds,
+         calls / megabytes, perMegabyte(SocketCounter::kSslReadCalls),
+         perMegabyte(SocketCounter::kReadCalls),
+         perMegabyte(SocketCounter::kWaitCalls),
+         (delta(SocketCounter::kReadCalls) + delta(SocketCounter::kWaitCalls)) /
+             calls);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long megabytes = options.GetInt("megabytes", 64);
+  int port = options.GetInt("port", BenchDefaultPort());
+  size_t bytes = megabytes * 1000000;
+  printf("%ld MB of %d byte records per case\n", megabytes, CHUNK_SIZE);
+  try {
+    Socket server('s', port, cert, cert);
+    for (int bufferSize : {4096, 16384, 65536, 262144}) {
+      runCase(server, port, bytes, bufferSize);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
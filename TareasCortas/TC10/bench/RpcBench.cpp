@@ -0,0 +1,195 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file RpcBench.cpp
+ * @brief Messages/sec and bytes/message of the TC10 login exchange as XML
+ * (sprintf + strcmp, as main.cpp does) against binary frames, first the codec
+ * alone and then round trips over plain TCP and TLS on loopback.
+ *
+ * Usage: bin/RpcBench [--cert file] [--messages n] [--round-trips n]
+ *                     [--port n]
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "BenchUtil.hpp"
+#include "Frame.hpp"
+#include "LoginProtocol.hpp"
+#include "Socket.hpp"
+
+static const char* const kXmlRequest =
+    "\n<Body>\n\t<UserName>%s</UserName>\n\t<Password>%s</Password>\n"
+    "</Body>\n";
+static const char* const kXmlResponse =
+    "\n<Body>\n\t<Server>os.ecci.ucr.ac.cr</Server>\n\t<dir>ci0123</dir>\n"
+    "\t<Name>Proyecto Integrador Redes y sistemas Operativos</Name>\n"
+    "\t<NickName>PIRO</NickName>\n\t<Description>Consolidar e integrar los "
+    "conocimientos de redes y sistemas operativos</Description>\n"
+    "\t<Author>profesores PIRO</Author>\n</Body>\n";
+
+static LoginResponse acceptedResponse() {
+  LoginResponse response;
+  response.status = 0;
+  response.server = "os.ecci.ucr.ac.cr";
+  response.dir = "ci0123";
+  response.name = "Proyecto Integrador Redes y sistemas Operativos";
+  response.nickName = "PIRO";
+  response.description =
+      "Consolidar e integrar los conocimientos de redes y sistemas operativos";
+  response.author = "profesores PIRO";
+  return response;
+}
+
+/**
+ * @brief what both sides do per login, without any I/O
+ */
+static void benchCodec(long messages) {
+  char request[1024], response[1024], valid[1024];
+  snprintf(valid, sizeof(valid), kXmlRequest, "piro", "ci0123");
+  size_t checksum = 0, xmlBytes = 0, binaryBytes = 0;
+  Stopwatch stopwatch;
+  for (long message = 0; message < messages; ++message) {
+    int length = snprintf(request, sizeof(request), kXmlRequest, "piro",
+                          "ci0123");
+    checksum += strcmp(valid, request) == 0;
+    xmlBytes = length + strlen(kXmlResponse);
+    checksum += xmlBytes;
+  }
+  double xmlSeconds = stopwatch.Seconds();
+  LoginResponse accepted = acceptedResponse();
+  stopwatch.Reset();
+  for (long message = 0; message < messages; ++message) {
+    size_t requestSize =
+        LoginRequest{"piro", "ci0123"}.Encode(request, sizeof(request));
+    FrameReader requestReader(request, requestSize);
+    LoginRequest decoded;
+    checksum += LoginRequest::Decode(requestReader, decoded) &&
+                decoded.password == "ci0123";
+    size_t responseSize = accepted.Encode(response, sizeof(response));
+    FrameReader responseReader(response, responseSize);
+    LoginResponse answer;
+    checksum += LoginResponse::Decode(responseReader, answer);
+    binaryBytes = requestSize + responseSize;
+  }
+  double binarySeconds = stopwatch.Seconds();
+  printf("codec  xml    %12.0f msg/s %6zu bytes/login\n",
+         messages / xmlSeconds, xmlBytes);
+  printf("codec  binary %12.0f msg/s %6zu bytes/login\n",
+         messages / binarySeconds, binaryBytes);
+  printf("checksum %zu\n", checksum);
+}
+
+/**
+ * @brief server side of one connection: answers logins until it closes
+ */
+static void serveLogins(Socket* client, bool ssl, bool binary) {
+  char buffer[1024], valid[1024];
+  snprintf(valid, sizeof(valid), kXmlRequest, "piro", "ci0123");
+  LoginResponse accepted = acceptedResponse();
+  try {
+    if (binary) {
+      FrameChannel channel(client, ssl);
+      while (true) {
+        FrameReader reader = channel.Receive();
+        LoginRequest request;
+        LoginRequest::Decode(reader, request);
+        channel.Send(buffer, accepted.Encode(buffer, sizeof(buffer)));
+      }
+    }
+    while (true) {
+      int bytes = ssl ? client->SSLRead(buffer, sizeof(buffer) - 1)
+                      : client->Read(buffer, sizeof(buffer) - 1);
+      if (bytes <= 0) {
+        break;
+      }
+      buffer[bytes] = '\0';
+      const char* answer = strcmp(valid, buffer) ? "Invalid Message"
+                                                 : kXmlResponse;
+      if (ssl) {
+        client->SSLWrite(answer, strlen(answer));
+      } else {
+        client->Write(answer);
+      }
+    }
+  } catch (const SocketException& e) {
+    // the client closed the connection
+  }
+}
+
+/**
+ * @brief login round trips over one persistent connection
+ */
+static void benchRoundTrips(const char* label, Socket* server, int port,
+                            bool ssl, bool binary, long roundTrips) {
+  std::thread worker([server, ssl, binary] {
+    Socket* client = server->Accept();
+    if (ssl) {
+      client->SSLCreate(server);
+      client->SSLAccept();
+    }
+    serveLogins(client, ssl, binary);
+    client->Close();
+    delete client;
+  });
+  Socket client('s', false, ssl);
+  if (ssl) {
+    client.SSLConnect("127.0.0.1", port);
+  } else {
+    client.Connect("127.0.0.1", port);
+  }
+  client.SetNoDelay();
+  char request[1024], response[1024];
+  size_t bytes = 0;
+  Stopwatch stopwatch;
+  if (binary) {
+    FrameChannel channel(&client, ssl);
+    for (long trip = 0; trip < roundTrips; ++trip) {
+      size_t size = LoginRequest{"piro", "ci0123"}.Encode(request,
+                                                         sizeof(request));
+      channel.Send(request, size);
+      FrameReader reader = channel.Receive();
+      LoginResponse answer;
+      LoginResponse::Decode(reader, answer);
+      bytes += size + answer.author.size();
+    }
+  } else {
+    for (long trip = 0; trip < roundTrips; ++trip) {
+      int size = snprintf(request, sizeof(request), kXmlRequest, "piro",
+                          "ci0123");
+      if (ssl) {
+        client.SSLWrite(request, size);
+        bytes += size + client.SSLRead(response, sizeof(response));
+      } else {
+        client.Write(request, size);
+        bytes += size + client.Read(response, sizeof(response));
+      }
+    }
+  }
+  double seconds = stopwatch.Seconds();
+  client.Close();
+  worker.join();
+  printf("%-6s %-6s %12.0f msg/s\n", label, binary ? "binary" : "xml",
+         roundTrips / seconds);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long messages = options.GetInt("messages", 2000000);
+  long roundTrips = options.GetInt("round-trips", 50000);
+  int port = options.GetInt("port", BenchDefaultPort());
+  try {
+    benchCodec(messages);
+    Socket plain('s', port);
+    benchRoundTrips("tcp", &plain, port, false, false, roundTrips);
+    benchRoundTrips("tcp", &plain, port, false, true, roundTrips);
+    Socket tls('s', port + 1, cert, cert);
+    benchRoundTrips("tls", &tls, port + 1, true, false, roundTrips);
+    benchRoundTrips("tls", &tls, port + 1, true, true, roundTrips);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,213 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file SlowReaderBench.cpp
+ * @brief Throughput and writer CPU time of three ways to send TLS data to
+ * consumers that read slower than the server writes, on non-blocking
+ * sockets over loopback:
+ *  - spin: TrySSLWrite retried at once on EAGAIN, what the old recursive
+ *    SSLWrite did, one thread per consumer
+ *  - SSLWrite: waits for the socket between records, one thread per
+ *    consumer
+ *  - SSLSend: one thread for every consumer, output queued by SSLSend and
+ *    written by SSLFlush on epoll writability events
+ *
+ * Usage: bin/SlowReaderBench [--cert file] [--consumers n] [--megabytes n]
+ *                            [--pause-us n] [--buffer-kb n] [--port n]
+ *
+ * Loopback grows socket buffers to megabytes, which would hide the slow
+ * reader, so both ends are limited to buffer-kb as on a long path.
+ */
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "Socket.hpp"
+
+// bytes given to each write, one full TLS record
+#define CHUNK_SIZE 16384
+// SSLSend mode produces more output once the queue is below this
+#define LOW_WATER (4 * CHUNK_SIZE)
+
+enum class Mode { kSpin, kSSLWrite, kSSLSend };
+
+static const char* const kModeNames[] = {"spin", "SSLWrite", "SSLSend"};
+
+/**
+ * @brief CPU seconds used by the calling thread so far
+ */
+static double threadCpuSeconds() {
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * @brief limits the kernel buffer of socket in one direction
+ */
+static void limitBuffer(Socket& socket, int option, int size) {
+  setsockopt(socket.GetIDSocket(), SOL_SOCKET, option, &size, sizeof(size));
+}
+
+/**
+ * @brief a slow consumer: reads bytes, pausing after every read
+ */
+static void consume(int port, size_t bytes, long pauseUs, int bufferSize) {
+  Socket client('s', false, true);
+  limitBuffer(client, SO_RCVBUF, bufferSize);
+  client.SSLConnect("127.0.0.1", port);
+  char buffer[CHUNK_SIZE];
+  for (size_t received = 0; received < bytes;) {
+    int read = client.SSLRead(buffer, sizeof(buffer));
+    if (read <= 0) {
+      break;
+    }
+    received += read;
+    std::this_thread::sleep_for(std::chrono::microseconds(pauseUs));
+  }
+}
+
+/**
+ * @brief one writer thread per consumer, spinning or waiting
+ */
+static double writeEach(Mode mode, std::vector<std::unique_ptr<Socket>>& all,
+                        size_t bytes) {
+  std::vector<std::thread> writers;
+  std::vector<double> cpu(all.size(), 0);
+  for (size_t index = 0; index < all.size(); ++index) {
+    writers.emplace_back([&, index] {
+      Socket* socket = all[index].get();
+      std::vector<char> chunk(CHUNK_SIZE, 'x');
+      for (size_t sent = 0; sent < bytes;) {
+        if (mode == Mode::kSSLWrite) {
+          sent += socket->SSLWrite(chunk.data(), chunk.size());
+          continue;
+        }
+        Result<int> written = socket->TrySSLWrite(chunk.data(), chunk.size());
+        if (written) {
+          sent += *written;
+        } else if (written.Error() !=
+                   std::errc::resource_unavailable_try_again) {
+          break;
+        }
+      }
+      cpu[index] = threadCpuSeconds();
+    });
+  }
+  double total = 0;
+  for (size_t index = 0; index < writers.size(); ++index) {
+    writers[index].join();
+    total += cpu[index];
+  }
+  return total;
+}
+
+/**
+ * @brief one writer thread for all consumers, driven by epoll
+ */
+static double writeQueued(std::vector<std::unique_ptr<Socket>>& all,
+                          size_t bytes) {
+  int epollId = epoll_create1(EPOLL_CLOEXEC);
+  std::vector<size_t> left(all.size(), bytes);
+  std::vector<char> chunk(CHUNK_SIZE, 'x');
+  size_t active = all.size();
+  for (size_t index = 0; index < all.size(); ++index) {
+    epoll_event event{};
+    event.events = EPOLLOUT;
+    event.data.u64 = index;
+    epoll_ctl(epollId, EPOLL_CTL_ADD, all[index]->GetIDSocket(), &event);
+  }
+  epoll_event events[64];
+  while (active > 0) {
+    int count = epoll_wait(epollId, events, 64, -1);
+    for (int ready = 0; ready < count; ++ready) {
+      size_t index = events[ready].data.u64;
+      Socket* socket = all[index].get();
+      Result<size_t> queued = socket->SSLFlush();
+      // keep some output queued so every event has something to write
+      while (queued && *queued < LOW_WATER && left[index] > 0) {
+        size_t size = std::min<size_t>(CHUNK_SIZE, left[index]);
+        left[index] -= size;
+        queued = socket->SSLSend(chunk.data(), size);
+      }
+      if (!queued || (*queued == 0 && left[index] == 0)) {
+        epoll_ctl(epollId, EPOLL_CTL_DEL, socket->GetIDSocket(), nullptr);
+        --active;
+        continue;
+      }
+      epoll_event event{};
+      event.events = socket->SSLWantsWrite() ? EPOLLOUT : EPOLLIN;
+      event.data.u64 = index;
+      epoll_ctl(epollId, EPOLL_CTL_MOD, socket->GetIDSocket(), &event);
+    }
+  }
+  close(epollId);
+  return threadCpuSeconds();
+}
+
+/**
+ * @brief connects the consumers, sends bytes to each and prints one row
+ */
+static void runCase(Mode mode, Socket& server, int port, long consumers,
+                    size_t bytes, long pauseUs, int bufferSize) {
+  std::vector<std::thread> readers;
+  std::vector<std::unique_ptr<Socket>> accepted;
+  for (long index = 0; index < consumers; ++index) {
+    readers.emplace_back(consume, port, bytes, pauseUs, bufferSize);
+    accepted.emplace_back(server.Accept());
+    limitBuffer(*accepted.back(), SO_SNDBUF, bufferSize);
+    accepted.back()->SSLCreate(&server);
+    accepted.back()->SSLAccept();
+    accepted.back()->SetNonBlocking();
+  }
+  Stopwatch stopwatch;
+  double cpu = 0;
+  if (mode == Mode::kSSLSend) {
+    // on its own thread so its CPU time is only the writing
+    std::thread writer([&] { cpu = writeQueued(accepted, bytes); });
+    writer.join();
+  } else {
+    cpu = writeEach(mode, accepted, bytes);
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  double seconds = stopwatch.Seconds();
+  printf("%-9s %8.1f MB/s %8.3f s writer CPU %6.1f%% of wall time\n",
+         kModeNames[static_cast<int>(mode)],
+         consumers * bytes / seconds / 1e6, cpu, 100 * cpu / seconds);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  const char* cert = options.Get("cert", BenchDefaultCert());
+  long consumers = options.GetInt("consumers", 8);
+  long megabytes = options.GetInt("megabytes", 16);
+  long pauseUs = options.GetInt("pause-us", 1000);
+  int bufferSize = options.GetInt("buffer-kb", 64) * 1024;
+  int port = options.GetInt("port", BenchDefaultPort());
+  size_t bytes = megabytes * 1000000;
+  printf("%ld consumers, %ld MB each, %ld us pause per read, %d KB buffers\n",
+         consumers, megabytes, pauseUs, bufferSize / 1024);
+  try {
+    Socket server('s', port, cert, cert);
+    runCase(Mode::kSpin, server, port, consumers, bytes, pauseUs,
+            bufferSize);
+    runCase(Mode::kSSLWrite, server, port, consumers, bytes, pauseUs,
+            bufferSize);
+    runCase(Mode::kSSLSend, server, port, consumers, bytes, pauseUs,
+            bufferSize);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
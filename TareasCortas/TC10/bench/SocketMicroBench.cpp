@@ -0,0 +1,390 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file SocketMicroBench.cpp
+ * @brief Cost per call of every Socket primitive, with Google Benchmark. Only
+ * socketpairs and loopback are used, so it runs without a network. Results go
+ * to JSON with "make microbench" and two runs can be compared with
+ * compare.py from Google Benchmark.
+ *
+ * Usage: bin/SocketMicroBench [--cert file] [--port n] [--benchmark_...]
+ */
+#include <benchmark/benchmark.h>
+#include <openssl/pem.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include "BenchUtil.hpp"
+#include "PeerIdentity.hpp"
+#include "Socket.hpp"
+#include "Trace.hpp"
+
+static const char* certFile = nullptr;
+static int basePort = 0;
+
+/**
+ * @brief listeners shared by every run: each benchmark function is called
+ *  several times and a port with connections in TIME_WAIT can't be bound again
+ */
+static Socket& plainListener() {
+  static Socket listener('s', basePort);
+  return listener;
+}
+static Socket& tlsListener() {
+  static Socket listener('s', basePort + 1, certFile, certFile);
+  return listener;
+}
+
+/**
+ * @brief a connected pair of stream sockets, no network involved
+ */
+class SocketPair {
+ public:
+  SocketPair() {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, this->fds) == -1) {
+      throw SocketException("socketpair failed", "SocketPair", errno, false);
+    }
+    this->left = std::make_unique<Socket>(this->fds[0]);
+    this->right = std::make_unique<Socket>(this->fds[1]);
+  }
+  ~SocketPair() {
+    close(this->fds[0]);
+    close(this->fds[1]);
+  }
+  int fds[2];
+  std::unique_ptr<Socket> left;
+  std::unique_ptr<Socket> right;
+};
+
+/**
+ * @brief a TLS connection over loopback, both ends owned by this thread once
+ *  the handshake is done
+ */
+class TlsPair {
+ public:
+  TlsPair() : client('s', false, true) {
+    // the listener must exist before the client connects
+    Socket& listener = tlsListener();
+    std::thread connector([this] {
+      this->client.SSLConnect("127.0.0.1", basePort + 1);
+    });
+    this->server.reset(listener.Accept());
+    this->server->SSLCreate(&listener);
+    this->server->SSLAccept();
+    connector.join();
+  }
+  ~TlsPair() {
+    this->client.Close();
+    this->server->Close();
+  }
+  Socket client;
+  std::unique_ptr<Socket> server;
+};
+
+static void BM_Write(benchmark::State& state) {
+  SocketPair pair;
+  std::string message(state.range(0), 'x');
+  char drain[65536];
+  // a unix socket charges a few hundred bytes per write against its buffer,
+  // empty it every batch so Write never blocks
+  const int64_t batch = std::min<int64_t>(64, 65536 / state.range(0));
+  int64_t written = 0;
+  for (auto _ : state) {
+    pair.left->Write(message.data(), message.size());
+    if (++written % batch == 0) {
+      state.PauseTiming();
+      for (int64_t left = batch * state.range(0); left > 0;) {
+        left -= pair.right->Read(drain, sizeof(drain));
+      }
+      state.ResumeTiming();
+    }
+  }
+  state.SetBytesProcessed(written * state.range(0));
+}
+BENCHMARK(BM_Write)->Arg(64)->Arg(1024)->Arg(16384);
+
+static void BM_Read(benchmark::State& state) {
+  SocketPair pair;
+  std::string batchData(65536 - 65536 % state.range(0), 'x');
+  char buffer[16384];
+  int64_t read = 0, available = 0;
+  for (auto _ : state) {
+    if (available == 0) {
+      state.PauseTiming();
+      pair.left->Write(batchData.data(), batchData.size());
+      available = batchData.size();
+      state.ResumeTiming();
+    }
+    int bytes = pair.right->Read(buffer, state.range(0));
+    available -= bytes;
+    read += bytes;
+  }
+  state.SetBytesProcessed(read);
+}
+BENCHMARK(BM_Read)->Arg(64)->Arg(1024)->Arg(16384);
+
+static void BM_Connect(benchmark::State& state) {
+  Socket& listener = plainListener();
+  for (auto _ : state) {
+    Socket client('s');
+    client.Connect("127.0.0.1", basePort);
+    state.PauseTiming();
+    std::unique_ptr<Socket> accepted(listener.Accept());
+    accepted->Close();
+    client.Close();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_Connect);
+
+static void BM_Accept(benchmark::State& state) {
+  Socket& listener = plainListener();
+  for (auto _ : state) {
+    state.PauseTiming();
+    Socket client('s');
+    client.Connect("127.0.0.1", basePort);
+    state.ResumeTiming();
+    std::unique_ptr<Socket> accepted(listener.Accept());
+    state.PauseTiming();
+    accepted->Close();
+    client.Close();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_Accept);
+
+static void BM_SendToRecvFrom(benchmark::State& state) {
+  int port = basePort + 2;
+  Socket receiver('d');
+  receiver.Bind(port);
+  Socket sender('d');
+  sockaddr_in destination{};
+  destination.sin_family = AF_INET;
+  destination.sin_port = htons(port);
+  destination.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sockaddr_in source{};
+  std::string message(state.range(0), 'x');
+  char buffer[65536];
+  for (auto _ : state) {
+    sender.sendTo(message.data(), message.size(), &destination);
+    receiver.recvFrom(buffer, sizeof(buffer), &source);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SendToRecvFrom)->Arg(64)->Arg(1024)->Arg(8192);
+
+static void BM_SSLAccept(benchmark::State& state) {
+  Socket& listener = tlsListener();
+  for (auto _ : state) {
+    state.PauseTiming();
+    // the client side of the handshake runs in its own thread
+    std::thread connector([] {
+      Socket client('s', false, true);
+      client.SSLConnect("127.0.0.1", basePort + 1);
+      client.Close();
+    });
+    std::unique_ptr<Socket> accepted(listener.Accept());
+    state.ResumeTiming();
+    accepted->SSLCreate(&listener);
+    accepted->SSLAccept();
+    state.PauseTiming();
+    connector.join();
+    accepted->Close();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(BM_SSLAccept)->UseRealTime();
+
+static void BM_SSLWrite(benchmark::State& state) {
+  TlsPair pair;
+  std::string message(state.range(0), 'x');
+  char drain[16384];
+  const int64_t batch = 65536 / state.range(0);
+  int64_t written = 0;
+  for (auto _ : state) {
+    pair.client.SSLWrite(message.data(), message.size());
+    if (++written % batch == 0) {
+      state.PauseTiming();
+      for (int64_t left = batch * state.range(0); left > 0;) {
+        left -= pair.server->SSLRead(drain, sizeof(drain));
+      }
+      state.ResumeTiming();
+    }
+  }
+  state.SetBytesProcessed(written * state.range(0));
+}
+BENCHMARK(BM_SSLWrite)->Arg(64)->Arg(1024)->Arg(16384);
+
+static void BM_SSLRead(benchmark::State& state) {
+  TlsPair pair;
+  std::string message(state.range(0), 'x');
+  char buffer[16384];
+  const int64_t batch = 65536 / state.range(0);
+  int64_t read = 0, available = 0;
+  for (auto _ : state) {
+    if (available == 0) {
+      state.PauseTiming();
+      for (int64_t record = 0; record < batch; ++record) {
+        pair.client.SSLWrite(message.data(), message.size());
+      }
+      available = batch * state.range(0);
+      state.ResumeTiming();
+    }
+    int bytes = pair.server->SSLRead(buffer, state.range(0));
+    available -= bytes;
+    read += bytes;
+  }
+  state.SetBytesProcessed(read);
+}
+BENCHMARK(BM_SSLRead)->Arg(64)->Arg(1024)->Arg(16384);
+
+static void BM_SocketExceptionThrow(benchmark::State& state) {
+  int64_t caught = 0;
+  for (auto _ : state) {
+    try {
+      throw SocketException("Error reading from socket", "Socket::Read",
+                            ECONNRESET, false);
+    } catch (const SocketException& e) {
+      ++caught;
+    }
+  }
+  benchmark::DoNotOptimize(caught);
+}
+BENCHMARK(BM_SocketExceptionThrow);
+
+static void BM_SocketExceptionWhat(benchmark::State& state) {
+  size_t length = 0;
+  for (auto _ : state) {
+    try {
+      throw SocketException("Error reading from socket", "Socket::Read",
+                            ECONNRESET, false);
+    } catch (const SocketException& e) {
+      length += strlen(e.what());
+    }
+  }
+  benchmark::DoNotOptimize(length);
+}
+BENCHMARK(BM_SocketExceptionWhat);
+
+static void BM_ReadClosedThrow(benchmark::State& state) {
+  SocketPair pair;
+  shutdown(pair.fds[1], SHUT_WR);
+  char buffer[64];
+  for (auto _ : state) {
+    try {
+      pair.left->Read(buffer, sizeof(buffer));
+    } catch (const SocketException& e) {
+      benchmark::DoNotOptimize(&e);
+    }
+  }
+}
+BENCHMARK(BM_ReadClosedThrow);
+
+static void BM_TryReadClosed(benchmark::State& state) {
+  SocketPair pair;
+  shutdown(pair.fds[1], SHUT_WR);
+  char buffer[64];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pair.left->TryRead(buffer, sizeof(buffer)));
+  }
+}
+BENCHMARK(BM_TryReadClosed);
+
+static void BM_SocketMetricsAdd(benchmark::State& state) {
+  for (auto _ : state) {
+    SocketMetrics::Add(SocketCounter::kBytesIn, 64);
+  }
+}
+BENCHMARK(BM_SocketMetricsAdd);
+
+static void BM_TraceScope(benchmark::State& state) {
+  for (auto _ : state) {
+    TraceScope scope(TracePhase::kHandler, 1);
+  }
+}
+BENCHMARK(BM_TraceScope);
+
+/**
+ * @brief the certificate of the bench, standing for a peer certificate
+ */
+static X509* benchCertificate() {
+  static X509* certificate = [] {
+    FILE* file = fopen(certFile, "r");
+    X509* read = file ? PEM_read_X509(file, nullptr, nullptr, nullptr)
+                      : nullptr;
+    if (file) {
+      fclose(file);
+    }
+    return read;
+  }();
+  return certificate;
+}
+
+// what SSLShowCerts did on every call: format both names into fresh strings
+static void BM_PeerNamesPerCall(benchmark::State& state) {
+  X509* certificate = benchCertificate();
+  for (auto _ : state) {
+    char* subject =
+        X509_NAME_oneline(X509_get_subject_name(certificate), nullptr, 0);
+    char* issuer =
+        X509_NAME_oneline(X509_get_issuer_name(certificate), nullptr, 0);
+    benchmark::DoNotOptimize(subject);
+    benchmark::DoNotOptimize(issuer);
+    OPENSSL_free(subject);
+    OPENSSL_free(issuer);
+  }
+}
+BENCHMARK(BM_PeerNamesPerCall);
+
+// done once per connection now
+static void BM_PeerIdentityLoad(benchmark::State& state) {
+  X509* certificate = benchCertificate();
+  PeerIdentity identity;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(identity.Load(certificate, X509_V_OK));
+  }
+}
+BENCHMARK(BM_PeerIdentityLoad);
+
+// per request: a cached identity against 1000 pinned certificates
+static void BM_PeerAllowlistAllows(benchmark::State& state) {
+  PeerIdentity identity;
+  identity.Load(benchCertificate(), X509_V_OK);
+  PeerAllowlist allowlist;
+  PeerFingerprint other{};
+  for (int index = 0; index < 999; ++index) {
+    memcpy(other.data(), &index, sizeof(index));
+    allowlist.Add(other);
+  }
+  allowlist.Add(identity.Fingerprint());
+  time_t now = time(nullptr);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(allowlist.Allows(&identity, now));
+  }
+}
+BENCHMARK(BM_PeerAllowlistAllows);
+
+static void BM_SSLPeer(benchmark::State& state) {
+  TlsPair pair;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pair.client.SSLPeer());
+  }
+}
+BENCHMARK(BM_SSLPeer);
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  // closing a TLS pair sends close_notify to a peer that may be gone already
+  signal(SIGPIPE, SIG_IGN);
+  BenchOptions options(argc, argv);
+  certFile = options.Get("cert", BenchDefaultCert());
+  basePort = options.GetInt("port", BenchDefaultPort());
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,190 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file SocketOptionsBench.cpp
+ * @brief Effect of each SocketOptions profile on an echo server over TCP
+ * loopback, with three workloads.
+ *
+ * Usage: bin/SocketOptionsBench [--seconds n] [--small-megabytes n]
+ *                               [--megabytes n] [--profile name] [--port n]
+ *
+ * The server echoes whole frames: it waits until a frame is complete and
+ * writes back every complete frame it has in one write. The profile is set
+ * on the listener (the accepted connection inherits it) and on the client.
+ * - request: one 64 byte request at a time, written as a 16 byte header
+ *   and a 48 byte body, as many as fit in the given seconds. This is where
+ *   Nagle and delayed ACKs meet: the body waits for the ACK of the header,
+ *   which the server delays because it has nothing to answer yet.
+ * - small: a stream of 128 byte frames, one write each, echoed while more
+ *   are written.
+ * - bulk: a stream of 64 KB frames.
+ */
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "HdrHistogram.hpp"
+#include "Socket.hpp"
+
+// bytes of a request and of its header
+#define REQUEST_SIZE 64
+#define HEADER_SIZE 16
+// frame of the small workload
+#define SMALL_FRAME 128
+// frame of the bulk workload
+#define BULK_FRAME 65536
+
+static const char* const kProfiles[] = {"default", "low-latency", "bulk",
+                                        "long-lived"};
+
+static void writeAll(Socket* socket, const char* buffer, size_t size) {
+  for (size_t done = 0; done < size;) {
+    Result<int> written = socket->TryWrite(buffer + done, size - done);
+    if (!written) {
+      throw SocketException("Error writing to socket", "writeAll",
+                            written.Error().value(), false);
+    }
+    done += *written;
+  }
+}
+
+/**
+ * @brief echoes the complete frames of frame bytes until the peer closes
+ */
+static void echo(Socket* connection, size_t frame) {
+  std::vector<char> buffer(1 << 20);
+  size_t held = 0;
+  while (true) {
+    Result<int> bytes =
+        connection->TryRead(buffer.data() + held, buffer.size() - held);
+    if (!bytes || *bytes == 0) {
+      return;
+    }
+    held += *bytes;
+    size_t complete = held - held % frame;
+    if (complete > 0) {
+      writeAll(connection, buffer.data(), complete);
+      memmove(buffer.data(), buffer.data() + complete, held - complete);
+      held -= complete;
+    }
+  }
+}
+
+/**
+ * @brief a listener and a client with the profile, connected, and the
+ *  thread that echoes frames of frame bytes on the accepted side
+ */
+class EchoPair {
+ public:
+  EchoPair(const SocketOptions& options, int port, size_t frame)
+      : listener('s', port) {
+    this->listener.SetOptions(options);
+    this->client.SetOptions(options);
+    this->client.Connect("127.0.0.1", port);
+    this->server = std::thread([this, frame]() {
+      std::unique_ptr<Socket> accepted(this->listener.Accept());
+      echo(accepted.get(), frame);
+      // accepted sockets are closed explicitly, as FigureServer does
+      accepted->Close();
+    });
+  }
+  ~EchoPair() {
+    this->client.Shutdown(SHUT_WR);
+    this->server.join();
+    // the passive constructor leaves closing to the caller
+    this->listener.Close();
+  }
+  Socket& Client() { return this->client; }
+
+ private:
+  Socket listener;
+  Socket client{'s'};
+  std::thread server;
+};
+
+/**
+ * @brief requests answered within seconds, latencies in nanoseconds
+ */
+static long benchRequests(const SocketOptions& options, int port,
+                          double seconds, HdrHistogram* latencies) {
+  EchoPair pair(options, port, REQUEST_SIZE);
+  char request[REQUEST_SIZE];
+  memset(request, 'r', sizeof(request));
+  long requests = 0;
+  Stopwatch stopwatch;
+  while (stopwatch.Seconds() < seconds) {
+    auto start = std::chrono::steady_clock::now();
+    writeAll(&pair.Client(), request, HEADER_SIZE);
+    writeAll(&pair.Client(), request + HEADER_SIZE,
+             REQUEST_SIZE - HEADER_SIZE);
+    for (int done = 0; done < REQUEST_SIZE;) {
+      done += pair.Client().Read(request + done, REQUEST_SIZE - done);
+    }
+    latencies->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+    ++requests;
+  }
+  return requests;
+}
+
+/**
+ * @brief MB/s echoing bytes in frame sized writes
+ */
+static double benchStream(const SocketOptions& options, int port,
+                          long bytes, size_t frame) {
+  EchoPair pair(options, port, frame);
+  long frames = bytes / frame;
+  Stopwatch stopwatch;
+  std::thread writer([&pair, frames, frame]() {
+    std::vector<char> buffer(frame, 'x');
+    for (long index = 0; index < frames; ++index) {
+      writeAll(&pair.Client(), buffer.data(), frame);
+    }
+  });
+  std::vector<char> buffer(1 << 20);
+  for (long left = frames * frame; left > 0;) {
+    left -= pair.Client().Read(buffer.data(), buffer.size());
+  }
+  writer.join();
+  return frames * frame / stopwatch.Seconds() / 1e6;
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  double seconds = options.GetInt("seconds", 2);
+  long smallMegabytes = options.GetInt("small-megabytes", 64);
+  long megabytes = options.GetInt("megabytes", 1024);
+  const char* only = options.Get("profile", nullptr);
+  int port = options.GetInt("port", BenchDefaultPort());
+  printf("request: %d bytes in two writes for %.0f s; small: %ld MB in %d "
+         "byte frames; bulk: %ld MB in %d byte frames\n",
+         REQUEST_SIZE, seconds, smallMegabytes, SMALL_FRAME, megabytes,
+         BULK_FRAME);
+  printf("%-12s %11s %9s %9s %10s %10s\n", "profile", "requests/s",
+         "p50 us", "p99 us", "small MB/s", "bulk MB/s");
+  for (const char* name : kProfiles) {
+    if (only != nullptr && strcmp(only, name) != 0) {
+      continue;
+    }
+    SocketOptions profile;
+    SocketOptions::Named(name, profile);
+    try {
+      HdrHistogram latencies(10000000000ull);
+      long requests = benchRequests(profile, port++, seconds, &latencies);
+      double small = benchStream(profile, port++, smallMegabytes << 20,
+                                 SMALL_FRAME);
+      double bulk = benchStream(profile, port++, megabytes << 20,
+                                BULK_FRAME);
+      printf("%-12s %11.0f %9.1f %9.1f %10.0f %10.0f\n", name,
+             requests / seconds, latencies.ValueAtPercentile(50) / 1e3,
+             latencies.ValueAtPercentile(99) / 1e3, small, bulk);
+      std::cout.flush();
+    } catch (const SocketException& e) {
+      std::cerr << name << ": " << e.what() << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,228 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file UnixSocketBench.cpp
+ * @brief Latency and throughput between two threads of one host over TCP
+ * loopback, over AF_UNIX stream, seqpacket and datagram sockets and over a
+ * ShmChannel (shared memory rings set up on an AF_UNIX connection).
+ *
+ * Usage: bin/UnixSocketBench [--round-trips n] [--message bytes]
+ *                            [--megabytes n] [--chunk bytes] [--port n]
+ *
+ * Latency: the client writes a message and waits for the echo, round-trips
+ * times; the percentiles are of one round trip. Throughput: the client
+ * writes megabytes in chunk sized writes and the other thread reads them.
+ * The AF_UNIX sockets use abstract names, TCP sets TCP_NODELAY. The two
+ * threads stand for two processes: none of the transports can tell.
+ */
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "HdrHistogram.hpp"
+#include "ShmChannel.hpp"
+#include "Socket.hpp"
+
+/**
+ * @brief one way of connecting the two threads
+ */
+struct Transport {
+  const char* name;
+  bool tcp;
+  char type;  ///< Socket type: 's', 'q' or 'd'
+  bool shm;   ///< a ShmChannel on top of the connection
+};
+
+static const Transport kTransports[] = {{"tcp", true, 's', false},
+                                        {"unix-stream", false, 's', false},
+                                        {"unix-seqpacket", false, 'q', false},
+                                        {"unix-dgram", false, 'd', false},
+                                        {"shm-ring", false, 's', true}};
+
+/**
+ * @brief both ends of a connection, and the listener if there is one
+ */
+struct Connection {
+  std::unique_ptr<Socket> listener;
+  std::unique_ptr<Socket> client;
+  std::unique_ptr<Socket> server;
+  /// the channels, for the shared memory transport
+  std::unique_ptr<ShmChannel> clientChannel;
+  std::unique_ptr<ShmChannel> serverChannel;
+  bool stream{false};  ///< messages may arrive split or merged
+
+  ~Connection() {
+    this->clientChannel.reset();
+    this->serverChannel.reset();
+    // accepted sockets are closed explicitly, as FigureServer does
+    if (this->listener != nullptr && this->server != nullptr) {
+      this->server->Close();
+    }
+  }
+};
+
+/**
+ * @brief connects a client and a server socket of transport
+ */
+static void connect(const Transport& transport, int port,
+                    Connection* connection) {
+  connection->stream = transport.type == 's';
+  std::string name =
+      "@tc10-bench-" + std::to_string(getpid()) + "-" + transport.name;
+  if (transport.tcp) {
+    connection->listener.reset(new Socket('s', port));
+    connection->client.reset(new Socket('s'));
+    connection->client->Connect("127.0.0.1", port);
+    connection->server.reset(connection->listener->Accept());
+    connection->client->SetNoDelay();
+    connection->server->SetNoDelay();
+  } else if (transport.type == 'd') {
+    // no connections: each end binds a name and takes the other as peer
+    UnixAddress serverName(name + "-server");
+    UnixAddress clientName(name + "-client");
+    connection->server.reset(new Socket('d', serverName));
+    connection->client.reset(new Socket('d', clientName));
+    connection->client->Connect(serverName);
+    connection->server->Connect(clientName);
+  } else {
+    UnixAddress address(name);
+    connection->listener.reset(new Socket(transport.type, address));
+    connection->client.reset(new Socket(transport.type, kUnixDomain));
+    connection->client->Connect(address);
+    connection->server.reset(connection->listener->Accept());
+    if (transport.shm) {
+      // the server side sends the rings before the client waits for them
+      connection->serverChannel.reset(
+          new ShmChannel(connection->server.get(), true));
+      connection->clientChannel.reset(
+          new ShmChannel(connection->client.get(), false));
+    }
+  }
+}
+
+/**
+ * @brief reads one message of size bytes: a Read for message sockets, as
+ *  many as it takes for a stream
+ */
+template <typename Endpoint>
+static void readMessage(Endpoint* socket, char* buffer, int size,
+                        bool stream) {
+  int done = 0;
+  do {
+    done += socket->Read(buffer + done, size - done);
+  } while (stream && done < size);
+}
+
+template <typename Endpoint>
+static void writeAll(Endpoint* socket, const char* buffer, int size) {
+  for (int done = 0; done < size;) {
+    Result<int> written = socket->TryWrite(buffer + done, size - done);
+    if (!written) {
+      throw SocketException("Error writing to socket", "writeAll",
+                            written.Error().value(), false);
+    }
+    done += *written;
+  }
+}
+
+/**
+ * @brief round trips of message bytes, in nanoseconds
+ */
+template <typename Endpoint>
+static void benchLatency(Endpoint* client, Endpoint* server, bool stream,
+                         long roundTrips, int message,
+                         HdrHistogram* latencies) {
+  std::thread echo([server, stream, roundTrips, message]() {
+    std::vector<char> buffer(message);
+    for (long trip = 0; trip < roundTrips; ++trip) {
+      readMessage(server, buffer.data(), message, stream);
+      writeAll(server, buffer.data(), message);
+    }
+  });
+  std::vector<char> buffer(message, 'x');
+  for (long trip = 0; trip < roundTrips; ++trip) {
+    auto start = std::chrono::steady_clock::now();
+    writeAll(client, buffer.data(), message);
+    readMessage(client, buffer.data(), message, stream);
+    latencies->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+  }
+  echo.join();
+}
+
+/**
+ * @brief seconds to move bytes from the client to the server
+ */
+template <typename Endpoint>
+static double benchThroughput(Endpoint* client, Endpoint* server, long bytes,
+                              int chunk) {
+  long chunks = bytes / chunk;
+  std::thread reader([server, chunks, chunk]() {
+    std::vector<char> buffer(chunk);
+    long left = chunks * chunk;
+    while (left > 0) {
+      left -= server->Read(buffer.data(), chunk);
+    }
+  });
+  std::vector<char> buffer(chunk, 'x');
+  Stopwatch stopwatch;
+  for (long index = 0; index < chunks; ++index) {
+    writeAll(client, buffer.data(), chunk);
+  }
+  reader.join();
+  return stopwatch.Seconds();
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  long roundTrips = options.GetInt("round-trips", 200000);
+  int message = options.GetInt("message", 64);
+  long megabytes = options.GetInt("megabytes", 1024);
+  int chunk = options.GetInt("chunk", 65536);
+  int port = options.GetInt("port", BenchDefaultPort());
+  printf("%ld round trips of %d bytes, %ld MB in %d byte writes\n",
+         roundTrips, message, megabytes, chunk);
+  printf("%-15s %12s %9s %9s %9s %10s\n", "transport", "round trips/s",
+         "p50 us", "p99 us", "p99.9 us", "MB/s");
+  for (const Transport& transport : kTransports) {
+    try {
+      Connection connection;
+      connect(transport, port++, &connection);
+      HdrHistogram latencies(1000000000ull);
+      Stopwatch stopwatch;
+      double seconds = 0;
+      if (transport.shm) {
+        benchLatency(connection.clientChannel.get(),
+                     connection.serverChannel.get(), true, roundTrips,
+                     message, &latencies);
+      } else {
+        benchLatency(connection.client.get(), connection.server.get(),
+                     connection.stream, roundTrips, message, &latencies);
+      }
+      double rate = roundTrips / stopwatch.Seconds();
+      if (transport.shm) {
+        seconds = benchThroughput(connection.clientChannel.get(),
+                                  connection.serverChannel.get(),
+                                  megabytes << 20, chunk);
+      } else {
+        seconds = benchThroughput(connection.client.get(),
+                                  connection.server.get(), megabytes << 20,
+                                  chunk);
+      }
+      printf("%-15s %12.0f %9.2f %9.2f %9.2f %10.0f\n", transport.name, rate,
+             latencies.ValueAtPercentile(50) / 1e3,
+             latencies.ValueAtPercentile(99) / 1e3,
+             latencies.ValueAtPercentile(99.9) / 1e3,
+             (megabytes << 20) / seconds / 1e6);
+      std::cout.flush();
+    } catch (const SocketException& e) {
+      std::cerr << transport.name << ": " << e.what() << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file XmlParserBench.cpp
+ * @brief Throughput of the streaming XML parser on the TC10 login (against
+ * the strcmp it replaced) and on a large document, fed whole and in pieces
+ * of the sizes SSLRead can return, down to one byte at a time.
+ *
+ * Usage: bin/XmlParserBench [--logins n] [--document-mb n] [--rounds n]
+ */
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BenchUtil.hpp"
+#include "LoginProtocol.hpp"
+#include "XmlParser.hpp"
+
+static const char* const kLogin =
+    "\n<Body>\n\t<UserName>piro</UserName>\n\t<Password>ci0123</Password>\n"
+    "</Body>\n";
+
+/**
+ * @brief counts elements and text bytes, so the work is not optimized away
+ */
+class CountingHandler : public XmlHandler {
+ public:
+  size_t elements{0};
+  size_t textBytes{0};
+  void EndElement(std::string_view name, std::string_view text,
+                  bool truncated) override {
+    (void)name, (void)truncated;
+    ++this->elements;
+    this->textBytes += text.size();
+  }
+};
+
+/**
+ * @brief a catalog of figures, each with a few fields and some entities
+ */
+static std::string largeDocument(size_t bytes) {
+  std::string document = "<?xml version=\"1.0\"?>\n<Catalog>\n";
+  for (size_t figure = 0; document.size() < bytes; ++figure) {
+    document += "  <Figure id=\"" + std::to_string(figure) + "\">\n";
+    document += "    <Name>figure" + std::to_string(figure) + "</Name>\n";
+    document += "    <Pieces>" + std::to_string(figure % 97) + "</Pieces>\n";
+    document +=
+        "    <Description>Lego figure &amp; instructions, pieces &lt; 100, "
+        "assembled by students of CI-0123 in the operating systems and "
+        "networks project</Description>\n";
+    document += "    <!-- inventory checked -->\n  </Figure>\n";
+  }
+  document += "</Catalog>\n";
+  return document;
+}
+
+/**
+ * @brief splits size bytes in pieces of at most chunk bytes (0 means random
+ *  sizes between 1 and 64)
+ */
+static std::vector<size_t> pieces(size_t size, size_t chunk) {
+  std::vector<size_t> sizes;
+  std::mt19937 random(7);
+  std::uniform_int_distribution<size_t> sizeDistribution(1, 64);
+  for (size_t offset = 0; offset < size;) {
+    size_t piece = chunk == 0 ? sizeDistribution(random) : chunk;
+    piece = std::min(piece, size - offset);
+    sizes.push_back(piece);
+    offset += piece;
+  }
+  return sizes;
+}
+
+static void benchLogins(long logins) {
+  size_t length = strlen(kLogin);
+  char received[256];
+  memcpy(received, kLogin, length + 1);
+  size_t accepted = 0;
+  Stopwatch stopwatch;
+  for (long login = 0; login < logins; ++login) {
+    // as if SSLRead had just written the buffer
+    asm volatile("" : : "r"(received) : "memory");
+    accepted += strcmp(kLogin, received) == 0;
+  }
+  double strcmpSeconds = stopwatch.Seconds();
+  printf("login  strcmp          %12.0f msg/s\n", logins / strcmpSeconds);
+  for (size_t chunk : {length, size_t{16}, size_t{1}}) {
+    std::vector<size_t> sizes = pieces(length, chunk);
+    stopwatch.Reset();
+    for (long login = 0; login < logins; ++login) {
+      LoginXmlHandler handler;
+      XmlParser parser(&handler);
+      size_t offset = 0;
+      for (size_t size : sizes) {
+        parser.Feed(received + offset, size);
+        offset += size;
+      }
+      accepted += parser.Done() && handler.Complete() &&
+                  handler.Request().password == "ci0123";
+    }
+    double seconds = stopwatch.Seconds();
+    printf("login  stream %4zu B     %12.0f msg/s %8.1f MB/s\n", chunk,
+           logins / seconds, logins * length / seconds / 1e6);
+  }
+  printf("accepted %zu\n", accepted);
+}
+
+static void benchDocument(size_t bytes, long rounds) {
+  std::string document = largeDocument(bytes);
+  for (size_t chunk : {document.size(), size_t{16384}, size_t{1024},
+                       size_t{0}, size_t{1}}) {
+    std::vector<size_t> sizes = pieces(document.size(), chunk);
+    CountingHandler handler;
+    XmlParser parser(&handler);
+    Stopwatch stopwatch;
+    for (long round = 0; round < rounds; ++round) {
+      parser.Reset();
+      size_t offset = 0;
+      for (size_t size : sizes) {
+        if (!parser.Feed(document.data() + offset, size)) {
+          printf("parse error: %s\n", parser.Error());
+          return;
+        }
+        offset += size;
+      }
+    }
+    double seconds = stopwatch.Seconds();
+    char label[32];
+    if (chunk == 0) {
+      snprintf(label, sizeof(label), "1-64 B");
+    } else if (chunk == document.size()) {
+      snprintf(label, sizeof(label), "whole");
+    } else {
+      snprintf(label, sizeof(label), "%zu B", chunk);
+    }
+    printf("doc    %-16s %10.1f MB/s (%zu elements/round)\n", label,
+           rounds * document.size() / seconds / 1e6,
+           handler.elements / rounds);
+  }
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options(argc, argv);
+  long logins = options.GetInt("logins", 2000000);
+  long megabytes = options.GetInt("document-mb", 8);
+  long rounds = options.GetInt("rounds", 5);
+  benchLogins(logins);
+  benchDocument(megabytes << 20, rounds);
+  return 0;
+}
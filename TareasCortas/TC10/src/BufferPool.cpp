@@ -0,0 +1,62 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "BufferPool.hpp"
+
+#include <new>
+
+#include "SlabAllocator.hpp"
+
+BufferPool::BufferPool(size_t blockSize, size_t maxCached)
+    : blockSize(blockSize), maxCached(maxCached) {
+  this->cached.reserve(maxCached);
+}
+
+BufferPool::~BufferPool() noexcept(true) {
+  for (char* block : this->cached) {
+    SlabAllocator::Free(block);
+  }
+}
+
+BufferPool& BufferPool::Shared() {
+  // never destroyed: detached connection threads may give blocks back while
+  // the process exits
+  static BufferPool* pool = new BufferPool();
+  return *pool;
+}
+
+BufferPool::Buffer BufferPool::Acquire() {
+  char* block = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->cached.empty()) {
+      // the last one given back is the most likely to be in the CPU cache
+      block = this->cached.back();
+      this->cached.pop_back();
+    }
+  }
+  if (block == nullptr) {
+    block = static_cast<char*>(SlabAllocator::Allocate(this->blockSize));
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+  this->inUse.fetch_add(1, std::memory_order_relaxed);
+  return Buffer(this, block);
+}
+
+size_t BufferPool::Cached() const noexcept(true) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->cached.size();
+}
+
+void BufferPool::release(char* block) noexcept(true) {
+  this->inUse.fetch_sub(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->cached.size() < this->maxCached) {
+      // the capacity was reserved in the constructor, this never allocates
+      this->cached.push_back(block);
+      return;
+    }
+  }
+  SlabAllocator::Free(block);
+}
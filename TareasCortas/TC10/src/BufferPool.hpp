@@ -0,0 +1,133 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file BufferPool.hpp
+ * @brief Defines BufferPool, fixed size I/O buffers shared by every
+ * connection of a process, so an idle connection doesn't keep its own.
+ */
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+constexpr size_t kPoolBlockSize = 16384;  ///< one full TLS record
+
+/**
+ * @class BufferPool
+ * @brief Hands out blocks of one size and keeps the ones given back (up to
+ *  a limit) for the next connection that needs one.
+ * @details a connection takes a block while it has a message in progress
+ *  and returns it when it goes idle; the blocks in use then follow the busy
+ *  connections instead of all the open ones. Blocks come from
+ *  SlabAllocator.
+ */
+class BufferPool {
+ public:
+  /**
+   * @class Buffer
+   * @brief One block of a pool, given back when destroyed. Empty when
+   *  default constructed or moved from.
+   */
+  class Buffer {
+   public:
+    Buffer() = default;
+    ~Buffer() noexcept(true) { this->Release(); }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    Buffer(Buffer&& other) noexcept(true)
+        : pool(other.pool), block(other.block) {
+      other.pool = nullptr;
+      other.block = nullptr;
+    }
+    Buffer& operator=(Buffer&& other) noexcept(true) {
+      if (this != &other) {
+        this->Release();
+        this->pool = other.pool;
+        this->block = other.block;
+        other.pool = nullptr;
+        other.block = nullptr;
+      }
+      return *this;
+    }
+    /**
+     * @brief the block, nullptr if empty
+     */
+    char* Data() const noexcept(true) { return this->block; }
+    /**
+     * @brief bytes in the block, 0 if empty
+     */
+    size_t Size() const noexcept(true) {
+      return this->pool != nullptr ? this->pool->blockSize : 0;
+    }
+    explicit operator bool() const noexcept(true) {
+      return this->block != nullptr;
+    }
+    /**
+     * @brief gives the block back to its pool, the buffer is empty after it
+     */
+    void Release() noexcept(true) {
+      if (this->block != nullptr) {
+        this->pool->release(this->block);
+        this->block = nullptr;
+      }
+    }
+
+   private:
+    friend class BufferPool;
+    Buffer(BufferPool* pool, char* block) noexcept(true)
+        : pool(pool), block(block) {}
+    BufferPool* pool{nullptr};
+    char* block{nullptr};
+  };
+
+  /**
+   * @brief Constructor for BufferPool
+   * @param blockSize bytes in every block
+   * @param maxCached blocks kept for reuse, the rest are freed
+   * @throws std::bad_alloc if the free list can't be reserved
+   */
+  explicit BufferPool(size_t blockSize = kPoolBlockSize,
+                      size_t maxCached = 1024) noexcept(false);
+  /**
+   * @brief Destructor, frees the cached blocks; every Buffer must be gone
+   */
+  ~BufferPool() noexcept(true);
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+  /**
+   * @brief the pool of kPoolBlockSize blocks used by the servers
+   * @throws std::bad_alloc if it can't be created on the first call
+   */
+  static BufferPool& Shared() noexcept(false);
+  /**
+   * @brief a cached block, or a new one if none is left
+   * @throws std::bad_alloc if a new block can't be allocated
+   */
+  Buffer Acquire() noexcept(false);
+  /**
+   * @brief bytes in every block
+   */
+  size_t BlockSize() const noexcept(true) { return this->blockSize; }
+  /**
+   * @brief blocks held by a Buffer
+   */
+  size_t InUse() const noexcept(true) {
+    return this->inUse.load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief blocks kept for reuse
+   */
+  size_t Cached() const noexcept(true);
+
+ private:
+  const size_t blockSize;        ///< bytes in every block
+  const size_t maxCached;        ///< limit of the free list
+  std::atomic<size_t> inUse{0};  ///< blocks held by a Buffer
+  mutable std::mutex mutex;      ///< protects cached
+  std::vector<char*> cached;     ///< blocks given back, last in first out
+
+  void release(char* block) noexcept(true);
+};
+#endif  // BUFFER_POOL_HPP
@@ -0,0 +1,179 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "CertificateReloader.hpp"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "Logger.hpp"
+
+// quiet time after the last change before reloading: the certificate and
+// the key are usually replaced one after the other
+#define SETTLE_MS 200
+
+/// eventfd of the reloader that handles SIGHUP, -1 if there is none
+static std::atomic<int> hangupWakeId{-1};
+
+/**
+ * @brief SIGHUP handler, only an async-signal-safe write to the eventfd
+ */
+static void hangup(int) {
+  int saved = errno;
+  int wakeId = hangupWakeId.load();
+  if (wakeId != -1) {
+    uint64_t one = 1;
+    if (write(wakeId, &one, sizeof(one)) != sizeof(one)) {
+      // the counter is full, a reload is pending anyway
+    }
+  }
+  errno = saved;
+}
+
+/**
+ * @brief directory and file name of path
+ */
+static std::string directoryOf(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash + 1);
+}
+static std::string nameOf(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+CertificateReloader::CertificateReloader(Socket* listener,
+                                         const char* certFileName,
+                                         const char* keyFileName)
+    : listener(listener),
+      certFile(certFileName),
+      keyFile(keyFileName),
+      certName(nameOf(certFileName)),
+      keyName(nameOf(keyFileName)) {
+  this->inotifyId = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  this->wakeId = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (this->inotifyId == -1 || this->wakeId == -1) {
+    int error = errno;
+    close(this->inotifyId);
+    close(this->wakeId);
+    throw SocketException("Error creating certificate watch",
+                          "CertificateReloader", error, false);
+  }
+  try {
+    this->watchDirectory(this->certFile);
+    this->watchDirectory(this->keyFile);
+  } catch (const SocketException& e) {
+    close(this->inotifyId);
+    close(this->wakeId);
+    throw;
+  }
+  hangupWakeId.store(this->wakeId);
+  struct sigaction action {};
+  action.sa_handler = hangup;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGHUP, &action, nullptr);
+  this->watcher = std::thread(&CertificateReloader::watch, this);
+}
+
+CertificateReloader::~CertificateReloader() {
+  signal(SIGHUP, SIG_DFL);
+  hangupWakeId.store(-1);
+  this->stop.store(true);
+  uint64_t one = 1;
+  if (write(this->wakeId, &one, sizeof(one)) != sizeof(one)) {
+    // the counter is full, the watcher wakes up anyway
+  }
+  this->watcher.join();
+  close(this->inotifyId);
+  close(this->wakeId);
+}
+
+void CertificateReloader::watchDirectory(const std::string& file) {
+  // the same directory twice gives the same watch, that is fine
+  if (inotify_add_watch(this->inotifyId, directoryOf(file).c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) == -1) {
+    throw SocketException("Error watching certificate directory",
+                          "CertificateReloader", errno, false);
+  }
+}
+
+bool CertificateReloader::consumeEvents() noexcept(true) {
+  alignas(inotify_event) char buffer[4096];
+  bool relevant = false;
+  ssize_t bytes = 0;
+  while ((bytes = read(this->inotifyId, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t offset = 0; offset < bytes;) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(buffer + offset);
+      if (event->len > 0 &&
+          (this->certName == event->name || this->keyName == event->name)) {
+        relevant = true;
+      }
+      offset += sizeof(inotify_event) + event->len;
+    }
+  }
+  return relevant;
+}
+
+bool CertificateReloader::Reload() noexcept(true) {
+  try {
+    this->listener->SSLReloadCertificates(this->certFile.c_str(),
+                                          this->keyFile.c_str());
+  } catch (const SocketException& e) {
+    Logger::Error("Certificate reload failed, keeping the current one: %s",
+                  e.what());
+    return false;
+  }
+  Logger::Info("Certificate reloaded from %s", this->certFile);
+  return true;
+}
+
+void CertificateReloader::watch() noexcept(true) {
+  using Clock = std::chrono::steady_clock;
+  bool pending = false;
+  Clock::time_point reloadAt;
+  pollfd sources[2] = {{this->inotifyId, POLLIN, 0},
+                       {this->wakeId, POLLIN, 0}};
+  while (true) {
+    int timeout = -1;
+    if (pending) {
+      timeout = static_cast<int>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(reloadAt -
+                                                                Clock::now())
+              .count());
+      timeout = timeout < 0 ? 0 : timeout;
+    }
+    int ready = ::poll(sources, 2, timeout);
+    if (ready < 0 && errno != EINTR) {
+      Logger::Error("Certificate watch stopped: %s", strerror(errno));
+      return;
+    }
+    if (ready > 0 && (sources[1].revents & POLLIN)) {
+      uint64_t count = 0;
+      if (read(this->wakeId, &count, sizeof(count)) < 0) {
+        // nothing to read, e.g. another wake-up already consumed it
+      }
+      if (this->stop.load()) {
+        return;
+      }
+      // SIGHUP: no need to wait for anything
+      pending = false;
+      this->Reload();
+      continue;
+    }
+    if (ready > 0 && (sources[0].revents & POLLIN) && this->consumeEvents()) {
+      // every new change pushes the reload further
+      pending = true;
+      reloadAt = Clock::now() + std::chrono::milliseconds(SETTLE_MS);
+      continue;
+    }
+    if (pending && Clock::now() >= reloadAt) {
+      pending = false;
+      this->Reload();
+    }
+  }
+}
@@ -0,0 +1,73 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file CertificateReloader.hpp
+ * @brief Defines CertificateReloader, a thread that reloads the certificate
+ * and key of a TLS listener when their files change or on SIGHUP, without
+ * closing the listener or any connection.
+ */
+#ifndef CERTIFICATE_RELOADER_HPP
+#define CERTIFICATE_RELOADER_HPP
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "Socket.hpp"
+
+/**
+ * @class CertificateReloader
+ * @brief Watches the directories of the certificate and key with inotify
+ *  (so files replaced by rename, as certbot and editors do, are seen too)
+ *  and waits for writes to settle before calling
+ *  Socket::SSLReloadCertificates. SIGHUP forces a reload. A failed reload
+ *  (e.g. a new certificate whose key is not there yet) is logged and the
+ *  listener keeps its current certificate.
+ */
+class CertificateReloader {
+ public:
+  /**
+   * @brief Constructor for CertificateReloader, starts watching
+   * @param listener passive TLS socket, it must outlive the reloader
+   * @param certFileName certificate loaded by the listener
+   * @param keyFileName private key loaded by the listener
+   * @throws SocketException if inotify or the signal can't be set up
+   */
+  CertificateReloader(Socket* listener, const char* certFileName,
+                      const char* keyFileName) noexcept(false);
+  /**
+   * @brief Destructor, stops watching (SIGHUP goes back to its default)
+   */
+  ~CertificateReloader() noexcept(true);
+  CertificateReloader(const CertificateReloader&) = delete;
+  CertificateReloader& operator=(const CertificateReloader&) = delete;
+  /**
+   * @brief reloads now, from the calling thread
+   * @return true if the new certificate is in use
+   */
+  bool Reload() noexcept(true);
+
+ private:
+  Socket* listener{nullptr};  ///< socket whose context is replaced
+  std::string certFile;       ///< certificate, as given
+  std::string keyFile;        ///< key, as given
+  std::string certName;       ///< file name of certFile, in its directory
+  std::string keyName;        ///< file name of keyFile, in its directory
+  int inotifyId{-1};          ///< watches the directories of both files
+  int wakeId{-1};             ///< eventfd written by SIGHUP and the destructor
+  std::atomic<bool> stop{false};  ///< set before the destructor wakes it
+  std::thread watcher;        ///< waits for changes and reloads
+
+  /**
+   * @brief adds the directory of file to the inotify watches
+   */
+  void watchDirectory(const std::string& file) noexcept(false);
+  /**
+   * @brief true if an inotify event names the certificate or the key
+   */
+  bool consumeEvents() noexcept(true);
+  /**
+   * @brief waits for events, reloads after a quiet period
+   */
+  void watch() noexcept(true);
+};
+#endif  // CERTIFICATE_RELOADER_HPP
@@ -0,0 +1,55 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "EarlyData.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Frame.hpp"
+
+// longest HTTP method looked for before giving up on a request line
+#define METHOD_SIZE 16
+
+EarlyVerdict EarlyDataGuard::Classify(const char* data, size_t size) const
+    noexcept(true) {
+  if (size == 0) {
+    return EarlyVerdict::kIncomplete;
+  }
+  if (data[0] == '\0') {
+    // a binary frame: its length says where it ends
+    if (size < kFrameHeaderSize) {
+      return EarlyVerdict::kIncomplete;
+    }
+    uint32_t length = 0;
+    memcpy(&length, data, sizeof(length));
+    size_t frameSize = sizeof(length) + ntohl(length);
+    if (frameSize > kMaxFrameSize || size > frameSize) {
+      return EarlyVerdict::kUnsafe;
+    }
+    if (size < frameSize) {
+      return EarlyVerdict::kIncomplete;
+    }
+    return this->frameTypes.test(static_cast<uint8_t>(data[4]))
+               ? EarlyVerdict::kIdempotent
+               : EarlyVerdict::kUnsafe;
+  }
+  std::string_view text(data, size);
+  size_t space = text.substr(0, METHOD_SIZE).find(' ');
+  if (space == std::string_view::npos) {
+    return size < METHOD_SIZE ? EarlyVerdict::kIncomplete
+                              : EarlyVerdict::kUnsafe;
+  }
+  std::string_view method = text.substr(0, space);
+  if (std::find(this->httpMethods.begin(), this->httpMethods.end(), method) ==
+      this->httpMethods.end()) {
+    return EarlyVerdict::kUnsafe;
+  }
+  size_t headEnd = text.find("\r\n\r\n");
+  if (headEnd == std::string_view::npos) {
+    return EarlyVerdict::kIncomplete;
+  }
+  // a body or a second, pipelined request waits for the handshake
+  return headEnd + 4 == size ? EarlyVerdict::kIdempotent
+                             : EarlyVerdict::kUnsafe;
+}
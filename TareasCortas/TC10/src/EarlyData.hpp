@@ -0,0 +1,122 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file EarlyData.hpp
+ * @brief Defines TlsSession, a session a client keeps to resume later, and
+ * EarlyDataGuard, what a server accepts as TLS 1.3 early (0-RTT) data.
+ */
+#ifndef EARLY_DATA_HPP
+#define EARLY_DATA_HPP
+
+#include <openssl/ssl.h>
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr uint32_t kEarlyDataDefault = 16384;  ///< one full TLS record
+
+/**
+ * @class TlsSession
+ * @brief Owns a reference to an OpenSSL session. A client takes it from a
+ *  connection with Socket::SSLSession and gives it to the next one with
+ *  Socket::SSLResume.
+ */
+class TlsSession {
+ public:
+  TlsSession() = default;
+  /**
+   * @brief takes ownership of one reference to session
+   */
+  explicit TlsSession(SSL_SESSION* session) noexcept(true)
+      : session(session) {}
+  ~TlsSession() noexcept(true) { SSL_SESSION_free(this->session); }
+  TlsSession(const TlsSession&) = delete;
+  TlsSession& operator=(const TlsSession&) = delete;
+  TlsSession(TlsSession&& other) noexcept(true) : session(other.session) {
+    other.session = nullptr;
+  }
+  TlsSession& operator=(TlsSession&& other) noexcept(true) {
+    std::swap(this->session, other.session);
+    return *this;
+  }
+  /**
+   * @brief the session, nullptr if none
+   */
+  SSL_SESSION* Get() const noexcept(true) { return this->session; }
+  /**
+   * @brief true if a connection can resume it
+   */
+  bool Resumable() const noexcept(true) {
+    return this->session != nullptr && SSL_SESSION_is_resumable(this->session);
+  }
+  /**
+   * @brief early data bytes the server accepts when resuming it, 0 if none
+   */
+  uint32_t MaxEarlyData() const noexcept(true) {
+    return this->session != nullptr
+               ? SSL_SESSION_get_max_early_data(this->session)
+               : 0;
+  }
+
+ private:
+  SSL_SESSION* session{nullptr};  ///< one reference, freed by the destructor
+};
+
+/**
+ * @brief what a server may do with the early data received so far
+ */
+enum class EarlyVerdict {
+  kIncomplete,  ///< not a whole message yet, read more
+  kIdempotent,  ///< one whole allowed message, it can be answered right away
+  kUnsafe,      ///< anything else, it waits for the handshake to complete
+};
+
+/**
+ * @class EarlyDataGuard
+ * @brief Server side rules for TLS 1.3 early data.
+ * @details Early data travels with the ClientHello, so anybody who recorded
+ *  it can send it again. OpenSSL lets each session ticket carry early data
+ *  only once (tickets are kept by the server for that); replayCheck extends
+ *  this beyond one process, e.g. to a store shared by several servers.
+ *  Even then, only a single whole message of an allowed type (frames of
+ *  Frame.hpp by type, HTTP requests by method) is answered before the
+ *  handshake completes. Anything else is held back until the client's
+ *  Finished proves it is not a replay, a replayed copy never gets that far.
+ */
+class EarlyDataGuard {
+ public:
+  /// id of the session being resumed; false rejects its early data and the
+  /// client sends it again after the handshake
+  using ReplayCheck =
+      std::function<bool(const unsigned char* id, unsigned int length)>;
+
+  uint32_t maxEarlyData{kEarlyDataDefault};  ///< bytes accepted per session
+  ReplayCheck replayCheck;                   ///< optional, called per offer
+
+  /**
+   * @brief answers frames of this message type from early data
+   */
+  void AllowFrameType(uint8_t type) noexcept(true) {
+    this->frameTypes.set(type);
+  }
+  /**
+   * @brief answers HTTP requests with this method (e.g. "GET") from early
+   *  data; only safe methods should be allowed
+   */
+  void AllowHttpMethod(std::string_view method) noexcept(false) {
+    this->httpMethods.emplace_back(method);
+  }
+  /**
+   * @brief classifies the early data received so far
+   */
+  EarlyVerdict Classify(const char* data, size_t size) const noexcept(true);
+
+ private:
+  std::bitset<256> frameTypes;           ///< allowed frame types
+  std::vector<std::string> httpMethods;  ///< allowed HTTP methods
+};
+#endif  // EARLY_DATA_HPP
@@ -0,0 +1,253 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "FigureIndex.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// "LEGOIDX" plus the format version
+static const char kMagic[8] = {'L', 'E', 'G', 'O', 'I', 'D', 'X', '1'};
+// seeds tried per bucket before giving up
+static const uint32_t kMaxSeed = 1 << 22;
+
+/**
+ * @brief true if count items of itemSize bytes at offset fit in a file of
+ *  length bytes; subtracts instead of adding, a sum could wrap around
+ */
+static bool fits(uint64_t offset, uint64_t count, uint64_t itemSize,
+                 uint64_t length) {
+  return offset <= length && count <= (length - offset) / itemSize;
+}
+
+struct FigureIndex::Header {
+  char magic[8];
+  uint32_t count;        ///< figures in the index
+  uint32_t slotCount;    ///< entries in the slot table
+  uint32_t bucketCount;  ///< seeds in the seed table
+  uint32_t reserved;
+  uint64_t seedsOffset;  ///< file offset of the seed table
+  uint64_t slotsOffset;  ///< file offset of the slot table
+  uint64_t fileSize;     ///< total size, to detect truncated files
+};
+
+struct FigureIndex::Entry {
+  uint64_t nameOffset;     ///< file offset of the figure name
+  uint32_t nameLength;     ///< 0 if the slot is empty
+  uint32_t reserved;
+  uint64_t pageOffset[3];  ///< file offset of each variant, by encoding
+  uint64_t pageLength[3];  ///< length of each variant, 0 if not built
+};
+
+FigureIndex::FigureIndex(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("Error opening figure index " + path + " - " +
+                             strerror(errno) + " (FigureIndex::FigureIndex)");
+  }
+  struct stat status;
+  if (fstat(fd, &status) == -1 ||
+      static_cast<size_t>(status.st_size) < sizeof(Header)) {
+    close(fd);
+    throw std::runtime_error("Invalid figure index " + path +
+                             " (FigureIndex::FigureIndex)");
+  }
+  this->length = status.st_size;
+  void* mapping = mmap(nullptr, this->length, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps its own reference to the file
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Error mapping figure index " + path + " - " +
+                             strerror(errno) + " (FigureIndex::FigureIndex)");
+  }
+  this->base = static_cast<const char*>(mapping);
+  madvise(mapping, this->length, MADV_WILLNEED);
+  this->header = reinterpret_cast<const Header*>(this->base);
+  // check every offset once here, so Find() does not need to
+  const Header& head = *this->header;
+  bool valid = memcmp(head.magic, kMagic, sizeof(kMagic)) == 0 &&
+               head.fileSize == this->length && head.bucketCount > 0 &&
+               head.slotCount >= head.count &&
+               head.seedsOffset % alignof(uint32_t) == 0 &&
+               fits(head.seedsOffset, head.bucketCount, sizeof(uint32_t),
+                    this->length) &&
+               head.slotsOffset % alignof(Entry) == 0 &&
+               fits(head.slotsOffset, head.slotCount, sizeof(Entry),
+                    this->length);
+  if (valid) {
+    this->seeds =
+        reinterpret_cast<const uint32_t*>(this->base + head.seedsOffset);
+    this->slots = reinterpret_cast<const Entry*>(this->base + head.slotsOffset);
+    for (uint32_t slot = 0; valid && slot < head.slotCount; ++slot) {
+      const Entry& entry = this->slots[slot];
+      valid = fits(entry.nameOffset, entry.nameLength, 1, this->length);
+      for (int variant = 0; valid && variant < 3; ++variant) {
+        valid = fits(entry.pageOffset[variant], entry.pageLength[variant], 1,
+                     this->length);
+      }
+    }
+  }
+  if (!valid) {
+    munmap(mapping, this->length);
+    throw std::runtime_error("Invalid figure index " + path +
+                             " (FigureIndex::FigureIndex)");
+  }
+}
+
+FigureIndex::~FigureIndex() noexcept(true) {
+  munmap(const_cast<char*>(this->base), this->length);
+}
+
+bool FigureIndex::Find(std::string_view name, CachedPage& page) const
+    noexcept(true) {
+  if (this->header->count == 0) {
+    return false;
+  }
+  uint32_t bucket = hash(name, 0) % this->header->bucketCount;
+  uint32_t slot = hash(name, this->seeds[bucket]) % this->header->slotCount;
+  const Entry& entry = this->slots[slot];
+  // names that are not in the index land on some slot too, compare the name
+  if (entry.nameLength != name.size() || name.empty() ||
+      memcmp(this->base + entry.nameOffset, name.data(), name.size()) != 0) {
+    return false;
+  }
+  std::string_view* variants[3] = {&page.identity, &page.gzip, &page.brotli};
+  for (int variant = 0; variant < 3; ++variant) {
+    *variants[variant] = std::string_view(
+        this->base + entry.pageOffset[variant], entry.pageLength[variant]);
+  }
+  return true;
+}
+
+size_t FigureIndex::Size() const noexcept(true) { return this->header->count; }
+
+size_t FigureIndex::Build(const PageCache& cache, const std::string& path) {
+  std::vector<std::pair<std::string, CachedPage>> figures;
+  cache.ForEach([&figures](const std::string& name, const CachedPage& page) {
+    figures.emplace_back(name, page);
+  });
+  Header head;
+  memset(&head, 0, sizeof(head));
+  memcpy(head.magic, kMagic, sizeof(kMagic));
+  head.count = figures.size();
+  // a few spare slots keep the seed search short
+  head.slotCount = head.count + head.count / 8 + 1;
+  head.bucketCount = head.count / 4 + 1;
+  // group the names by bucket, the fullest buckets are placed first while
+  // most slots are still free
+  std::vector<std::vector<uint32_t>> buckets(head.bucketCount);
+  for (uint32_t figure = 0; figure < head.count; ++figure) {
+    buckets[hash(figures[figure].first, 0) % head.bucketCount].push_back(
+        figure);
+  }
+  std::vector<uint32_t> order(head.bucketCount);
+  for (uint32_t bucket = 0; bucket < head.bucketCount; ++bucket) {
+    order[bucket] = bucket;
+  }
+  std::stable_sort(order.begin(), order.end(), [&buckets](auto a, auto b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+  std::vector<uint32_t> seeds(head.bucketCount, 0);
+  std::vector<int64_t> slotFigure(head.slotCount, -1);
+  std::vector<uint32_t> candidate;
+  for (uint32_t bucket : order) {
+    if (buckets[bucket].empty()) {
+      break;
+    }
+    uint32_t seed = 1;
+    for (; seed < kMaxSeed; ++seed) {
+      candidate.clear();
+      bool fits = true;
+      for (uint32_t figure : buckets[bucket]) {
+        uint32_t slot = hash(figures[figure].first, seed) % head.slotCount;
+        if (slotFigure[slot] != -1 ||
+            std::find(candidate.begin(), candidate.end(), slot) !=
+                candidate.end()) {
+          fits = false;
+          break;
+        }
+        candidate.push_back(slot);
+      }
+      if (fits) {
+        break;
+      }
+    }
+    if (seed == kMaxSeed) {
+      throw std::runtime_error("No perfect hash found for the figures "
+                               "(FigureIndex::Build)");
+    }
+    seeds[bucket] = seed;
+    for (size_t index = 0; index < candidate.size(); ++index) {
+      slotFigure[candidate[index]] = buckets[bucket][index];
+    }
+  }
+  // lay out the tables, then the names and pages after them
+  head.seedsOffset = sizeof(Header);
+  uint64_t seedsEnd = head.seedsOffset + head.bucketCount * sizeof(uint32_t);
+  head.slotsOffset = (seedsEnd + alignof(Entry) - 1) / alignof(Entry) *
+                     alignof(Entry);
+  uint64_t dataOffset = head.slotsOffset + head.slotCount * sizeof(Entry);
+  std::vector<Entry> slots(head.slotCount);
+  memset(slots.data(), 0, slots.size() * sizeof(Entry));
+  std::string data;
+  for (uint32_t slot = 0; slot < head.slotCount; ++slot) {
+    if (slotFigure[slot] == -1) {
+      continue;
+    }
+    const auto& [name, page] = figures[slotFigure[slot]];
+    Entry& entry = slots[slot];
+    entry.nameOffset = dataOffset + data.size();
+    entry.nameLength = name.size();
+    data += name;
+    std::string_view variants[3] = {page.identity, page.gzip, page.brotli};
+    for (int variant = 0; variant < 3; ++variant) {
+      entry.pageOffset[variant] = dataOffset + data.size();
+      entry.pageLength[variant] = variants[variant].size();
+      data += variants[variant];
+    }
+  }
+  head.fileSize = dataOffset + data.size();
+  // write beside the destination and rename, rename() is atomic
+  std::string temporary = path + ".tmp";
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  std::string padding(head.slotsOffset - seedsEnd, '\0');
+  file.write(reinterpret_cast<const char*>(&head), sizeof(head));
+  file.write(reinterpret_cast<const char*>(seeds.data()),
+             seeds.size() * sizeof(uint32_t));
+  file.write(padding.data(), padding.size());
+  file.write(reinterpret_cast<const char*>(slots.data()),
+             slots.size() * sizeof(Entry));
+  file.write(data.data(), data.size());
+  file.close();
+  if (!file || rename(temporary.c_str(), path.c_str()) == -1) {
+    unlink(temporary.c_str());
+    throw std::runtime_error("Error writing figure index " + path +
+                             " (FigureIndex::Build)");
+  }
+  return head.count;
+}
+
+uint64_t FigureIndex::hash(std::string_view name, uint64_t seed) noexcept(
+    true) {
+  // FNV-1a seeded through its offset basis...
+  uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+  for (unsigned char character : name) {
+    hash ^= character;
+    hash *= 0x100000001b3ULL;
+  }
+  // ...and the splitmix64 finalizer, so "% size" uses well mixed bits
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
@@ -0,0 +1,81 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file FigureIndex.hpp
+ * @brief Defines a read-only figure catalog file built offline and mapped in
+ * memory: a perfect hash from figure name to the page bytes (raw, gzip and
+ * brotli) packed in the same file.
+ */
+#ifndef FIGURE_INDEX_HPP
+#define FIGURE_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "PageCache.hpp"
+
+/**
+ * @class FigureIndex
+ * @brief Memory mapped figure catalog.
+ * @details File layout (host byte order, the file is meant to be built on the
+ * machine that serves it):
+ *  header | bucket seeds (uint32) | slots (Entry) | names and pages
+ * A figure name hashes with seed 0 to a bucket; the bucket's seed hashes it
+ * again to its slot. Build() chooses the seeds so no two names share a slot,
+ * so a lookup is two hashes, one name comparison and pointer arithmetic, with
+ * no system call.
+ */
+class FigureIndex {
+ public:
+  /**
+   * @brief maps an index file
+   * @param path index file built with Build()
+   * @throws std::runtime_error if it can't be mapped or is not a valid index
+   */
+  explicit FigureIndex(const std::string& path) noexcept(false);
+  FigureIndex(const FigureIndex&) = delete;
+  FigureIndex& operator=(const FigureIndex&) = delete;
+  /**
+   * @brief Destructor, unmaps the file
+   */
+  ~FigureIndex() noexcept(true);
+  /**
+   * @brief looks up a figure
+   * @param name figure name
+   * @param page where the views (into the mapping) of the page are stored
+   * @return true if the figure is in the index
+   */
+  bool Find(std::string_view name, CachedPage& page) const noexcept(true);
+  /**
+   * @brief number of figures in the index
+   */
+  size_t Size() const noexcept(true);
+  /**
+   * @brief writes an index with every page of a cache. The file is written
+   *  beside the destination and renamed over it, so a server mapping the old
+   *  index never sees a partial file.
+   * @param cache pages to store, with their compressed variants
+   * @param path destination file
+   * @throws std::runtime_error if the file can't be written or no perfect
+   *  hash is found
+   * @return number of figures written
+   */
+  static size_t Build(const PageCache& cache, const std::string& path) noexcept(
+      false);
+
+ private:
+  struct Header;
+  struct Entry;
+  const char* base{nullptr};          ///< start of the mapping
+  size_t length{0};                   ///< bytes mapped
+  const Header* header{nullptr};      ///< file header
+  const uint32_t* seeds{nullptr};     ///< seed of every bucket
+  const Entry* slots{nullptr};        ///< one entry per slot, may be empty
+  /**
+   * @private
+   * @brief 64 bit hash of a name with a seed
+   */
+  static uint64_t hash(std::string_view name, uint64_t seed) noexcept(true);
+};
+#endif  // FIGURE_INDEX_HPP
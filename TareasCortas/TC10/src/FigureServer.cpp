@@ -0,0 +1,218 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "FigureServer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#include "BufferPool.hpp"
+#include "Logger.hpp"
+#include "SlabAllocator.hpp"
+#include "Trace.hpp"
+
+FigureServer::FigureServer(Socket* listener, const PageCache* cache,
+                           int idleTimeout, int maxRequests,
+                           size_t handshakeThreads) noexcept(false)
+    : listener(listener),
+      cache(cache),
+      idleTimeout(idleTimeout),
+      maxRequests(maxRequests) {
+  if (handshakeThreads > 0) {
+    this->handshakes = std::make_unique<HandshakePool>(
+        handshakeThreads, [this](Socket* client, uint32_t connection) {
+          this->spawn(client, connection);
+        });
+  }
+}
+
+void FigureServer::Run(int connections) {
+  for (int served = 0; connections < 0 || served < connections; ++served) {
+    // numbered from 1, 0 is the connection of a direct Serve call
+    uint32_t connection = served + 1;
+    Socket* client = nullptr;
+    {
+      TRACE_PHASE(kAccept, connection);
+      client = this->listener->Accept();
+    }
+    try {
+      TRACE_PHASE(kSslCreate, connection);
+      // responses are already batched per flush, Nagle would only hold the
+      // tail of a batch until the client's delayed ACK
+      client->SetNoDelay();
+      client->SSLCreate(this->listener);
+    } catch (const SocketException& e) {
+      Logger::Error("Server error: %s", e.what());
+      client->Close();
+      delete client;
+      continue;
+    }
+    if (this->handshakes != nullptr) {
+      this->handshakes->Submit(client, connection);
+      continue;
+    }
+    try {
+      this->spawn(client, connection);
+    } catch (const std::system_error& e) {
+      Logger::Error("Server error: %s", e.what());
+      client->Close();
+      delete client;
+    }
+  }
+}
+
+void FigureServer::spawn(Socket* client, uint32_t connection) {
+  std::thread worker(&FigureServer::Serve, this, client, connection);
+  worker.detach();
+}
+
+void FigureServer::Serve(Socket* client, uint32_t connection) noexcept(
+    true) {
+  // the read buffer is a pool block, so the largest request head accepted
+  // is kPoolBlockSize
+  BufferPool::Buffer block;
+  size_t received = 0;
+  int served = 0;
+  bool keepAlive = true;
+  // bytes of a request body still to arrive, dropped as they do
+  size_t discard = 0;
+  // responses are queued here and flushed together, the capacity is reused
+  std::string output;
+  try {
+    bool lean = client->SSLMemoryLean();
+    block = BufferPool::Shared().Acquire();
+    client->SSLHoldPoolBlock(true);
+    if (!client->SSLEstablished()) {
+      TRACE_PHASE(kSslAccept, connection);
+      // a resumed client may have sent its first request with the handshake
+      received = client->SSLAcceptEarly(block.Data(), block.Size());
+    }
+    while (keepAlive) {
+      char* buffer = block.Data();
+      // answer, in order, every complete request received so far
+      size_t parsed = std::min(discard, received);
+      discard -= parsed;
+      HttpRequest request;
+      {
+        TRACE_PHASE(kHandler, connection);
+        while (keepAlive && discard == 0) {
+          size_t length = HttpRequest::Parse(
+              std::string_view(buffer + parsed, received - parsed), request);
+          if (length == 0) {
+            break;
+          }
+          parsed += length;
+          // a chunked body can't be told from the next request, close
+          keepAlive = request.valid && request.KeepAlive() &&
+                      request.transferEncoding.empty() &&
+                      ++served < this->maxRequests;
+          this->handle(request, keepAlive, output);
+          // no request needs its body, but it must not be taken for the
+          // next request
+          size_t body = std::min(request.contentLength, received - parsed);
+          parsed += body;
+          discard = request.contentLength - body;
+        }
+      }
+      // keep the start of the next request at the start of the buffer
+      memmove(buffer, buffer + parsed, received - parsed);
+      received -= parsed;
+      if (!output.empty()) {
+        TRACE_PHASE(kSslWrite, connection);
+        client->SSLWrite(output.data(), output.size());
+        output.clear();
+      }
+      if (!keepAlive) {
+        break;
+      }
+      if (received == block.Size()) {
+        throw SocketException("Request head too large", "FigureServer::Serve",
+                              EMSGSIZE, false);
+      }
+      if (lean && received == 0) {
+        // nothing in progress: an idle connection holds no buffer of its own
+        block.Release();
+        client->SSLHoldPoolBlock(false);
+        std::string().swap(output);
+        // and what the handshake and the last request freed on this thread
+        SlabAllocator::ReleaseThreadCache();
+      }
+      // an idle persistent connection is closed after the idle timeout
+      if (!client->WaitToRead(this->idleTimeout)) {
+        break;
+      }
+      if (!block) {
+        block = BufferPool::Shared().Acquire();
+        client->SSLHoldPoolBlock(true);
+      }
+      int bytes = 0;
+      try {
+        TRACE_PHASE(kSslRead, connection);
+        bytes = client->SSLRead(block.Data() + received,
+                                block.Size() - received);
+      } catch (const SocketException& e) {
+        // closing between requests is how clients end a persistent connection
+        if (received == 0 && served > 0) {
+          break;
+        }
+        throw;
+      }
+      if (bytes <= 0) {
+        break;
+      }
+      received += bytes;
+    }
+  } catch (const std::exception& e) {
+    Logger::Error("Server error: %s", e.what());
+  }
+  try {
+    TRACE_PHASE(kClose, connection);
+    client->Close();
+  } catch (const std::exception& e) {
+    Logger::Error("Server error: %s", e.what());
+  }
+  delete client;
+}
+
+void FigureServer::handle(const HttpRequest& request, bool keepAlive,
+                          std::string& output) const {
+  CachedPage page;
+  bool found = request.valid && request.method == "GET" &&
+               this->cache->Find(request.Parameter("figure"), page);
+  if (!request.valid) {
+    respond(output, "400 Bad Request", "Bad Request\n",
+            ContentEncoding::kIdentity, keepAlive);
+  } else if (!request.transferEncoding.empty()) {
+    respond(output, "501 Not Implemented", "Transfer-Encoding not supported\n",
+            ContentEncoding::kIdentity, keepAlive);
+  } else if (!found) {
+    respond(output, "404 Not Found", "Figure not found\n",
+            ContentEncoding::kIdentity, keepAlive);
+  } else {
+    AcceptedEncodings accepted = PageCache::Negotiate(request.acceptEncoding);
+    ContentEncoding encoding = ContentEncoding::kIdentity;
+    std::string_view body = PageCache::Select(page, accepted, encoding);
+    respond(output, "200 OK", body, encoding, keepAlive);
+  }
+}
+
+void FigureServer::respond(std::string& output, const char* status,
+                           std::string_view body, ContentEncoding encoding,
+                           bool keepAlive) {
+  char head[256];
+  const char* encodingName = PageCache::EncodingName(encoding);
+  // Vary tells caches in between that the body depends on Accept-Encoding
+  int length = snprintf(head, sizeof(head),
+                        "HTTP/1.1 %s\r\n"
+                        "Content-Type: text/html\r\n"
+                        "Content-Length: %zu\r\n"
+                        "%s%s%s"
+                        "Vary: Accept-Encoding\r\n"
+                        "Connection: %s\r\n\r\n",
+                        status, body.size(),
+                        encodingName ? "Content-Encoding: " : "",
+                        encodingName ? encodingName : "",
+                        encodingName ? "\r\n" : "",
+                        keepAlive ? "keep-alive" : "close");
+  output.append(head, length);
+  output.append(body);
+}
@@ -0,0 +1,94 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file FigureServer.hpp
+ * @brief Defines the Lego figure HTTPS server: one thread per connection,
+ * figure pages served from a PageCache (see TrabajoEnClase/TC9/readme.md),
+ * handshakes optionally run by a HandshakePool.
+ */
+#ifndef FIGURE_SERVER_HPP
+#define FIGURE_SERVER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "HandshakePool.hpp"
+#include "HttpRequest.hpp"
+#include "PageCache.hpp"
+#include "Socket.hpp"
+
+/**
+ * @class FigureServer
+ * @brief Answers "GET /lego/figure=<name>" and
+ * "GET /lego/listphp?figure=<name>" with the cached page of the figure,
+ * compressed according to the client's Accept-Encoding.
+ * @details Connections are persistent (HTTP/1.1 keep-alive) until the client
+ * asks to close, stays idle longer than the idle timeout, or reaches the
+ * request limit. Pipelined requests are answered in order, and every
+ * response to the requests received together is flushed in one write.
+ * Requests are read into a block of BufferPool::Shared(); with
+ * Socket::SSLSetMemoryLean on the listener an idle connection gives the
+ * block and its response queue back until the next request arrives.
+ */
+class FigureServer {
+ public:
+  /**
+   * @brief Constructor for FigureServer
+   * @param listener passive SSL socket, it must outlive the server
+   * @param cache pages to serve, it must outlive the server
+   * @param idleTimeout seconds a persistent connection may stay idle
+   * @param maxRequests requests served on one connection before closing it
+   * @param handshakeThreads threads of a HandshakePool that runs every
+   *  handshake before the connection gets its own thread, 0 to handshake
+   *  on the connection's thread
+   * @throws SocketException if the handshake pool can't be started
+   */
+  FigureServer(Socket* listener, const PageCache* cache, int idleTimeout = 5,
+               int maxRequests = 1000,
+               size_t handshakeThreads = 0) noexcept(false);
+  /**
+   * @brief accept loop, every connection is served by a detached thread
+   * @param connections number of connections to accept, -1 for ever
+   * @throws SocketException if can't accept a connection
+   */
+  void Run(int connections = -1) noexcept(false);
+  /**
+   * @brief serves one connection: handshake (unless it is already
+   *  established), then requests and responses until the connection is
+   *  closed. The client socket is closed and deleted
+   *  afterwards.
+   * @param client accepted socket with its SSL structure already created
+   * @param connection number of the connection in the lifecycle trace
+   */
+  void Serve(Socket* client, uint32_t connection = 0) noexcept(true);
+
+ private:
+  Socket* listener{nullptr};        ///< passive SSL socket
+  const PageCache* cache{nullptr};  ///< figure pages
+  int idleTimeout{5};               ///< seconds before closing an idle client
+  int maxRequests{1000};            ///< requests per connection
+  /// runs the handshakes, nullptr if every connection does its own
+  std::unique_ptr<HandshakePool> handshakes;
+  /**
+   * @private
+   * @brief starts the detached thread that serves client
+   */
+  void spawn(Socket* client, uint32_t connection) noexcept(false);
+  /**
+   * @private
+   * @brief answers one request, appending the response to the output queue
+   * @param keepAlive false if the connection is closed after this response
+   */
+  void handle(const HttpRequest& request, bool keepAlive,
+              std::string& output) const noexcept(false);
+  /**
+   * @private
+   * @brief appends status line, headers and body of a response to output
+   * @param encoding coding of the body, identity for none
+   */
+  static void respond(std::string& output, const char* status,
+                      std::string_view body, ContentEncoding encoding,
+                      bool keepAlive) noexcept(false);
+};
+#endif  // FIGURE_SERVER_HPP
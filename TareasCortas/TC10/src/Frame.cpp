@@ -0,0 +1,192 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "Frame.hpp"
+
+#include <cstring>
+
+/**
+ * @brief writes an unsigned integer in network byte order (big endian)
+ */
+static void putNumber(char* out, uint64_t value, size_t bytes) {
+  for (size_t index = bytes; index > 0; --index) {
+    out[index - 1] = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+}
+
+/**
+ * @brief reads an unsigned integer in network byte order (big endian)
+ */
+static uint64_t getNumber(const char* in, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t index = 0; index < bytes; ++index) {
+    value = (value << 8) | static_cast<unsigned char>(in[index]);
+  }
+  return value;
+}
+
+FrameWriter::FrameWriter(char* buffer, size_t capacity, uint8_t type)
+    : buffer(buffer), capacity(capacity) {
+  this->reserve(kFrameHeaderSize);
+  this->buffer[4] = static_cast<char>(type);
+  this->buffer[5] = static_cast<char>(kFrameVersion);
+  this->size = kFrameHeaderSize;
+}
+
+void FrameWriter::AddUInt32(uint8_t tag, uint32_t value) {
+  this->reserve(2 + 4);
+  char* out = this->buffer + this->size;
+  out[0] = static_cast<char>(tag);
+  out[1] = static_cast<char>(WireType::kUInt32);
+  putNumber(out + 2, value, 4);
+  this->size += 2 + 4;
+  ++this->fields;
+}
+
+void FrameWriter::AddUInt64(uint8_t tag, uint64_t value) {
+  this->reserve(2 + 8);
+  char* out = this->buffer + this->size;
+  out[0] = static_cast<char>(tag);
+  out[1] = static_cast<char>(WireType::kUInt64);
+  putNumber(out + 2, value, 8);
+  this->size += 2 + 8;
+  ++this->fields;
+}
+
+void FrameWriter::AddString(uint8_t tag, std::string_view value) {
+  if (value.size() > 0xffff) {
+    throw SocketException("Field too large", "FrameWriter::AddString",
+                          EMSGSIZE, false);
+  }
+  this->reserve(2 + 2 + value.size());
+  char* out = this->buffer + this->size;
+  out[0] = static_cast<char>(tag);
+  out[1] = static_cast<char>(WireType::kBytes);
+  putNumber(out + 2, value.size(), 2);
+  memcpy(out + 4, value.data(), value.size());
+  this->size += 2 + 2 + value.size();
+  ++this->fields;
+}
+
+size_t FrameWriter::Finish() noexcept(true) {
+  putNumber(this->buffer, this->size - 4, 4);
+  putNumber(this->buffer + 6, this->fields, 2);
+  return this->size;
+}
+
+void FrameWriter::reserve(size_t bytes) {
+  if (this->size + bytes > this->capacity ||
+      this->size + bytes > kMaxFrameSize) {
+    throw SocketException("Frame too large", "FrameWriter", EMSGSIZE, false);
+  }
+}
+
+size_t FrameReader::Complete(const char* data, size_t size) {
+  if (size < 4) {
+    return 0;
+  }
+  size_t frameSize = 4 + getNumber(data, 4);
+  if (frameSize > kMaxFrameSize || frameSize < kFrameHeaderSize) {
+    throw SocketException("Invalid frame length", "FrameReader::Complete",
+                          EPROTO, false);
+  }
+  return size >= frameSize ? frameSize : 0;
+}
+
+FrameReader::FrameReader(const char* data, size_t size)
+    : data(data), size(size), position(kFrameHeaderSize) {
+  if (size < kFrameHeaderSize ||
+      static_cast<uint8_t>(data[5]) != kFrameVersion) {
+    throw SocketException("Invalid frame header", "FrameReader::FrameReader",
+                          EPROTO, false);
+  }
+  this->type = static_cast<uint8_t>(data[4]);
+  this->remaining = getNumber(data + 6, 2);
+}
+
+bool FrameReader::Next(FrameField& field) {
+  if (this->remaining == 0) {
+    return false;
+  }
+  if (this->position + 2 > this->size) {
+    throw SocketException("Truncated frame", "FrameReader::Next", EPROTO,
+                          false);
+  }
+  const char* in = this->data + this->position;
+  field.tag = static_cast<uint8_t>(in[0]);
+  field.type = static_cast<WireType>(in[1]);
+  size_t valueSize = 0;
+  switch (field.type) {
+    case WireType::kUInt32:
+      valueSize = 4;
+      break;
+    case WireType::kUInt64:
+      valueSize = 8;
+      break;
+    case WireType::kBytes:
+      valueSize = this->position + 4 <= this->size ? 2 + getNumber(in + 2, 2)
+                                                   : this->size;
+      break;
+    default:
+      throw SocketException("Unknown field type", "FrameReader::Next", EPROTO,
+                            false);
+  }
+  if (this->position + 2 + valueSize > this->size) {
+    throw SocketException("Truncated frame", "FrameReader::Next", EPROTO,
+                          false);
+  }
+  if (field.type == WireType::kBytes) {
+    field.number = valueSize - 2;
+    field.bytes = std::string_view(in + 4, valueSize - 2);
+  } else {
+    field.number = getNumber(in + 2, valueSize);
+    field.bytes = std::string_view();
+  }
+  this->position += 2 + valueSize;
+  --this->remaining;
+  return true;
+}
+
+FrameChannel::FrameChannel(Socket* socket, bool ssl) noexcept(true)
+    : socket(socket), ssl(ssl) {}
+
+void FrameChannel::Preload(const char* data, size_t size) {
+  if (this->received + size > sizeof(this->buffer)) {
+    throw SocketException("Frame too large", "FrameChannel::Preload",
+                          EMSGSIZE, false);
+  }
+  memcpy(this->buffer + this->received, data, size);
+  this->received += size;
+}
+
+void FrameChannel::Send(const char* frame, size_t size) {
+  if (this->ssl) {
+    this->socket->SSLWrite(frame, size);
+  } else {
+    this->socket->Write(frame, size);
+  }
+}
+
+FrameReader FrameChannel::Receive() {
+  // drop the frame returned last time, keep what came after it
+  if (this->consumed > 0) {
+    memmove(this->buffer, this->buffer + this->consumed,
+            this->received - this->consumed);
+    this->received -= this->consumed;
+    this->consumed = 0;
+  }
+  size_t frameSize = 0;
+  while ((frameSize = FrameReader::Complete(this->buffer, this->received)) ==
+         0) {
+    char* end = this->buffer + this->received;
+    int space = sizeof(this->buffer) - this->received;
+    int bytes = this->ssl ? this->socket->SSLRead(end, space)
+                          : this->socket->Read(end, space);
+    if (bytes <= 0) {
+      throw SocketException("Connection closed in the middle of a frame",
+                            "FrameChannel::Receive", ECONNRESET, false);
+    }
+    this->received += bytes;
+  }
+  this->consumed = frameSize;
+  return FrameReader(this->buffer, frameSize);
+}
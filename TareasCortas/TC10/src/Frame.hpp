@@ -0,0 +1,160 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file Frame.hpp
+ * @brief Defines a length-prefixed binary framing with typed fields, encoded
+ * and decoded in caller buffers without heap allocation, plus a channel that
+ * sends and receives frames over a plain or SSL Socket.
+ */
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "Socket.hpp"
+
+/**
+ * @brief Frame layout (integers in network byte order):
+ *  length u32 (bytes after this field) | type u8 | version u8 | fields u16 |
+ *  fields...
+ * and every field is: tag u8 | wire type u8 | value, where the value is 4 or
+ * 8 bytes for integers and a u16 length plus the bytes for strings.
+ * The first byte of a frame is always 0 (frames are smaller than 16 MB), so
+ * a server can tell a frame from a text (XML) message by its first byte.
+ */
+enum class WireType : uint8_t { kUInt32 = 1, kUInt64 = 2, kBytes = 3 };
+
+constexpr size_t kFrameHeaderSize = 8;      ///< length, type, version, fields
+constexpr size_t kMaxFrameSize = 1 << 16;   ///< largest frame accepted
+constexpr uint8_t kFrameVersion = 1;        ///< version written in frames
+
+/**
+ * @brief One decoded field. bytes views the frame buffer.
+ */
+struct FrameField {
+  uint8_t tag{0};
+  WireType type{WireType::kUInt32};
+  uint64_t number{0};      ///< value of integer fields
+  std::string_view bytes;  ///< value of string fields
+};
+
+/**
+ * @class FrameWriter
+ * @brief Encodes one frame into a caller buffer.
+ */
+class FrameWriter {
+ public:
+  /**
+   * @brief starts a frame of the given message type
+   * @param buffer where the frame is written, it must outlive the writer
+   * @param capacity buffer size
+   * @throws SocketException if the buffer can't hold the frame header
+   */
+  FrameWriter(char* buffer, size_t capacity, uint8_t type) noexcept(false);
+  /**
+   * @brief appends fields
+   * @throws SocketException if the field does not fit in the buffer
+   */
+  void AddUInt32(uint8_t tag, uint32_t value) noexcept(false);
+  void AddUInt64(uint8_t tag, uint64_t value) noexcept(false);
+  void AddString(uint8_t tag, std::string_view value) noexcept(false);
+  /**
+   * @brief writes the length and field count in the header
+   * @return size of the complete frame
+   */
+  size_t Finish() noexcept(true);
+
+ private:
+  char* buffer{nullptr};  ///< frame being written
+  size_t capacity{0};     ///< buffer size
+  size_t size{0};         ///< bytes written so far
+  uint16_t fields{0};     ///< fields written so far
+  /**
+   * @private
+   * @brief checks there is room for the next bytes
+   * @throws SocketException if there is not
+   */
+  void reserve(size_t bytes) noexcept(false);
+};
+
+/**
+ * @class FrameReader
+ * @brief Decodes one complete frame in place.
+ */
+class FrameReader {
+ public:
+  /**
+   * @brief size of the first frame in data, if all of it is there
+   * @return frame size, 0 if more bytes are needed
+   * @throws SocketException if the length is larger than kMaxFrameSize
+   */
+  static size_t Complete(const char* data, size_t size) noexcept(false);
+  /**
+   * @brief Constructor for FrameReader
+   * @param data one complete frame (see Complete()), it must outlive the
+   *  reader and the fields read from it
+   * @throws SocketException if the header is malformed
+   */
+  FrameReader(const char* data, size_t size) noexcept(false);
+  /**
+   * @brief message type of the frame
+   */
+  uint8_t Type() const noexcept(true) { return this->type; }
+  /**
+   * @brief reads the next field
+   * @param field where the field is stored
+   * @return false after the last field
+   * @throws SocketException if a field is truncated or of unknown type
+   */
+  bool Next(FrameField& field) noexcept(false);
+
+ private:
+  const char* data{nullptr};  ///< frame
+  size_t size{0};             ///< frame size
+  size_t position{0};         ///< next field
+  uint16_t remaining{0};      ///< fields not read yet
+  uint8_t type{0};            ///< message type
+};
+
+/**
+ * @class FrameChannel
+ * @brief Sends and receives frames over a Socket, plain or SSL. Received
+ *  bytes are kept in a fixed buffer inside the channel, so a frame split
+ *  across reads, or several frames in one read, need no allocation.
+ */
+class FrameChannel {
+ public:
+  /**
+   * @brief Constructor for FrameChannel
+   * @param socket connected socket, it must outlive the channel
+   * @param ssl true to use SSLRead/SSLWrite, false for Read/Write
+   */
+  FrameChannel(Socket* socket, bool ssl) noexcept(true);
+  /**
+   * @brief adds bytes already read from the socket, e.g. while telling a
+   *  frame from a text message
+   * @throws SocketException if they don't fit in the receive buffer
+   */
+  void Preload(const char* data, size_t size) noexcept(false);
+  /**
+   * @brief sends one complete frame
+   * @throws SocketException if can't write to the socket
+   */
+  void Send(const char* frame, size_t size) noexcept(false);
+  /**
+   * @brief receives the next frame
+   * @return reader over the frame, valid until the next Receive()
+   * @throws SocketException if can't read, the peer closes in the middle of
+   *  a frame or the frame is malformed
+   */
+  FrameReader Receive() noexcept(false);
+
+ private:
+  Socket* socket{nullptr};        ///< connected socket
+  bool ssl{false};                ///< true if the socket is SSL
+  char buffer[kMaxFrameSize];     ///< received bytes
+  size_t received{0};             ///< bytes in buffer
+  size_t consumed{0};             ///< bytes of frames already returned
+};
+#endif  // FRAME_HPP
@@ -0,0 +1,224 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "HandshakePool.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "Logger.hpp"
+#include "Trace.hpp"
+
+// how often the poller looks for handshakes past their deadline
+#define EXPIRE_INTERVAL_MS 250
+
+HandshakePool::HandshakePool(size_t threads, Established established,
+                             int timeout)
+    : established(std::move(established)), timeout(timeout) {
+  this->epollId = epoll_create1(EPOLL_CLOEXEC);
+  this->wakeId = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  epoll_event wake{};
+  wake.events = EPOLLIN;
+  wake.data.ptr = nullptr;
+  if (this->epollId == -1 || this->wakeId == -1 ||
+      epoll_ctl(this->epollId, EPOLL_CTL_ADD, this->wakeId, &wake) == -1) {
+    int error = errno;
+    close(this->epollId);
+    close(this->wakeId);
+    throw SocketException("Error creating handshake epoll set",
+                          "HandshakePool::HandshakePool", error, false);
+  }
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  this->poller = std::thread(&HandshakePool::poll, this);
+  for (size_t index = 0; index < threads; ++index) {
+    this->workers.emplace_back(&HandshakePool::work, this);
+  }
+}
+
+HandshakePool::~HandshakePool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->readyChanged.notify_all();
+  uint64_t one = 1;
+  if (write(this->wakeId, &one, sizeof(one)) != sizeof(one)) {
+    // the poller still stops at its next expiry check
+  }
+  this->poller.join();
+  for (std::thread& worker : this->workers) {
+    worker.join();
+  }
+  for (Job* job : this->ready) {
+    this->drop(job);
+  }
+  for (Job* job : this->parked) {
+    this->drop(job);
+  }
+  close(this->epollId);
+  close(this->wakeId);
+}
+
+void HandshakePool::Submit(Socket* client, uint32_t connection) noexcept(
+    true) {
+  Job* job = new (std::nothrow) Job{client, connection,
+                                    std::chrono::steady_clock::now() +
+                                        this->timeout};
+  if (job == nullptr) {
+    client->Close();
+    delete client;
+    return;
+  }
+  this->inFlight.fetch_add(1, std::memory_order_relaxed);
+  try {
+    client->SetNonBlocking();
+  } catch (const SocketException& e) {
+    Logger::Error("Server error: %s", e.what());
+    this->drop(job);
+    return;
+  }
+  {
+    // the ClientHello is usually there already, try right away
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->ready.push_back(job);
+  }
+  this->readyChanged.notify_one();
+}
+
+void HandshakePool::poll() noexcept(true) {
+  epoll_event events[64];
+  std::vector<Job*> expired;
+  std::chrono::steady_clock::time_point nextExpiry =
+      std::chrono::steady_clock::now();
+  while (true) {
+    int count = epoll_wait(this->epollId, events, 64, EXPIRE_INTERVAL_MS);
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->stop) {
+      break;
+    }
+    bool woke = false;
+    for (int index = 0; index < count; ++index) {
+      Job* job = static_cast<Job*>(events[index].data.ptr);
+      // EPOLLONESHOT: the socket stays silent until a worker parks it again
+      if (job != nullptr && this->parked.erase(job) == 1) {
+        this->ready.push_back(job);
+        woke = true;
+      }
+    }
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (now >= nextExpiry) {
+      nextExpiry = now + std::chrono::milliseconds(EXPIRE_INTERVAL_MS);
+      for (auto job = this->parked.begin(); job != this->parked.end();) {
+        if ((*job)->deadline <= now) {
+          // once deleted no event of it is left in the epoll set
+          epoll_ctl(this->epollId, EPOLL_CTL_DEL,
+                    (*job)->client->GetIDSocket(), nullptr);
+          expired.push_back(*job);
+          job = this->parked.erase(job);
+        } else {
+          ++job;
+        }
+      }
+    }
+    lock.unlock();
+    if (woke) {
+      this->readyChanged.notify_all();
+    }
+    for (Job* job : expired) {
+      Logger::Warn("Handshake of connection %u timed out", job->connection);
+      this->drop(job);
+    }
+    expired.clear();
+  }
+}
+
+void HandshakePool::work() noexcept(true) {
+  while (true) {
+    Job* job = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->readyChanged.wait(
+          lock, [this] { return this->stop || !this->ready.empty(); });
+      if (this->stop) {
+        return;
+      }
+      job = this->ready.front();
+      this->ready.pop_front();
+    }
+    this->step(job);
+  }
+}
+
+void HandshakePool::step(Job* job) noexcept(true) {
+  Result<int> result = 0;
+  {
+    TRACE_PHASE(kSslAccept, job->connection);
+    result = job->client->TrySSLAccept();
+  }
+  if (result) {
+    Socket* client = job->client;
+    uint32_t connection = job->connection;
+    if (job->registered) {
+      epoll_ctl(this->epollId, EPOLL_CTL_DEL, client->GetIDSocket(), nullptr);
+    }
+    delete job;
+    this->inFlight.fetch_sub(1, std::memory_order_relaxed);
+    try {
+      client->SetNonBlocking(false);
+      this->established(client, connection);
+    } catch (const std::exception& e) {
+      Logger::Error("Server error: %s", e.what());
+      client->Close();
+      delete client;
+    }
+    return;
+  }
+  if (result.Error() == std::errc::resource_unavailable_try_again) {
+    if (std::chrono::steady_clock::now() >= job->deadline) {
+      Logger::Warn("Handshake of connection %u timed out", job->connection);
+    } else if (this->park(job)) {
+      return;
+    }
+  } else {
+    Logger::Error("Server error: handshake failed: %s",
+                  result.Error().message());
+  }
+  this->drop(job);
+}
+
+bool HandshakePool::park(Job* job) noexcept(true) {
+  epoll_event event{};
+  event.events =
+      (job->client->SSLWantsWrite() ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+  event.data.ptr = job;
+  // parked before the socket is armed: the poller looks the job up in parked
+  // as soon as the event arrives
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->stop) {
+    return false;
+  }
+  this->parked.insert(job);
+  int operation = job->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (epoll_ctl(this->epollId, operation, job->client->GetIDSocket(),
+                &event) == -1) {
+    this->parked.erase(job);
+    return false;
+  }
+  job->registered = true;
+  return true;
+}
+
+void HandshakePool::drop(Job* job) noexcept(true) {
+  try {
+    job->client->Close();
+  } catch (const SocketException& e) {
+    // the connection is being dropped anyway
+  }
+  delete job->client;
+  delete job;
+  this->inFlight.fetch_sub(1, std::memory_order_relaxed);
+}
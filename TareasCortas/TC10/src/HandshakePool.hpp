@@ -0,0 +1,118 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file HandshakePool.hpp
+ * @brief Defines HandshakePool, a few threads that run the TLS handshakes of
+ * a server so their private key operations don't compete with the threads
+ * serving established connections.
+ */
+#ifndef HANDSHAKE_POOL_HPP
+#define HANDSHAKE_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "Socket.hpp"
+
+/**
+ * @class HandshakePool
+ * @brief Runs server handshakes in non-blocking steps on a fixed number of
+ *  threads and hands every established connection back to the caller.
+ * @details a handshake waiting for the client is parked in an epoll set
+ *  watched by one poller thread, so a slow or silent client only holds a
+ *  descriptor, never a thread; when its socket is ready the next step runs
+ *  on a free worker. At most `threads` handshakes use the CPU at once, the
+ *  rest of the machine keeps serving established connections. Handshakes
+ *  not finished within the timeout are dropped.
+ */
+class HandshakePool {
+ public:
+  /**
+   * @brief called on a worker thread with a connection whose handshake just
+   *  completed, the socket is blocking again. It owns the socket from then
+   *  on and should return quickly (e.g. start the connection's thread).
+   */
+  using Established = std::function<void(Socket* client, uint32_t id)>;
+  /**
+   * @brief Constructor for HandshakePool, starts the threads
+   * @param threads workers running handshake steps, 0 for one per core
+   * @param established receives every established connection
+   * @param timeout seconds a handshake may take
+   * @throws SocketException if the epoll set can't be created
+   */
+  HandshakePool(size_t threads, Established established,
+                int timeout = 10) noexcept(false);
+  /**
+   * @brief Destructor, stops the threads and drops the handshakes in flight
+   */
+  ~HandshakePool() noexcept(true);
+  HandshakePool(const HandshakePool&) = delete;
+  HandshakePool& operator=(const HandshakePool&) = delete;
+  /**
+   * @brief queues the handshake of an accepted socket
+   * @param client socket with its SSL structure created, the pool owns it
+   *  (and closes it if the handshake fails)
+   * @param connection number of the connection in the lifecycle trace
+   */
+  void Submit(Socket* client, uint32_t connection) noexcept(true);
+  /**
+   * @brief handshakes queued, running or waiting for their client
+   */
+  size_t InFlight() const noexcept(true) {
+    return this->inFlight.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /**
+   * @brief one handshake in flight
+   */
+  struct Job {
+    Socket* client;
+    uint32_t connection;
+    std::chrono::steady_clock::time_point deadline;
+    bool registered{false};  ///< the socket is in the epoll set
+  };
+  Established established;    ///< receives the established connections
+  std::chrono::seconds timeout;
+  int epollId{-1};            ///< parked handshakes, data.ptr is the Job
+  int wakeId{-1};             ///< eventfd that stops the poller
+  std::mutex mutex;           ///< protects ready, parked and stop
+  std::condition_variable readyChanged;
+  std::deque<Job*> ready;            ///< jobs with a step to run
+  std::unordered_set<Job*> parked;   ///< jobs waiting for their socket
+  bool stop{false};
+  std::atomic<size_t> inFlight{0};
+  std::thread poller;                ///< moves ready sockets to ready
+  std::vector<std::thread> workers;  ///< run the steps
+
+  /**
+   * @brief waits for parked sockets and expires old handshakes
+   */
+  void poll() noexcept(true);
+  /**
+   * @brief runs steps of ready jobs until the pool stops
+   */
+  void work() noexcept(true);
+  /**
+   * @brief one handshake step of job, then hands it over, parks it or
+   *  drops it
+   */
+  void step(Job* job) noexcept(true);
+  /**
+   * @brief waits for the socket of job in the direction OpenSSL asked for
+   * @return false if the socket can't be watched
+   */
+  bool park(Job* job) noexcept(true);
+  /**
+   * @brief closes and deletes the socket of job, and job
+   */
+  void drop(Job* job) noexcept(true);
+};
+#endif  // HANDSHAKE_POOL_HPP
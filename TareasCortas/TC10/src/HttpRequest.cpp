@@ -0,0 +1,126 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "HttpRequest.hpp"
+
+#include <strings.h>
+
+/**
+ * @brief case insensitive search of a token in a header value
+ */
+static bool hasToken(std::string_view value, std::string_view token) {
+  for (size_t start = 0; start + token.size() <= value.size(); ++start) {
+    if (strncasecmp(value.data() + start, token.data(), token.size()) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief value of a Content-Length header, only digits
+ * @return false if it is not a number or doesn't fit
+ */
+static bool parseLength(std::string_view value, size_t& length) {
+  while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+    value.remove_suffix(1);
+  }
+  if (value.empty() || value.size() > 18) {
+    return false;
+  }
+  length = 0;
+  for (char digit : value) {
+    if (digit < '0' || digit > '9') {
+      return false;
+    }
+    length = length * 10 + (digit - '0');
+  }
+  return true;
+}
+
+size_t HttpRequest::Parse(std::string_view buffer,
+                          HttpRequest& request) noexcept(true) {
+  request = HttpRequest();
+  // the head ends with an empty line, wait until all of it has arrived
+  size_t end = buffer.find("\r\n\r\n");
+  if (end == std::string_view::npos) {
+    return 0;
+  }
+  std::string_view head = buffer.substr(0, end + 2);
+  // request line: method SP target SP version CRLF
+  size_t lineEnd = head.find("\r\n");
+  std::string_view line = head.substr(0, lineEnd);
+  size_t space = line.find(' ');
+  size_t lastSpace = line.rfind(' ');
+  if (space != std::string_view::npos && lastSpace > space + 1) {
+    request.method = line.substr(0, space);
+    request.target = line.substr(space + 1, lastSpace - space - 1);
+    request.version = line.substr(lastSpace + 1);
+    request.valid = request.version.substr(0, 5) == "HTTP/";
+  }
+  // header lines: name ":" OWS value CRLF
+  head.remove_prefix(lineEnd + 2);
+  bool hasLength = false;
+  while (!head.empty()) {
+    lineEnd = head.find("\r\n");
+    line = head.substr(0, lineEnd);
+    head.remove_prefix(lineEnd + 2);
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
+    std::string_view name = line.substr(0, colon);
+    std::string_view value = line.substr(colon + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+      value.remove_prefix(1);
+    }
+    // header names are case insensitive
+    if (name.size() == 15 &&
+        strncasecmp(name.data(), "Accept-Encoding", name.size()) == 0) {
+      request.acceptEncoding = value;
+    } else if (name.size() == 10 &&
+               strncasecmp(name.data(), "Connection", name.size()) == 0) {
+      request.connection = value;
+    } else if (name.size() == 17 &&
+               strncasecmp(name.data(), "Transfer-Encoding", name.size()) ==
+                   0) {
+      request.transferEncoding = value;
+    } else if (name.size() == 14 &&
+               strncasecmp(name.data(), "Content-Length", name.size()) == 0) {
+      // two lengths that differ could frame the body two ways
+      size_t length = 0;
+      if (!parseLength(value, length) ||
+          (hasLength && length != request.contentLength)) {
+        request.valid = false;
+      }
+      request.contentLength = length;
+      hasLength = true;
+    }
+  }
+  return end + 4;
+}
+
+std::string_view HttpRequest::Parameter(std::string_view key) const
+    noexcept(true) {
+  size_t position = 0;
+  while ((position = this->target.find(key, position)) !=
+         std::string_view::npos) {
+    size_t valueStart = position + key.size();
+    // the key must be a whole segment: "/key=", "?key=" or "&key="
+    bool startsSegment = position > 0 && (this->target[position - 1] == '/' ||
+                                          this->target[position - 1] == '?' ||
+                                          this->target[position - 1] == '&');
+    if (startsSegment && valueStart < this->target.size() &&
+        this->target[valueStart] == '=') {
+      std::string_view value = this->target.substr(valueStart + 1);
+      return value.substr(0, value.find_first_of("&/#"));
+    }
+    position = valueStart;
+  }
+  return std::string_view();
+}
+
+bool HttpRequest::KeepAlive() const noexcept(true) {
+  if (this->version == "HTTP/1.0") {
+    return hasToken(this->connection, "keep-alive");
+  }
+  return !hasToken(this->connection, "close");
+}
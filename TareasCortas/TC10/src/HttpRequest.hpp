@@ -0,0 +1,52 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file HttpRequest.hpp
+ * @brief Defines a minimal HTTP/1.x request head parser, enough for the Lego
+ * figure server (request line plus the headers it cares about).
+ */
+#ifndef HTTP_REQUEST_HPP
+#define HTTP_REQUEST_HPP
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Parsed request head. Every field is a view into the buffer given to
+ * Parse(), so the buffer must outlive the request.
+ */
+struct HttpRequest {
+  std::string_view method;          ///< e.g. "GET"
+  std::string_view target;          ///< e.g. "/lego/figure=octupus"
+  std::string_view version;         ///< e.g. "HTTP/1.1"
+  std::string_view acceptEncoding;  ///< Accept-Encoding value, may be empty
+  std::string_view connection;      ///< Connection value, may be empty
+  /// Transfer-Encoding value, may be empty; no coding is supported
+  std::string_view transferEncoding;
+  size_t contentLength{0};  ///< bytes of body that follow the head
+  /// false if the request line or Content-Length is malformed
+  bool valid{false};
+  /**
+   * @brief parses one request head (up to and including the empty line).
+   *  The body, if any, is not part of it: contentLength bytes follow.
+   * @param buffer received bytes, may hold a partial request
+   * @param request where the parsed fields are stored
+   * @return number of bytes the head takes, 0 if the head is not complete yet
+   */
+  static size_t Parse(std::string_view buffer, HttpRequest& request) noexcept(
+      true);
+  /**
+   * @brief value of a "key=value" parameter in the target, both as a query
+   *  ("/lego/listphp?figure=elephant") and as a path segment
+   *  ("/lego/figure=octupus").
+   * @param key parameter name
+   * @return parameter value, empty if not present
+   */
+  std::string_view Parameter(std::string_view key) const noexcept(true);
+  /**
+   * @brief whether the client wants the connection kept open after this
+   *  request: the default for HTTP/1.1 unless "Connection: close", and only
+   *  with "Connection: keep-alive" for HTTP/1.0.
+   */
+  bool KeepAlive() const noexcept(true);
+};
+#endif  // HTTP_REQUEST_HPP
@@ -0,0 +1,290 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "Logger.hpp"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ThreadLease.hpp"
+
+// longest line written, longer messages are truncated
+#define LOG_LINE_SIZE 1024
+
+static const char* const kLevelNames[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+bool Logger::ParseLevel(const char* name, LogLevel& level) noexcept(true) {
+  static const char* const kNames[] = {"debug", "info", "warn", "error",
+                                       "off"};
+  for (size_t index = 0; index < sizeof(kNames) / sizeof(kNames[0]);
+       ++index) {
+    if (strcasecmp(name, kNames[index]) == 0) {
+      level = static_cast<LogLevel>(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief level given by LOG_LEVEL, info if it is not set or not valid
+ */
+static LogLevel initialLevel() noexcept(true) {
+  LogLevel level = LogLevel::kInfo;
+  const char* name = getenv("LOG_LEVEL");
+  if (name == nullptr || !Logger::ParseLevel(name, level)) {
+    level = LogLevel::kInfo;
+  }
+  return level;
+}
+std::atomic<LogLevel> Logger::currentLevel{initialLevel()};
+
+/**
+ * @brief single-producer single-consumer queue of records, the producer
+ *  and consumer sides in different cache lines
+ */
+struct LogRing {
+  alignas(64) std::atomic<bool> leased{false};
+  alignas(64) std::atomic<uint64_t> head{0};  ///< records ever published
+  std::atomic<uint64_t> dropped{0};           ///< records lost, ring full
+  alignas(64) std::atomic<uint64_t> tail{0};  ///< records ever written
+  uint64_t droppedReported{0};                ///< dropped already reported
+  LogRecord records[kLogRingCapacity];
+};
+static LogRing rings[kLogRings];
+/// false before the writer starts, after it stops and in forked children
+static std::atomic<bool> writerRunning{false};
+
+static thread_local LogRing* threadRing = nullptr;
+static thread_local bool threadSynchronous = false;  ///< found no ring
+static thread_local uint32_t threadId = 0;
+static thread_local LogRecord threadRecord;  ///< for synchronous writes
+
+/**
+ * @brief formats the "time LEVEL [tid] message" line of a record
+ * @return length of the line, with its '\n'
+ */
+static size_t formatLine(const LogRecord& record, char* line) noexcept(true) {
+  time_t seconds = static_cast<time_t>(record.time / 1000000000ull);
+  tm utc;
+  gmtime_r(&seconds, &utc);
+  size_t length = strftime(line, LOG_LINE_SIZE, "%Y-%m-%dT%H:%M:%S", &utc);
+  length += snprintf(line + length, LOG_LINE_SIZE - length, ".%06luZ %s [%u] ",
+                     static_cast<unsigned long>(record.time % 1000000000ull /
+                                                1000),
+                     kLevelNames[static_cast<size_t>(record.level)],
+                     record.thread);
+  int message = record.format(record, line + length, LOG_LINE_SIZE - length);
+  length += message > 0 ? static_cast<size_t>(message) : 0;
+  length = std::min<size_t>(length, LOG_LINE_SIZE - 2);
+  // messages may bring their own line break
+  if (line[length - 1] != '\n') {
+    line[length++] = '\n';
+  }
+  return length;
+}
+
+/**
+ * @brief stream of a level: warnings and errors to stderr
+ */
+static FILE* streamOf(LogLevel level) noexcept(true) {
+  return level >= LogLevel::kWarn ? stderr : stdout;
+}
+
+/**
+ * @class LogWriter
+ * @brief the background thread that formats and writes every ring
+ */
+class LogWriter {
+ public:
+  LogWriter() noexcept(false) : owner(getpid()) {
+    // a child keeps the rings but not this thread, it writes synchronously
+    pthread_atfork(nullptr, nullptr, [] {
+      writerRunning.store(false, std::memory_order_release);
+    });
+    writerRunning.store(true, std::memory_order_release);
+    this->thread = new std::thread(&LogWriter::run, this);
+  }
+  ~LogWriter() {
+    // a forked child must not join its parent's thread, nor write the
+    // parent's records a second time
+    if (getpid() != this->owner) {
+      return;
+    }
+    writerRunning.store(false, std::memory_order_release);
+    this->stop.store(true, std::memory_order_release);
+    this->thread->join();
+    delete this->thread;
+  }
+  /**
+   * @brief formats and writes what every ring has, oldest first
+   * @return number of records written
+   */
+  size_t Drain() noexcept(true) {
+    this->lines.clear();
+    this->entries.clear();
+    char line[LOG_LINE_SIZE];
+    for (LogRing& ring : rings) {
+      uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+      uint64_t head = ring.head.load(std::memory_order_acquire);
+      for (uint64_t index = tail; index < head; ++index) {
+        const LogRecord& record = ring.records[index % kLogRingCapacity];
+        this->add(record.time, record.level, line, formatLine(record, line));
+      }
+      // the producer may reuse the records now
+      ring.tail.store(head, std::memory_order_release);
+      uint64_t dropped = ring.dropped.load(std::memory_order_relaxed);
+      if (dropped != ring.droppedReported) {
+        int length = snprintf(line, sizeof(line),
+                              "%lu log messages dropped, ring full\n",
+                              static_cast<unsigned long>(
+                                  dropped - ring.droppedReported));
+        this->add(0, LogLevel::kWarn, line, length);
+        ring.droppedReported = dropped;
+      }
+    }
+    // rings are visited in turn, the time puts their lines back in order
+    std::stable_sort(this->entries.begin(), this->entries.end(),
+                     [](const Entry& left, const Entry& right) {
+                       return left.time < right.time;
+                     });
+    for (const Entry& entry : this->entries) {
+      fwrite(this->lines.data() + entry.offset, 1, entry.length,
+             streamOf(entry.level));
+    }
+    if (!this->entries.empty()) {
+      fflush(stdout);
+      fflush(stderr);
+    }
+    return this->entries.size();
+  }
+
+ private:
+  /**
+   * @brief a formatted line in lines
+   */
+  struct Entry {
+    uint64_t time;
+    LogLevel level;
+    size_t offset;
+    size_t length;
+  };
+  pid_t owner;                  ///< process that started the thread
+  std::thread* thread;          ///< leaked by forked children
+  std::atomic<bool> stop{false};
+  std::string lines;            ///< text of the lines of one drain
+  std::vector<Entry> entries;   ///< lines of one drain
+
+  void add(uint64_t time, LogLevel level, const char* line,
+           size_t length) noexcept(true) {
+    this->entries.push_back({time, level, this->lines.size(), length});
+    this->lines.append(line, length);
+  }
+  void run() noexcept(true) {
+    while (true) {
+      bool stopping = this->stop.load(std::memory_order_acquire);
+      if (this->Drain() == 0) {
+        if (stopping) {
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+};
+
+/**
+ * @brief the writer, started by the first thread that logs and stopped
+ *  (after writing everything) when the program exits
+ */
+static LogWriter& logWriter() noexcept(false) {
+  static LogWriter writer;
+  return writer;
+}
+
+/**
+ * @brief the thread is exiting: destructors of other thread locals may
+ *  still log, synchronously
+ */
+static void leaveRing() noexcept {
+  threadRing = nullptr;
+  threadSynchronous = true;
+}
+
+/**
+ * @brief leases a free ring to the calling thread, it logs synchronously if
+ *  there is none
+ */
+static void leaseRing() noexcept(true) {
+  threadId = static_cast<uint32_t>(syscall(SYS_gettid));
+  try {
+    logWriter();
+  } catch (const std::exception& e) {
+    threadSynchronous = true;
+    return;
+  }
+  threadRing = ThreadLease<LogRing>::Acquire(rings, leaveRing);
+  threadSynchronous = threadRing == nullptr;
+}
+
+LogRecord* Logger::acquire() noexcept(true) {
+  if (threadRing == nullptr && !threadSynchronous) {
+    leaseRing();
+  }
+  LogRing* ring = threadRing;
+  if (ring == nullptr || !writerRunning.load(std::memory_order_relaxed)) {
+    return &threadRecord;
+  }
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= kLogRingCapacity) {
+    // the only producer of this ring: a plain increment
+    ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+    return nullptr;
+  }
+  return &ring->records[head % kLogRingCapacity];
+}
+
+void Logger::publish(LogRecord* record) noexcept(true) {
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  record->time =
+      static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+  record->thread = threadId;
+  if (record == &threadRecord) {
+    char line[LOG_LINE_SIZE];
+    fwrite(line, 1, formatLine(*record, line), streamOf(record->level));
+    return;
+  }
+  LogRing* ring = threadRing;
+  ring->head.store(ring->head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+}
+
+void Logger::Flush() noexcept(true) {
+  uint64_t heads[kLogRings];
+  for (size_t index = 0; index < kLogRings; ++index) {
+    heads[index] = rings[index].head.load(std::memory_order_acquire);
+  }
+  for (size_t index = 0; index < kLogRings; ++index) {
+    while (writerRunning.load(std::memory_order_acquire) &&
+           rings[index].tail.load(std::memory_order_acquire) < heads[index]) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  }
+  fflush(stdout);
+}
+
+uint64_t Logger::Dropped() noexcept(true) {
+  uint64_t dropped = 0;
+  for (const LogRing& ring : rings) {
+    dropped += ring.dropped.load(std::memory_order_relaxed);
+  }
+  return dropped;
+}
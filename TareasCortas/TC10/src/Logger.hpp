@@ -0,0 +1,412 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file Logger.hpp
+ * @brief Defines Logger, an asynchronous logger: the calling thread only
+ * copies the format string pointer and the arguments into its own ring
+ * buffer, a background thread formats and writes them, so workers never
+ * wait on the stdout lock or a flush.
+ */
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+constexpr size_t kLogRings = 64;          ///< threads logging at once
+constexpr size_t kLogRingCapacity = 1024;  ///< records per ring, power of 2
+constexpr size_t kLogPayload = 216;       ///< bytes of arguments per record
+
+/**
+ * @brief Severity of a message, messages below Logger::Level() are skipped
+ *  before anything is copied
+ */
+enum class LogLevel : uint8_t { kDebug, kInfo, kWarn, kError, kOff };
+
+/**
+ * @brief One message waiting to be written: the arguments are kept as
+ *  bytes and formatted by the writer thread
+ */
+struct LogRecord {
+  /// formats the record into buffer, the instance for the argument types
+  int (*format)(const LogRecord& record, char* buffer, size_t capacity);
+  const char* text{nullptr};  ///< printf format, a string literal
+  uint64_t time{0};           ///< CLOCK_REALTIME in nanoseconds
+  uint32_t thread{0};         ///< id of the thread that logged it
+  LogLevel level{LogLevel::kInfo};
+  uint16_t size{0};           ///< bytes used in payload
+  char payload[kLogPayload];  ///< the arguments, see LogCodec
+};
+
+/**
+ * @brief copies arguments into a record payload and back, values by value
+ *  and strings by content (truncated to the free space)
+ */
+class LogPayload {
+ public:
+  explicit LogPayload(LogRecord& record) noexcept(true) : record(record) {}
+  void Put(const void* value, size_t size) noexcept(true) {
+    if (this->record.size + size <= kLogPayload) {
+      memcpy(this->record.payload + this->record.size, value, size);
+      this->record.size += size;
+    } else {
+      // no room: the value reads as zero, strings are truncated instead
+      this->record.size = kLogPayload;
+    }
+  }
+  void PutString(const char* text, size_t length) noexcept(true) {
+    size_t room = kLogPayload - this->record.size;
+    if (room == 0) {
+      return;
+    }
+    length = length < room - 1 ? length : room - 1;
+    memcpy(this->record.payload + this->record.size, text, length);
+    this->record.payload[this->record.size + length] = '\0';
+    this->record.size += length + 1;
+  }
+
+ private:
+  LogRecord& record;
+};
+
+/**
+ * @brief reads a payload in the order it was written
+ */
+class LogPayloadReader {
+ public:
+  explicit LogPayloadReader(const LogRecord& record) noexcept(true)
+      : record(record) {}
+  void Get(void* value, size_t size) noexcept(true) {
+    if (this->offset + size <= this->record.size) {
+      memcpy(value, this->record.payload + this->offset, size);
+    } else {
+      memset(value, 0, size);
+    }
+    this->offset += size;
+  }
+  const char* GetString() noexcept(true) {
+    if (this->offset >= this->record.size) {
+      return "";
+    }
+    const char* text = this->record.payload + this->offset;
+    this->offset += strlen(text) + 1;
+    return text;
+  }
+
+ private:
+  const LogRecord& record;
+  size_t offset{0};
+};
+
+/**
+ * @brief how an argument type is stored: trivially copyable values as
+ *  their bytes
+ */
+template <typename T>
+struct LogCodec {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "log arguments are copied, pass values or strings");
+  using Decoded = T;
+  static void Encode(LogPayload& payload, const T& value) noexcept(true) {
+    payload.Put(&value, sizeof(value));
+  }
+  static T Decode(LogPayloadReader& reader) noexcept(true) {
+    T value;
+    reader.Get(&value, sizeof(value));
+    return value;
+  }
+};
+/// C strings are copied, the caller's buffer may be gone when it is written
+template <>
+struct LogCodec<const char*> {
+  using Decoded = const char*;
+  static void Encode(LogPayload& payload, const char* value) noexcept(true) {
+    value = value != nullptr ? value : "(null)";
+    payload.PutString(value, strlen(value));
+  }
+  static const char* Decode(LogPayloadReader& reader) noexcept(true) {
+    return reader.GetString();
+  }
+};
+template <>
+struct LogCodec<char*> : LogCodec<const char*> {};
+/// printed with %s
+template <>
+struct LogCodec<std::string_view> : LogCodec<const char*> {
+  static void Encode(LogPayload& payload, std::string_view value) noexcept(
+      true) {
+    payload.PutString(value.data(), value.size());
+  }
+};
+template <>
+struct LogCodec<std::string> : LogCodec<std::string_view> {};
+
+/**
+ * @brief what a printf conversion takes, and what a log argument is
+ */
+struct LogArgument {
+  enum Kind : uint8_t { kInteger, kFloating, kString, kPointer, kOther };
+  Kind kind{kOther};
+  size_t size{0};  ///< bytes of an integer or floating argument
+
+  /**
+   * @brief kind of an argument of type T, as LogCodec stores it
+   */
+  template <typename T>
+  static constexpr LogArgument Of() noexcept(true) {
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*> ||
+                  std::is_same_v<D, std::string> ||
+                  std::is_same_v<D, std::string_view>) {
+      return {kString, 0};
+    } else if constexpr (std::is_floating_point_v<D>) {
+      return {kFloating, sizeof(D)};
+    } else if constexpr (std::is_integral_v<D> || std::is_enum_v<D>) {
+      return {kInteger, sizeof(D)};
+    } else if constexpr (std::is_pointer_v<D>) {
+      return {kPointer, 0};
+    } else {
+      return {kOther, 0};
+    }
+  }
+};
+
+/**
+ * @class LogFormat
+ * @brief A printf format checked against the types of its arguments at
+ *  compile time
+ * @details the format is only formatted later, on the writer thread, where
+ *  the compiler's -Wformat can't see it; this checks the same things:
+ *  one argument per conversion (and per * width or precision), integers
+ *  of the size the length modifier says (short ones promote to int),
+ *  strings for %s, pointers for %p and no %n. Signedness is not checked,
+ *  as -Wformat doesn't by default. A mismatch fails to compile with a call
+ *  to formatDoesNotMatchArguments.
+ */
+template <typename... Args>
+class LogFormat {
+ public:
+  /**
+   * @brief checks format, which must be a constant (a string literal)
+   */
+  consteval LogFormat(const char* format) : text(format) {  // NOLINT
+    const std::array<LogArgument, sizeof...(Args)> arguments{
+        LogArgument::Of<Args>()...};
+    size_t next = 0;
+    // the next argument must be of kind, size 0 is any size
+    auto take = [&](LogArgument::Kind kind, size_t size, bool promoted) {
+      if (next == arguments.size() || arguments[next].kind != kind ||
+          (size != 0 && (promoted ? arguments[next].size > size
+                                  : arguments[next].size != size))) {
+        formatDoesNotMatchArguments();
+      }
+      ++next;
+    };
+    const char* at = format;
+    // a width or a precision, * takes an int argument
+    auto skipField = [&]() {
+      if (*at == '*') {
+        take(LogArgument::kInteger, sizeof(int), true);
+        ++at;
+      }
+      while (*at >= '0' && *at <= '9') {
+        ++at;
+      }
+    };
+    const std::string_view flags = "-+ #0'";
+    const std::string_view integers = "diuoxXc";
+    const std::string_view floatings = "fFeEgGaA";
+    while (*at != '\0') {
+      if (*at++ != '%') {
+        continue;
+      }
+      if (*at == '%') {
+        ++at;
+        continue;
+      }
+      while (*at != '\0' && flags.find(*at) != std::string_view::npos) {
+        ++at;
+      }
+      skipField();
+      if (*at == '.') {
+        ++at;
+        skipField();
+      }
+      // hh and h promote to int
+      size_t size = sizeof(int);
+      bool promoted = true;
+      if (*at == 'h') {
+        at += at[1] == 'h' ? 2 : 1;
+      } else if (*at == 'l' && at[1] == 'l') {
+        size = sizeof(long long);  // NOLINT
+        promoted = false;
+        at += 2;
+      } else if (*at == 'l' || *at == 'z' || *at == 'j' || *at == 't' ||
+                 *at == 'L') {
+        size = *at == 'l'   ? sizeof(long)  // NOLINT
+               : *at == 'z' ? sizeof(size_t)
+               : *at == 'j' ? sizeof(intmax_t)
+               : *at == 't' ? sizeof(ptrdiff_t)
+                            : sizeof(long double);
+        promoted = false;
+        ++at;
+      }
+      char conversion = *at++;
+      if (integers.find(conversion) != std::string_view::npos) {
+        take(LogArgument::kInteger, size, promoted);
+      } else if (floatings.find(conversion) != std::string_view::npos) {
+        // floats promote to double
+        bool isLong = !promoted && size == sizeof(long double);
+        take(LogArgument::kFloating, isLong ? size : sizeof(double), !isLong);
+      } else if (conversion == 's') {
+        take(LogArgument::kString, 0, false);
+      } else if (conversion == 'p') {
+        take(LogArgument::kPointer, 0, false);
+      } else {
+        // %n, an unknown conversion or a % at the end
+        formatDoesNotMatchArguments();
+        break;
+      }
+    }
+    if (next != arguments.size()) {
+      formatDoesNotMatchArguments();
+    }
+  }
+  /**
+   * @brief the format string
+   */
+  const char* Text() const noexcept(true) { return this->text; }
+
+ private:
+  const char* text;  ///< printf format, a string literal
+
+  /**
+   * @brief not constexpr: calling it while checking fails the build
+   */
+  static void formatDoesNotMatchArguments() noexcept(true) {}
+};
+
+/**
+ * @class Logger
+ * @brief Lock-free asynchronous logging with a runtime level
+ * @details each thread leases a single-producer single-consumer ring the
+ *  first time it logs (given back when it exits) and the writer thread is
+ *  its only consumer. A full ring drops the message and counts it, logging
+ *  never blocks; a thread that finds every ring taken, or a forked child,
+ *  writes synchronously. Warnings and errors go to stderr, the rest to
+ *  stdout, as lines "2023-06-01T12:00:00.123456Z INFO [tid] message".
+ *  The level starts from the environment variable LOG_LEVEL (debug, info,
+ *  warn, error or off), info by default.
+ */
+class Logger {
+ public:
+  /**
+   * @brief messages below level are skipped
+   */
+  static void SetLevel(LogLevel level) noexcept(true) {
+    currentLevel.store(level, std::memory_order_relaxed);
+  }
+  static LogLevel Level() noexcept(true) {
+    return currentLevel.load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief level from its name, as in LOG_LEVEL
+   * @return false if the name is unknown
+   */
+  static bool ParseLevel(const char* name, LogLevel& level) noexcept(true);
+  /**
+   * @brief logs a message
+   * @param format printf format, it must be a string literal: only the
+   *  pointer is kept until the message is written. Checked against args
+   *  when compiling, see LogFormat
+   * @param args values and strings (char*, std::string, std::string_view
+   *  for %s), copied now and formatted later
+   */
+  template <typename... Args>
+  static void Log(LogLevel level,
+                  LogFormat<std::type_identity_t<Args>...> format,
+                  const Args&... args) noexcept(true) {
+    if (level < Level()) {
+      return;
+    }
+    LogRecord* record = acquire();
+    if (record == nullptr) {
+      return;
+    }
+    record->format = &formatRecord<std::decay_t<Args>...>;
+    record->text = format.Text();
+    record->level = level;
+    record->size = 0;
+    LogPayload payload(*record);
+    (LogCodec<std::decay_t<Args>>::Encode(payload, args), ...);
+    publish(record);
+  }
+  template <typename... Args>
+  static void Debug(LogFormat<std::type_identity_t<Args>...> format,
+                    const Args&... args) noexcept(true) {
+    Log(LogLevel::kDebug, format, args...);
+  }
+  template <typename... Args>
+  static void Info(LogFormat<std::type_identity_t<Args>...> format,
+                   const Args&... args) noexcept(true) {
+    Log(LogLevel::kInfo, format, args...);
+  }
+  template <typename... Args>
+  static void Warn(LogFormat<std::type_identity_t<Args>...> format,
+                   const Args&... args) noexcept(true) {
+    Log(LogLevel::kWarn, format, args...);
+  }
+  template <typename... Args>
+  static void Error(LogFormat<std::type_identity_t<Args>...> format,
+                    const Args&... args) noexcept(true) {
+    Log(LogLevel::kError, format, args...);
+  }
+  /**
+   * @brief waits until every message logged so far has been written
+   */
+  static void Flush() noexcept(true);
+  /**
+   * @brief messages dropped so far because their ring was full
+   */
+  static uint64_t Dropped() noexcept(true);
+
+ private:
+  static std::atomic<LogLevel> currentLevel;  ///< runtime level
+  /**
+   * @brief next free record of the calling thread's ring, or a thread local
+   *  record that publish writes synchronously; nullptr if the ring is full
+   */
+  static LogRecord* acquire() noexcept(true);
+  /**
+   * @brief hands the record filled after acquire to the writer
+   */
+  static void publish(LogRecord* record) noexcept(true);
+  /**
+   * @brief decodes the arguments (left to right, braced initialization) and
+   *  formats them with snprintf
+   */
+  template <typename... Args>
+  static int formatRecord(const LogRecord& record, char* buffer,
+                          size_t capacity) noexcept(true) {
+    if constexpr (sizeof...(Args) == 0) {
+      return snprintf(buffer, capacity, "%s", record.text);
+    } else {
+      LogPayloadReader reader(record);
+      std::tuple<typename LogCodec<Args>::Decoded...> values{
+          LogCodec<Args>::Decode(reader)...};
+      return std::apply(
+          [&](auto... value) {
+            return snprintf(buffer, capacity, record.text, value...);
+          },
+          values);
+    }
+  }
+};
+#endif  // LOGGER_HPP
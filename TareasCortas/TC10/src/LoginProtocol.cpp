@@ -0,0 +1,100 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "LoginProtocol.hpp"
+
+#include <cstring>
+
+size_t LoginRequest::Encode(char* buffer, size_t capacity) const {
+  FrameWriter writer(buffer, capacity,
+                     static_cast<uint8_t>(MessageType::kLoginRequest));
+  writer.AddString(1, this->userName);
+  writer.AddString(2, this->password);
+  return writer.Finish();
+}
+
+bool LoginRequest::Decode(FrameReader& reader, LoginRequest& request) {
+  if (reader.Type() != static_cast<uint8_t>(MessageType::kLoginRequest)) {
+    return false;
+  }
+  bool hasUserName = false, hasPassword = false;
+  FrameField field;
+  while (reader.Next(field)) {
+    // unknown tags are skipped, so newer clients can add fields
+    if (field.tag == 1 && field.type == WireType::kBytes) {
+      request.userName = field.bytes;
+      hasUserName = true;
+    } else if (field.tag == 2 && field.type == WireType::kBytes) {
+      request.password = field.bytes;
+      hasPassword = true;
+    }
+  }
+  return hasUserName && hasPassword;
+}
+
+size_t LoginResponse::Encode(char* buffer, size_t capacity) const {
+  FrameWriter writer(buffer, capacity,
+                     static_cast<uint8_t>(MessageType::kLoginResponse));
+  writer.AddUInt32(1, this->status);
+  if (this->status == 0) {
+    writer.AddString(2, this->server);
+    writer.AddString(3, this->dir);
+    writer.AddString(4, this->name);
+    writer.AddString(5, this->nickName);
+    writer.AddString(6, this->description);
+    writer.AddString(7, this->author);
+  }
+  return writer.Finish();
+}
+
+bool LoginResponse::Decode(FrameReader& reader, LoginResponse& response) {
+  if (reader.Type() != static_cast<uint8_t>(MessageType::kLoginResponse)) {
+    return false;
+  }
+  bool hasStatus = false;
+  std::string_view* strings[] = {&response.server,   &response.dir,
+                                 &response.name,     &response.nickName,
+                                 &response.description, &response.author};
+  FrameField field;
+  while (reader.Next(field)) {
+    if (field.tag == 1 && field.type == WireType::kUInt32) {
+      response.status = field.number;
+      hasStatus = true;
+    } else if (field.tag >= 2 && field.tag <= 7 &&
+               field.type == WireType::kBytes) {
+      *strings[field.tag - 2] = field.bytes;
+    }
+  }
+  return hasStatus;
+}
+
+void LoginXmlHandler::StartElement(std::string_view name) {
+  if (this->depth++ == 0) {
+    this->inBody = name == "Body";
+  }
+}
+
+void LoginXmlHandler::EndElement(std::string_view name, std::string_view text,
+                                 bool truncated) {
+  // only the direct children of <Body> are fields
+  if (this->depth-- != 2 || !this->inBody) {
+    return;
+  }
+  char* field = nullptr;
+  size_t* length = nullptr;
+  if (name == "UserName") {
+    field = this->userName;
+    length = &this->userNameLength;
+    this->hasUserName = true;
+  } else if (name == "Password") {
+    field = this->password;
+    length = &this->passwordLength;
+    this->hasPassword = true;
+  } else {
+    return;
+  }
+  if (truncated || text.size() > kLoginFieldCapacity) {
+    this->valid = false;
+    return;
+  }
+  memcpy(field, text.data(), text.size());
+  *length = text.size();
+}
@@ -0,0 +1,111 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file LoginProtocol.hpp
+ * @brief Defines the schema of the TC10 login exchange as binary frames, the
+ * alternative to the XML <Body><UserName>...</UserName>... messages, and the
+ * handler that reads the XML login while it streams in.
+ */
+#ifndef LOGIN_PROTOCOL_HPP
+#define LOGIN_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "Frame.hpp"
+#include "XmlParser.hpp"
+
+/**
+ * @brief Message types carried in the frame header.
+ */
+enum class MessageType : uint8_t { kLoginRequest = 1, kLoginResponse = 2 };
+
+/**
+ * @brief Client login. Fields: 1 UserName, 2 Password (strings).
+ */
+struct LoginRequest {
+  std::string_view userName;
+  std::string_view password;
+  /**
+   * @brief encodes the request as a frame
+   * @return frame size
+   * @throws SocketException if the buffer is too small
+   */
+  size_t Encode(char* buffer, size_t capacity) const noexcept(false);
+  /**
+   * @brief decodes a request, the strings view the reader's frame
+   * @return false if the frame is not a complete login request
+   * @throws SocketException if the frame is malformed
+   */
+  static bool Decode(FrameReader& reader, LoginRequest& request) noexcept(
+      false);
+};
+
+/**
+ * @brief Server answer. Fields: 1 Status (u32, 0 accepted, 1 rejected) and,
+ * when accepted, 2 Server, 3 Dir, 4 Name, 5 NickName, 6 Description,
+ * 7 Author (strings).
+ */
+struct LoginResponse {
+  uint32_t status{1};
+  std::string_view server;
+  std::string_view dir;
+  std::string_view name;
+  std::string_view nickName;
+  std::string_view description;
+  std::string_view author;
+  /**
+   * @brief encodes the response as a frame
+   * @return frame size
+   * @throws SocketException if the buffer is too small
+   */
+  size_t Encode(char* buffer, size_t capacity) const noexcept(false);
+  /**
+   * @brief decodes a response, the strings view the reader's frame
+   * @return false if the frame is not a login response
+   * @throws SocketException if the frame is malformed
+   */
+  static bool Decode(FrameReader& reader, LoginResponse& response) noexcept(
+      false);
+};
+
+constexpr size_t kLoginFieldCapacity = 256;  ///< longest XML login field
+
+/**
+ * @class LoginXmlHandler
+ * @brief Picks <UserName> and <Password> out of an XML login
+ *  (<Body><UserName>...</UserName><Password>...</Password></Body>) as soon as
+ *  each field is complete, the other elements are ignored.
+ */
+class LoginXmlHandler : public XmlHandler {
+ public:
+  void StartElement(std::string_view name) override;
+  void EndElement(std::string_view name, std::string_view text,
+                  bool truncated) override;
+  /**
+   * @brief true once both fields were read and neither was too long
+   */
+  bool Complete() const noexcept(true) {
+    return this->valid && this->hasUserName && this->hasPassword;
+  }
+  /**
+   * @brief the fields read so far, they view this handler
+   */
+  LoginRequest Request() const noexcept(true) {
+    return LoginRequest{
+        std::string_view(this->userName, this->userNameLength),
+        std::string_view(this->password, this->passwordLength)};
+  }
+
+ private:
+  char userName[kLoginFieldCapacity];  ///< copy of <UserName>
+  size_t userNameLength{0};            ///< bytes in userName
+  char password[kLoginFieldCapacity];  ///< copy of <Password>
+  size_t passwordLength{0};            ///< bytes in password
+  size_t depth{0};                     ///< open elements
+  bool inBody{false};                  ///< the root element is <Body>
+  bool hasUserName{false};             ///< <UserName> was read
+  bool hasPassword{false};             ///< <Password> was read
+  bool valid{true};                    ///< no field was too long
+};
+#endif  // LOGIN_PROTOCOL_HPP
@@ -0,0 +1,120 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "MetricsEndpoint.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "SocketException.hpp"
+#include "SocketMetrics.hpp"
+#include "Trace.hpp"
+
+// time a client gets to send its request before the bare text is sent
+#define REQUEST_WAIT_MS 100
+// a client that stops reading holds the (only) serving thread at most this
+// long per send, and this long for the whole response
+#define SEND_TIMEOUT_MS 2000
+#define RESPONSE_DEADLINE_MS 10000
+
+MetricsEndpoint::MetricsEndpoint(const char* path) : path(path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (this->path.size() >= sizeof(address.sun_path)) {
+    throw SocketException("Metrics socket path too long", "MetricsEndpoint",
+                          ENAMETOOLONG, false);
+  }
+  memcpy(address.sun_path, path, this->path.size() + 1);
+  this->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (this->listener == -1) {
+    throw SocketException("Error creating metrics socket", "MetricsEndpoint",
+                          errno, false);
+  }
+  // a socket file left by a previous run would make bind fail
+  unlink(path);
+  if (bind(this->listener, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) == -1 ||
+      listen(this->listener, 16) == -1) {
+    int error = errno;
+    close(this->listener);
+    throw SocketException("Error binding metrics socket", "MetricsEndpoint",
+                          error, false);
+  }
+  this->server = std::thread(&MetricsEndpoint::serve, this);
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+  // wakes up the accept of the serving thread
+  shutdown(this->listener, SHUT_RDWR);
+  this->server.join();
+  close(this->listener);
+  unlink(this->path.c_str());
+}
+
+void MetricsEndpoint::serve() noexcept(true) {
+  while (true) {
+    int client = accept4(this->listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      break;
+    }
+    // a scrape that never reads must not stall the next ones, nor join()
+    timeval timeout{SEND_TIMEOUT_MS / 1000, SEND_TIMEOUT_MS % 1000 * 1000};
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    answer(client);
+    close(client);
+  }
+}
+
+void MetricsEndpoint::answer(int client) noexcept(true) {
+  bool http = false;
+  bool trace = false;
+  pollfd request{client, POLLIN, 0};
+  if (poll(&request, 1, REQUEST_WAIT_MS) == 1) {
+    // only the target matters: /trace or anything else for the metrics
+    char buffer[1024];
+    ssize_t bytes = read(client, buffer, sizeof(buffer) - 1);
+    http = bytes > 0;
+    if (http) {
+      buffer[bytes] = '\0';
+      trace = strncmp(buffer, "GET /trace", 10) == 0;
+    }
+  }
+  std::string body;
+  try {
+    body = trace ? Tracer::ChromeJson() : SocketMetrics::Prometheus();
+  } catch (const std::exception& e) {
+    return;
+  }
+  std::string response;
+  if (http) {
+    char head[160];
+    snprintf(head, sizeof(head),
+             "HTTP/1.0 200 OK\r\n"
+             "Content-Type: %s\r\n"
+             "Content-Length: %zu\r\n\r\n",
+             trace ? "application/json" : "text/plain; version=0.0.4",
+             body.size());
+    response = head;
+  }
+  response += body;
+  // a reader that takes a little at a time can't get around the timeout
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(RESPONSE_DEADLINE_MS);
+  for (size_t sent = 0; sent < response.size();) {
+    ssize_t bytes = send(client, response.data() + sent,
+                         response.size() - sent, MSG_NOSIGNAL);
+    if (bytes <= 0 || std::chrono::steady_clock::now() > deadline) {
+      return;
+    }
+    sent += bytes;
+  }
+}
@@ -0,0 +1,55 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file MetricsEndpoint.hpp
+ * @brief Defines MetricsEndpoint, a local admin socket (AF_UNIX) that
+ * answers every connection with SocketMetrics in Prometheus text format, or
+ * with the connection lifecycle trace for "GET /trace".
+ */
+#ifndef METRICS_ENDPOINT_HPP
+#define METRICS_ENDPOINT_HPP
+
+#include <string>
+#include <thread>
+
+/**
+ * @class MetricsEndpoint
+ * @brief Serves the metrics from its own thread, so scraping never touches
+ *  the threads doing I/O. Only reachable from this machine and limited by
+ *  the file permissions of the socket. Usage:
+ *  curl --unix-socket /tmp/tc10.metrics http://localhost/metrics
+ *  curl --unix-socket /tmp/tc10.metrics http://localhost/trace > trace.json
+ */
+class MetricsEndpoint {
+ public:
+  /**
+   * @brief Constructor for MetricsEndpoint, starts serving right away
+   * @param path file system path of the socket, a stale one is replaced
+   * @throws SocketException if the socket can't be created or bound
+   */
+  explicit MetricsEndpoint(const char* path) noexcept(false);
+  /**
+   * @brief Destructor, stops the thread and removes the socket file
+   * @details a scrape in progress ends first; one whose client doesn't
+   *  read is dropped after a few seconds
+   */
+  ~MetricsEndpoint() noexcept(true);
+  MetricsEndpoint(const MetricsEndpoint&) = delete;
+  MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+ private:
+  std::string path;    ///< path of the socket file
+  int listener{-1};    ///< listening AF_UNIX socket
+  std::thread server;  ///< accepts and answers the scrapes
+
+  /**
+   * @brief accepts connections until the listener is shut down
+   */
+  void serve() noexcept(true);
+  /**
+   * @brief answers one scrape: an HTTP/1.0 response if a request arrives
+   *  (curl, Prometheus), the bare metrics otherwise (nc -U)
+   *  A client that stops reading gets the response cut short.
+   */
+  static void answer(int client) noexcept(true);
+};
+#endif  // METRICS_ENDPOINT_HPP
@@ -0,0 +1,211 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "PageCache.hpp"
+
+#include <brotli/encode.h>
+#include <dirent.h>
+#include <zlib.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "FigureIndex.hpp"
+
+PageCache::PageCache(bool precompress) noexcept(true)
+    : precompress(precompress) {}
+
+PageCache::~PageCache() noexcept(true) {}
+
+size_t PageCache::LoadIndex(const std::string& path) {
+  this->index = std::make_unique<FigureIndex>(path);
+  return this->index->Size();
+}
+
+size_t PageCache::LoadDirectory(const std::string& path) {
+  DIR* directory = opendir(path.c_str());
+  if (directory == nullptr) {
+    throw std::runtime_error("Error opening figure directory " + path +
+                             " (PageCache::LoadDirectory)");
+  }
+  size_t loaded = 0;
+  while (dirent* entry = readdir(directory)) {
+    std::string fileName = entry->d_name;
+    // only the figure pages, the name without extension is the figure name
+    size_t dot = fileName.rfind('.');
+    if (dot == std::string::npos) {
+      continue;
+    }
+    std::string extension = fileName.substr(dot);
+    if (extension != ".htm" && extension != ".html") {
+      continue;
+    }
+    std::ifstream file(path + "/" + fileName, std::ios::binary);
+    if (!file) {
+      closedir(directory);
+      throw std::runtime_error("Error reading page " + fileName +
+                               " (PageCache::LoadDirectory)");
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    this->Insert(fileName.substr(0, dot), content.str());
+    ++loaded;
+  }
+  closedir(directory);
+  return loaded;
+}
+
+void PageCache::Insert(const std::string& name, std::string content) {
+  OwnedPage page;
+  if (this->precompress) {
+    // keep a variant only if it actually saves bytes on the wire
+    std::string gzip = gzipCompress(content);
+    if (gzip.size() < content.size()) {
+      page.gzip = std::move(gzip);
+    }
+    std::string brotli = brotliCompress(content);
+    if (brotli.size() < content.size()) {
+      page.brotli = std::move(brotli);
+    }
+  }
+  page.identity = std::move(content);
+  this->pages[name] = std::move(page);
+}
+
+bool PageCache::Find(std::string_view name, CachedPage& page) const
+    noexcept(true) {
+  if (this->index && this->index->Find(name, page)) {
+    return true;
+  }
+  if (this->pages.empty()) {
+    return false;
+  }
+  auto owned = this->pages.find(std::string(name));
+  if (owned == this->pages.end()) {
+    return false;
+  }
+  page.identity = owned->second.identity;
+  page.gzip = owned->second.gzip;
+  page.brotli = owned->second.brotli;
+  return true;
+}
+
+void PageCache::ForEach(
+    const std::function<void(const std::string&, const CachedPage&)>& visit)
+    const {
+  for (const auto& [name, owned] : this->pages) {
+    visit(name, CachedPage{owned.identity, owned.gzip, owned.brotli});
+  }
+}
+
+size_t PageCache::Size() const noexcept(true) {
+  return this->pages.size() + (this->index ? this->index->Size() : 0);
+}
+
+AcceptedEncodings PageCache::Negotiate(
+    std::string_view acceptEncoding) noexcept(true) {
+  // q-values of the codings we can serve, -1 means "not mentioned"
+  double gzipQ = -1, brotliQ = -1, anyQ = -1;
+  while (!acceptEncoding.empty()) {
+    size_t comma = acceptEncoding.find(',');
+    std::string_view item = acceptEncoding.substr(0, comma);
+    acceptEncoding = comma == std::string_view::npos
+                         ? std::string_view()
+                         : acceptEncoding.substr(comma + 1);
+    // split "coding;q=value" and trim the spaces around the coding
+    size_t semicolon = item.find(';');
+    std::string_view coding = item.substr(0, semicolon);
+    while (!coding.empty() && coding.front() == ' ') coding.remove_prefix(1);
+    while (!coding.empty() && coding.back() == ' ') coding.remove_suffix(1);
+    double quality = 1;
+    if (semicolon != std::string_view::npos) {
+      size_t q = item.find("q=", semicolon);
+      if (q != std::string_view::npos) {
+        // strtod stops at the first character that is not part of a number
+        std::string value(item.substr(q + 2));
+        quality = std::strtod(value.c_str(), nullptr);
+      }
+    }
+    if (coding == "gzip" || coding == "x-gzip") {
+      gzipQ = quality;
+    } else if (coding == "br") {
+      brotliQ = quality;
+    } else if (coding == "*") {
+      anyQ = quality;
+    }
+  }
+  if (gzipQ < 0) gzipQ = anyQ;
+  if (brotliQ < 0) brotliQ = anyQ;
+  AcceptedEncodings accepted;
+  accepted.gzip = gzipQ > 0 ? gzipQ : 0;
+  accepted.brotli = brotliQ > 0 ? brotliQ : 0;
+  return accepted;
+}
+
+std::string_view PageCache::Select(const CachedPage& page,
+                                   const AcceptedEncodings& accepted,
+                                   ContentEncoding& encoding) noexcept(true) {
+  // a variant that wasn't built (not smaller) can't be chosen
+  double brotliQ = page.brotli.empty() ? 0 : accepted.brotli;
+  double gzipQ = page.gzip.empty() ? 0 : accepted.gzip;
+  // brotli wins ties, it is usually smaller for HTML
+  if (brotliQ > 0 && brotliQ >= gzipQ) {
+    encoding = ContentEncoding::kBrotli;
+    return page.brotli;
+  }
+  if (gzipQ > 0) {
+    encoding = ContentEncoding::kGzip;
+    return page.gzip;
+  }
+  encoding = ContentEncoding::kIdentity;
+  return page.identity;
+}
+
+const char* PageCache::EncodingName(ContentEncoding encoding) noexcept(true) {
+  switch (encoding) {
+    case ContentEncoding::kBrotli:
+      return "br";
+    case ContentEncoding::kGzip:
+      return "gzip";
+    default:
+      return nullptr;
+  }
+}
+
+std::string PageCache::gzipCompress(std::string_view data) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 15 window bits + 16 asks zlib for a gzip header instead of a zlib one
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("Error initializing zlib (PageCache::Insert)");
+  }
+  std::string output(deflateBound(&stream, data.size()), '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef*>(output.data());
+  stream.avail_out = output.size();
+  int status = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    throw std::runtime_error("Error compressing page (PageCache::Insert)");
+  }
+  output.resize(stream.total_out);
+  return output;
+}
+
+std::string PageCache::brotliCompress(std::string_view data) {
+  size_t size = BrotliEncoderMaxCompressedSize(data.size());
+  std::string output(size, '\0');
+  int status = BrotliEncoderCompress(
+      BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(),
+      reinterpret_cast<const uint8_t*>(data.data()), &size,
+      reinterpret_cast<uint8_t*>(output.data()));
+  if (status == BROTLI_FALSE) {
+    throw std::runtime_error("Error compressing page (PageCache::Insert)");
+  }
+  output.resize(size);
+  return output;
+}
@@ -0,0 +1,154 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file PageCache.hpp
+ * @brief Defines an in-memory cache of figure pages with precompressed
+ * (gzip/brotli) variants, selected through Accept-Encoding negotiation.
+ */
+#ifndef PAGE_CACHE_HPP
+#define PAGE_CACHE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class FigureIndex;
+
+/**
+ * @brief Content codings the cache can serve, in order of preference.
+ */
+enum class ContentEncoding { kIdentity, kGzip, kBrotli };
+
+/**
+ * @brief q-values an Accept-Encoding header gives the compressed codings,
+ *  0 for a coding the client refuses or doesn't mention.
+ */
+struct AcceptedEncodings {
+  double gzip{0};    ///< q-value of gzip (or x-gzip)
+  double brotli{0};  ///< q-value of br
+};
+
+/**
+ * @brief A cached page: its raw bytes and the compressed variants built once
+ * when the page was inserted. A compressed variant is left empty when it is
+ * not smaller than the raw page, so it is never worth sending. The views
+ * point into the cache (or its mapped index) and live as long as it does.
+ */
+struct CachedPage {
+  std::string_view identity;  ///< raw page bytes
+  std::string_view gzip;      ///< gzip variant, empty if not worth sending
+  std::string_view brotli;    ///< brotli variant, empty if not worth sending
+};
+
+/**
+ * @class PageCache
+ * @brief Read-mostly cache of pages keyed by figure name.
+ * @details Pages are loaded (and compressed) once at startup, after that the
+ * cache is only read, so it can be shared by every worker thread without
+ * locking.
+ */
+class PageCache {
+ public:
+  /**
+   * @brief Constructor for PageCache
+   * @param precompress if false only the raw bytes are kept, useful to
+   *  compare against the uncompressed behavior.
+   */
+  explicit PageCache(bool precompress = true) noexcept(true);
+  /**
+   * @brief Destructor, unmaps the figure index if one was loaded
+   */
+  ~PageCache() noexcept(true);
+  /**
+   * @brief loads every .htm/.html file in a directory, the file name without
+   *  extension is the figure name.
+   * @param path directory containing the figure pages
+   * @throws std::runtime_error if the directory or a page can't be read
+   * @return number of pages loaded
+   */
+  size_t LoadDirectory(const std::string& path) noexcept(false);
+  /**
+   * @brief maps a figure index built offline (see FigureIndex::Build), its
+   *  pages are looked up before the ones inserted in memory.
+   * @param path index file
+   * @throws std::runtime_error if the index can't be mapped or is invalid
+   * @return number of pages in the index
+   */
+  size_t LoadIndex(const std::string& path) noexcept(false);
+  /**
+   * @brief inserts a page, building its compressed variants.
+   * @param name figure name used as key
+   * @param content raw page bytes
+   * @throws std::runtime_error if a compressor fails
+   */
+  void Insert(const std::string& name, std::string content) noexcept(false);
+  /**
+   * @brief looks up a page by figure name
+   * @param name figure name
+   * @param page where the views of the page are stored if it is found
+   * @return true if the page is in the cache
+   */
+  bool Find(std::string_view name, CachedPage& page) const noexcept(true);
+  /**
+   * @brief calls visit with every page inserted in memory (not the index)
+   */
+  void ForEach(const std::function<void(const std::string&, const CachedPage&)>&
+                   visit) const noexcept(false);
+  /**
+   * @brief number of pages in the cache, including the mapped index
+   */
+  size_t Size() const noexcept(true);
+  /**
+   * @brief the codings an Accept-Encoding header value accepts, honoring
+   *  q-values ("gzip;q=0", "*;q=0.5", ...).
+   * @param acceptEncoding value of the Accept-Encoding header, may be empty
+   */
+  static AcceptedEncodings Negotiate(std::string_view acceptEncoding) noexcept(
+      true);
+  /**
+   * @brief selects the variant of a page to send: the built variant the
+   *  client accepts with the highest q-value (brotli on ties), identity if
+   *  there is none.
+   * @param page cached page
+   * @param accepted what Negotiate returned for the request
+   * @param encoding out: coding of the selected variant
+   * @return bytes of the selected variant
+   */
+  static std::string_view Select(const CachedPage& page,
+                                 const AcceptedEncodings& accepted,
+                                 ContentEncoding& encoding) noexcept(true);
+  /**
+   * @brief token to send in the Content-Encoding header
+   * @return "gzip", "br" or nullptr for identity
+   */
+  static const char* EncodingName(ContentEncoding encoding) noexcept(true);
+
+ private:
+  /**
+   * @private
+   * @brief bytes of a page inserted in memory, CachedPage views them
+   */
+  struct OwnedPage {
+    std::string identity;
+    std::string gzip;
+    std::string brotli;
+  };
+  bool precompress{true};  ///< true if compressed variants are built
+  std::unordered_map<std::string, OwnedPage> pages;  ///< pages by name
+  std::unique_ptr<FigureIndex> index;  ///< mapped index, may be null
+  /**
+   * @private
+   * @brief compresses data in gzip format using zlib
+   * @throws std::runtime_error if zlib fails
+   */
+  static std::string gzipCompress(std::string_view data) noexcept(false);
+  /**
+   * @private
+   * @brief compresses data using brotli at maximum quality
+   * @throws std::runtime_error if brotli fails
+   */
+  static std::string brotliCompress(std::string_view data) noexcept(false);
+};
+#endif  // PAGE_CACHE_HPP
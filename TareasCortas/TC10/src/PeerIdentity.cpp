@@ -0,0 +1,221 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "PeerIdentity.hpp"
+
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <strings.h>
+
+#include <cstdio>
+
+/**
+ * @brief ASN1 time as seconds since the epoch, 0 if it can't be decoded
+ */
+static time_t epochOf(const ASN1_TIME* time) noexcept(true) {
+  tm utc{};
+  if (time == nullptr || ASN1_TIME_to_tm(time, &utc) != 1) {
+    return 0;
+  }
+  return timegm(&utc);
+}
+
+/**
+ * @brief SHA-256 fetched once: EVP_sha256() looks the implementation up on
+ *  every digest in OpenSSL 3, a third of the cost of fingerprinting
+ */
+static const EVP_MD* sha256() noexcept(true) {
+  static const EVP_MD* digest = [] {
+    const EVP_MD* fetched = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+    return fetched != nullptr ? fetched : EVP_sha256();
+  }();
+  return digest;
+}
+
+bool PeerIdentity::Load(X509* certificate, long verifyResult) noexcept(
+    true) {
+  this->verifyResult = verifyResult;
+  // X509_NAME_oneline and X509_NAME_get_text_by_NID write into our buffers
+  X509_NAME* subjectName = X509_get_subject_name(certificate);
+  X509_NAME_oneline(subjectName, this->subject, sizeof(this->subject));
+  X509_NAME_oneline(X509_get_issuer_name(certificate), this->issuer,
+                    sizeof(this->issuer));
+  if (X509_NAME_get_text_by_NID(subjectName, NID_commonName,
+                                this->commonName,
+                                sizeof(this->commonName)) < 0) {
+    this->commonName[0] = '\0';
+  }
+  this->loadSans(certificate);
+  unsigned int length = 0;
+  bool digested = X509_digest(certificate, sha256(),
+                              this->fingerprint.data(), &length) == 1 &&
+                  length == kPeerFingerprint;
+  this->notBefore = epochOf(X509_get0_notBefore(certificate));
+  this->notAfter = epochOf(X509_get0_notAfter(certificate));
+  return digested && this->notAfter != 0;
+}
+
+bool PeerIdentity::Load(const SSL* ssl) noexcept(true) {
+  // a borrowed pointer: no reference count to take and drop
+  X509* certificate = SSL_get0_peer_certificate(ssl);
+  if (certificate == nullptr) {
+    return false;
+  }
+  return this->Load(certificate, SSL_get_verify_result(ssl));
+}
+
+void PeerIdentity::loadSans(X509* certificate) noexcept(true) {
+  this->sanCount = 0;
+  GENERAL_NAMES* names = static_cast<GENERAL_NAMES*>(
+      X509_get_ext_d2i(certificate, NID_subject_alt_name, nullptr, nullptr));
+  if (names == nullptr) {
+    return;
+  }
+  bool room = true;
+  for (int index = 0; room && index < sk_GENERAL_NAME_num(names); ++index) {
+    const GENERAL_NAME* name = sk_GENERAL_NAME_value(names, index);
+    int type = 0;
+    const void* value = GENERAL_NAME_get0_value(name, &type);
+    if (type != GEN_DNS && type != GEN_EMAIL && type != GEN_URI &&
+        type != GEN_IPADD) {
+      // directory names, other names: not used to identify peers here, and
+      // their values are structures of their own, not ASN1_STRINGs
+      continue;
+    }
+    const ASN1_STRING* string = static_cast<const ASN1_STRING*>(value);
+    const char* text = reinterpret_cast<const char*>(ASN1_STRING_get0_data(
+        string));
+    size_t length = static_cast<size_t>(ASN1_STRING_length(string));
+    switch (type) {
+      case GEN_DNS:
+        room = this->addSan("DNS:", text, length);
+        break;
+      case GEN_EMAIL:
+        room = this->addSan("email:", text, length);
+        break;
+      case GEN_URI:
+        room = this->addSan("URI:", text, length);
+        break;
+      case GEN_IPADD: {
+        char address[INET6_ADDRSTRLEN];
+        int family = length == 4 ? AF_INET : AF_INET6;
+        if ((length == 4 || length == 16) &&
+            inet_ntop(family, text, address, sizeof(address)) != nullptr) {
+          room = this->addSan("IP:", address, strlen(address));
+        }
+        break;
+      }
+    }
+  }
+  GENERAL_NAMES_free(names);
+}
+
+bool PeerIdentity::addSan(const char* type, const char* value,
+                          size_t length) noexcept(true) {
+  size_t used = this->sanCount == 0
+                    ? 0
+                    : this->sanOffsets[this->sanCount - 1] +
+                          this->sanLengths[this->sanCount - 1];
+  size_t prefix = strlen(type);
+  if (this->sanCount == kPeerSans ||
+      used + prefix + length > sizeof(this->sans)) {
+    return false;
+  }
+  memcpy(this->sans + used, type, prefix);
+  memcpy(this->sans + used + prefix, value, length);
+  this->sanOffsets[this->sanCount] = static_cast<uint16_t>(used);
+  this->sanLengths[this->sanCount] = static_cast<uint16_t>(prefix + length);
+  ++this->sanCount;
+  return true;
+}
+
+bool PeerIdentity::MatchesHost(std::string_view host) const noexcept(true) {
+  bool dnsNames = false;
+  for (size_t index = 0; index < this->sanCount; ++index) {
+    std::string_view name = this->San(index);
+    if (name.substr(0, 4) == "DNS:") {
+      dnsNames = true;
+      name.remove_prefix(4);
+      if (name.size() == host.size() &&
+          strncasecmp(name.data(), host.data(), host.size()) == 0) {
+        return true;
+      }
+    }
+  }
+  // RFC 6125: the CN only counts when there are no DNS names
+  return !dnsNames && host.size() == strlen(this->commonName) &&
+         strncasecmp(this->commonName, host.data(), host.size()) == 0;
+}
+
+void PeerIdentity::FingerprintHex(char* buffer) const noexcept(true) {
+  static const char kDigits[] = "0123456789abcdef";
+  for (size_t index = 0; index < kPeerFingerprint; ++index) {
+    buffer[2 * index] = kDigits[this->fingerprint[index] >> 4];
+    buffer[2 * index + 1] = kDigits[this->fingerprint[index] & 0xf];
+  }
+  buffer[2 * kPeerFingerprint] = '\0';
+}
+
+/**
+ * @brief value of a hex digit, -1 if it is not one
+ */
+static int hexValue(char digit) noexcept(true) {
+  if (digit >= '0' && digit <= '9') {
+    return digit - '0';
+  }
+  if (digit >= 'a' && digit <= 'f') {
+    return digit - 'a' + 10;
+  }
+  if (digit >= 'A' && digit <= 'F') {
+    return digit - 'A' + 10;
+  }
+  return -1;
+}
+
+bool PeerAllowlist::AddHex(const char* hex) noexcept(false) {
+  PeerFingerprint fingerprint{};
+  size_t bytes = 0;
+  for (const char* digit = hex; *digit != '\0';) {
+    if (*digit == ':') {
+      ++digit;
+      continue;
+    }
+    int high = hexValue(digit[0]);
+    int low = high < 0 ? -1 : hexValue(digit[1]);
+    if (low < 0 || bytes == kPeerFingerprint) {
+      return false;
+    }
+    fingerprint[bytes++] = static_cast<unsigned char>(high << 4 | low);
+    digit += 2;
+  }
+  if (bytes != kPeerFingerprint) {
+    return false;
+  }
+  this->Add(fingerprint);
+  return true;
+}
+
+size_t PeerAllowlist::AddPemFile(const char* fileName) noexcept(false) {
+  FILE* file = fopen(fileName, "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  size_t added = 0;
+  X509* certificate = nullptr;
+  while ((certificate = PEM_read_X509(file, nullptr, nullptr, nullptr)) !=
+         nullptr) {
+    PeerFingerprint fingerprint{};
+    unsigned int length = 0;
+    if (X509_digest(certificate, sha256(), fingerprint.data(),
+                    &length) == 1 &&
+        length == kPeerFingerprint) {
+      this->Add(fingerprint);
+      ++added;
+    }
+    X509_free(certificate);
+  }
+  // PEM_read_X509 leaves "no start line" on the queue at the end of file
+  ERR_clear_error();
+  fclose(file);
+  return added;
+}
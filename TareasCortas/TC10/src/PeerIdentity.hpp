@@ -0,0 +1,168 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file PeerIdentity.hpp
+ * @brief Defines PeerIdentity, the fields of a peer certificate extracted
+ * once per connection into fixed buffers, and PeerAllowlist, certificate
+ * pinning by SHA-256 fingerprint checked with one hash lookup.
+ */
+#ifndef PEER_IDENTITY_HPP
+#define PEER_IDENTITY_HPP
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <unordered_set>
+
+constexpr size_t kPeerNameSize = 256;  ///< subject and issuer, one line
+constexpr size_t kPeerCommonNameSize = 64;
+constexpr size_t kPeerSans = 16;         ///< subject alternative names kept
+constexpr size_t kPeerSanBytes = 512;    ///< text of all of them
+constexpr size_t kPeerFingerprint = 32;  ///< SHA-256
+
+/// SHA-256 of the DER encoded certificate
+using PeerFingerprint = std::array<unsigned char, kPeerFingerprint>;
+
+/**
+ * @class PeerIdentity
+ * @brief Who the peer is according to its certificate: subject, issuer,
+ *  common name, subject alternative names ("DNS:host", "IP:addr",
+ *  "email:..." or "URI:..."), fingerprint, validity and the chain
+ *  verification result. Filled once, read without touching OpenSSL.
+ */
+class PeerIdentity {
+ public:
+  /**
+   * @brief extracts the fields of certificate, names longer than their
+   *  buffer are truncated and SANs past kPeerSans are left out
+   * @param verifyResult SSL_get_verify_result of the connection
+   * @return false if a field could not be decoded
+   */
+  bool Load(X509* certificate, long verifyResult) noexcept(true);
+  /**
+   * @brief extracts the certificate the peer of ssl presented
+   * @return false if it presented none
+   */
+  bool Load(const SSL* ssl) noexcept(true);
+  /**
+   * @brief subject as "/C=CR/O=UCR/CN=host" (X509_NAME_oneline)
+   */
+  const char* Subject() const noexcept(true) { return this->subject; }
+  const char* Issuer() const noexcept(true) { return this->issuer; }
+  /**
+   * @brief CN of the subject, empty if there is none
+   */
+  const char* CommonName() const noexcept(true) { return this->commonName; }
+  size_t SanCount() const noexcept(true) { return this->sanCount; }
+  /**
+   * @brief the index-th subject alternative name, type prefixed
+   */
+  std::string_view San(size_t index) const noexcept(true) {
+    return std::string_view(this->sans + this->sanOffsets[index],
+                            this->sanLengths[index]);
+  }
+  /**
+   * @brief true if one of the DNS names (or the CN, when there are none)
+   *  is host, compared case insensitively and without wildcards
+   */
+  bool MatchesHost(std::string_view host) const noexcept(true);
+  const PeerFingerprint& Fingerprint() const noexcept(true) {
+    return this->fingerprint;
+  }
+  /**
+   * @brief fingerprint as 64 lowercase hex digits, buffer of at least 65
+   */
+  void FingerprintHex(char* buffer) const noexcept(true);
+  time_t NotBefore() const noexcept(true) { return this->notBefore; }
+  time_t NotAfter() const noexcept(true) { return this->notAfter; }
+  /**
+   * @brief true if now is outside the validity period
+   */
+  bool Expired(time_t now) const noexcept(true) {
+    return now < this->notBefore || now >= this->notAfter;
+  }
+  /**
+   * @brief true if OpenSSL verified the chain (only when the context asked
+   *  for verification, otherwise a self signed certificate is not)
+   */
+  bool Verified() const noexcept(true) {
+    return this->verifyResult == X509_V_OK;
+  }
+  long VerifyResult() const noexcept(true) { return this->verifyResult; }
+
+ private:
+  char subject[kPeerNameSize]{};
+  char issuer[kPeerNameSize]{};
+  char commonName[kPeerCommonNameSize]{};
+  char sans[kPeerSanBytes]{};           ///< the SANs one after the other
+  uint16_t sanOffsets[kPeerSans]{};     ///< start of each SAN in sans
+  uint16_t sanLengths[kPeerSans]{};     ///< length of each SAN
+  size_t sanCount{0};                   ///< SANs in sans
+  PeerFingerprint fingerprint{};        ///< SHA-256 of the DER encoding
+  time_t notBefore{0};                  ///< start of validity, UTC
+  time_t notAfter{0};                   ///< end of validity, UTC
+  long verifyResult{X509_V_OK};         ///< SSL_get_verify_result
+
+  /**
+   * @brief copies the subject alternative names of certificate
+   */
+  void loadSans(X509* certificate) noexcept(true);
+  /**
+   * @brief appends a SAN, false if it does not fit
+   */
+  bool addSan(const char* type, const char* value, size_t length) noexcept(
+      true);
+};
+
+/**
+ * @class PeerAllowlist
+ * @brief Certificates allowed to connect, pinned by fingerprint. Filled at
+ *  startup and only read afterwards, so any number of threads may call
+ *  Allows at once; each call is a hash lookup on the cached fingerprint.
+ */
+class PeerAllowlist {
+ public:
+  void Add(const PeerFingerprint& fingerprint) noexcept(false) {
+    this->allowed.insert(fingerprint);
+  }
+  /**
+   * @brief adds a fingerprint written as hex, with or without ':' between
+   *  the bytes (as printed by "openssl x509 -fingerprint -sha256")
+   * @return false if it is not 32 bytes of hex
+   */
+  bool AddHex(const char* hex) noexcept(false);
+  /**
+   * @brief adds the fingerprint of every certificate in a PEM file
+   * @return number of certificates added
+   */
+  size_t AddPemFile(const char* fileName) noexcept(false);
+  /**
+   * @brief true if peer presented a pinned certificate that is valid now
+   * @param peer identity of the connection, nullptr if it presented none
+   */
+  bool Allows(const PeerIdentity* peer, time_t now) const noexcept(true) {
+    return peer != nullptr && !peer->Expired(now) &&
+           this->allowed.count(peer->Fingerprint()) != 0;
+  }
+  size_t Size() const noexcept(true) { return this->allowed.size(); }
+
+ private:
+  /**
+   * @brief a SHA-256 is already uniform, its first bytes are the hash
+   */
+  struct FingerprintHash {
+    size_t operator()(const PeerFingerprint& fingerprint) const
+        noexcept(true) {
+      size_t hash;
+      memcpy(&hash, fingerprint.data(), sizeof(hash));
+      return hash;
+    }
+  };
+  std::unordered_set<PeerFingerprint, FingerprintHash> allowed;
+};
+#endif  // PEER_IDENTITY_HPP
@@ -0,0 +1,54 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file Result.hpp
+ * @brief Defines Result, the value or error returned by the non-throwing
+ * Socket methods (the same idea as C++23 std::expected<T, std::error_code>).
+ */
+#ifndef RESULT_HPP
+#define RESULT_HPP
+
+#include <system_error>
+
+/**
+ * @class Result
+ * @brief Holds either a value or the std::error_code that prevented it
+ */
+template <typename T>
+class Result {
+ public:
+  /**
+   * @brief successful result
+   */
+  Result(T value) noexcept(true) : value(value) {}  // NOLINT
+  /**
+   * @brief failed result
+   */
+  Result(std::error_code error) noexcept(true) : error(error) {}  // NOLINT
+  /**
+   * @brief true if there is a value
+   */
+  explicit operator bool() const noexcept(true) { return !this->error; }
+  /**
+   * @brief the value, undefined if there is an error
+   */
+  const T& operator*() const noexcept(true) { return this->value; }
+  /**
+   * @brief the value
+   * @throws std::system_error if there is an error instead
+   */
+  const T& Value() const noexcept(false) {
+    if (this->error) {
+      throw std::system_error(this->error);
+    }
+    return this->value;
+  }
+  /**
+   * @brief the error, a false error_code if there is a value
+   */
+  std::error_code Error() const noexcept(true) { return this->error; }
+
+ private:
+  T value{};              ///< value, if there is no error
+  std::error_code error;  ///< error, if there is no value
+};
+#endif  // RESULT_HPP
@@ -0,0 +1,364 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "ShmChannel.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+// bytes before the data of each ring, its positions and flags
+#define RING_HEADER 4096
+// smallest ring, one page
+#define MIN_RING_BYTES 4096
+// largest ring a client accepts from a server
+#define MAX_RING_BYTES (1ull << 30)
+// times a side checks its ring again, yielding in between, before it
+// sleeps on the eventfd
+#define SHM_SPINS 64
+
+/// first bytes of the handshake, so a stray connection is not mapped
+static constexpr uint32_t kShmMagic = 0x544d4853;  // "SHMT"
+
+/**
+ * @brief positions and flags of one ring, in the shared memory
+ * @details the positions only grow, the byte of position p is at
+ *  p % ringBytes; each one is on its own cache line so the two sides
+ *  don't take the line from each other on every update.
+ */
+struct ShmRing {
+  alignas(64) std::atomic<uint64_t> head{0};  ///< written up to, by writer
+  std::atomic<uint32_t> writerAsleep{0};      ///< writer waits for room
+  std::atomic<uint32_t> writerClosed{0};      ///< no more data comes
+  alignas(64) std::atomic<uint64_t> tail{0};  ///< read up to, by reader
+  std::atomic<uint32_t> readerAsleep{0};      ///< reader waits for data
+  std::atomic<uint32_t> readerClosed{0};      ///< nobody reads anymore
+};
+static_assert(sizeof(ShmRing) <= RING_HEADER, "ring header fits");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "atomics shared between processes can't take a lock");
+
+/**
+ * @brief what the server sends along with the descriptors
+ */
+struct ShmHello {
+  uint32_t magic;
+  uint32_t rings;      ///< always 2
+  uint64_t ringBytes;  ///< of each ring
+};
+
+ShmChannel::ShmChannel(Socket* connection, bool server, size_t ringBytes)
+    : connection(connection) {
+  try {
+    if (server) {
+      this->create(ringBytes);
+    } else {
+      this->join();
+    }
+  } catch (const SocketException& e) {
+    // the destructor won't run for a constructor that throws
+    this->Close();
+    throw;
+  }
+}
+
+ShmChannel::~ShmChannel() noexcept(true) { this->Close(); }
+
+void ShmChannel::create(size_t ringBytes) {
+  ringBytes = std::bit_ceil(std::max<size_t>(ringBytes, MIN_RING_BYTES));
+  int descriptors[5] = {-1, -1, -1, -1, -1};
+  auto fail = [&descriptors](const char* message, int error) {
+    for (int descriptor : descriptors) {
+      if (descriptor != -1) {
+        close(descriptor);
+      }
+    }
+    throw SocketException(message, "ShmChannel::ShmChannel", error, false);
+  };
+  descriptors[0] =
+      memfd_create("tc10-shm-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  // sealed at its size: the client checks neither side can shrink it under
+  // the other's mapping (which would turn accesses into SIGBUS)
+  if (descriptors[0] == -1 ||
+      ftruncate(descriptors[0], 2 * (RING_HEADER + ringBytes)) == -1 ||
+      fcntl(descriptors[0], F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+    fail("Error creating shared memory", errno);
+  }
+  for (int index = 1; index < 5; ++index) {
+    descriptors[index] = eventfd(0, EFD_CLOEXEC);
+    if (descriptors[index] == -1) {
+      fail("Error creating eventfd", errno);
+    }
+  }
+  this->ringBytes = ringBytes;
+  try {
+    this->map(descriptors[0], descriptors + 1, true);
+  } catch (const SocketException& e) {
+    fail("Error mapping shared memory", e.Code().value());
+  }
+  // the eventfds belong to the channel now, only the memfd is left
+  new (this->output) ShmRing();
+  new (this->input) ShmRing();
+  ShmHello hello{kShmMagic, 2, ringBytes};
+  try {
+    this->connection->SendDescriptors(&hello, sizeof(hello), descriptors, 5);
+  } catch (const SocketException& e) {
+    close(descriptors[0]);
+    throw;
+  }
+  // the mapping keeps the memory
+  close(descriptors[0]);
+}
+
+void ShmChannel::join() {
+  ShmHello hello;
+  std::vector<int> descriptors;
+  int bytes = this->connection->ReceiveDescriptors(&hello, sizeof(hello),
+                                                   &descriptors);
+  if (bytes != sizeof(hello) || descriptors.size() != 5 ||
+      hello.magic != kShmMagic || hello.rings != 2 ||
+      !std::has_single_bit(hello.ringBytes) ||
+      hello.ringBytes < MIN_RING_BYTES || hello.ringBytes > MAX_RING_BYTES) {
+    for (int descriptor : descriptors) {
+      close(descriptor);
+    }
+    throw SocketException("Peer is not a shared memory channel",
+                          "ShmChannel::ShmChannel", EPROTO, false);
+  }
+  this->ringBytes = hello.ringBytes;
+  try {
+    this->map(descriptors[0], descriptors.data() + 1, false);
+  } catch (const SocketException& e) {
+    close(descriptors[0]);
+    for (size_t index = 1; index < descriptors.size(); ++index) {
+      close(descriptors[index]);
+    }
+    throw;
+  }
+  close(descriptors[0]);
+}
+
+void ShmChannel::map(int memfd, const int* eventfds, bool first) {
+  size_t bytes = 2 * (RING_HEADER + this->ringBytes);
+  // a memfd shorter than the rings, or one that may still shrink, would
+  // fault on access instead of failing here
+  struct stat status;
+  if (fstat(memfd, &status) == -1) {
+    throw SocketException("Error checking shared memory",
+                          "ShmChannel::ShmChannel", errno, false);
+  }
+  int seals = fcntl(memfd, F_GET_SEALS);
+  if (static_cast<size_t>(status.st_size) < bytes || seals == -1 ||
+      (seals & F_SEAL_SHRINK) == 0) {
+    throw SocketException("Shared memory doesn't hold its rings",
+                          "ShmChannel::ShmChannel", EPROTO, false);
+  }
+  void* memory =
+      mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (memory == MAP_FAILED) {
+    throw SocketException("Error mapping shared memory",
+                          "ShmChannel::ShmChannel", errno, false);
+  }
+  this->memory = memory;
+  this->memoryBytes = bytes;
+  char* rings[2] = {static_cast<char*>(memory),
+                    static_cast<char*>(memory) + RING_HEADER + this->ringBytes};
+  // the server writes the first ring and the client the second
+  int mine = first ? 0 : 1;
+  this->output = reinterpret_cast<ShmRing*>(rings[mine]);
+  this->outputData = rings[mine] + RING_HEADER;
+  this->outputHasData = eventfds[2 * mine];
+  this->outputHasRoom = eventfds[2 * mine + 1];
+  this->input = reinterpret_cast<ShmRing*>(rings[1 - mine]);
+  this->inputData = rings[1 - mine] + RING_HEADER;
+  this->inputHasData = eventfds[2 * (1 - mine)];
+  this->inputHasRoom = eventfds[2 * (1 - mine) + 1];
+}
+
+int ShmChannel::Read(void* buffer, int bufferSize) {
+  Result<int> nBytesRead = this->TryRead(buffer, bufferSize);
+  if (!nBytesRead) {
+    throw SocketException("Error reading from channel", "ShmChannel::Read",
+                          nBytesRead.Error().value(), false);
+  } else if (0 == *nBytesRead) {
+    throw SocketException("Error reading from channel", "ShmChannel::Read",
+                          ECONNRESET, false);
+  }
+  return *nBytesRead;
+}
+
+Result<int> ShmChannel::TryRead(void* buffer, int bufferSize) noexcept(
+    true) {
+  if (this->memory == nullptr) {
+    return std::error_code(EBADF, std::system_category());
+  }
+  // 0 bytes read means the peer closed, it can't be the answer to a request
+  // for none
+  if (bufferSize <= 0) {
+    return std::error_code(EINVAL, std::system_category());
+  }
+  ShmRing* ring = this->input;
+  uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  uint64_t head = ring->head.load(std::memory_order_acquire);
+  for (int spins = 0; head == tail; ++spins) {
+    // the writer sets closed after its last head, seen here with it
+    if (ring->writerClosed.load(std::memory_order_acquire)) {
+      head = ring->head.load(std::memory_order_acquire);
+      if (head == tail) {
+        return 0;
+      }
+      break;
+    }
+    if (spins < SHM_SPINS) {
+      std::this_thread::yield();
+    } else {
+      // a write that doesn't see the flag is seen by the check after it
+      ring->readerAsleep.store(1, std::memory_order_seq_cst);
+      if (ring->head.load(std::memory_order_seq_cst) == tail &&
+          !ring->writerClosed.load(std::memory_order_seq_cst)) {
+        int error = this->sleep(this->inputHasData);
+        if (error != 0) {
+          ring->readerAsleep.store(0, std::memory_order_relaxed);
+          return std::error_code(error, std::system_category());
+        }
+      }
+      ring->readerAsleep.store(0, std::memory_order_relaxed);
+    }
+    head = ring->head.load(std::memory_order_acquire);
+  }
+  size_t bytes = std::min<uint64_t>(head - tail, bufferSize);
+  size_t offset = tail & (this->ringBytes - 1);
+  size_t first = std::min(bytes, this->ringBytes - offset);
+  memcpy(buffer, this->inputData + offset, first);
+  memcpy(static_cast<char*>(buffer) + first, this->inputData, bytes - first);
+  ring->tail.store(tail + bytes, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ring->writerAsleep.load(std::memory_order_relaxed)) {
+    wake(this->inputHasRoom);
+  }
+  SocketMetrics::Add(SocketCounter::kBytesIn, bytes);
+  return static_cast<int>(bytes);
+}
+
+void ShmChannel::Write(const void* buffer, int bufferSize) {
+  Result<int> status = this->TryWrite(buffer, bufferSize);
+  if (!status) {
+    throw SocketException("Error writing to channel", "ShmChannel::Write",
+                          status.Error().value(), false);
+  }
+}
+
+Result<int> ShmChannel::TryWrite(const void* buffer, int bufferSize) noexcept(
+    true) {
+  if (this->memory == nullptr) {
+    return std::error_code(EBADF, std::system_category());
+  }
+  if (bufferSize <= 0) {
+    return std::error_code(EINVAL, std::system_category());
+  }
+  ShmRing* ring = this->output;
+  const char* bytes = static_cast<const char*>(buffer);
+  size_t done = 0;
+  size_t size = bufferSize;
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  int spins = 0;
+  while (done < size) {
+    if (ring->readerClosed.load(std::memory_order_acquire)) {
+      return std::error_code(EPIPE, std::system_category());
+    }
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t room = this->ringBytes - (head - tail);
+    if (room == 0) {
+      if (spins++ < SHM_SPINS) {
+        std::this_thread::yield();
+        continue;
+      }
+      ring->writerAsleep.store(1, std::memory_order_seq_cst);
+      if (ring->tail.load(std::memory_order_seq_cst) == tail &&
+          !ring->readerClosed.load(std::memory_order_seq_cst)) {
+        int error = this->sleep(this->outputHasRoom);
+        if (error != 0) {
+          ring->writerAsleep.store(0, std::memory_order_relaxed);
+          return std::error_code(error, std::system_category());
+        }
+      }
+      ring->writerAsleep.store(0, std::memory_order_relaxed);
+      continue;
+    }
+    spins = 0;
+    size_t chunk = std::min(room, size - done);
+    size_t offset = head & (this->ringBytes - 1);
+    size_t first = std::min(chunk, this->ringBytes - offset);
+    memcpy(this->outputData + offset, bytes + done, first);
+    memcpy(this->outputData, bytes + done + first, chunk - first);
+    head += chunk;
+    done += chunk;
+    ring->head.store(head, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ring->readerAsleep.load(std::memory_order_relaxed)) {
+      wake(this->outputHasData);
+    }
+  }
+  SocketMetrics::Add(SocketCounter::kBytesOut, size);
+  return bufferSize;
+}
+
+void ShmChannel::Close() noexcept(true) {
+  if (this->memory != nullptr) {
+    this->output->writerClosed.store(1, std::memory_order_release);
+    this->input->readerClosed.store(1, std::memory_order_release);
+    // whatever the peer waits for, it must look again
+    wake(this->outputHasData);
+    wake(this->inputHasRoom);
+    munmap(this->memory, this->memoryBytes);
+    this->memory = nullptr;
+    this->input = this->output = nullptr;
+  }
+  for (int* event : {&this->inputHasData, &this->inputHasRoom,
+                     &this->outputHasData, &this->outputHasRoom}) {
+    if (*event != -1) {
+      close(*event);
+      *event = -1;
+    }
+  }
+}
+
+int ShmChannel::sleep(int event) noexcept(true) {
+  // the connection carries nothing after the handshake: readable means the
+  // peer is gone
+  struct pollfd watched[2] = {
+      {event, POLLIN, 0}, {this->connection->GetIDSocket(), POLLIN, 0}};
+  SocketMetrics::Add(SocketCounter::kWaitCalls);
+  while (poll(watched, 2, -1) == -1) {
+    if (errno != EINTR) {
+      return errno;
+    }
+  }
+  if (watched[0].revents & POLLIN) {
+    uint64_t rings = 0;
+    if (read(event, &rings, sizeof(rings)) == -1 && errno != EAGAIN) {
+      return errno;
+    }
+    return 0;
+  }
+  return ECONNRESET;
+}
+
+void ShmChannel::wake(int event) noexcept(true) {
+  uint64_t one = 1;
+  if (write(event, &one, sizeof(one)) == -1) {
+    // the counter can't overflow in practice, and a closed peer has its
+    // own copy of the descriptor
+  }
+}
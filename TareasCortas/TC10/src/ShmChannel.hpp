@@ -0,0 +1,130 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file ShmChannel.hpp
+ * @brief Defines ShmChannel, a byte stream between two processes of one
+ * host through rings in shared memory, set up over an AF_UNIX connection.
+ */
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+#include <cstddef>
+
+#include "Result.hpp"
+#include "Socket.hpp"
+
+constexpr size_t kShmRingBytes = 1 << 20;  ///< default ring per direction
+
+struct ShmRing;
+
+/**
+ * @class ShmChannel
+ * @brief Read and Write as on a stream Socket, but the bytes are copied
+ *  once into a memfd both processes map and once out of it, without a
+ *  system call while the peer keeps up.
+ * @details one single producer, single consumer ring per direction: only
+ *  one thread may write and one read at a time on each side. A side that
+ *  finds its ring empty (or full) spins a little and then sleeps on an
+ *  eventfd the other side rings only when it sees it asleep. The AF_UNIX
+ *  connection of the handshake must stay open: it carries no data, but
+ *  its end of file tells a sleeping side that the peer died.
+ */
+class ShmChannel {
+ public:
+  /**
+   * @brief sets up the channel over an AF_UNIX stream connection
+   * @details the server creates the memfd and the eventfds and passes them
+   *  with SCM_RIGHTS; the client maps what it gets. Call it with server
+   *  true on one end and false on the other, once per connection.
+   * @param connection the AF_UNIX connection, not owned, must outlive the
+   *  channel
+   * @param ringBytes bytes of each ring, rounded up to a power of two; the
+   *  client takes the server's
+   * @throws SocketException if the memory or the eventfds can't be created
+   *  or passed, or the peer is not a ShmChannel (or its memory doesn't
+   *  hold the rings it announced)
+   */
+  ShmChannel(Socket* connection, bool server,
+             size_t ringBytes = kShmRingBytes) noexcept(false);
+  /**
+   * @brief Destructor, closes the channel if it is still open
+   */
+  ~ShmChannel() noexcept(true);
+  ShmChannel(const ShmChannel&) = delete;
+  ShmChannel& operator=(const ShmChannel&) = delete;
+  /**
+   * @brief reads what the peer wrote, waiting until there is something
+   * @return bytes read, at most bufferSize
+   * @throws SocketException ECONNRESET if the peer closed the channel
+   */
+  int Read(void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief non-throwing Read
+   * @return bytes read, 0 if the peer closed the channel, or the errno of
+   *  the failure (EINVAL for a bufferSize of 0 or less)
+   */
+  Result<int> TryRead(void* buffer, int bufferSize) noexcept(true);
+  /**
+   * @brief writes the whole buffer, waiting for room in the ring
+   * @throws SocketException EPIPE if the peer closed the channel
+   */
+  void Write(const void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief non-throwing Write
+   * @return bytes written, always bufferSize, or the errno of the failure
+   *  (EINVAL for a bufferSize of 0 or less)
+   */
+  Result<int> TryWrite(const void* buffer, int bufferSize) noexcept(true);
+  /**
+   * @brief tells the peer no more data comes, wakes it and unmaps the
+   *  rings; the AF_UNIX connection stays with its owner
+   */
+  void Close() noexcept(true);
+  /**
+   * @brief bytes of each ring
+   */
+  size_t RingBytes() const noexcept(true) { return this->ringBytes; }
+
+ private:
+  Socket* connection;          ///< of the handshake, watched for the peer
+  size_t ringBytes{0};         ///< of each ring, a power of two
+  void* memory{nullptr};       ///< both rings, mapped
+  size_t memoryBytes{0};       ///< bytes mapped
+  ShmRing* input{nullptr};     ///< written by the peer
+  ShmRing* output{nullptr};    ///< read by the peer
+  char* inputData{nullptr};    ///< bytes of input
+  char* outputData{nullptr};   ///< bytes of output
+  int inputHasData{-1};        ///< eventfd rung by the peer's writes
+  int inputHasRoom{-1};        ///< eventfd rung by this side's reads
+  int outputHasData{-1};       ///< eventfd rung by this side's writes
+  int outputHasRoom{-1};       ///< eventfd rung by the peer's reads
+
+  /**
+   * @private
+   * @brief the server side of the handshake
+   */
+  void create(size_t ringBytes) noexcept(false);
+  /**
+   * @private
+   * @brief the client side of the handshake
+   */
+  void join() noexcept(false);
+  /**
+   * @private
+   * @brief maps the rings of the memfd and takes the eventfds, which come
+   *  by ring: data and room of the first ring, then of the second
+   * @param first true if this side writes the first ring
+   */
+  void map(int memfd, const int* eventfds, bool first) noexcept(false);
+  /**
+   * @private
+   * @brief sleeps on an eventfd until it is rung or the peer dies
+   * @return 0, or the errno that ends the wait
+   */
+  int sleep(int event) noexcept(true);
+  /**
+   * @private
+   * @brief rings an eventfd
+   */
+  static void wake(int event) noexcept(true);
+};
+#endif  // SHM_CHANNEL_HPP
@@ -0,0 +1,336 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "SlabAllocator.hpp"
+
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+// bytes before every block: its class and the size asked for
+#define HEADER_SIZE 16
+// smallest slab carved into blocks of one class
+#define SLAB_SIZE 65536
+// blocks of one class a slab holds at least
+#define SLAB_BLOCKS 8
+// bytes of one class a thread keeps for itself, at least 2 and at most
+// CACHE_MAX_BLOCKS blocks
+#define CACHE_CLASS_BYTES 16384
+#define CACHE_MAX_BLOCKS 64
+
+/// class sizes, header included: four per power of two, and room for a 16
+/// KB buffer (a full TLS record) plus its header and OpenSSL's overhead
+static constexpr uint32_t kClassSizes[] = {
+    32,    48,    64,    80,    96,    112,   128,   160,   192,   224,
+    256,   320,   384,   448,   512,   640,   768,   896,   1024,  1280,
+    1536,  1792,  2048,  2560,  3072,  3584,  4096,  5120,  6144,  7168,
+    8192,  10240, 12288, 14336, 16384, 17408, 18432, 20480, 24576, 28672,
+    32768};
+static constexpr size_t kClassCount =
+    sizeof(kClassSizes) / sizeof(kClassSizes[0]);
+/// class of the blocks that come from malloc
+static constexpr uint32_t kLargeClass = UINT32_MAX;
+
+/// what precedes the bytes handed out
+struct BlockHeader {
+  uint32_t sizeClass;  ///< index in kClassSizes, or kLargeClass
+  uint32_t unused;
+  uint64_t size;  ///< bytes asked for, what Reallocate copies
+};
+static_assert(sizeof(BlockHeader) == HEADER_SIZE, "header keeps alignment");
+
+/// a block in a free list, the link overwrites the header
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+/// the list of one class shared by every thread
+struct SharedList {
+  std::mutex mutex;
+  FreeBlock* head{nullptr};
+  size_t count{0};
+};
+
+static SharedList shared[kClassCount];
+static std::atomic<size_t> reservedBytes{0};
+static std::atomic<size_t> inUseBytes{0};
+static std::atomic<size_t> largeBytes{0};
+static std::atomic<bool> installed{false};
+
+/**
+ * @brief blocks of a class a thread may keep
+ */
+static uint32_t cacheLimit(size_t sizeClass) {
+  return std::clamp<uint32_t>(CACHE_CLASS_BYTES / kClassSizes[sizeClass], 2,
+                              CACHE_MAX_BLOCKS);
+}
+
+/**
+ * @brief smallest class that holds bytes, kClassCount if none does
+ */
+static size_t classOf(size_t bytes) {
+  return std::lower_bound(kClassSizes, kClassSizes + kClassCount, bytes) -
+         kClassSizes;
+}
+
+/**
+ * @brief maps a new slab for a class and adds its blocks to the shared
+ *  list; called with the list locked
+ * @return false if the system is out of memory
+ */
+static bool carveSlab(size_t sizeClass) {
+  size_t blockSize = kClassSizes[sizeClass];
+  size_t bytes = std::max<size_t>(SLAB_SIZE, SLAB_BLOCKS * blockSize);
+  void* slab = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (slab == MAP_FAILED) {
+    return false;
+  }
+  reservedBytes.fetch_add(bytes, std::memory_order_relaxed);
+  SharedList& list = shared[sizeClass];
+  char* start = static_cast<char*>(slab);
+  // the blocks are linked in address order, so they are handed out in it
+  for (size_t offset = (bytes / blockSize) * blockSize; offset > 0;) {
+    offset -= blockSize;
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(start + offset);
+    block->next = list.head;
+    list.head = block;
+    ++list.count;
+  }
+  return true;
+}
+
+/**
+ * @class ThreadCache
+ * @brief free blocks of the calling thread, by class
+ */
+class ThreadCache {
+ public:
+  ~ThreadCache();
+  /**
+   * @brief a block of the class, nullptr if the system is out of memory
+   */
+  FreeBlock* Pop(size_t sizeClass) {
+    if (this->heads[sizeClass] == nullptr && !this->refill(sizeClass)) {
+      return nullptr;
+    }
+    FreeBlock* block = this->heads[sizeClass];
+    this->heads[sizeClass] = block->next;
+    --this->counts[sizeClass];
+    return block;
+  }
+  void Push(size_t sizeClass, FreeBlock* block) {
+    block->next = this->heads[sizeClass];
+    this->heads[sizeClass] = block;
+    if (++this->counts[sizeClass] > cacheLimit(sizeClass)) {
+      this->give(sizeClass, this->counts[sizeClass] / 2);
+    }
+  }
+  /**
+   * @brief gives every cached block to the shared lists
+   */
+  void Flush() {
+    for (size_t sizeClass = 0; sizeClass < kClassCount; ++sizeClass) {
+      this->give(sizeClass, this->counts[sizeClass]);
+    }
+  }
+
+ private:
+  FreeBlock* heads[kClassCount]{};
+  uint32_t counts[kClassCount]{};
+
+  /**
+   * @brief moves up to half the limit from the shared list, carving a slab
+   *  if it is empty
+   */
+  bool refill(size_t sizeClass) {
+    SharedList& list = shared[sizeClass];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    if (list.head == nullptr && !carveSlab(sizeClass)) {
+      return false;
+    }
+    uint32_t wanted = std::max<uint32_t>(cacheLimit(sizeClass) / 2, 1);
+    while (wanted-- > 0 && list.head != nullptr) {
+      FreeBlock* block = list.head;
+      list.head = block->next;
+      --list.count;
+      block->next = this->heads[sizeClass];
+      this->heads[sizeClass] = block;
+      ++this->counts[sizeClass];
+    }
+    return true;
+  }
+  /**
+   * @brief moves count blocks from the top of the cache to the shared list
+   */
+  void give(size_t sizeClass, uint32_t count) {
+    if (count == 0) {
+      return;
+    }
+    FreeBlock* first = this->heads[sizeClass];
+    FreeBlock* last = first;
+    for (uint32_t index = 1; index < count; ++index) {
+      last = last->next;
+    }
+    this->heads[sizeClass] = last->next;
+    this->counts[sizeClass] -= count;
+    SharedList& list = shared[sizeClass];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    last->next = list.head;
+    list.head = first;
+    list.count += count;
+  }
+};
+
+/// set when the thread's cache was destroyed: OpenSSL still frees its
+/// per-thread state after the thread_local destructors ran
+static thread_local bool cacheGone = false;
+
+ThreadCache::~ThreadCache() {
+  this->Flush();
+  cacheGone = true;
+}
+
+/**
+ * @brief the calling thread's cache, nullptr while the thread exits
+ */
+static ThreadCache* threadCache() {
+  if (cacheGone) {
+    return nullptr;
+  }
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+void* SlabAllocator::Allocate(size_t size) noexcept(true) {
+  // compared before adding the header, which could overflow
+  size_t sizeClass = size < kClassSizes[kClassCount - 1]
+                         ? classOf(size + HEADER_SIZE)
+                         : kClassCount;
+  BlockHeader* header = nullptr;
+  if (sizeClass == kClassCount) {
+    if (size > SIZE_MAX - HEADER_SIZE) {
+      return nullptr;
+    }
+    header = static_cast<BlockHeader*>(malloc(size + HEADER_SIZE));
+    if (header == nullptr) {
+      return nullptr;
+    }
+    header->sizeClass = kLargeClass;
+    largeBytes.fetch_add(size, std::memory_order_relaxed);
+  } else {
+    ThreadCache* cache = threadCache();
+    FreeBlock* block = nullptr;
+    if (cache != nullptr) {
+      block = cache->Pop(sizeClass);
+    } else {
+      SharedList& list = shared[sizeClass];
+      std::lock_guard<std::mutex> lock(list.mutex);
+      if (list.head != nullptr || carveSlab(sizeClass)) {
+        block = list.head;
+        list.head = block->next;
+        --list.count;
+      }
+    }
+    if (block == nullptr) {
+      return nullptr;
+    }
+    header = reinterpret_cast<BlockHeader*>(block);
+    header->sizeClass = sizeClass;
+    inUseBytes.fetch_add(kClassSizes[sizeClass], std::memory_order_relaxed);
+  }
+  header->size = size;
+  return reinterpret_cast<char*>(header) + HEADER_SIZE;
+}
+
+void* SlabAllocator::Reallocate(void* block, size_t size) noexcept(true) {
+  if (block == nullptr) {
+    return Allocate(size);
+  }
+  if (size == 0) {
+    Free(block);
+    return nullptr;
+  }
+  BlockHeader* header = reinterpret_cast<BlockHeader*>(
+      static_cast<char*>(block) - HEADER_SIZE);
+  if (header->sizeClass != kLargeClass &&
+      size + HEADER_SIZE <= kClassSizes[header->sizeClass]) {
+    header->size = size;
+    return block;
+  }
+  void* moved = Allocate(size);
+  if (moved != nullptr) {
+    memcpy(moved, block, std::min<size_t>(header->size, size));
+    Free(block);
+  }
+  return moved;
+}
+
+void SlabAllocator::Free(void* block) noexcept(true) {
+  if (block == nullptr) {
+    return;
+  }
+  BlockHeader* header = reinterpret_cast<BlockHeader*>(
+      static_cast<char*>(block) - HEADER_SIZE);
+  if (header->sizeClass == kLargeClass) {
+    largeBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    free(header);
+    return;
+  }
+  size_t sizeClass = header->sizeClass;
+  inUseBytes.fetch_sub(kClassSizes[sizeClass], std::memory_order_relaxed);
+  FreeBlock* freed = reinterpret_cast<FreeBlock*>(header);
+  ThreadCache* cache = threadCache();
+  if (cache != nullptr) {
+    cache->Push(sizeClass, freed);
+    return;
+  }
+  SharedList& list = shared[sizeClass];
+  std::lock_guard<std::mutex> lock(list.mutex);
+  freed->next = list.head;
+  list.head = freed;
+  ++list.count;
+}
+
+void SlabAllocator::ReleaseThreadCache() noexcept(true) {
+  ThreadCache* cache = threadCache();
+  if (cache != nullptr) {
+    cache->Flush();
+  }
+}
+
+static void* opensslMalloc(size_t size, const char*, int) {
+  return SlabAllocator::Allocate(size);
+}
+
+static void* opensslRealloc(void* block, size_t size, const char*, int) {
+  return SlabAllocator::Reallocate(block, size);
+}
+
+static void opensslFree(void* block, const char*, int) {
+  SlabAllocator::Free(block);
+}
+
+bool SlabAllocator::InstallForOpenSsl() noexcept(true) {
+  if (!CRYPTO_set_mem_functions(opensslMalloc, opensslRealloc, opensslFree)) {
+    return false;
+  }
+  installed = true;
+  return true;
+}
+
+bool SlabAllocator::InstalledForOpenSsl() noexcept(true) {
+  return installed.load();
+}
+
+SlabStats SlabAllocator::Stats() noexcept(true) {
+  SlabStats stats;
+  stats.reserved = reservedBytes.load(std::memory_order_relaxed);
+  stats.inUse = inUseBytes.load(std::memory_order_relaxed);
+  stats.large = largeBytes.load(std::memory_order_relaxed);
+  return stats;
+}
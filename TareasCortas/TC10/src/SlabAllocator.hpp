@@ -0,0 +1,75 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file SlabAllocator.hpp
+ * @brief Defines SlabAllocator, a size class allocator with per-thread
+ * caches for the short lived allocations of TLS connections: OpenSSL's own
+ * (through CRYPTO_set_mem_functions), Socket objects and BufferPool blocks.
+ */
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include <cstddef>
+
+/**
+ * @brief memory of the slab allocator, in bytes
+ */
+struct SlabStats {
+  size_t reserved{0};  ///< slabs taken from the system, never given back
+  size_t inUse{0};     ///< blocks handed out, by their class size
+  size_t large{0};     ///< allocations too large for a class, from malloc
+};
+
+/**
+ * @class SlabAllocator
+ * @brief Rounds every allocation up to one of a few dozen size classes and
+ *  carves the blocks of each class out of page aligned slabs.
+ * @details a freed block goes to the free list of its class in the calling
+ *  thread's cache, and the next allocation of that class on the thread
+ *  takes it back, both without a lock. Caches that grow past their limit
+ *  give half to a list shared by every thread, which also feeds the threads
+ *  that run out. A handshake allocates and frees hundreds of small objects
+ *  of the same few sizes, connection after connection, so blocks are
+ *  reused instead of splitting and merging a general heap, and memory
+ *  freed by one connection can't be stranded between the objects of
+ *  others that live longer.
+ *  Allocations larger than the largest class go to malloc. Slabs are never
+ *  given back, the reserved memory stays at the peak of each class.
+ */
+class SlabAllocator {
+ public:
+  /**
+   * @brief a block of at least size bytes, aligned to 16, or nullptr if the
+   *  system is out of memory
+   */
+  static void* Allocate(size_t size) noexcept(true);
+  /**
+   * @brief realloc: block may be nullptr (Allocate), size 0 frees block and
+   *  returns nullptr; the block stays where it is if its class still fits
+   */
+  static void* Reallocate(void* block, size_t size) noexcept(true);
+  /**
+   * @brief gives back a block of Allocate or Reallocate, nullptr is ignored
+   */
+  static void Free(void* block) noexcept(true);
+  /**
+   * @brief gives the free blocks cached by the calling thread to the lists
+   *  shared by every thread, e.g. before the thread waits a long time
+   */
+  static void ReleaseThreadCache() noexcept(true);
+  /**
+   * @brief makes OpenSSL allocate through the slab allocator
+   * @details CRYPTO_set_mem_functions only works before OpenSSL allocates
+   *  anything, so call it first thing in main, before any Socket exists.
+   * @return false if OpenSSL already allocated with malloc
+   */
+  static bool InstallForOpenSsl() noexcept(true);
+  /**
+   * @brief true once InstallForOpenSsl succeeded
+   */
+  static bool InstalledForOpenSsl() noexcept(true);
+  /**
+   * @brief reserved, in use and large bytes of the whole process
+   */
+  static SlabStats Stats() noexcept(true);
+};
+#endif  // SLAB_ALLOCATOR_HPP
@@ -4,6 +4,107 @@
 // chapters 59-61.
 #include "Socket.hpp"
 
+#include <openssl/pem.h>
+#include <poll.h>
+#include <sys/un.h>
+
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "Logger.hpp"
+#include "SlabAllocator.hpp"
+
+// SSL_write returns after each record instead of after the whole buffer,
+// and a write retried after WANT_WRITE may pass the same bytes from another
+// address (the output queue moves as it grows)
+static constexpr long kSslWriteModes =
+    SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+
+// how long SSLRead waits for a record when nothing is buffered
+#define SSL_READ_TIMEOUT_MS 5000
+// read buffer of a TLS connection, room for about four full records
+#define SSL_READ_AHEAD 65536
+
+// seconds Close waits for the Finished of a client whose early data was
+// answered
+#define EARLY_FINISH_WAIT 1
+
+/**
+ * @brief what a passive TLS socket needs to replace its context
+ */
+struct SSLServerState {
+  std::string passphrase;  ///< of the key, typed once at startup
+  bool prompt{false};      ///< the passphrase callback may ask for it
+  /// SSLCreate calls reading the context, by parity of epoch
+  std::atomic<uint32_t> readers[2]{};
+  std::atomic<uint64_t> epoch{0};  ///< number of context replacements
+  std::mutex reloading;            ///< one reload and policy at a time
+  TlsPolicy policy;                ///< set again on every new context
+  /// early data rules, nullptr if early data is refused
+  std::shared_ptr<const EarlyDataGuard> earlyData;
+  bool lean{false};  ///< SSLSetMemoryLean, set again on every new context
+  ~SSLServerState() {
+    OPENSSL_cleanse(this->passphrase.data(), this->passphrase.size());
+  }
+};
+
+/**
+ * @brief passphrase of an encrypted key: the one typed before or, when the
+ *  socket is being created, asked for on the terminal
+ */
+static int passphraseCallback(char* buffer, int size, int writing,
+                              void* data) {
+  SSLServerState* state = static_cast<SSLServerState*>(data);
+  if (state->passphrase.empty()) {
+    if (!state->prompt) {
+      return 0;
+    }
+    int length = PEM_def_callback(buffer, size, writing, nullptr);
+    if (length > 0) {
+      state->passphrase.assign(buffer, length);
+    }
+    return length;
+  }
+  int length = std::min<int>(size, state->passphrase.size());
+  memcpy(buffer, state->passphrase.data(), length);
+  return length;
+}
+
+/**
+ * @brief asks the replay check of the guard about the session a client
+ *  offers early data with
+ */
+static int allowEarlyData(SSL* ssl, void* data) {
+  const EarlyDataGuard* guard = static_cast<const EarlyDataGuard*>(data);
+  if (!guard->replayCheck) {
+    return 1;
+  }
+  unsigned int length = 0;
+  const unsigned char* id =
+      SSL_SESSION_get_id(SSL_get_session(ssl), &length);
+  try {
+    return guard->replayCheck(id, length) ? 1 : 0;
+  } catch (const std::exception& e) {
+    // when in doubt the client repeats the data after the handshake
+    return 0;
+  }
+}
+
+/**
+ * @brief sets the early data rules of guard on a server context
+ * @return false if OpenSSL refused them
+ */
+static bool applyEarlyData(SSL_CTX* context, const EarlyDataGuard* guard) {
+  // stateful tickets: OpenSSL removes a session from its cache when it is
+  // resumed, so its early data can't be accepted twice
+  SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+  SSL_CTX_set_allow_early_data_cb(context, allowEarlyData,
+                                  const_cast<EarlyDataGuard*>(guard));
+  return SSL_CTX_set_max_early_data(context, guard->maxEarlyData) &&
+         SSL_CTX_set_recv_max_early_data(context, guard->maxEarlyData);
+}
+
 int Socket::fdIsValid(int fd) {
   // checks if the file descriptor is valid
   return fcntl(fd, F_GETFD) != -1 || errno != EBADF;
@@ -12,7 +113,8 @@ int Socket::fdIsValid(int fd) {
 Socket::Socket(char socketType, bool isIpv6, bool isSsl) {
   // check if socket type is valid.
   if (socketType != 's' && socketType != 'd') {
-    throw SocketException("Invalid socket type", "Socket::Socket", EINVAL);
+    throw SocketException("Invalid socket type", "Socket::Socket",
+                          EINVAL, false);
   }
   // Set the domain to IPv4 or IPv6
   int domain = AF_INET;
@@ -30,7 +132,8 @@ Socket::Socket(char socketType, bool isIpv6, bool isSsl) {
   // Create the socket
   this->idSocket = socket(domain, type, 0);
   if (this->idSocket == -1) {
-    throw SocketException("Error creating socket", "Socket::Socket", errno);
+    throw SocketException("Error creating socket", "Socket::Socket",
+                          errno, false);
   }
   // Prepare socket if SSL is enabled
   if (isSsl) {
@@ -47,7 +150,8 @@ Socket::Socket(char socketType, bool isIpv6, bool isSsl) {
 Socket::Socket(char socketType, int port, bool isIpv6) noexcept(false) {
   // check if socket type is valid.
   if (socketType != 's' && socketType != 'd') {
-    throw SocketException("Invalid socket type", "Socket::Socket", EINVAL);
+    throw SocketException("Invalid socket type", "Socket::Socket",
+                          EINVAL, false);
   }
   // Set the domain to IPv4 or IPv6
   int domain = AF_INET;
@@ -66,7 +170,7 @@ Socket::Socket(char socketType, int port, bool isIpv6) noexcept(false) {
   this->idSocket = socket(domain, type, 0);
   if (this->idSocket == -1) {
     throw SocketException("Error creating pasive Socket", "Socket::Socket",
-                          errno);
+                          errno, false);
   }
   // bind the socket to the port
   try {
@@ -81,7 +185,8 @@ Socket::Socket(char socketType, int port, const char *certFileName,
                const char *keyFileName, bool isIpv6) {
   // check if socket type is valid.
   if (socketType != 's' && socketType != 'd') {
-    throw SocketException("Invalid socket type", "Socket::Socket", EINVAL);
+    throw SocketException("Invalid socket type", "Socket::Socket",
+                          EINVAL, false);
   }
   // prepare the ssl context
   try {
@@ -108,7 +213,7 @@ Socket::Socket(char socketType, int port, const char *certFileName,
   this->idSocket = socket(domain, type, 0);
   if (this->idSocket == -1) {
     throw SocketException("Error creating pasive Socket", "Socket::Socket",
-                          errno);
+                          errno, false);
   }
   // bind it to an address and port, and start listening
   // for incoming connections
@@ -121,27 +226,115 @@ Socket::Socket(char socketType, int port, const char *certFileName,
   }
 }
 
+Socket::Socket(int socketDescriptor) {
+  if (fdIsValid(socketDescriptor) == 0) {
+    throw SocketException("Invalid socket descriptor", "Socket(int)");
+  }
+  this->idSocket = socketDescriptor;
+}
+
+Socket::Socket(char socketType, UnixDomain) {
+  this->createUnix(socketType, "Socket::Socket");
+  this->isOpen = true;
+}
+
+Socket::Socket(char socketType, const UnixAddress &address) {
+  this->createUnix(socketType, "Socket::Socket");
+  this->isOpen = true;
+  try {
+    this->Bind(address);
+    if (socketType != 'd') {
+      this->Listen(SOMAXCONN);
+    }
+  } catch (const SocketException &e) {
+    // the destructor won't run for a constructor that throws
+    close(this->idSocket);
+    throw_with_nested(SocketException("Error Creating Passive Socket",
+                                      "Socket::Socket", false));
+  }
+}
+
+void Socket::createUnix(char socketType, const char *function) {
+  int type = 0;
+  if (socketType == 's') {
+    type = SOCK_STREAM;
+  } else if (socketType == 'd') {
+    type = SOCK_DGRAM;
+  } else if (socketType == 'q') {
+    type = SOCK_SEQPACKET;  // connection oriented, keeps message boundaries
+  } else {
+    throw SocketException("Invalid socket type", function, EINVAL, false);
+  }
+  this->idSocket = socket(AF_UNIX, type, 0);
+  if (this->idSocket == -1) {
+    throw SocketException("Error creating Unix socket", function, errno,
+                          false);
+  }
+}
+
+void *Socket::operator new(size_t size) {
+  void *block = SlabAllocator::Allocate(size);
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void Socket::operator delete(void *block) noexcept(true) {
+  SlabAllocator::Free(block);
+}
+
 Socket::Socket::~Socket() {
   if (this->isOpen) {
     try {
       this->Close();
     } catch (SocketException &e) {
-      std::cerr << e.what() << std::endl;
+      Logger::Error("%s", e.what());
     }
   }
 }
 
 void Socket::Close() {
-  int status = close(this->idSocket);
-  if (status == -1) {
-    throw SocketException("Error closing socket", "Socket::Close", errno);
+  if (this->earlyPending) {
+    try {
+      // the answer to early data may still be on its way, closing with the
+      // client's Finished unread would reset the connection and lose it
+      if (this->isReadyToRead(EARLY_FINISH_WAIT)) {
+        this->finishEarlyData();
+      }
+    } catch (const SocketException &e) {
+      // the connection is closed anyway
+    }
+    this->earlyPending = false;
   }
+  this->earlyHeld.clear();
+  this->output.clear();
+  this->outputSent = 0;
+  // the close_notify alert must be sent before the descriptor is closed,
+  // otherwise another thread may already own the same descriptor number
+  if (this->SSLStruct != nullptr) {
+    if (SSL_shutdown(this->SSLStruct) < 0) {
+      // e.g. the handshake never finished, keep it off the thread's queue
+      this->sslErrors.Drain();
+    }
+    SSL_free(this->SSLStruct);
+    this->SSLStruct = nullptr;
+  }
+  this->peer.reset();
+  this->peerLoaded = false;
   if (this->SSLContext != nullptr) {
     SSL_CTX_free(this->SSLContext);
+    this->SSLContext = nullptr;
   }
-  if (this->SSLStruct != nullptr) {
-    SSL_shutdown(this->SSLStruct);
-    SSL_free(this->SSLStruct);
+  int status = close(this->idSocket);
+  if (!this->unixPath.empty()) {
+    // nobody can connect to it anymore, the next server may bind the path
+    unlink(this->unixPath.c_str());
+    this->unixPath.clear();
+  }
+  if (status == -1) {
+    throw SocketException("Error closing socket", "Socket::Close",
+                          errno, false);
   }
   this->isOpen = false;
 }
@@ -157,10 +350,11 @@ void Socket::connectIPv4(const char *host, int port) {
   // dotted-decimal notation to binary form.
   status = inet_pton(AF_INET, host, &hostIpv4.sin_addr);
   if (status == 0) {
-    throw SocketException("Invalid IPv4 address", "Socket::Connect", EINVAL);
+    throw SocketException("Invalid IPv4 address", "Socket::Connect",
+                          EINVAL, false);
   } else if (status == -1) {
     throw SocketException("Error converting IPv4 address", "Socket::Connect",
-                          errno);
+                          errno, false);
   }
   // sin_port is the port number we want to connect to. it is a 16-bit integer
   // network byte order is big endian, host byte order is little endian, so we
@@ -171,9 +365,11 @@ void Socket::connectIPv4(const char *host, int port) {
   // connect() system call connects this active socket to a listening socket
   // pasive socket. usually used for TCP sockets.
   status = connect(idSocket, hostIpv4Ptr, hostIpv4Len);
+  this->count(SocketCounter::kConnectCalls);
   if (status == -1) {
+    this->count(ErrorCounter(errno));
     throw SocketException("Error connecting to IPv4 address", "Socket::Connect",
-                          errno);
+                          errno, false);
   }
 }
 
@@ -186,10 +382,11 @@ void Socket::connectIPv6(const char *host, int port) {
   // dotted-decimal notation to binary form.
   status = inet_pton(AF_INET6, host, &hostIpv6.sin6_addr);
   if (status == 0) {
-    throw SocketException("Invalid IPv6 address", "Socket::Connect", EINVAL);
+    throw SocketException("Invalid IPv6 address", "Socket::Connect",
+                          EINVAL, false);
   } else if (status == -1) {
     throw SocketException("Error converting IPv6 address", "Socket::Connect",
-                          errno);
+                          errno, false);
   }
   // sin_port is the port number we want to connect to. it is a 16-bit integer
   hostIpv6.sin6_port = htons(port);
@@ -198,9 +395,11 @@ void Socket::connectIPv6(const char *host, int port) {
   // connect() system call connects this active socket to a listening socket
   // pasive socket. usually used for TCP sockets.
   status = connect(idSocket, hostIpv6Ptr, hostIpv6Len);
+  this->count(SocketCounter::kConnectCalls);
   if (status == -1) {
+    this->count(ErrorCounter(errno));
     throw SocketException("Error connecting to IPv6 address", "Socket::Connect",
-                          errno);
+                          errno, false);
   }
 }
 
@@ -216,6 +415,28 @@ void Socket::Connect(const char *host, int port) {
   }
 }
 
+/**
+ * @brief the errno closest to a getaddrinfo EAI_* status
+ */
+static int addressInfoErrno(int status) {
+  switch (status) {
+    case EAI_SYSTEM:
+      return errno;
+    case EAI_AGAIN:
+      return EAGAIN;
+    case EAI_MEMORY:
+      return ENOMEM;
+    case EAI_BADFLAGS:
+    case EAI_FAMILY:
+    case EAI_SOCKTYPE:
+    case EAI_SERVICE:
+      return EINVAL;
+    default:
+      // EAI_NONAME, EAI_NODATA, EAI_FAIL: there is no such host
+      return EHOSTUNREACH;
+  }
+}
+
 void Socket::Connect(const char *host, const char *service) {
   int status = -1;
   struct addrinfo hints, *result, *rp;
@@ -233,8 +454,9 @@ void Socket::Connect(const char *host, const char *service) {
   // addresses returned by getaddrinfo.
   status = getaddrinfo(host, service, &hints, &result);
   if (status != 0) {
-    throw SocketException("Error getting address info", "Socket::Connect",
-                          status);
+    // gai_strerror's texts are static, like the literals other throws use
+    throw SocketException(gai_strerror(status), "Socket::Connect",
+                          addressInfoErrno(status), false);
   }
   for (rp = result; rp; rp = rp->ai_next) {
     status = connect(this->idSocket, rp->ai_addr, rp->ai_addrlen);
@@ -243,31 +465,127 @@ void Socket::Connect(const char *host, const char *service) {
     }
   }
   freeaddrinfo(result);
+  this->count(SocketCounter::kConnectCalls);
+  if (status == -1) {
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error connecting to host", "Socket::Connect",
+                          errno, false);
+  }
+}
+
+void Socket::Connect(const UnixAddress &address) {
+  int status = connect(this->idSocket, address.Data(), address.Length());
+  this->count(SocketCounter::kConnectCalls);
+  if (status == -1) {
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error connecting to Unix socket", "Socket::Connect",
+                          errno, false);
+  }
+}
+
+socklen_t Socket::peerAddress(const char *host, int port,
+                              struct sockaddr_storage *address) {
+  memset(address, 0, sizeof(*address));
+  int status = -1;
+  socklen_t length = 0;
+  if (this->ipv6) {
+    struct sockaddr_in6 *hostIpv6 =
+        reinterpret_cast<struct sockaddr_in6 *>(address);
+    hostIpv6->sin6_family = AF_INET6;
+    hostIpv6->sin6_port = htons(port);
+    status = inet_pton(AF_INET6, host, &hostIpv6->sin6_addr);
+    length = sizeof(*hostIpv6);
+  } else {
+    struct sockaddr_in *hostIpv4 =
+        reinterpret_cast<struct sockaddr_in *>(address);
+    hostIpv4->sin_family = AF_INET;
+    hostIpv4->sin_port = htons(port);
+    status = inet_pton(AF_INET, host, &hostIpv4->sin_addr);
+    length = sizeof(*hostIpv4);
+  }
+  if (status == 0) {
+    throw SocketException("Invalid address", "Socket::Connect", EINVAL,
+                          false);
+  } else if (status == -1) {
+    throw SocketException("Error converting address", "Socket::Connect",
+                          errno, false);
+  }
+  return length;
+}
+
+int Socket::ConnectFast(const char *host, int port, const void *buffer,
+                        int bufferSize) {
+  struct sockaddr_storage address;
+  socklen_t length = this->peerAddress(host, port, &address);
+  // sendto with MSG_FASTOPEN is connect and write: with a cookie the bytes
+  // go in the SYN, without one the SYN asks for a cookie and they follow
+  int status = sendto(this->idSocket, buffer, bufferSize, MSG_FASTOPEN,
+                      reinterpret_cast<struct sockaddr *>(&address), length);
+  if (status == -1 && errno == EOPNOTSUPP) {
+    // client side off in net.ipv4.tcp_fastopen
+    this->Connect(host, port);
+    this->Write(buffer, bufferSize);
+    return bufferSize;
+  }
+  this->count(SocketCounter::kConnectCalls);
+  this->count(SocketCounter::kSendToCalls);
   if (status == -1) {
-    throw SocketException("Error connecting to host", "Socket::Connect", errno);
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error connecting with Fast Open",
+                          "Socket::ConnectFast", errno, false);
   }
+  this->count(SocketCounter::kBytesOut, status);
+  return status;
 }
 
 int Socket::Read(void *buffer, int bufferSize) {
-  int nBytesRead = -1;
+  Result<int> nBytesRead = this->TryRead(buffer, bufferSize);
+  if (!nBytesRead) {
+    throw SocketException("Error reading from socket", "Socket::Read",
+                          nBytesRead.Error().value(), false);
+  } else if (0 == *nBytesRead) {
+    throw SocketException("Error reading from socket", "Socket::Read",
+                          ECONNRESET, false);
+  }
+  return *nBytesRead;
+}
+
+Result<int> Socket::TryRead(void *buffer, int bufferSize) noexcept(true) {
   // Read from the socket and store the data in buffer using system call read
-  nBytesRead = read(this->idSocket, buffer, bufferSize);
+  int nBytesRead = read(this->idSocket, buffer, bufferSize);
+  this->count(SocketCounter::kReadCalls);
   if (-1 == nBytesRead) {
-    throw SocketException("Error reading from socket", "Socket::Read", errno);
-  } else if (0 == nBytesRead) {
-    throw SocketException("Error reading from socket", "Socket::Read",
-                          ECONNRESET);
+    int error = errno;
+    this->count(ErrorCounter(error));
+    return std::error_code(error, std::system_category());
+  }
+  this->count(SocketCounter::kBytesIn, nBytesRead);
+  if (nBytesRead > 0) {
+    this->rearmQuickAck();
   }
   return nBytesRead;
 }
 
 void Socket::Write(const void *buffer, int bufferSize) {
-  int status = -1;
+  Result<int> status = this->TryWrite(buffer, bufferSize);
+  if (!status) {
+    throw SocketException("Error writing to socket", "Socket::Write",
+                          status.Error().value(), false);
+  }
+}
+
+Result<int> Socket::TryWrite(const void *buffer, int bufferSize) noexcept(
+    true) {
   // Write to the socket using system call write
-  status = write(this->idSocket, buffer, bufferSize);
+  int status = write(this->idSocket, buffer, bufferSize);
+  this->count(SocketCounter::kWriteCalls);
   if (-1 == status) {
-    throw SocketException("Error writing to socket", "Socket::Write", errno);
+    int error = errno;
+    this->count(ErrorCounter(error));
+    return std::error_code(error, std::system_category());
   }
+  this->count(SocketCounter::kBytesOut, status);
+  return status;
 }
 
 void Socket::Write(const char *buffer) {
@@ -283,7 +601,8 @@ void Socket::Listen(int backlog) {
   // mark the socket as passive using system call listen
   status = listen(this->idSocket, backlog);
   if (-1 == status) {
-    throw SocketException("Error listening to socket", "Socket::Listen", errno);
+    throw SocketException("Error listening to socket", "Socket::Listen",
+                          errno, false);
   }
 }
 
@@ -305,7 +624,7 @@ void Socket::bindIPv4(int port) {
   status = bind(idSocket, hostIpv4Ptr, hostIpv4Len);
   if (-1 == status) {
     throw SocketException("Error binding to socket IPV4", "Socket::Bind",
-                          errno);
+                          errno, false);
   }
 }
 
@@ -323,7 +642,7 @@ void Socket::bindIPv6(int port) {
   status = bind(idSocket, hostIpv6Ptr, hostIpv6Len);
   if (-1 == status) {
     throw SocketException("Error binding to socket IPV6", "Socket::Bind",
-                          errno);
+                          errno, false);
   }
 }
 
@@ -339,6 +658,35 @@ void Socket::Bind(int port) {
   }
 }
 
+void Socket::Bind(const UnixAddress &address) {
+  int status = bind(this->idSocket, address.Data(), address.Length());
+  if (-1 == status && errno == EADDRINUSE && !address.Abstract()) {
+    // the file may be left by a server that died: if nobody answers on it,
+    // it is stale and can be replaced
+    int type = 0;
+    socklen_t typeLength = sizeof(type);
+    getsockopt(this->idSocket, SOL_SOCKET, SO_TYPE, &type, &typeLength);
+    int probe = socket(AF_UNIX, type, 0);
+    if (probe != -1) {
+      bool stale = connect(probe, address.Data(), address.Length()) == -1 &&
+                   errno == ECONNREFUSED;
+      close(probe);
+      if (stale && unlink(address.Name().c_str()) == 0) {
+        status = bind(this->idSocket, address.Data(), address.Length());
+      } else {
+        errno = EADDRINUSE;
+      }
+    }
+  }
+  if (-1 == status) {
+    throw SocketException("Error binding to Unix socket", "Socket::Bind",
+                          errno, false);
+  }
+  if (!address.Abstract()) {
+    this->unixPath = address.Name();
+  }
+}
+
 Socket *Socket::Accept() {
   int newSocketFd = -1;
   // sockaddr_storage is large enough to hold both IPv4 and IPv6 structures
@@ -348,11 +696,15 @@ Socket *Socket::Accept() {
   socklen_t clientAddrLen = sizeof(clientAddr);
   // accept a connection on a socket
   newSocketFd = accept(this->idSocket, clientAddrPtr, &clientAddrLen);
+  this->count(SocketCounter::kAcceptCalls);
   if (newSocketFd < 0) {
+    this->count(ErrorCounter(errno));
     throw SocketException("Error accepting connection", "Socket::Accept",
-                          errno);
+                          errno, false);
   }
   Socket *newSocket = new Socket(newSocketFd);
+  // the kernel copied the listener's options, except this one
+  newSocket->quickAck = this->quickAck;
   return newSocket;
 }
 
@@ -362,7 +714,48 @@ void Socket::Shutdown(int mode) {
   status = shutdown(this->idSocket, mode);
   if (-1 == status) {
     throw SocketException("Error shutting down socket", "Socket::Shutdown",
-                          errno);
+                          errno, false);
+  }
+}
+
+void Socket::SetNoDelay(bool enable) {
+  int value = enable ? 1 : 0;
+  int status = setsockopt(this->idSocket, IPPROTO_TCP, TCP_NODELAY, &value,
+                          sizeof(value));
+  if (-1 == status) {
+    throw SocketException("Error setting TCP_NODELAY", "Socket::SetNoDelay",
+                          errno, false);
+  }
+}
+
+void Socket::SetOptions(const SocketOptions &options) {
+  const char *failed = nullptr;
+  int error = options.Apply(this->idSocket, &failed);
+  if (error != 0) {
+    throw SocketException(failed, "Socket::SetOptions", error, false);
+  }
+  if (options.quickAck) {
+    this->quickAck = *options.quickAck;
+  }
+}
+
+void Socket::rearmQuickAck() noexcept(true) {
+  if (this->quickAck) {
+    int value = 1;
+    setsockopt(this->idSocket, IPPROTO_TCP, TCP_QUICKACK, &value,
+               sizeof(value));
+  }
+}
+
+void Socket::SetNonBlocking(bool enable) {
+  int flags = fcntl(this->idSocket, F_GETFL);
+  if (flags != -1) {
+    flags = enable ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    flags = fcntl(this->idSocket, F_SETFL, flags);
+  }
+  if (-1 == flags) {
+    throw SocketException("Error setting O_NONBLOCK", "Socket::SetNonBlocking",
+                          errno, false);
   }
 }
 
@@ -375,9 +768,13 @@ int Socket::sendTo(const void *message, int length, const void *destAddr) {
   // Send the message using the sendto system call
   nBytesSent = sendto(this->idSocket, message, length, 0,
                       reinterpret_cast<const sockaddr *>(destAddr), addrSize);
+  this->count(SocketCounter::kSendToCalls);
   if (-1 == nBytesSent) {
-    throw SocketException("Error sending message", "Socket::sendTo", errno);
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error sending message", "Socket::sendTo",
+                          errno, false);
   }
+  this->count(SocketCounter::kBytesOut, nBytesSent);
   return nBytesSent;
 }
 
@@ -388,8 +785,122 @@ int Socket::recvFrom(void *buffer, int length, void *srcAddr) {
   // Receive data using the recvfrom system call
   nBytesReceived = recvfrom(this->idSocket, buffer, length, 0,
                             reinterpret_cast<sockaddr *>(srcAddr), &addrSize);
+  this->count(SocketCounter::kRecvFromCalls);
+  if (-1 == nBytesReceived) {
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error receiving message", "Socket::recvFrom",
+                          errno, false);
+  }
+  this->count(SocketCounter::kBytesIn, nBytesReceived);
+  return nBytesReceived;
+}
+
+int Socket::sendTo(const void *message, int length,
+                   const UnixAddress &destAddr) {
+  int nBytesSent = sendto(this->idSocket, message, length, 0, destAddr.Data(),
+                          destAddr.Length());
+  this->count(SocketCounter::kSendToCalls);
+  if (-1 == nBytesSent) {
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error sending message", "Socket::sendTo",
+                          errno, false);
+  }
+  this->count(SocketCounter::kBytesOut, nBytesSent);
+  return nBytesSent;
+}
+
+int Socket::recvFrom(void *buffer, int length, UnixAddress *srcAddr) {
+  UnixAddress source;
+  int nBytesReceived = recvfrom(this->idSocket, buffer, length, 0,
+                                source.Data(), source.LengthPointer());
+  this->count(SocketCounter::kRecvFromCalls);
   if (-1 == nBytesReceived) {
-    throw SocketException("Error receiving message", "Socket::recvFrom", errno);
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error receiving message", "Socket::recvFrom",
+                          errno, false);
+  }
+  this->count(SocketCounter::kBytesIn, nBytesReceived);
+  if (srcAddr != nullptr) {
+    *srcAddr = source;
+  }
+  return nBytesReceived;
+}
+
+int Socket::SendDescriptors(const void *buffer, int bufferSize,
+                            const int *descriptors, int count) {
+  if (bufferSize <= 0 || count < 0 || count > kMaxPassedDescriptors) {
+    throw SocketException("Invalid descriptors message",
+                          "Socket::SendDescriptors", EINVAL, false);
+  }
+  struct iovec data = {const_cast<void *>(buffer),
+                       static_cast<size_t>(bufferSize)};
+  // the control buffer must be aligned for cmsghdr
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) *
+                                           kMaxPassedDescriptors)];
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  if (count > 0) {
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(header), descriptors, sizeof(int) * count);
+  }
+  int nBytesSent = sendmsg(this->idSocket, &message, MSG_NOSIGNAL);
+  this->count(SocketCounter::kWriteCalls);
+  if (-1 == nBytesSent) {
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error sending descriptors",
+                          "Socket::SendDescriptors", errno, false);
+  }
+  this->count(SocketCounter::kBytesOut, nBytesSent);
+  return nBytesSent;
+}
+
+int Socket::ReceiveDescriptors(void *buffer, int bufferSize,
+                               std::vector<int> *descriptors) {
+  struct iovec data = {buffer, static_cast<size_t>(bufferSize)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) *
+                                           kMaxPassedDescriptors)];
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  int nBytesReceived = recvmsg(this->idSocket, &message, MSG_CMSG_CLOEXEC);
+  this->count(SocketCounter::kReadCalls);
+  if (-1 == nBytesReceived) {
+    this->count(ErrorCounter(errno));
+    throw SocketException("Error receiving descriptors",
+                          "Socket::ReceiveDescriptors", errno, false);
+  }
+  this->count(SocketCounter::kBytesIn, nBytesReceived);
+  size_t first = descriptors->size();
+  for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+      size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const unsigned char *received = CMSG_DATA(header);
+      for (size_t index = 0; index < count; ++index) {
+        int descriptor = -1;
+        memcpy(&descriptor, received + index * sizeof(int), sizeof(int));
+        descriptors->push_back(descriptor);
+      }
+    }
+  }
+  if (message.msg_flags & MSG_CTRUNC) {
+    // some were lost, the ones that arrived alone are of no use
+    for (size_t index = first; index < descriptors->size(); ++index) {
+      close((*descriptors)[index]);
+    }
+    descriptors->resize(first);
+    throw SocketException("Too many descriptors in message",
+                          "Socket::ReceiveDescriptors", EMSGSIZE, false);
   }
   return nBytesReceived;
 }
@@ -399,15 +910,17 @@ void Socket::SSLInitContext() {
   // We must create a method to define our context
   const SSL_METHOD *method = TLS_client_method();
   if (method == nullptr) {
-    throw SocketException("Error creating SSL method",
-                          "Socket::SSLInitContext");
+    this->throwSslError("Error creating SSL method", "Socket::SSLInitContext");
   }
   // build a new SSL context using the method
   SSL_CTX *context = SSL_CTX_new(method);
   if (context == nullptr) {
-    throw SocketException("Error creating SSL Ctx", "Socket::SSLInitContext");
+    this->throwSslError("Error creating SSL Ctx", "Socket::SSLInitContext");
   }
   this->SSLContext = context;
+  if (!TlsPolicy::Default().Apply(context)) {
+    this->throwSslError("Error applying TLS policy", "Socket::SSLInitContext");
+  }
 }
 /**
  * @brief SSLInitContext method initializes the SSL context
@@ -426,8 +939,9 @@ void Socket::SSLInit() {
   }
   SSL *ssl = SSL_new(this->SSLContext);
   if (ssl == nullptr) {
-    throw SocketException("Error creating SSL", "Socket::SSLInit");
+    this->throwSslError("Error creating SSL", "Socket::SSLInit");
   }
+  SSL_set_mode(ssl, kSslWriteModes);
   this->SSLStruct = ssl;
 }
 void Socket::SSLInitServerContext() {
@@ -435,17 +949,23 @@ void Socket::SSLInitServerContext() {
   const SSL_METHOD *method = nullptr;
   method = TLS_server_method();
   if (method == nullptr) {
-    throw SocketException("Error Initiating SSL Server Context",
-                          "Socket::SSLInitServerContext");
+    this->throwSslError("Error Initiating SSL Server Context",
+                        "Socket::SSLInitServerContext");
   }
   this->SSLContext = SSL_CTX_new(method);
   if (this->SSLContext == nullptr) {
-    throw SocketException("Error Initiating SSL Server Context",
-                          "Socket::SSLInitServerContext");
+    this->throwSslError("Error Initiating SSL Server Context",
+                        "Socket::SSLInitServerContext");
+  }
+  if (!TlsPolicy::Default().Apply(this->SSLContext)) {
+    this->throwSslError("Error applying TLS policy",
+                        "Socket::SSLInitServerContext");
   }
 }
 void Socket::SSLInitServer(const char *certFileName, const char *keyFileName) {
   try {
+    this->serverState = std::make_unique<SSLServerState>();
+    this->serverState->policy = TlsPolicy::Default();
     this->SSLInitServerContext();
     this->SSLLoadCertificates(certFileName, keyFileName);
   } catch (SocketException &e) {
@@ -455,72 +975,166 @@ void Socket::SSLInitServer(const char *certFileName, const char *keyFileName) {
 
 void Socket::SSLLoadCertificates(const char *certFileName,
                                  const char *keyFileName) {
+  this->loadCertificates(this->SSLContext, certFileName, keyFileName, true);
+}
+
+void Socket::loadCertificates(SSL_CTX *context, const char *certFileName,
+                              const char *keyFileName, bool prompt) {
+  if (this->serverState != nullptr) {
+    this->serverState->prompt = prompt;
+    SSL_CTX_set_default_passwd_cb(context, passphraseCallback);
+    SSL_CTX_set_default_passwd_cb_userdata(context, this->serverState.get());
+  }
   // set the local certificate from CertFileName
   int status = -1;
-  status = SSL_CTX_use_certificate_file(this->SSLContext, certFileName,
+  status = SSL_CTX_use_certificate_file(context, certFileName,
                                         SSL_FILETYPE_PEM);
   if (status <= 0) {
-    throw SocketException("Error loading certificate",
-                          "Socket::SSLLoadCertificates");
+    this->throwSslError("Error loading certificate",
+                        "Socket::SSLLoadCertificates");
   }
 
   // set the private key from KeyFileName (may be the same as CertFile)
-  status = SSL_CTX_use_PrivateKey_file(this->SSLContext, keyFileName,
+  status = SSL_CTX_use_PrivateKey_file(context, keyFileName,
                                        SSL_FILETYPE_PEM);
   if (status <= 0) {
-    throw SocketException("Error loading private key",
-                          "Socket::SSLLoadCertificates");
+    this->throwSslError("Error loading private key",
+                        "Socket::SSLLoadCertificates");
   }
   // verify private key
-  status = SSL_CTX_check_private_key(this->SSLContext);
+  status = SSL_CTX_check_private_key(context);
   if (!status) {
-    throw SocketException("Error verifying private key",
-                          "Socket::SSLLoadCertificates");
+    this->throwSslError("Error verifying private key",
+                        "Socket::SSLLoadCertificates");
+  }
+}
+
+void Socket::SSLReloadCertificates(const char *certFileName,
+                                   const char *keyFileName) {
+  SSLServerState *state = this->serverState.get();
+  if (state == nullptr) {
+    throw SocketException("Not a passive TLS socket",
+                          "Socket::SSLReloadCertificates", EINVAL, false);
+  }
+  std::lock_guard<std::mutex> lock(state->reloading);
+  // everything slow (files, key parsing) happens before the switch
+  SSL_CTX *fresh = SSL_CTX_new(TLS_server_method());
+  if (fresh == nullptr) {
+    this->throwSslError("Error Initiating SSL Server Context",
+                        "Socket::SSLReloadCertificates");
+  }
+  try {
+    if (!state->policy.Apply(fresh)) {
+      this->throwSslError("Error applying TLS policy",
+                          "Socket::SSLReloadCertificates");
+    }
+    if (state->earlyData != nullptr &&
+        !applyEarlyData(fresh, state->earlyData.get())) {
+      this->throwSslError("Error enabling early data",
+                          "Socket::SSLReloadCertificates");
+    }
+    if (state->lean) {
+      SSL_CTX_set_mode(fresh, SSL_MODE_RELEASE_BUFFERS);
+    }
+    this->loadCertificates(fresh, certFileName, keyFileName, false);
+  } catch (const SocketException &e) {
+    SSL_CTX_free(fresh);
+    throw;
+  }
+  SSL_CTX *old = this->SSLContext.exchange(fresh);
+  // grace period: wait for the SSLCreate calls that may still hold old, the
+  // ones starting from now on count on the other parity and read fresh
+  uint64_t epoch = state->epoch.fetch_add(1);
+  while (state->readers[epoch & 1].load() != 0) {
+    std::this_thread::yield();
   }
+  // sessions created from old hold their own reference to it
+  SSL_CTX_free(old);
 }
 
 void Socket::SSLShowCerts() noexcept(true) {
-  // Get the peer's certificate
-  X509 *peerCertificates = SSL_get_peer_certificate(this->SSLStruct);
-  if (peerCertificates != nullptr) {
-    std::cout << "Server certificates:" << std::endl;
-    // Get the subject name of the certificate and convert it to a string
-    char *line =
-        X509_NAME_oneline(X509_get_subject_name(peerCertificates), nullptr, 0);
-    std::cout << "Subject: " << line << std::endl;
-    // Free the memory allocated for the subject name string
-    OPENSSL_free(line);
-    // Get the issuer name of the certificate and convert it to a string
-    line =
-        X509_NAME_oneline(X509_get_issuer_name(peerCertificates), nullptr, 0);
-    std::cout << "Issuer: " << line << std::endl;
-    // Free the memory allocated for the issuer name string
-    OPENSSL_free(line);
-    // Free the certificate object
-    X509_free(peerCertificates);
+  const PeerIdentity* identity = this->SSLPeer();
+  if (identity != nullptr) {
+    Logger::Info("Server certificates:");
+    Logger::Info("Subject: %s", identity->Subject());
+    Logger::Info("Issuer: %s", identity->Issuer());
+    for (size_t index = 0; index < identity->SanCount(); ++index) {
+      Logger::Info("Alternative name: %s", identity->San(index));
+    }
+    char fingerprint[2 * kPeerFingerprint + 1];
+    identity->FingerprintHex(fingerprint);
+    Logger::Info("SHA-256 fingerprint: %s", fingerprint);
+    time_t notAfter = identity->NotAfter();
+    tm utc;
+    char until[32];
+    strftime(until, sizeof(until), "%Y-%m-%d %H:%M:%SZ",
+             gmtime_r(&notAfter, &utc));
+    Logger::Info("Valid until: %s%s", until,
+                 identity->Expired(time(nullptr)) ? " (expired)" : "");
   } else {
-    std::cout << "No certificates." << std::endl;
+    Logger::Info("No certificates.");
   }
 }
+
+const PeerIdentity* Socket::SSLPeer() noexcept(true) {
+  if (!this->peerLoaded && this->SSLStruct != nullptr &&
+      SSL_is_init_finished(this->SSLStruct)) {
+    // the certificate can't change within a session, extract it only once
+    this->peerLoaded = true;
+    if (SSL_get0_peer_certificate(this->SSLStruct) != nullptr) {
+      this->peer.reset(new (std::nothrow) PeerIdentity());
+      if (this->peer != nullptr && !this->peer->Load(this->SSLStruct)) {
+        this->peer.reset();
+      }
+    }
+  }
+  return this->peer.get();
+}
+
 void Socket::SSLCreate(Socket *parent) {
-  SSL *ssl = SSL_new(parent->SSLContext);
+  SSL *ssl = nullptr;
+  SSLServerState *state = parent->serverState.get();
+  if (state == nullptr) {
+    ssl = SSL_new(parent->SSLContext);
+  } else {
+    // RCU read side: announced in the parity of the current epoch, retried
+    // if a reload flipped it meanwhile, so the reload can wait for us
+    while (true) {
+      uint64_t epoch = state->epoch.load();
+      state->readers[epoch & 1].fetch_add(1);
+      if (state->epoch.load() == epoch) {
+        // SSL_new takes its own reference to the context
+        ssl = SSL_new(parent->SSLContext.load());
+        state->readers[epoch & 1].fetch_sub(1);
+        break;
+      }
+      state->readers[epoch & 1].fetch_sub(1);
+    }
+    this->earlyData = state->earlyData;
+  }
   if (ssl == nullptr) {
-    throw SocketException("Error creating SSL", "Socket::SSLCreate");
+    this->throwSslError("Error creating SSL", "Socket::SSLCreate");
   }
+  SSL_set_mode(ssl, kSslWriteModes);
   this->SSLStruct = ssl;
-  if (!SSL_set_fd(ssl, this->idSocket))
-    throw SocketException("Error setting SSL fd", "Socket::SSLCreate");
+  this->attachSocketBio("Socket::SSLCreate");
 }
 
 void Socket::SSLAccept() {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
   while (true) {
     // Call SSL_accept() to initiate TLS/SSL handshake
     int result = SSL_accept(this->SSLStruct);
     if (result > 0) {
       // Handshake succeeded
+      this->countHandshake(start);
       break;
     }
     int error = SSL_get_error(this->SSLStruct, result);
+    this->count(error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE
+                    ? SocketCounter::kWouldBlock
+                    : SocketCounter::kHandshakeFailures);
     // Handle the error based on the specific SSL error code
     switch (error) {
         // ssl_error_want_read and ssl_error_want_write are not errors per se,
@@ -530,26 +1144,149 @@ void Socket::SSLAccept() {
       case SSL_ERROR_WANT_WRITE: {
         int readyToReadOrWrite = readyToReadWrite(error);
         if (readyToReadOrWrite < 0) {
-          throw SocketException("Error while waiting to read/write socket",
-                                "Socket::SSLAccept");
+          this->count(SocketCounter::kHandshakeFailures);
+          this->throwSslError("Error while waiting to read/write socket",
+                              "Socket::SSLAccept");
         }
         // The socket is now ready, retry SSL_accept()
         continue;
       }
       case SSL_ERROR_ZERO_RETURN:
         // The TLS/SSL connection has been closed
-        throw SocketException("TLS/SSL connection has been closed",
-                              "Socket::SSLAccept");
+        this->throwSslError("TLS/SSL connection has been closed",
+                            "Socket::SSLAccept");
       case SSL_ERROR_SYSCALL:
         // I/O error occurred; check errno for the specific error
-        throw SocketException("I/O error occurred", "Socket::SSLAccept", errno);
+        this->count(ErrorCounter(errno != 0 ? errno : ECONNRESET));
+        throw SocketException("I/O error occurred", "Socket::SSLAccept",
+                              errno, false);
       default:
         // Other SSL errors
-        throw SocketException("Other SSL errors", "Socket::SSLAccept");
+        this->throwSslError("Other SSL errors", "Socket::SSLAccept");
     }
   }
 }
 
+Result<int> Socket::TrySSLAccept() noexcept(true) {
+  if (this->handshakeStart == std::chrono::steady_clock::time_point{}) {
+    this->handshakeStart = std::chrono::steady_clock::now();
+  }
+  int result = SSL_accept(this->SSLStruct);
+  if (result > 0) {
+    this->countHandshake(this->handshakeStart);
+    return 1;
+  }
+  std::error_code error = this->sslIoError(result);
+  if (error != std::errc::resource_unavailable_try_again) {
+    this->count(SocketCounter::kHandshakeFailures);
+  }
+  return error;
+}
+
+int Socket::SSLAcceptEarly(void *buffer, int bufferSize) {
+  if (this->earlyData == nullptr) {
+    this->SSLAccept();
+    return 0;
+  }
+  this->handshakeStart = std::chrono::steady_clock::now();
+  char *data = static_cast<char *>(buffer);
+  size_t received = 0;
+  while (true) {
+    size_t bytes = 0;
+    int status = SSL_read_early_data(this->SSLStruct, data + received,
+                                     bufferSize - received, &bytes);
+    if (status == SSL_READ_EARLY_DATA_ERROR) {
+      this->waitForHandshake(status, "Socket::SSLAcceptEarly");
+      continue;
+    }
+    received += bytes;
+    if (status == SSL_READ_EARLY_DATA_FINISH) {
+      break;
+    }
+    if (this->earlyData->Classify(data, received) ==
+        EarlyVerdict::kIdempotent) {
+      // answered now, the handshake completes on the next read
+      this->count(SocketCounter::kEarlyAnswered);
+      this->count(SocketCounter::kBytesIn, received);
+      this->earlyPending = true;
+      return received;
+    }
+    if (received == static_cast<size_t>(bufferSize)) {
+      this->count(SocketCounter::kHandshakeFailures);
+      throw SocketException("Early data larger than the buffer",
+                            "Socket::SSLAcceptEarly", EMSGSIZE, false);
+    }
+  }
+  // all the early data is in, only the client's Finished is left
+  this->completeHandshake("Socket::SSLAcceptEarly");
+  if (received > 0) {
+    this->count(SocketCounter::kEarlyDeferred);
+    this->count(SocketCounter::kBytesIn, received);
+  } else if (SSL_get_early_data_status(this->SSLStruct) ==
+             SSL_EARLY_DATA_REJECTED) {
+    this->count(SocketCounter::kEarlyRejected);
+  }
+  return received;
+}
+
+void Socket::finishEarlyData() {
+  this->earlyPending = false;
+  char chunk[4096];
+  while (true) {
+    size_t bytes = 0;
+    int status =
+        SSL_read_early_data(this->SSLStruct, chunk, sizeof(chunk), &bytes);
+    if (status == SSL_READ_EARLY_DATA_ERROR) {
+      this->waitForHandshake(status, "Socket::finishEarlyData");
+      continue;
+    }
+    this->earlyHeld.append(chunk, bytes);
+    if (status == SSL_READ_EARLY_DATA_FINISH) {
+      break;
+    }
+  }
+  this->count(SocketCounter::kBytesIn, this->earlyHeld.size());
+  this->completeHandshake("Socket::finishEarlyData");
+}
+
+std::error_code Socket::tryFinishEarlyData() noexcept(true) {
+  try {
+    this->finishEarlyData();
+  } catch (const SocketException &e) {
+    return e.Code();
+  } catch (const std::bad_alloc &) {
+    return std::make_error_code(std::errc::not_enough_memory);
+  }
+  return std::error_code();
+}
+
+void Socket::completeHandshake(const char *function) {
+  int result = 0;
+  while ((result = SSL_do_handshake(this->SSLStruct)) <= 0) {
+    this->waitForHandshake(result, function);
+  }
+  this->countHandshake(this->handshakeStart);
+}
+
+void Socket::waitForHandshake(int result, const char *function) {
+  int error = SSL_get_error(this->SSLStruct, result);
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+    this->count(SocketCounter::kWouldBlock);
+    if (this->readyToReadWrite(error) < 0) {
+      this->count(SocketCounter::kHandshakeFailures);
+      this->throwSslError("Error while waiting to read/write socket",
+                          function);
+    }
+    return;
+  }
+  this->count(SocketCounter::kHandshakeFailures);
+  if (error == SSL_ERROR_SYSCALL) {
+    this->count(ErrorCounter(errno != 0 ? errno : ECONNRESET));
+    throw SocketException("I/O error occurred", function, errno, false);
+  }
+  this->throwSslError("TLS handshake failed", function);
+}
+
 void Socket::SSLConnect(const char *host, int port) {
   int status = -1;
   try {
@@ -558,15 +1295,15 @@ void Socket::SSLConnect(const char *host, int port) {
     throw_with_nested(SocketException("Error connecting to host",
                                       "Socket::SSLConnect", errno, false));
   }
-  status = SSL_set_fd(this->SSLStruct, this->idSocket);
-  if (-1 == status) {
-    throw SocketException("Error setting SSL file descriptor",
-                          "Socket::SSLConnect");
-  }
+  this->attachSocketBio("Socket::SSLConnect");
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
   status = SSL_connect(this->SSLStruct);
   if (-1 == status) {
-    throw SocketException("Error connecting to SSL host", "Socket::SSLConnect");
+    this->count(SocketCounter::kHandshakeFailures);
+    this->throwSslError("Error connecting to SSL host", "Socket::SSLConnect");
   }
+  this->countHandshake(start);
 }
 
 void Socket::SSLConnect(const char *host, const char *service) {
@@ -575,113 +1312,360 @@ void Socket::SSLConnect(const char *host, const char *service) {
     this->Connect(host, service);  // Establish a non SSL connection first
   } catch (SocketException &e) {
     throw_with_nested(SocketException("Error connecting to host",
-                                      "Socket::SSLConnect", errno));
-  }
-  status = SSL_set_fd(this->SSLStruct, this->idSocket);
-  if (-1 == status) {
-    throw SocketException("Error setting SSL file descriptor",
-                          "Socket::SSLConnect");
+                                      "Socket::SSLConnect", errno, false));
   }
+  this->attachSocketBio("Socket::SSLConnect");
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
   status = SSL_connect(this->SSLStruct);
   if (-1 == status) {
-    throw SocketException("Error connecting to SSL host", "Socket::SSLConnect");
+    this->count(SocketCounter::kHandshakeFailures);
+    this->throwSslError("Error connecting to SSL host", "Socket::SSLConnect");
   }
+  this->countHandshake(start);
 }
 
-int Socket::SSLRead(void *buffer, int bufferSize) {
-  int nBytesRead = -1;
+bool Socket::SSLConnectEarly(const char *host, int port, const void *buffer,
+                             int bufferSize) {
+  SSL_SESSION *session = SSL_get0_session(this->SSLStruct);
+  if (session == nullptr || bufferSize <= 0 ||
+      SSL_SESSION_get_max_early_data(session) <
+          static_cast<uint32_t>(bufferSize)) {
+    this->SSLConnect(host, port);
+    this->SSLWrite(buffer, bufferSize);
+    return false;
+  }
   try {
-    if (isReadyToRead(this->idSocket, 5) == false) {
-      throw SocketException("Error reading from SSLSocket", "Socket::SSLRead",
-                            errno);
-    }
+    this->Connect(host, port);  // Establish a non SSL connection first
   } catch (SocketException &e) {
-    // if there was an error reading in isReadyToRead, throw it again
-    throw;
+    throw_with_nested(SocketException("Error connecting to host",
+                                      "Socket::SSLConnectEarly", errno,
+                                      false));
   }
-  do {
-    nBytesRead = SSL_read(this->SSLStruct, buffer, bufferSize);
-    if (nBytesRead < 0) {
-      // gets ssl error to see if we should try again.
-      int sslError = SSL_get_error(this->SSLStruct, nBytesRead);
-      if (sslError == SSL_ERROR_WANT_READ || sslError == SSL_ERROR_WANT_WRITE) {
+  this->attachSocketBio("Socket::SSLConnectEarly");
+  this->handshakeStart = std::chrono::steady_clock::now();
+  // the ClientHello and the message leave together
+  const char *data = static_cast<const char *>(buffer);
+  size_t sent = 0;
+  while (sent < static_cast<size_t>(bufferSize)) {
+    size_t written = 0;
+    this->count(SocketCounter::kSslWriteCalls);
+    if (SSL_write_early_data(this->SSLStruct, data + sent, bufferSize - sent,
+                             &written) <= 0) {
+      this->waitForHandshake(0, "Socket::SSLConnectEarly");
+    }
+    sent += written;
+  }
+  this->completeHandshake("Socket::SSLConnectEarly");
+  if (SSL_get_early_data_status(this->SSLStruct) != SSL_EARLY_DATA_ACCEPTED) {
+    // the server never saw it (old ticket, replay check, no 0-RTT there)
+    this->count(SocketCounter::kEarlyRejected);
+    this->SSLWrite(buffer, bufferSize);
+    return false;
+  }
+  this->count(SocketCounter::kBytesOut, sent);
+  return true;
+}
+
+TlsSession Socket::SSLSession() noexcept(true) {
+  return TlsSession(this->SSLStruct != nullptr
+                        ? SSL_get1_session(this->SSLStruct)
+                        : nullptr);
+}
+
+void Socket::SSLResume(const TlsSession &session) {
+  if (this->SSLStruct == nullptr ||
+      !SSL_set_session(this->SSLStruct, session.Get())) {
+    this->throwSslError("Error resuming TLS session", "Socket::SSLResume");
+  }
+}
+
+int Socket::SSLRead(void *buffer, int bufferSize) {
+  if (this->earlyPending) {
+    this->finishEarlyData();
+  }
+  if (!this->earlyHeld.empty()) {
+    int bytes = std::min<size_t>(bufferSize, this->earlyHeld.size());
+    memcpy(buffer, this->earlyHeld.data(), bytes);
+    this->earlyHeld.erase(0, bytes);
+    return bytes;
+  }
+  char *data = static_cast<char *>(buffer);
+  int total = 0;
+  // the socket BIO reads without blocking: records OpenSSL already holds
+  // are drained first, and the wait below only happens with nothing at all
+  this->readNoWait = true;
+  try {
+    while (total < bufferSize) {
+      int bytes = SSL_read(this->SSLStruct, data + total, bufferSize - total);
+      this->count(SocketCounter::kSslReadCalls);
+      if (bytes > 0) {
+        total += bytes;
+        // more records may have come with the same system call
+        if (!SSL_has_pending(this->SSLStruct)) {
+          break;
+        }
         continue;
-      } else {
-        // if it was an error that will not be solved by trying again
-        throw SocketException("Error reading from SSLSocket",
+      }
+      int sslError = SSL_get_error(this->SSLStruct, bytes);
+      bool wants =
+          sslError == SSL_ERROR_WANT_READ || sslError == SSL_ERROR_WANT_WRITE;
+      if (total > 0 || (!wants && bytes == 0)) {
+        // what was read is returned first; 0 is the end of the stream, with
+        // or without close_notify
+        if (sslError != SSL_ERROR_ZERO_RETURN && !wants) {
+          this->sslErrors.Drain();
+        }
+        break;
+      }
+      if (!wants) {
+        this->throwSslIoError(bytes, "Error reading from SSLSocket",
                               "Socket::SSLRead");
       }
+      this->count(SocketCounter::kWouldBlock);
+      int ready = this->readyToReadWrite(sslError, SSL_READ_TIMEOUT_MS);
+      if (ready <= 0) {
+        this->count(ready == 0 ? SocketCounter::kTimeoutErrors
+                               : ErrorCounter(errno));
+        throw SocketException("Error reading from SSLSocket",
+                              "Socket::SSLRead",
+                              ready == 0 ? ETIMEDOUT : errno, false);
+      }
     }
-  } while (nBytesRead < 0);
-  return nBytesRead;
+  } catch (const SocketException &) {
+    this->readNoWait = false;
+    throw;
+  }
+  this->readNoWait = false;
+  this->count(SocketCounter::kBytesIn, total);
+  return total;
+}
+
+Result<int> Socket::TrySSLRead(void *buffer, int bufferSize) noexcept(true) {
+  if (this->earlyPending) {
+    std::error_code error = this->tryFinishEarlyData();
+    if (error) {
+      return error;
+    }
+  }
+  if (!this->earlyHeld.empty()) {
+    int bytes = std::min<size_t>(bufferSize, this->earlyHeld.size());
+    memcpy(buffer, this->earlyHeld.data(), bytes);
+    this->earlyHeld.erase(0, bytes);
+    return bytes;
+  }
+  int nBytesRead = SSL_read(this->SSLStruct, buffer, bufferSize);
+  this->count(SocketCounter::kSslReadCalls);
+  if (nBytesRead > 0) {
+    this->count(SocketCounter::kBytesIn, nBytesRead);
+    return nBytesRead;
+  }
+  if (SSL_get_error(this->SSLStruct, nBytesRead) == SSL_ERROR_ZERO_RETURN) {
+    return 0;
+  }
+  return this->sslIoError(nBytesRead);
+}
+
+bool Socket::WaitToRead(int timeoutSec, int timeoutMicroSec) {
+  if (this->earlyPending) {
+    // the client's Finished, or its next message, completes the handshake
+    if (!this->isReadyToRead(timeoutSec, timeoutMicroSec)) {
+      return false;
+    }
+    this->finishEarlyData();
+  }
+  if (!this->earlyHeld.empty()) {
+    return true;
+  }
+  // records read ahead by OpenSSL don't show up in the socket
+  if (this->SSLStruct != nullptr && SSL_has_pending(this->SSLStruct)) {
+    return true;
+  }
+  return this->isReadyToRead(timeoutSec, timeoutMicroSec);
 }
 
 int Socket::SSLWrite(const void *buffer, int bufferSize) {
-  int nBytesWritten = -1;
-  // ssl_write returns the number of bytes written or -1 if an error occurs
-  nBytesWritten = SSL_write(this->SSLStruct, buffer, bufferSize);
-  if (nBytesWritten <= 0) {
-    // If the error is SSL_ERROR_WANT_READ it means the write operation was
-    // not completed and we must try again. If the error is
-    // SSL_ERROR_WANT_WRITE it means the socket is not ready for writing and
-    // we must try again.
-    int sslError = SSL_get_error(this->SSLStruct, nBytesWritten);
+  const char *data = static_cast<const char *>(buffer);
+  int total = 0;
+  // partial writes are enabled: SSL_write returns after each record, and
+  // when the socket is full we wait for it instead of retrying hot
+  while (total < bufferSize) {
+    int written = this->writeSome(data + total, bufferSize - total);
+    if (written > 0) {
+      total += written;
+      continue;
+    }
+    int sslError = SSL_get_error(this->SSLStruct, written);
     if (sslError == SSL_ERROR_WANT_READ || sslError == SSL_ERROR_WANT_WRITE) {
-      SSLWrite(buffer, bufferSize);
-    } else {
-      throw SocketException("Error writing to SSL socket", "Socket::SSLWrite");
+      this->count(SocketCounter::kWouldBlock);
+      if (this->readyToReadWrite(sslError) < 0) {
+        throw SocketException("Error waiting to write to SSL socket",
+                              "Socket::SSLWrite", errno, false);
+      }
+      continue;
     }
+    this->throwSslIoError(written, "Error writing to SSL socket",
+                          "Socket::SSLWrite");
+  }
+  this->count(SocketCounter::kBytesOut, total);
+  return total;
+}
+
+int Socket::writeSome(const char *buffer, int bufferSize) noexcept(true) {
+  this->count(SocketCounter::kSslWriteCalls);
+  if (this->earlyPending) {
+    // answers the early data before the client's Finished arrives
+    size_t written = 0;
+    return SSL_write_early_data(this->SSLStruct, buffer, bufferSize, &written)
+               ? static_cast<int>(written)
+               : 0;
   }
-  return nBytesWritten;
+  return SSL_write(this->SSLStruct, buffer, bufferSize);
 }
+
+Result<size_t> Socket::SSLSend(const void *buffer, int bufferSize) noexcept(
+    true) {
+  const char *data = static_cast<const char *>(buffer);
+  if (this->SSLQueued() > 0) {
+    // behind older output: queued, the next SSLFlush sends it in order
+    if (this->outputSent >= this->output.size() / 2) {
+      this->output.erase(0, this->outputSent);
+      this->outputSent = 0;
+    }
+    this->output.append(data, bufferSize);
+    return this->SSLQueued();
+  }
+  // nothing ahead of it, write straight from the caller's buffer
+  int sent = 0;
+  while (sent < bufferSize) {
+    int written = this->writeSome(data + sent, bufferSize - sent);
+    if (written <= 0) {
+      std::error_code error = this->sslIoError(written);
+      if (error != std::errc::resource_unavailable_try_again) {
+        return error;
+      }
+      break;
+    }
+    this->count(SocketCounter::kBytesOut, written);
+    sent += written;
+  }
+  // a record OpenSSL could not send yet is written again from the queue,
+  // SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER lets it move there
+  this->output.assign(data + sent, bufferSize - sent);
+  this->outputSent = 0;
+  return this->SSLQueued();
+}
+
+Result<size_t> Socket::SSLFlush() noexcept(true) {
+  while (this->outputSent < this->output.size()) {
+    int written = this->writeSome(this->output.data() + this->outputSent,
+                                  this->output.size() - this->outputSent);
+    if (written <= 0) {
+      std::error_code error = this->sslIoError(written);
+      if (error != std::errc::resource_unavailable_try_again) {
+        return error;
+      }
+      return this->SSLQueued();
+    }
+    this->count(SocketCounter::kBytesOut, written);
+    this->outputSent += written;
+  }
+  if (this->SSLMemoryLean()) {
+    std::string().swap(this->output);
+  } else {
+    // keeps the capacity for the next burst
+    this->output.clear();
+  }
+  this->outputSent = 0;
+  return 0;
+}
+
+Result<int> Socket::TrySSLWrite(const void *buffer, int bufferSize) noexcept(
+    true) {
+  int nBytesWritten =
+      this->writeSome(static_cast<const char *>(buffer), bufferSize);
+  if (nBytesWritten > 0) {
+    this->count(SocketCounter::kBytesOut, nBytesWritten);
+    return nBytesWritten;
+  }
+  return this->sslIoError(nBytesWritten);
+}
+
+std::error_code Socket::sslIoError(int result) noexcept(true) {
+  switch (SSL_get_error(this->SSLStruct, result)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+      this->count(SocketCounter::kWouldBlock);
+      return std::make_error_code(std::errc::resource_unavailable_try_again);
+    case SSL_ERROR_SYSCALL: {
+      // errno is 0 when the peer went away without a close_notify
+      int error = errno != 0 ? errno : ECONNRESET;
+      this->count(ErrorCounter(error));
+      return std::error_code(error, std::system_category());
+    }
+    default:
+      this->count(SocketCounter::kTlsErrors);
+      if (this->sslErrors.Drain() == 0) {
+        return std::make_error_code(std::errc::protocol_error);
+      }
+      return MakeSslError(this->sslErrors.First());
+  }
+}
+
+void Socket::countHandshake(
+    std::chrono::steady_clock::time_point start) noexcept(true) {
+  uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  this->stats.counters[static_cast<size_t>(SocketCounter::kHandshakes)] += 1;
+  this->stats.handshakeNanoseconds = nanoseconds;
+  SocketMetrics::RecordHandshake(nanoseconds);
+}
+
+void Socket::throwSslError(const char *message, const char *function) {
+  this->count(SocketCounter::kTlsErrors);
+  this->sslErrors.Drain();
+  throw SocketException(message, function, this->sslErrors);
+}
+
+void Socket::throwSslIoError(int result, const char *message,
+                             const char *function) {
+  // counts it as a reset, a timeout or a TLS error, and drains the queue
+  std::error_code error = this->sslIoError(result);
+  if (error.category() == std::system_category()) {
+    throw SocketException(message, function, error.value(), false);
+  }
+  throw SocketException(message, function, this->sslErrors);
+}
+
 bool Socket::isReadyToRead(int timeoutSec, int timeoutMicroSec) {
-  // Declare a set of file descriptors to monitor for reading.
-  fd_set readSet;
-  // Initialize the set to have zero bits for all file descriptors.
-  FD_ZERO(&readSet);
-  // Add the socket's file descriptor to the set.
-  FD_SET(this->idSocket, &readSet);
-  // Declare a timeval structure to specify the timeout.
-  timeval timeout;
-  // Set the timeval structure's seconds field to the input timeoutSec.
-  timeout.tv_sec = timeoutSec;
-  // Set the timeval structure's microseconds field to the input
-  // timeoutMicroSec.
-  timeout.tv_usec = timeoutMicroSec;
-  // Call the select() syscall to check file descriptor set for readability.
-  // It returns the number of ready file descriptors, or -1 if an error.
-  int status = select(this->idSocket + 1, &readSet, nullptr, nullptr, &timeout);
-  // Check if the select() function returned -1 (indicating an error).
+  // poll, not select: a server with many idle connections has descriptors
+  // past FD_SETSIZE, which FD_SET would write out of its set
+  pollfd ready{};
+  ready.fd = this->idSocket;
+  ready.events = POLLIN;
+  int timeoutMs = timeoutSec * 1000 + timeoutMicroSec / 1000;
+  this->count(SocketCounter::kWaitCalls);
+  int status = poll(&ready, 1, timeoutMs);
   if (-1 == status) {
-    // If an error occurred, throw SocketException with description of error,
-    // the function name, and the error number.
     throw SocketException("Error checking if socket is ready to read",
-                          "Socket::isReadyToRead", errno);
-  }
-  // Return true if the select() function indicated that the socket's fd
-  // is ready for reading, otherwise return false.
-  return (status > 0 && FD_ISSET(this->idSocket, &readSet));
-}
-
-int Socket::readyToReadWrite(int error) noexcept(true) {
-  fd_set read_fds, write_fds;
-  FD_ZERO(&read_fds);
-  FD_ZERO(&write_fds);
-  // a data structure used by the select() function to represent a set of
-  // file descriptors. In this case, read_fds is used to represent
-  // the set of file descriptors that should be monitored for reading,
-  // while write_fds is used to represent the set of file descriptors
-  // that should be monitored for writing.
-  if (error == SSL_ERROR_WANT_READ) {
-    FD_SET(this->idSocket, &read_fds);
-  } else {
-    FD_SET(this->idSocket, &write_fds);
+                          "Socket::isReadyToRead", errno, false);
   }
-  // Wait for the socket to become ready (you can also set a timeout if
-  // needed)
-  int select_result =
-      select(this->idSocket + 1, &read_fds, &write_fds, nullptr, nullptr);
-  return select_result;
+  // a closed or reset connection is ready too, the read tells which
+  return status > 0;
+}
+
+int Socket::readyToReadWrite(int error, int timeoutMs) noexcept(true) {
+  // poll, unlike select, works for descriptors past FD_SETSIZE
+  pollfd ready{};
+  ready.fd = this->idSocket;
+  ready.events = error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+  this->count(SocketCounter::kWaitCalls);
+  int status = 0;
+  do {
+    status = poll(&ready, 1, timeoutMs);
+  } while (status == -1 && errno == EINTR);
+  return status;
 }
 
 void Socket::SSLStartLibrary() {
@@ -695,6 +1679,165 @@ const char *Socket::SSLGetCipher() {
   if (this->SSLStruct != nullptr) {
     return SSL_get_cipher(this->SSLStruct);
   } else {
-    throw SocketException("Error getting cipher", "Socket::SSLGetCipher");
+    this->throwSslError("Error getting cipher", "Socket::SSLGetCipher");
+  }
+}
+
+const char *Socket::SSLGetVersion() {
+  if (this->SSLStruct == nullptr) {
+    this->throwSslError("Error getting version", "Socket::SSLGetVersion");
+  }
+  return SSL_get_version(this->SSLStruct);
+}
+
+void Socket::SSLSetPolicy(const TlsPolicy &policy) {
+  SSLServerState *state = this->serverState.get();
+  std::unique_lock<std::mutex> lock;
+  if (state != nullptr) {
+    // a reload in progress must not build its context with the old policy
+    lock = std::unique_lock<std::mutex>(state->reloading);
+    state->policy = policy;
+  }
+  SSL_CTX *context = this->SSLContext.load();
+  if ((context != nullptr && !policy.Apply(context)) ||
+      (this->SSLStruct != nullptr && !policy.Apply(this->SSLStruct))) {
+    this->throwSslError("Error applying TLS policy", "Socket::SSLSetPolicy");
+  }
+}
+
+void Socket::SSLEnableEarlyData(const EarlyDataGuard &guard) {
+  SSLServerState *state = this->serverState.get();
+  if (state == nullptr) {
+    throw SocketException("Not a passive TLS socket",
+                          "Socket::SSLEnableEarlyData", EINVAL, false);
+  }
+  std::lock_guard<std::mutex> lock(state->reloading);
+  state->earlyData = std::make_shared<const EarlyDataGuard>(guard);
+  if (!applyEarlyData(this->SSLContext.load(), state->earlyData.get())) {
+    this->throwSslError("Error enabling early data",
+                        "Socket::SSLEnableEarlyData");
+  }
+}
+
+void Socket::SSLSetMemoryLean(bool lean) {
+  SSLServerState *state = this->serverState.get();
+  std::unique_lock<std::mutex> lock;
+  if (state != nullptr) {
+    lock = std::unique_lock<std::mutex>(state->reloading);
+    state->lean = lean;
+  }
+  // SSL_new copies the modes of the context into each connection
+  SSL_CTX *context = this->SSLContext.load();
+  if (context != nullptr) {
+    if (lean) {
+      SSL_CTX_set_mode(context, SSL_MODE_RELEASE_BUFFERS);
+    } else {
+      SSL_CTX_clear_mode(context, SSL_MODE_RELEASE_BUFFERS);
+    }
+  }
+  if (this->SSLStruct != nullptr) {
+    if (lean) {
+      SSL_set_mode(this->SSLStruct, SSL_MODE_RELEASE_BUFFERS);
+    } else {
+      SSL_clear_mode(this->SSLStruct, SSL_MODE_RELEASE_BUFFERS);
+    }
+  }
+}
+
+bool Socket::SSLMemoryLean() const noexcept(true) {
+  if (this->SSLStruct != nullptr) {
+    return SSL_get_mode(this->SSLStruct) & SSL_MODE_RELEASE_BUFFERS;
+  }
+  SSL_CTX *context = this->SSLContext.load();
+  return context != nullptr &&
+         (SSL_CTX_get_mode(context) & SSL_MODE_RELEASE_BUFFERS);
+}
+
+ConnectionMemory Socket::SSLConnectionMemory() const noexcept(true) {
+  ConnectionMemory memory;
+  // a short queue lives inside the string, only a larger one is allocated
+  size_t inlined = std::string().capacity();
+  memory.queuedCapacity =
+      this->output.capacity() > inlined ? this->output.capacity() : 0;
+  memory.poolBlock = this->poolBlock;
+  memory.tlsBuffersReleased =
+      this->SSLStruct != nullptr && this->SSLMemoryLean() &&
+      SSL_is_init_finished(this->SSLStruct) &&
+      !SSL_has_pending(this->SSLStruct) && this->SSLQueued() == 0;
+  return memory;
+}
+
+BIO_METHOD *Socket::socketBioMethod() noexcept(true) {
+  static BIO_METHOD *method = [] {
+    BIO_METHOD *created = BIO_meth_new(
+        BIO_get_new_index() | BIO_TYPE_SOURCE_SINK | BIO_TYPE_DESCRIPTOR,
+        "Socket");
+    if (created != nullptr) {
+      BIO_meth_set_read(created, Socket::bioRead);
+      BIO_meth_set_write(created, Socket::bioWrite);
+      BIO_meth_set_ctrl(created, Socket::bioCtrl);
+    }
+    return created;
+  }();
+  return method;
+}
+
+void Socket::attachSocketBio(const char *function) {
+  BIO_METHOD *method = socketBioMethod();
+  BIO *bio = method != nullptr ? BIO_new(method) : nullptr;
+  if (bio == nullptr) {
+    this->throwSslError("Error creating socket BIO", function);
+  }
+  BIO_set_data(bio, this);
+  BIO_set_init(bio, 1);
+  // one reference, used for both directions
+  SSL_set_bio(this->SSLStruct, bio, bio);
+  // a read takes every record the socket has, up to SSL_READ_AHEAD bytes
+  SSL_set_read_ahead(this->SSLStruct, 1);
+  SSL_set_default_read_buffer_len(this->SSLStruct, SSL_READ_AHEAD);
+}
+
+int Socket::bioRead(BIO *bio, char *buffer, int size) {
+  Socket *socket = static_cast<Socket *>(BIO_get_data(bio));
+  BIO_clear_retry_flags(bio);
+  ssize_t bytes = recv(socket->idSocket, buffer, size,
+                       socket->readNoWait ? MSG_DONTWAIT : 0);
+  socket->count(SocketCounter::kReadCalls);
+  if (bytes == -1 &&
+      (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    BIO_set_retry_read(bio);
+  } else if (bytes > 0) {
+    socket->rearmQuickAck();
+  }
+  return bytes;
+}
+
+int Socket::bioWrite(BIO *bio, const char *buffer, int size) {
+  Socket *socket = static_cast<Socket *>(BIO_get_data(bio));
+  BIO_clear_retry_flags(bio);
+  // a peer that went away is an EPIPE error, not a SIGPIPE
+  ssize_t bytes = send(socket->idSocket, buffer, size, MSG_NOSIGNAL);
+  socket->count(SocketCounter::kWriteCalls);
+  if (bytes == -1 &&
+      (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    BIO_set_retry_write(bio);
+  }
+  return bytes;
+}
+
+long Socket::bioCtrl(BIO *bio, int command, long, void *pointer) {
+  switch (command) {
+    case BIO_CTRL_FLUSH:
+      // nothing is buffered here
+      return 1;
+    case BIO_C_GET_FD: {
+      int descriptor = static_cast<Socket *>(BIO_get_data(bio))->idSocket;
+      if (pointer != nullptr) {
+        *static_cast<int *>(pointer) = descriptor;
+      }
+      return descriptor;
+    }
+    default:
+      return 0;
   }
 }
@@ -9,18 +9,46 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "EarlyData.hpp"
+#include "PeerIdentity.hpp"
+#include "Result.hpp"
 #include "SocketException.hpp"
+#include "SocketMetrics.hpp"
+#include "SocketOptions.hpp"
+#include "TlsPolicy.hpp"
+#include "UnixAddress.hpp"
 
 #ifndef SOCKET_HPP
 #define SOCKET_HPP
 
+struct SSLServerState;
+
+/// descriptors a SendDescriptors message can carry
+constexpr int kMaxPassedDescriptors = 64;
+
+/**
+ * @brief What one TLS connection holds beyond its session state, see
+ *  Socket::SSLSetMemoryLean
+ */
+struct ConnectionMemory {
+  size_t queuedCapacity{0};        ///< bytes reserved by the SSLSend queue
+  bool poolBlock{false};           ///< a BufferPool block is lent to it
+  bool tlsBuffersReleased{false};  ///< OpenSSL's read/write buffers freed
+};
+
 class Socket {
  public:
   /**
@@ -76,12 +104,36 @@ class Socket {
    * @details used for accepting connections, used by the accept method.
    * @throws SocketException if the socket descriptor is invalid.
    */
-  explicit Socket(int socketDescriptor) noexcept(false) {
-    if (fdIsValid(socketDescriptor) == 0) {
-      throw SocketException("Invalid socket descriptor", "Socket(int)");
-    }
-    this->idSocket = socketDescriptor;
-  }
+  explicit Socket(int socketDescriptor) noexcept(false);
+  /**
+   * @brief builds an active AF_UNIX socket, for peers on the same host
+   * @details no TCP stack in between: no checksums, segments, ACKs or
+   *  Nagle. Read, Write, Accept and Shutdown work as for TCP.
+   * @param socketType 's' stream, 'd' datagram (reliable and ordered within
+   *  a host) or 'q' seqpacket (connection oriented, message boundaries kept,
+   *  a Read returns one message)
+   * @throws SocketException if the socket type is invalid.
+   * @throws SocketException if the socket can't be created.
+   */
+  Socket(char socketType, UnixDomain) noexcept(false);
+  /**
+   * @brief builds a passive AF_UNIX socket bound to address; stream and
+   *  seqpacket sockets also listen
+   * @details a socket file left by a process that died is replaced, one
+   *  that a live socket still listens on is not (EADDRINUSE); which one it
+   *  is, a test connection tells. Close removes the file it created.
+   * @param socketType 's', 'd' or 'q' as for the active constructor
+   * @throws SocketException if the socket type is invalid.
+   * @throws SocketException if the socket can't be created, bound or listen.
+   */
+  Socket(char socketType, const UnixAddress& address) noexcept(false);
+  /**
+   * @brief Socket objects are allocated by SlabAllocator, an accepted
+   *  connection reuses the block of one deleted before
+   * @throws std::bad_alloc if there is no memory left
+   */
+  static void* operator new(size_t size) noexcept(false);
+  static void operator delete(void* block) noexcept(true);
   /**
    * @brief default constructor
    * @details closes socket file descriptor and frees SSL context and structure
@@ -116,6 +168,28 @@ class Socket {
    * @throws SocketException if can't connect to host
    */
   void Connect(const char* host, const char* service) noexcept(false);
+  /**
+   * @brief connects an AF_UNIX socket to a passive one, or sets the peer of
+   *  a datagram socket
+   * @throws SocketException if can't connect to address
+   */
+  void Connect(const UnixAddress& address) noexcept(false);
+  /**
+   * @brief connects and writes the first bytes in one call, with TCP Fast
+   *  Open: they go in the SYN and the server can answer in its first
+   *  segment, one round trip sooner than Connect and Write
+   * @details only once the server gave this host a cookie, on an earlier
+   *  connection (the SYN of that one asks for it, its data follows the
+   *  handshake as usual). A server without Fast Open drops the data of the
+   *  SYN and the kernel sends it again, so it is never lost. If the client
+   *  side is off in net.ipv4.tcp_fastopen it is a plain Connect and Write.
+   *  Data in a SYN may arrive twice, only send idempotent requests this way.
+   * @param host address in dot notation, IPv4 or IPv6 as the socket
+   * @return bytes of buffer sent, the rest is for Write
+   * @throws SocketException if the address is invalid or can't connect
+   */
+  int ConnectFast(const char* host, int port, const void* buffer,
+                  int bufferSize) noexcept(false);
   /**
    * @brief read method uses read system call to read data from a TCP socket
    * (STREAM). Other system like send/recv could be used for this too.
@@ -126,6 +200,14 @@ class Socket {
    * @return int number of bytes read
    */
   int Read(void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief non-throwing Read: an orderly close by the peer is not an error
+   * @param buffer buffer to store data read from socket
+   * @param bufferSize buffer capacity, number of bytes to read
+   * @return number of bytes read, 0 if the peer closed the connection, or
+   *  the errno of the failure
+   */
+  Result<int> TryRead(void* buffer, int bufferSize) noexcept(true);
   /**
    * @brief write method uses write system call.
    * @param const void* buffer to write in.
@@ -133,6 +215,13 @@ class Socket {
    * @throws SocketException if can't write to socket
    */
   void Write(const void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief non-throwing Write
+   * @param buffer data to write
+   * @param bufferSize number of bytes to write
+   * @return number of bytes written or the errno of the failure
+   */
+  Result<int> TryWrite(const void* buffer, int bufferSize) noexcept(true);
   /**
    * @brief write method uses write sys call to perform a write operation in a
    *  TCP socket (STREAM). Calls like send/recv could be used for this too.
@@ -155,6 +244,12 @@ class Socket {
    * @throws SocketException if can't bind to socket
    */
   void Bind(int port) noexcept(false);
+  /**
+   * @brief binds an AF_UNIX socket, e.g. a datagram client that needs an
+   *  address to get answers at
+   * @throws SocketException if can't bind to address
+   */
+  void Bind(const UnixAddress& address) noexcept(false);
   /**
    * @brief accept method uses accept system call to accepts an incoming
    *  connection on a listening stream socket.
@@ -169,11 +264,39 @@ class Socket {
    * @throws SocketException if can't shutdown socket
    */
   void Shutdown(int mode) noexcept(false);
+  /**
+   * @brief SetNoDelay method uses setsockopt to set TCP_NODELAY, so small
+   *  writes are sent right away instead of waiting for the ACK of previous
+   *  data (Nagle's algorithm). Useful when the caller already coalesces its
+   *  writes, like a server flushing a batch of responses.
+   * @param enable true to disable Nagle's algorithm
+   * @throws SocketException if can't set the option
+   */
+  void SetNoDelay(bool enable = true) noexcept(false);
+  /**
+   * @brief sets the options that have a value, e.g. a profile of
+   *  SocketOptions::Named
+   * @details on a listener they are inherited by the accepted sockets.
+   *  With quickAck on, every read sets TCP_QUICKACK again, since the kernel
+   *  goes back to delayed ACKs on its own.
+   * @throws SocketException naming the first option that couldn't be set
+   */
+  void SetOptions(const SocketOptions& options) noexcept(false);
+  /**
+   * @brief sets or clears O_NONBLOCK: reads, writes and handshake steps
+   *  return EAGAIN instead of waiting (use the Try methods)
+   * @throws SocketException if can't change the flags
+   */
+  void SetNonBlocking(bool enable = true) noexcept(false);
   /**
    * @brief: sets the id of the socket (socket file descriptor)
    * @param int id id of the socket
    */
   void SetIDSocket(int newId) noexcept(true);
+  /**
+   * @brief file descriptor of the socket, e.g. to wait for it with epoll
+   */
+  int GetIDSocket() const noexcept(true) { return this->idSocket; }
   /**
    * @brief sendTo method uses sendto system call to send a message to a
    *  UDP Socket (datagram)
@@ -195,6 +318,44 @@ class Socket {
    * @throws SocketException if can't receive message
    */
   int recvFrom(void* buffer, int length, void* srcAddr) noexcept(false);
+  /**
+   * @brief sendTo for an AF_UNIX datagram socket
+   * @return int number of bytes sent
+   * @throws SocketException if can't send message
+   */
+  int sendTo(const void* message, int length,
+             const UnixAddress& destAddr) noexcept(false);
+  /**
+   * @brief recvFrom for an AF_UNIX datagram socket
+   * @param srcAddr where the sender's address is stored, empty if it is not
+   *  bound; may be nullptr
+   * @return int number of bytes received
+   * @throws SocketException if can't receive message
+   */
+  int recvFrom(void* buffer, int length, UnixAddress* srcAddr) noexcept(false);
+  /**
+   * @brief sends open descriptors to the peer of an AF_UNIX socket along
+   *  with a message (SCM_RIGHTS), e.g. an accepted connection handed to a
+   *  worker process
+   * @details the peer gets its own descriptors for the same open files;
+   *  the caller's stay open. The message must have at least one byte.
+   * @param descriptors count descriptors, at most kMaxPassedDescriptors
+   * @return bytes of the message sent
+   * @throws SocketException if can't send message
+   */
+  int SendDescriptors(const void* buffer, int bufferSize,
+                      const int* descriptors, int count) noexcept(false);
+  /**
+   * @brief receives a message and the descriptors sent with it
+   * @details the descriptors are appended to descriptors, close-on-exec,
+   *  and the caller owns them. Descriptors past kMaxPassedDescriptors are
+   *  closed by the kernel and the call throws EMSGSIZE after closing the
+   *  ones it received.
+   * @return bytes of the message, 0 if the peer closed the connection
+   * @throws SocketException if can't receive message
+   */
+  int ReceiveDescriptors(void* buffer, int bufferSize,
+                         std::vector<int>* descriptors) noexcept(false);
   /**
    * @brief SSLConnect method uses SSL_connect sys call to connect to a server
    * @param const char* host host name
@@ -214,6 +375,32 @@ class Socket {
    * @throws SocketException if can't connect to SSL host
    */
   void SSLConnect(const char* host, const char* service) noexcept(false);
+  /**
+   * @brief SSLConnect that sends a first message along with the handshake
+   * @details if a session given to SSLResume lets it (TLS 1.3, the server
+   *  accepts early data, bufferSize within its limit), the message goes out
+   *  as early data with the ClientHello and its answer can arrive one round
+   *  trip sooner. Otherwise, or if the server rejects it, it is written
+   *  after the handshake; either way it is delivered exactly once.
+   * @return true if the message went as early data and was accepted
+   * @throws SocketException as SSLConnect and SSLWrite
+   */
+  bool SSLConnectEarly(const char* host, int port, const void* buffer,
+                       int bufferSize) noexcept(false);
+  /**
+   * @brief the session of this connection, to resume it in a later one
+   * @details TLS 1.3 servers send session tickets after the handshake, take
+   *  the session once the first answer was read. With the tickets of
+   *  SSLEnableEarlyData every session is good for one resumption, take the
+   *  new session from each connection.
+   */
+  TlsSession SSLSession() noexcept(true);
+  /**
+   * @brief resumes session in the next SSLConnect, saving a round trip of
+   *  the handshake, the certificate check and the key exchange
+   * @throws SocketException if OpenSSL refuses the session
+   */
+  void SSLResume(const TlsSession& session) noexcept(false);
   /**
    * @brief: SSLRead method uses SSL_read system call to read from a socket
    * @param: void* buffer buffer to store the message
@@ -222,14 +409,66 @@ class Socket {
    * @throws SocketException if can't read from SSL socket
    */
   int SSLRead(void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief non-throwing SSL_read, it blocks like SSL_read does
+   * @details after SSLAcceptEarly it completes the handshake first and
+   *  returns the early data held until then, as SSLRead does
+   * @param buffer buffer to store the message
+   * @param bufferSize size of the buffer
+   * @return number of bytes read, 0 if the peer closed the TLS session, or
+   *  the error (EAGAIN when OpenSSL needs the socket to be ready, an errno
+   *  for transport failures, an SslErrorCategory code otherwise)
+   */
+  Result<int> TrySSLRead(void* buffer, int bufferSize) noexcept(true);
+  /**
+   * @brief waits until a read won't block: decrypted data is already
+   *  buffered by OpenSSL or there are bytes (or EOF) in the socket.
+   * @param timeoutSec seconds to wait
+   * @param timeoutMicroSec microseconds to wait, added to timeoutSec
+   * @return true if there is something to read, false on timeout
+   * @throws SocketException if select fails
+   */
+  bool WaitToRead(int timeoutSec, int timeoutMicroSec = 0) noexcept(false);
   /**
    * @brief SSLWrite method uses SSL_write system call to write to a socket
+   * @details writes the whole buffer, on a non-blocking socket it waits
+   *  for the socket between records
    * @param const void* buffer buffer to store the message
    * @param int bufferSize size of the buffer
-   * @return int number of bytes written
+   * @return int number of bytes written, always bufferSize
    * @throws SocketException if can't write to SSL socket
    */
   int SSLWrite(const void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief non-throwing SSL_write, or SSL_write_early_data while the
+   *  handshake of SSLAcceptEarly is still open
+   * @param buffer message to write
+   * @param bufferSize size of the message
+   * @return number of bytes written, which may be less than bufferSize
+   *  (partial writes are enabled), or the error, as for TrySSLRead
+   */
+  Result<int> TrySSLWrite(const void* buffer, int bufferSize) noexcept(true);
+  /**
+   * @brief non-blocking write that keeps what the socket can't take yet
+   * @details for sockets set with SetNonBlocking and driven by readiness
+   *  events: the message goes out right away if nothing is queued ahead of
+   *  it, the rest is queued and written by SSLFlush once the socket is
+   *  ready again (in the direction SSLWantsWrite tells), in order.
+   * @return bytes queued after the call (0 if everything was written), or
+   *  the error; never EAGAIN
+   */
+  Result<size_t> SSLSend(const void* buffer, int bufferSize) noexcept(true);
+  /**
+   * @brief writes queued output until it is gone or the socket is full
+   * @return bytes still queued, or the error
+   */
+  Result<size_t> SSLFlush() noexcept(true);
+  /**
+   * @brief bytes given to SSLSend that are not written yet
+   */
+  size_t SSLQueued() const noexcept(true) {
+    return this->output.size() - this->outputSent;
+  }
   /**
    * @brief Construct a new SSL * variable from a previously created context.
    * Constructs a new SSL * variable from a previously created context using the
@@ -244,11 +483,99 @@ class Socket {
    *  handshake and negotiates the TLS/SSL connection through a handshake.
    */
   void SSLAccept() noexcept(false);
+  /**
+   * @brief SSLAccept that also reads the early data of a resumed session
+   * @details without SSLEnableEarlyData on the listener it is SSLAccept. An
+   *  allowed message (see EarlyDataGuard) is returned while the handshake
+   *  is still running: SSLWrite answers it right away and the next SSLRead
+   *  or WaitToRead completes the handshake. Any other early data is
+   *  returned only after the handshake completed.
+   * @param buffer where the early data is stored, at least maxEarlyData
+   *  bytes so an offer always fits
+   * @return bytes of early data in buffer, 0 if there were none
+   * @throws SocketException as SSLAccept, EMSGSIZE if buffer is too small
+   */
+  int SSLAcceptEarly(void* buffer, int bufferSize) noexcept(false);
+  /**
+   * @brief one non-blocking step of the server handshake, for a socket set
+   *  with SetNonBlocking
+   * @return 1 once the handshake is complete, EAGAIN while it waits for the
+   *  socket (SSLWantsWrite tells in which direction), or the error
+   */
+  Result<int> TrySSLAccept() noexcept(true);
+  /**
+   * @brief true if the last EAGAIN from a Try method needs the socket to
+   *  be writable, false if it needs it readable
+   */
+  bool SSLWantsWrite() const noexcept(true) {
+    return this->SSLStruct != nullptr && SSL_want_write(this->SSLStruct);
+  }
+  /**
+   * @brief true once the TLS handshake of this socket has completed
+   */
+  bool SSLEstablished() const noexcept(true) {
+    return this->SSLStruct != nullptr && SSL_is_init_finished(this->SSLStruct);
+  }
   /**
    * @brief Get the cipher used by the current SSL connection.
    * @return const char* The cipher used by the current SSL connection.
    */
   const char* SSLGetCipher() noexcept(false);
+  /**
+   * @brief protocol version of the current SSL connection, e.g. "TLSv1.3"
+   */
+  const char* SSLGetVersion() noexcept(false);
+  /**
+   * @brief sets the versions, cipher suites and groups to negotiate
+   * @details contexts start with TlsPolicy::Default(). On a passive socket
+   *  call it before accepting (a context in use can't be changed safely);
+   *  it is kept for SSLReloadCertificates, which is how a running listener
+   *  switches policy. On an active socket, call it before SSLConnect.
+   * @throws SocketException if OpenSSL rejects the policy (e.g. no known
+   *  cipher in a list)
+   */
+  void SSLSetPolicy(const TlsPolicy& policy) noexcept(false);
+  /**
+   * @brief accepts TLS 1.3 early data from resumed sessions, by the rules
+   *  of guard; connections read it with SSLAcceptEarly
+   * @details sessions are kept by the server (stateful tickets) so OpenSSL
+   *  can take each one's early data only once. Call it before accepting;
+   *  SSLReloadCertificates keeps it, but starts a new session cache, so
+   *  clients do one full handshake after a reload.
+   * @throws SocketException EINVAL if this is not a passive TLS socket
+   */
+  void SSLEnableEarlyData(const EarlyDataGuard& guard) noexcept(false);
+  /**
+   * @brief memory-lean connections: OpenSSL frees a connection's read and
+   *  write buffers (about 34 KB, more with read-ahead) whenever they are
+   *  empty, and SSLFlush frees the SSLSend queue once it is written
+   * @details an idle connection then keeps only its session state, at the
+   *  cost of an allocation per burst of I/O. On a passive socket it applies
+   *  to the connections accepted from then on and is kept by
+   *  SSLReloadCertificates; on an active socket, to its connection.
+   * @throws std::system_error if the listener's lock can't be taken
+   */
+  void SSLSetMemoryLean(bool lean = true) noexcept(false);
+  /**
+   * @brief true if SSLSetMemoryLean is on for this socket or its listener
+   */
+  bool SSLMemoryLean() const noexcept(true);
+  /**
+   * @brief what this connection holds now
+   * @details OpenSSL doesn't say whether it freed its buffers; they count
+   *  as released when lean mode is on, the handshake is over and nothing
+   *  is left in them (no pending record, nothing queued), which is when
+   *  SSL_MODE_RELEASE_BUFFERS frees them.
+   */
+  ConnectionMemory SSLConnectionMemory() const noexcept(true);
+  /**
+   * @brief tells the socket that whoever reads for it holds (or gave back)
+   *  a BufferPool block for it, as FigureServer does, for
+   *  SSLConnectionMemory
+   */
+  void SSLHoldPoolBlock(bool held) noexcept(true) {
+    this->poolBlock = held;
+  }
   /**
    * @brief starts all Openssl libraries to get error information.
    * @throws SocketException if can't start libraries
@@ -264,14 +591,68 @@ class Socket {
    * Displays the SSL certificates identified in the connection.
    */
   void SSLShowCerts() noexcept(true);
+  /**
+   * @brief builds a new server context from the certificate and key files
+   *  and switches the connections created from now on to it, RCU style:
+   *  SSLCreate never locks, the old context is released once no SSLCreate
+   *  still reads it, and connections already created keep theirs until
+   *  they close. Only for passive TLS sockets; safe to call from any thread
+   *  while others accept.
+   * @details an encrypted key is opened with the passphrase typed when the
+   *  socket was created, a reload never prompts
+   * @throws SocketException if the files can't be loaded or don't match, the
+   *  current context stays in use
+   */
+  void SSLReloadCertificates(const char* certFileName,
+                             const char* keyFileName) noexcept(false);
+  /**
+   * @brief identity in the certificate of the peer
+   * @details extracted on the first call after the handshake and kept for
+   *  the rest of the connection, later calls only return it. Use it with
+   *  PeerAllowlist::Allows to authorize a request.
+   * @return nullptr if the peer presented no certificate or the handshake
+   *  has not finished
+   */
+  const PeerIdentity* SSLPeer() noexcept(true);
+  /**
+   * @brief OpenSSL errors of the last failed TLS operation on this socket
+   */
+  const TlsErrorCapture& SSLErrors() const noexcept(true) {
+    return this->sslErrors;
+  }
+  /**
+   * @brief I/O counters of this socket, also added to SocketMetrics
+   */
+  const SocketStats& Stats() const noexcept(true) { return this->stats; }
 
  private:
   int idSocket{0};               ///< id of the socket
   int port{0};                   ///< port number of passive socket
+  std::string unixPath;          ///< socket file created by Bind, if any
   bool ipv6{false};              ///< true if the socket is ipv6
   bool isOpen{false};            ///< true if the socket is open
-  SSL_CTX* SSLContext{nullptr};  ///< SSL context if the socket is SSL
+  /// SSL context if the socket is SSL, replaced by SSLReloadCertificates
+  std::atomic<SSL_CTX*> SSLContext{nullptr};
+  /// passphrase and readers of SSLContext, only for passive TLS sockets
+  std::unique_ptr<SSLServerState> serverState;
   SSL* SSLStruct{nullptr};       ///< SSL structure if the socket is SSL
+  TlsErrorCapture sslErrors;     ///< errors of the last failed TLS operation
+  SocketStats stats;             ///< I/O counters of this socket
+  std::unique_ptr<PeerIdentity> peer;  ///< certificate of the peer, if any
+  bool peerLoaded{false};              ///< peer extracted for this session
+  /// early data rules of the listener, shared by the accepted sockets
+  std::shared_ptr<const EarlyDataGuard> earlyData;
+  /// early data was answered and the handshake is still to be completed
+  bool earlyPending{false};
+  /// early data that came after the answered message, read by SSLRead
+  std::string earlyHeld;
+  bool readNoWait{false};  ///< the socket BIO reads with MSG_DONTWAIT
+  bool quickAck{false};    ///< TCP_QUICKACK is set again after reads
+  std::string output;    ///< queued by SSLSend, from outputSent on
+  size_t outputSent{0};  ///< bytes of output already written
+  bool poolBlock{false};  ///< see SSLHoldPoolBlock
+  /// first TrySSLAccept step, to time a handshake done in steps
+  std::chrono::steady_clock::time_point handshakeStart{};
   /**
    * @private
    * @brief Checks if the given file descriptor is valid or not.
@@ -301,6 +682,14 @@ class Socket {
    * @throws SocketException If the IPv6 address is invalid.
    */
   void connectIPv6(const char* host, int port) noexcept(false);
+  /**
+   * @private
+   * @brief fills address with host and port, of the family of the socket
+   * @return the length of the address
+   * @throws SocketException if host is not a valid address
+   */
+  socklen_t peerAddress(const char* host, int port,
+                        struct sockaddr_storage* address) noexcept(false);
   /**
    * @private
    * @brief Binds the socket to an IPv4 address and port number.
@@ -316,6 +705,12 @@ class Socket {
    * @throws SocketException If there is an error binding to the socket.
    */
   void bindIPv6(int port) noexcept(false);
+  /**
+   * @private
+   * @brief creates the AF_UNIX socket of the constructors
+   * @throws SocketException If the type is invalid or socket fails.
+   */
+  void createUnix(char socketType, const char* function) noexcept(false);
   /**
    * @private
    * @brief Checks if the given file descriptor is ready to read from.
@@ -328,18 +723,108 @@ class Socket {
    */
   bool isReadyToRead(int timeoutSec, int timeoutMicroSec = 0) noexcept(false);
   /**
-   * Uses the select() function to monitor the socket file descriptor for
+   * Uses the poll() function to monitor the socket file descriptor for
    * reading or writing, depending on the error parameter.
    *
    * @param error An error code to determine whether to monitor the socket for
    *  reading or writing. If error is SSL_ERROR_WANT_READ, the
    *  socket will be monitored for reading. Otherwise, it will be monitored for
    *  writing.
-   * @return The result of the select() function, which indicates whether the
+   * @param timeoutMs milliseconds to wait, -1 to wait with no limit
+   * @return The result of the poll() function, which indicates whether the
    *  socket is ready for reading or writing. Returns -1 on error, 0 if
-   *  the select timed out, or a positive integer if the socket is ready.
+   *  the poll timed out, or a positive integer if the socket is ready.
+   */
+  int readyToReadWrite(int error, int timeoutMs = -1) noexcept(true);
+  /**
+   * @private
+   * @brief reads and writes of the TLS connection go through this BIO on
+   *  the socket descriptor, instead of OpenSSL's own socket BIO, so the
+   *  system calls are counted and SSLRead can read without blocking
    */
-  int readyToReadWrite(int error) noexcept(true);
+  void attachSocketBio(const char* function) noexcept(false);
+  /**
+   * @private
+   * @brief the BIO method of attachSocketBio, created once
+   */
+  static BIO_METHOD* socketBioMethod() noexcept(true);
+  static int bioRead(BIO* bio, char* buffer, int size);
+  static int bioWrite(BIO* bio, const char* buffer, int size);
+  static long bioCtrl(BIO* bio, int command, long number, void* pointer);
+  /**
+   * @private
+   * @brief sets TCP_QUICKACK again if it is on, after data was read
+   */
+  void rearmQuickAck() noexcept(true);
+  /**
+   * @private
+   * @brief adds value to a counter of this socket and of SocketMetrics
+   */
+  void count(SocketCounter counter, uint64_t value = 1) noexcept(true) {
+    this->stats.counters[static_cast<size_t>(counter)] += value;
+    SocketMetrics::Add(counter, value);
+  }
+  /**
+   * @private
+   * @brief counts a completed handshake that started at start
+   */
+  void countHandshake(std::chrono::steady_clock::time_point start) noexcept(
+      true);
+  /**
+   * @private
+   * @brief one SSL_write, or SSL_write_early_data while answering early
+   *  data
+   * @return bytes written, or a value for SSL_get_error
+   */
+  int writeSome(const char* buffer, int bufferSize) noexcept(true);
+  /**
+   * @private
+   * @brief after a handshake step failed with result: waits for the socket
+   *  if OpenSSL needs it, throws otherwise
+   * @throws SocketException if the handshake failed
+   */
+  void waitForHandshake(int result, const char* function) noexcept(false);
+  /**
+   * @private
+   * @brief SSL_do_handshake until it completes, then counts the handshake
+   *  started at handshakeStart
+   */
+  void completeHandshake(const char* function) noexcept(false);
+  /**
+   * @private
+   * @brief after early data was answered: reads the rest of it into
+   *  earlyHeld and completes the handshake
+   */
+  void finishEarlyData() noexcept(false);
+  /**
+   * @private
+   * @brief finishEarlyData for the Try methods
+   * @return the error that ended it, empty if the handshake completed
+   */
+  std::error_code tryFinishEarlyData() noexcept(true);
+  /**
+   * @private
+   * @brief error of a failed SSL_read or SSL_write as a std::error_code
+   * @param result value returned by SSL_read or SSL_write
+   */
+  std::error_code sslIoError(int result) noexcept(true);
+  /**
+   * @private
+   * @brief drains the OpenSSL error queue into sslErrors and throws them
+   * @throws SocketException always
+   */
+  [[noreturn]] void throwSslError(const char* message,
+                                  const char* function) noexcept(false);
+  /**
+   * @private
+   * @brief throws the error of a failed SSL_read or SSL_write: a system
+   *  error (a reset, a broken pipe) with its errno, anything else with the
+   *  OpenSSL errors behind it
+   * @param result value returned by SSL_read or SSL_write
+   * @throws SocketException always
+   */
+  [[noreturn]] void throwSslIoError(int result, const char* message,
+                                    const char* function) noexcept(false);
   /**
    * @private
    * @brief Initialize SSL server context.
@@ -367,6 +852,13 @@ class Socket {
    */
   void SSLLoadCertificates(const char* certFileName,
                            const char* keyFileName) noexcept(false);
+  /**
+   * @private
+   * @brief loads certificate and key into context and checks they match
+   * @param prompt true to ask for the key passphrase if it is not known yet
+   */
+  void loadCertificates(SSL_CTX* context, const char* certFileName,
+                        const char* keyFileName, bool prompt) noexcept(false);
   /**
    * @private
    * @brief SSLInitContext method initializes the SSL context
@@ -1,54 +1,100 @@
 // Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
 #include "SocketException.hpp"
 
-SocketException::SocketException(const std::string& message,
-                                 const std::string& function, int errorCode,
-                                 bool isSslError)
-    : mMessage(message), mFunction(function), mErrorCode(errorCode) {
+/**
+ * @brief names OpenSSL error codes with ERR_error_string_n
+ */
+class SslErrorCategoryImpl : public std::error_category {
+ public:
+  const char* name() const noexcept override { return "openssl"; }
+  std::string message(int condition) const override {
+    char buffer[256];
+    ERR_error_string_n(static_cast<unsigned long>(condition), buffer,
+                       sizeof(buffer));
+    return buffer;
+  }
+};
+
+const std::error_category& SslErrorCategory() noexcept {
+  static const SslErrorCategoryImpl category;
+  return category;
+}
+
+std::error_code MakeSslError(unsigned long error) noexcept {
+  if (ERR_SYSTEM_ERROR(error)) {
+    return std::error_code(ERR_GET_REASON(error), std::system_category());
+  }
+  // library and reason codes use the low 31 bits, they fit in an int
+  return std::error_code(static_cast<int>(error), SslErrorCategory());
+}
+
+SocketException::SocketException(const char* message, const char* function,
+                                 int errorCode, bool isSslError) noexcept
+    : mMessage(message), mFunction(function) {
   if (isSslError) {
-    this->mErrorMessage = sslErrorMessage();
+    this->mSslError = static_cast<unsigned long>(errorCode);
   } else {
-    this->mErrorMessage = errorMessage();
+    this->mErrorCode = errorCode;
   }
 }
 
-SocketException::SocketException(const std::string& message,
-                                 const std::string& function, bool isSslError)
+SocketException::SocketException(const char* message, const char* function,
+                                 bool isSslError) noexcept
     : mMessage(message), mFunction(function) {
   if (isSslError) {
-    this->mErrorMessage = sslErrorMessage();
-  } else {
-    this->mErrorMessage = mMessage + " (" + mFunction + ")";
+    // the whole queue, leftovers would be blamed on the next operation
+    this->mSslErrors.Drain();
+    this->mSslError = this->mSslErrors.First();
   }
 }
+
+SocketException::SocketException(const char* message, const char* function,
+                                 const TlsErrorCapture& sslErrors) noexcept
+    : mMessage(message),
+      mFunction(function),
+      mSslError(sslErrors.First()),
+      mSslErrors(sslErrors) {}
+
 const char* SocketException::what() const noexcept {
+  if (this->mErrorMessage.empty()) {
+    try {
+      if (this->mSslError != 0) {
+        this->mErrorMessage = sslErrorMessage();
+      } else if (this->mErrorCode != 0) {
+        this->mErrorMessage = errorMessage();
+      } else {
+        this->mErrorMessage = std::string(mMessage) + " (" + mFunction + ")";
+      }
+    } catch (const std::bad_alloc&) {
+      return this->mMessage;
+    }
+  }
   return this->mErrorMessage.c_str();
 }
 
-const std::string& SocketException::function() const noexcept {
-  return mFunction;
+std::error_code SocketException::Code() const noexcept {
+  if (this->mSslError != 0) {
+    return MakeSslError(this->mSslError);
+  }
+  return std::error_code(this->mErrorCode, std::system_category());
 }
 
-int SocketException::errorCode() const noexcept { return mErrorCode; }
+const char* SocketException::function() const noexcept { return mFunction; }
 
-std::string SocketException::errorMessage() const noexcept {
-  return mMessage + " (" + mFunction + ") - " + strerror(mErrorCode);
-}
+int SocketException::errorCode() const noexcept { return mErrorCode; }
 
-std::string SocketException::sslErrorMessage() const noexcept {
-  return mMessage + " (" + mFunction + ") - " +
-         ERR_error_string(mErrorCode, NULL);
+std::string SocketException::errorMessage() const {
+  return std::string(mMessage) + " (" + mFunction + ") - " +
+         strerror(mErrorCode);
 }
 
-std::string SocketException::getSslError() const noexcept {
-  uint64_t error = ERR_get_error();
-  const char* buffer = ERR_reason_error_string(error);
-  std::string output = mMessage + " (" + mFunction + ") - ";
-  if (buffer) {
-    output += ": ";
-    output += buffer;
+std::string SocketException::sslErrorMessage() const {
+  // ERR_error_string(code, NULL) shares one static buffer among threads
+  char errors[1024];
+  if (this->mSslErrors.Size() > 0) {
+    this->mSslErrors.Format(errors, sizeof(errors));
   } else {
-    output += ": NULL";
+    ERR_error_string_n(mSslError, errors, sizeof(errors));
   }
-  return output;
+  return std::string(mMessage) + " (" + mFunction + ") - " + errors;
 }
@@ -15,6 +15,22 @@
 #include <cstring>
 #include <exception>
 #include <string>
+#include <system_error>
+
+#include "TlsErrors.hpp"
+
+/**
+ * @brief Error category of OpenSSL error codes (the values of ERR_get_error)
+ */
+const std::error_category& SslErrorCategory() noexcept;
+
+/**
+ * @brief Wraps an OpenSSL error code in a std::error_code
+ * @param error value of ERR_get_error
+ * @return the errno value for system errors reported through OpenSSL, an
+ *  SslErrorCategory code otherwise
+ */
+std::error_code MakeSslError(unsigned long error) noexcept;
 
 /**
  * @class SocketException
@@ -22,40 +38,68 @@
  * @details This exception is thrown when a socket operation (e.g. connect,
  * bind, send, etc.) fails. It stores the error message, the name of the
  * function that failed, and the error code associated with the failure.
+ * Nothing is formatted until what() is called, so throwing and catching an
+ * exception whose text nobody reads costs no allocations.
  */
 class SocketException : public std::exception {
  public:
   /**
    * @brief Constructor for SocketException
-   * @param message The error message to associate with the exception
-   * @param function The name of the function that failed
-   * @param errorCode The error code associated with the failure
+   * @param message The error message to associate with the exception, it
+   *  must be a string literal (it is not copied)
+   * @param function The name of the function that failed, a string literal
+   * @param errorCode The error code associated with the failure, an OpenSSL
+   *  error code if isSslError, an errno value otherwise
    */
-  SocketException(const std::string& message, const std::string& function,
-                  int errorCode, bool isSslError = true);
+  SocketException(const char* message, const char* function, int errorCode,
+                  bool isSslError = true) noexcept;
   /**
    * @brief Constructor for SocketException that does not take an error code
-   * @param message The error message to associate with the exception
-   * @param function is the function where error occurs
+   * @param message The error message to associate with the exception, a
+   *  string literal
+   * @param function is the function where error occurs, a string literal
+   * @param isSslError drains the OpenSSL error queue of this thread into the
+   *  exception
    */
-  SocketException(const std::string& message, const std::string& function,
-                  bool isSslError = true);
+  SocketException(const char* message, const char* function,
+                  bool isSslError = true) noexcept;
+  /**
+   * @brief Constructor for SocketException with errors already drained
+   * @param message The error message, a string literal
+   * @param function is the function where error occurs, a string literal
+   * @param sslErrors the OpenSSL errors of the failure
+   */
+  SocketException(const char* message, const char* function,
+                  const TlsErrorCapture& sslErrors) noexcept;
   /**
    * @brief Returns a C-style character string describing the exception
+   * @details formatted on the first call, do not call it from several
+   *  threads at once on the same exception
    * @return A C-style character string describing the exception
    */
   const char* what() const noexcept override;
+  /**
+   * @brief Returns the error as a std::error_code, the same value the
+   *  non-throwing Socket::Try* methods return
+   */
+  std::error_code Code() const noexcept;
+  /**
+   * @brief Returns every OpenSSL error queued when the exception was built
+   */
+  const TlsErrorCapture& SslErrors() const noexcept { return mSslErrors; }
 
  private:
-  std::string mMessage;   ///< The error message associated with the exception
-  std::string mFunction;  ///< The name of the function that failed
-  int mErrorCode;         ///< The error code associated with the failure
-  std::string mErrorMessage;  ///< The error message to return
+  const char* mMessage;   ///< The error message associated with the exception
+  const char* mFunction;  ///< The name of the function that failed
+  int mErrorCode{0};      ///< errno value associated with the failure
+  unsigned long mSslError{0};  ///< OpenSSL error code of the failure
+  TlsErrorCapture mSslErrors;  ///< OpenSSL error queue at the failure
+  mutable std::string mErrorMessage;  ///< The error message to return
   /**
    * @brief Returns the name of the function that failed
    * @return The name of the function that failed
    */
-  const std::string& function() const noexcept;
+  const char* function() const noexcept;
 
   /**
    * @brief Returns the error code associated with the failure
@@ -67,13 +111,12 @@ class SocketException : public std::exception {
    * @brief Returns a string describing the error
    * @return A string describing the error
    */
-  std::string errorMessage() const noexcept;
+  std::string errorMessage() const noexcept(false);
   /**
-   * @brief gets the error message from the SSL library
-   * @param message the message to prepend to the error message
+   * @brief gets the error message from the SSL library, every queued error
+   *  is included
    * @details depends on initialization of SSL libraries outside this class
    */
-  std::string sslErrorMessage() const noexcept;
-  std::string getSslError() const noexcept;
+  std::string sslErrorMessage() const noexcept(false);
 };
 #endif  // SOCKET_EXCEPTION_HPP
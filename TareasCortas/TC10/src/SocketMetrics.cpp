@@ -0,0 +1,236 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "SocketMetrics.hpp"
+
+#include <openssl/err.h>
+
+#include <atomic>
+#include <cstdio>
+
+#include "BufferPool.hpp"
+#include "SlabAllocator.hpp"
+#include "ThreadLease.hpp"
+#include "TlsErrors.hpp"
+
+/**
+ * @brief counters of the threads that lease it, one writer at a time
+ */
+struct alignas(kMetricsCacheLine) MetricsShard {
+  std::atomic<bool> leased{false};
+  std::atomic<uint64_t> counters[kSocketCounterCount]{};
+  std::atomic<uint64_t> handshakeBuckets[kHandshakeBuckets]{};
+  std::atomic<uint64_t> handshakeNanoseconds{0};
+};
+static MetricsShard shards[kMetricsShards];
+static MetricsShard sharedShard;  ///< for threads that found no free shard
+
+/// shard of the calling thread, a plain pointer so the fast path has no
+/// thread_local initialization guard
+static thread_local MetricsShard* threadShard = nullptr;
+
+/**
+ * @brief the thread is exiting: later counts go to the shared shard
+ */
+static void leaveShard() noexcept {
+  threadShard = &sharedShard;
+}
+
+/**
+ * @brief leases a free shard to the calling thread, the shared one if there
+ *  is none
+ */
+static MetricsShard* leaseShard() noexcept(true) {
+  threadShard = ThreadLease<MetricsShard>::Acquire(shards, leaveShard);
+  if (threadShard == nullptr) {
+    threadShard = &sharedShard;
+  }
+  return threadShard;
+}
+
+/**
+ * @brief adds to one field of the calling thread's shard
+ */
+template <typename Field>
+static inline void addToShard(Field field, uint64_t value) noexcept(true) {
+  MetricsShard* shard = threadShard;
+  if (__builtin_expect(shard == nullptr, 0)) {
+    shard = leaseShard();
+  }
+  std::atomic<uint64_t>& counter = field(*shard);
+  if (shard == &sharedShard) {
+    counter.fetch_add(value, std::memory_order_relaxed);
+  } else {
+    // the only writer: a plain read-modify-write, readers see either value
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+}
+
+void SocketMetrics::Add(SocketCounter counter, uint64_t value) noexcept(true) {
+  size_t index = static_cast<size_t>(counter);
+  addToShard(
+      [index](MetricsShard& shard) -> std::atomic<uint64_t>& {
+        return shard.counters[index];
+      },
+      value);
+}
+
+void SocketMetrics::RecordHandshake(uint64_t nanoseconds) noexcept(true) {
+  size_t bucket = 0;
+  for (uint64_t bound = 64000; bucket + 1 < kHandshakeBuckets &&
+                               nanoseconds > bound;
+       bound <<= 1) {
+    ++bucket;
+  }
+  addToShard(
+      [bucket](MetricsShard& shard) -> std::atomic<uint64_t>& {
+        return shard.handshakeBuckets[bucket];
+      },
+      1);
+  addToShard([](MetricsShard& shard) -> std::atomic<uint64_t>& {
+    return shard.handshakeNanoseconds;
+  }, nanoseconds);
+  Add(SocketCounter::kHandshakes);
+}
+
+/**
+ * @brief sum of one field over every shard
+ */
+template <typename Field>
+static uint64_t sumShards(Field field) noexcept(true) {
+  uint64_t total = field(sharedShard).load(std::memory_order_relaxed);
+  for (MetricsShard& shard : shards) {
+    total += field(shard).load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t SocketMetrics::Total(SocketCounter counter) noexcept(true) {
+  size_t index = static_cast<size_t>(counter);
+  return sumShards([index](MetricsShard& shard) -> std::atomic<uint64_t>& {
+    return shard.counters[index];
+  });
+}
+
+/**
+ * @brief name, labels and help of each counter, same order as SocketCounter;
+ *  counters of a family are next to each other
+ */
+struct CounterInfo {
+  const char* family;
+  const char* labels;
+  const char* help;
+};
+static const CounterInfo kCounterInfo[kSocketCounterCount] = {
+    {"socket_bytes_total", "direction=\"in\"",
+     "Bytes moved through sockets, plaintext for TLS."},
+    {"socket_bytes_total", "direction=\"out\"", nullptr},
+    {"socket_calls_total", "call=\"read\"",
+     "I/O calls made, system calls or OpenSSL calls."},
+    {"socket_calls_total", "call=\"write\"", nullptr},
+    {"socket_calls_total", "call=\"ssl_read\"", nullptr},
+    {"socket_calls_total", "call=\"ssl_write\"", nullptr},
+    {"socket_calls_total", "call=\"recvfrom\"", nullptr},
+    {"socket_calls_total", "call=\"sendto\"", nullptr},
+    {"socket_calls_total", "call=\"accept\"", nullptr},
+    {"socket_calls_total", "call=\"connect\"", nullptr},
+    {"socket_calls_total", "call=\"wait\"", nullptr},
+    {"socket_would_block_total", nullptr,
+     "Calls that returned EAGAIN or wanted the socket to be ready."},
+    {"tls_handshakes_total", "result=\"ok\"", "TLS handshakes."},
+    {"tls_handshakes_total", "result=\"error\"", nullptr},
+    {"tls_early_data_total", "result=\"answered\"",
+     "TLS 1.3 early data offers by outcome."},
+    {"tls_early_data_total", "result=\"deferred\"", nullptr},
+    {"tls_early_data_total", "result=\"rejected\"", nullptr},
+    {"socket_errors_total", "type=\"reset\"", "Failed socket calls by type."},
+    {"socket_errors_total", "type=\"timeout\"", nullptr},
+    {"socket_errors_total", "type=\"tls\"", nullptr},
+    {"socket_errors_total", "type=\"other\"", nullptr},
+};
+
+std::string SocketMetrics::Prometheus() {
+  std::string text;
+  char line[256];
+  for (size_t index = 0; index < kSocketCounterCount; ++index) {
+    const CounterInfo& info = kCounterInfo[index];
+    if (info.help != nullptr) {
+      snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n",
+               info.family, info.help, info.family);
+      text += line;
+    }
+    uint64_t value = Total(static_cast<SocketCounter>(index));
+    if (info.labels != nullptr) {
+      snprintf(line, sizeof(line), "%s{%s} %lu\n", info.family, info.labels,
+               static_cast<unsigned long>(value));
+    } else {
+      snprintf(line, sizeof(line), "%s %lu\n", info.family,
+               static_cast<unsigned long>(value));
+    }
+    text += line;
+  }
+  text +=
+      "# HELP tls_handshake_seconds Duration of the completed TLS "
+      "handshakes.\n# TYPE tls_handshake_seconds histogram\n";
+  uint64_t cumulative = 0;
+  for (size_t bucket = 0; bucket < kHandshakeBuckets; ++bucket) {
+    cumulative += sumShards([bucket](MetricsShard& shard)
+                                -> std::atomic<uint64_t>& {
+      return shard.handshakeBuckets[bucket];
+    });
+    if (bucket + 1 < kHandshakeBuckets) {
+      snprintf(line, sizeof(line),
+               "tls_handshake_seconds_bucket{le=\"%.7g\"} %lu\n",
+               64e-6 * (1ull << bucket),
+               static_cast<unsigned long>(cumulative));
+    } else {
+      snprintf(line, sizeof(line),
+               "tls_handshake_seconds_bucket{le=\"+Inf\"} %lu\n",
+               static_cast<unsigned long>(cumulative));
+    }
+    text += line;
+  }
+  uint64_t nanoseconds =
+      sumShards([](MetricsShard& shard) -> std::atomic<uint64_t>& {
+        return shard.handshakeNanoseconds;
+      });
+  snprintf(line, sizeof(line),
+           "tls_handshake_seconds_sum %.6f\ntls_handshake_seconds_count %lu\n",
+           nanoseconds / 1e9, static_cast<unsigned long>(cumulative));
+  text += line;
+  text +=
+      "# HELP tls_errors_total OpenSSL errors drained, by library and "
+      "reason.\n# TYPE tls_errors_total counter\n";
+  TlsErrorCounters::ForEach([&text, &line](unsigned long code,
+                                           uint64_t count) {
+    // code 0 holds the reasons that did not fit in TlsErrorCounters
+    const char* reason = code == 0 ? "other" : ERR_reason_error_string(code);
+    if (reason != nullptr) {
+      snprintf(line, sizeof(line), "tls_errors_total{reason=\"%s\"} %lu\n",
+               reason, static_cast<unsigned long>(count));
+    } else {
+      snprintf(line, sizeof(line),
+               "tls_errors_total{reason=\"lib%d:%d\"} %lu\n",
+               ERR_GET_LIB(code), ERR_GET_REASON(code),
+               static_cast<unsigned long>(count));
+    }
+    text += line;
+  });
+  const BufferPool& pool = BufferPool::Shared();
+  snprintf(line, sizeof(line),
+           "# HELP buffer_pool_bytes Memory of the shared I/O buffer pool.\n"
+           "# TYPE buffer_pool_bytes gauge\n"
+           "buffer_pool_bytes{state=\"in_use\"} %zu\n"
+           "buffer_pool_bytes{state=\"cached\"} %zu\n",
+           pool.InUse() * pool.BlockSize(), pool.Cached() * pool.BlockSize());
+  text += line;
+  SlabStats slabs = SlabAllocator::Stats();
+  snprintf(line, sizeof(line),
+           "# HELP slab_allocator_bytes Memory of the slab allocator.\n"
+           "# TYPE slab_allocator_bytes gauge\n"
+           "slab_allocator_bytes{state=\"reserved\"} %zu\n"
+           "slab_allocator_bytes{state=\"in_use\"} %zu\n"
+           "slab_allocator_bytes{state=\"large\"} %zu\n",
+           slabs.reserved, slabs.inUse, slabs.large);
+  text += line;
+  return text;
+}
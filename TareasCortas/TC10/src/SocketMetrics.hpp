@@ -0,0 +1,112 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file SocketMetrics.hpp
+ * @brief Defines the I/O counters kept by every Socket (SocketStats) and
+ * their process wide totals (SocketMetrics), kept in per-thread shards and
+ * exported in Prometheus text format.
+ */
+#ifndef SOCKET_METRICS_HPP
+#define SOCKET_METRICS_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr size_t kMetricsCacheLine = 64;   ///< shards never share a line
+constexpr size_t kMetricsShards = 128;     ///< threads counting at once
+constexpr size_t kHandshakeBuckets = 16;   ///< powers of two from 64 us
+
+/**
+ * @brief Everything counted, per socket and per process
+ */
+enum class SocketCounter : size_t {
+  kBytesIn,            ///< bytes received (plaintext for TLS)
+  kBytesOut,           ///< bytes sent (plaintext for TLS)
+  kReadCalls,          ///< read system calls
+  kWriteCalls,         ///< write system calls
+  kSslReadCalls,       ///< SSL_read calls
+  kSslWriteCalls,      ///< SSL_write calls
+  kRecvFromCalls,      ///< recvfrom system calls
+  kSendToCalls,        ///< sendto system calls
+  kAcceptCalls,        ///< connections accepted
+  kConnectCalls,       ///< connections opened
+  kWaitCalls,          ///< select and poll calls waiting for the socket
+  kWouldBlock,         ///< EAGAIN or SSL_ERROR_WANT_READ/WRITE
+  kHandshakes,         ///< TLS handshakes completed
+  kHandshakeFailures,  ///< TLS handshakes that failed
+  kEarlyAnswered,      ///< early data answered before the handshake ended
+  kEarlyDeferred,      ///< early data held until the handshake ended
+  kEarlyRejected,      ///< early data refused, sent again after it
+  kResetErrors,        ///< peer went away (ECONNRESET, EPIPE, no close_notify)
+  kTimeoutErrors,      ///< ETIMEDOUT and waits that timed out
+  kTlsErrors,          ///< failures reported by OpenSSL itself
+  kOtherErrors,        ///< any other errno
+  kCount               ///< number of counters, not a counter
+};
+
+constexpr size_t kSocketCounterCount =
+    static_cast<size_t>(SocketCounter::kCount);
+
+/**
+ * @brief counter an errno of a failed call is counted in
+ */
+inline SocketCounter ErrorCounter(int error) noexcept(true) {
+  switch (error) {
+    case EAGAIN:
+      return SocketCounter::kWouldBlock;
+    case ECONNRESET:
+    case ECONNABORTED:
+    case EPIPE:
+      return SocketCounter::kResetErrors;
+    case ETIMEDOUT:
+      return SocketCounter::kTimeoutErrors;
+    default:
+      return SocketCounter::kOtherErrors;
+  }
+}
+
+/**
+ * @brief Counters of one socket. A socket is used by one thread at a time,
+ *  so they are plain integers.
+ */
+struct SocketStats {
+  uint64_t counters[kSocketCounterCount]{};  ///< indexed by SocketCounter
+  uint64_t handshakeNanoseconds{0};          ///< duration of the handshake
+  uint64_t operator[](SocketCounter counter) const noexcept(true) {
+    return this->counters[static_cast<size_t>(counter)];
+  }
+};
+
+/**
+ * @class SocketMetrics
+ * @brief Process wide totals of every SocketStats
+ * @details each thread leases a cache line aligned shard and is its only
+ *  writer, so counting is a relaxed load and store with no lock prefix and
+ *  no line bouncing between cores; a shard is handed to another thread when
+ *  its owner exits, keeping its values. Threads that find every shard taken
+ *  share one more, updated with atomic adds. Reading sums every shard
+ *  without stopping the writers.
+ */
+class SocketMetrics {
+ public:
+  /**
+   * @brief adds value to a counter of the calling thread's shard
+   */
+  static void Add(SocketCounter counter, uint64_t value = 1) noexcept(true);
+  /**
+   * @brief counts a completed TLS handshake and its duration
+   */
+  static void RecordHandshake(uint64_t nanoseconds) noexcept(true);
+  /**
+   * @brief sum of a counter over every shard
+   */
+  static uint64_t Total(SocketCounter counter) noexcept(true);
+  /**
+   * @brief every counter, the handshake histogram, the OpenSSL errors by
+   *  reason (TlsErrorCounters) and the memory of BufferPool::Shared() and
+   *  SlabAllocator in Prometheus text exposition format
+   */
+  static std::string Prometheus() noexcept(false);
+};
+#endif  // SOCKET_METRICS_HPP
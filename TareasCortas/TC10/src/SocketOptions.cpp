@@ -0,0 +1,99 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "SocketOptions.hpp"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+
+// unsent bytes the low-latency profile lets the kernel hold
+#define LOW_LATENCY_NOTSENT 16384
+// socket buffers of the bulk profile
+#define BULK_BUFFER (4 << 20)
+
+/**
+ * @brief one option: where it goes and the message if it fails
+ */
+struct OptionSlot {
+  std::optional<int> value;
+  int level;
+  int name;
+  const char* message;
+};
+
+bool SocketOptions::Named(const char* name, SocketOptions& options) noexcept(
+    true) {
+  SocketOptions named;
+  if (strcmp(name, "low-latency") == 0) {
+    named.noDelay = true;
+    named.quickAck = true;
+    named.deferAccept = 1;
+    named.notSentLowat = LOW_LATENCY_NOTSENT;
+  } else if (strcmp(name, "bulk") == 0) {
+    named.noDelay = false;
+    named.sendBuffer = BULK_BUFFER;
+    named.receiveBuffer = BULK_BUFFER;
+  } else if (strcmp(name, "long-lived") == 0) {
+    named.keepAlive = true;
+    named.keepIdle = 60;
+    named.keepInterval = 10;
+    named.keepCount = 6;
+    named.userTimeoutMs = 90000;
+  } else if (strcmp(name, "default") != 0) {
+    return false;
+  }
+  options = named;
+  return true;
+}
+
+/**
+ * @brief the value of a flag as setsockopt takes it
+ */
+static std::optional<int> flag(const std::optional<bool>& value) {
+  if (!value) {
+    return std::nullopt;
+  }
+  return *value ? 1 : 0;
+}
+
+int SocketOptions::Apply(int descriptor, const char** failed) const noexcept(
+    true) {
+  // buffers before anything else: the window scale of a connection is
+  // chosen from the receive buffer when it is created
+  const OptionSlot slots[] = {
+      {this->receiveBuffer, SOL_SOCKET, SO_RCVBUF, "Error setting SO_RCVBUF"},
+      {this->sendBuffer, SOL_SOCKET, SO_SNDBUF, "Error setting SO_SNDBUF"},
+      {flag(this->noDelay), IPPROTO_TCP, TCP_NODELAY,
+       "Error setting TCP_NODELAY"},
+      {flag(this->quickAck), IPPROTO_TCP, TCP_QUICKACK,
+       "Error setting TCP_QUICKACK"},
+      {flag(this->keepAlive), SOL_SOCKET, SO_KEEPALIVE,
+       "Error setting SO_KEEPALIVE"},
+      {this->keepIdle, IPPROTO_TCP, TCP_KEEPIDLE, "Error setting TCP_KEEPIDLE"},
+      {this->keepInterval, IPPROTO_TCP, TCP_KEEPINTVL,
+       "Error setting TCP_KEEPINTVL"},
+      {this->keepCount, IPPROTO_TCP, TCP_KEEPCNT, "Error setting TCP_KEEPCNT"},
+      {this->userTimeoutMs, IPPROTO_TCP, TCP_USER_TIMEOUT,
+       "Error setting TCP_USER_TIMEOUT"},
+      {this->deferAccept, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+       "Error setting TCP_DEFER_ACCEPT"},
+      {this->notSentLowat, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+       "Error setting TCP_NOTSENT_LOWAT"},
+      {this->fastOpen, IPPROTO_TCP, TCP_FASTOPEN, "Error setting TCP_FASTOPEN"},
+      {flag(this->fastOpenConnect), IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+       "Error setting TCP_FASTOPEN_CONNECT"}};
+  for (const OptionSlot& slot : slots) {
+    if (!slot.value) {
+      continue;
+    }
+    int value = *slot.value;
+    if (setsockopt(descriptor, slot.level, slot.name, &value,
+                   sizeof(value)) == -1) {
+      *failed = slot.message;
+      return errno;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file SocketOptions.hpp
+ * @brief Defines SocketOptions, the TCP and socket level options of a
+ * connection or listener, with named profiles for request/response, bulk
+ * and long lived traffic.
+ */
+#ifndef SOCKET_OPTIONS_HPP
+#define SOCKET_OPTIONS_HPP
+
+#include <optional>
+
+/**
+ * @class SocketOptions
+ * @brief Options to set with setsockopt. Empty ones are left as they are,
+ *  the kernel defaults for a new socket.
+ * @details set on a listener, Linux copies them to every accepted
+ *  connection (except TCP_QUICKACK, which the kernel clears by itself
+ *  after a while; Socket sets it again after each read while it is on).
+ *  Setting a buffer size turns off the kernel's automatic sizing of that
+ *  buffer, and the value is capped by net.core.rmem_max / wmem_max.
+ *  Fast Open needs net.ipv4.tcp_fastopen: bit 1 for clients (the default),
+ *  bit 2 for listeners. fastOpen is how many connections with data in
+ *  their SYN may wait for accept; fastOpenConnect makes the first write
+ *  after Connect (or the ClientHello of SSLConnect) ride in the SYN. No
+ *  profile sets them: one is for listeners only, the other for clients.
+ */
+class SocketOptions {
+ public:
+  std::optional<bool> noDelay;        ///< TCP_NODELAY, no Nagle
+  std::optional<bool> quickAck;       ///< TCP_QUICKACK, no delayed ACKs
+  std::optional<int> sendBuffer;      ///< SO_SNDBUF, bytes
+  std::optional<int> receiveBuffer;   ///< SO_RCVBUF, bytes
+  std::optional<bool> keepAlive;      ///< SO_KEEPALIVE
+  std::optional<int> keepIdle;        ///< TCP_KEEPIDLE, idle seconds
+  std::optional<int> keepInterval;    ///< TCP_KEEPINTVL, seconds
+  std::optional<int> keepCount;       ///< TCP_KEEPCNT, probes
+  std::optional<int> userTimeoutMs;   ///< TCP_USER_TIMEOUT, unacked data
+  std::optional<int> deferAccept;     ///< TCP_DEFER_ACCEPT, listener seconds
+  std::optional<int> notSentLowat;    ///< TCP_NOTSENT_LOWAT, bytes
+  std::optional<int> fastOpen;        ///< TCP_FASTOPEN, listener SYN queue
+  std::optional<bool> fastOpenConnect;  ///< TCP_FASTOPEN_CONNECT, client
+
+  /**
+   * @brief a named profile:
+   *  - "default": nothing set
+   *  - "low-latency": request/response; no Nagle and no delayed ACKs,
+   *    accept only once the request arrived, and at most 16 KB unsent in
+   *    the kernel so new data isn't queued behind old
+   *  - "bulk": large transfers; Nagle on so writes fill whole segments,
+   *    and 4 MB buffers so a window is never short on a fast link
+   *  - "long-lived": keep-alive probes after 60 s idle (every 10 s, 6 of
+   *    them) and a 90 s limit for unacknowledged data, so dead peers are
+   *    found
+   * @return false if name is unknown, options are left unchanged
+   */
+  static bool Named(const char* name, SocketOptions& options) noexcept(true);
+  /**
+   * @brief sets every option that has a value on descriptor
+   * @param failed on failure, a message naming the option that failed
+   * @return 0, or the errno of the first option that failed (the ones
+   *  before it are set)
+   */
+  int Apply(int descriptor, const char** failed) const noexcept(true);
+};
+#endif  // SOCKET_OPTIONS_HPP
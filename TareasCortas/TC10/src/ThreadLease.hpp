@@ -0,0 +1,73 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file ThreadLease.hpp
+ * @brief Defines ThreadLease, which leases one of a fixed set of per-thread
+ * slots (metrics shards, trace rings, log rings) to the calling thread and
+ * gives it back when the thread exits.
+ */
+#ifndef THREAD_LEASE_HPP
+#define THREAD_LEASE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @class ThreadLease
+ * @brief Leases slots to threads, one writer per slot at a time
+ * @details Slot has a std::atomic<bool> leased. The thread keeps the slot
+ *  in a thread_local pointer of its own, so the fast path has no
+ *  thread_local initialization guard. When the thread exits the slot is
+ *  given back and atExit runs: destructors of other thread locals may
+ *  still write, and by then the slot may belong to another thread, so
+ *  atExit must point the thread's pointer elsewhere (and keep the thread
+ *  from leasing again).
+ */
+template <typename Slot>
+class ThreadLease {
+ public:
+  /// points the exiting thread's slot pointer away from its slot
+  using ExitHandler = void (*)() noexcept;
+
+  /**
+   * @brief leases a free slot of slots to the calling thread, at most once
+   *  per thread
+   * @param atExit runs when the thread exits, after the slot is given back
+   * @return the slot, nullptr if every slot is taken
+   */
+  template <size_t kCount>
+  static Slot* Acquire(Slot (&slots)[kCount], ExitHandler atExit) noexcept(
+      true) {
+    // threads start at different slots, so they don't all race for the first
+    static std::atomic<size_t> nextStart{0};
+    size_t start = nextStart.fetch_add(1, std::memory_order_relaxed);
+    for (size_t probe = 0; probe < kCount; ++probe) {
+      Slot& candidate = slots[(start + probe) % kCount];
+      bool leased = false;
+      // acquire: sees everything the previous owner stored in the slot
+      if (candidate.leased.compare_exchange_strong(
+              leased, true, std::memory_order_acquire)) {
+        static thread_local ThreadLease lease;
+        lease.slot = &candidate;
+        lease.atExit = atExit;
+        return &candidate;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * @brief gives the slot back, the thread is exiting
+   */
+  ~ThreadLease() {
+    if (this->slot != nullptr) {
+      // release: the next owner sees what this thread stored
+      this->slot->leased.store(false, std::memory_order_release);
+      this->atExit();
+    }
+  }
+
+ private:
+  Slot* slot{nullptr};          ///< slot leased to the thread
+  ExitHandler atExit{nullptr};  ///< redirects the thread's slot pointer
+};
+#endif  // THREAD_LEASE_HPP
@@ -0,0 +1,104 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "TlsErrors.hpp"
+
+#include <openssl/err.h>
+
+#include <atomic>
+#include <cstring>
+
+/**
+ * @brief open addressing table of reason -> count, keys are claimed with a
+ *  compare-and-swap and never removed
+ */
+struct ReasonSlot {
+  std::atomic<unsigned long> code{0};
+  std::atomic<uint64_t> count{0};
+};
+static ReasonSlot reasonSlots[kTlsReasonSlots];
+static std::atomic<uint64_t> otherReasons{0};
+
+/**
+ * @brief library and reason only, the same reason raised from different
+ *  places is counted once
+ */
+static unsigned long reasonKey(unsigned long code) {
+  if (ERR_SYSTEM_ERROR(code)) {
+    return ERR_PACK(ERR_LIB_SYS, 0, ERR_GET_REASON(code));
+  }
+  return ERR_PACK(ERR_GET_LIB(code), 0, ERR_GET_REASON(code));
+}
+
+size_t TlsErrorCapture::Drain() noexcept(true) {
+  this->size = this->dropped = 0;
+  const char* file = nullptr;
+  const char* func = nullptr;
+  int line = 0;
+  unsigned long code = 0;
+  while ((code = ERR_get_error_all(&file, &line, &func, nullptr, nullptr)) !=
+         0) {
+    TlsErrorCounters::Count(code);
+    if (this->size < kTlsErrorCapacity) {
+      TlsError& error = this->errors[this->size++];
+      error.code = code;
+      error.file = file;
+      error.func = func;
+      error.line = line;
+    } else {
+      ++this->dropped;
+    }
+  }
+  return this->size + this->dropped;
+}
+
+size_t TlsErrorCapture::Format(char* buffer, size_t capacity) const
+    noexcept(true) {
+  if (capacity == 0) {
+    return 0;
+  }
+  size_t length = 0;
+  buffer[0] = '\0';
+  for (size_t index = 0; index < this->size && length + 1 < capacity;
+       ++index) {
+    if (index > 0 && length + 3 < capacity) {
+      memcpy(buffer + length, "; ", 3);
+      length += 2;
+    }
+    ERR_error_string_n(this->errors[index].code, buffer + length,
+                       capacity - length);
+    length += strlen(buffer + length);
+  }
+  return length;
+}
+
+void TlsErrorCounters::Count(unsigned long code) noexcept(true) {
+  unsigned long key = reasonKey(code);
+  size_t start = key % kTlsReasonSlots;
+  for (size_t probe = 0; probe < kTlsReasonSlots; ++probe) {
+    ReasonSlot& slot = reasonSlots[(start + probe) % kTlsReasonSlots];
+    unsigned long current = slot.code.load(std::memory_order_acquire);
+    if (current == 0 &&
+        slot.code.compare_exchange_strong(current, key,
+                                          std::memory_order_acq_rel)) {
+      current = key;
+    }
+    if (current == key) {
+      slot.count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  otherReasons.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TlsErrorCounters::ForEach(
+    const std::function<void(unsigned long code, uint64_t count)>& visit) {
+  for (ReasonSlot& slot : reasonSlots) {
+    unsigned long code = slot.code.load(std::memory_order_acquire);
+    if (code != 0) {
+      visit(code, slot.count.load(std::memory_order_relaxed));
+    }
+  }
+  uint64_t others = otherReasons.load(std::memory_order_relaxed);
+  if (others > 0) {
+    visit(0, others);
+  }
+}
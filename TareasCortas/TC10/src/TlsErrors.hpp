@@ -0,0 +1,99 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file TlsErrors.hpp
+ * @brief Defines TlsErrorCapture, a copy of the OpenSSL error queue of the
+ * calling thread kept without heap allocation, and TlsErrorCounters, the
+ * process wide number of errors seen per OpenSSL reason.
+ */
+#ifndef TLS_ERRORS_HPP
+#define TLS_ERRORS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+constexpr size_t kTlsErrorCapacity = 8;  ///< entries kept per capture
+constexpr size_t kTlsReasonSlots = 128;  ///< distinct reasons counted
+
+/**
+ * @brief One entry of the OpenSSL error queue
+ */
+struct TlsError {
+  unsigned long code{0};      ///< packed library and reason (ERR_get_error)
+  const char* file{nullptr};  ///< OpenSSL source file that raised it
+  const char* func{nullptr};  ///< OpenSSL function that raised it
+  int line{0};                ///< line in file
+};
+
+/**
+ * @class TlsErrorCapture
+ * @brief The errors of one failed TLS operation, oldest (root cause) first
+ */
+class TlsErrorCapture {
+ public:
+  /**
+   * @brief moves every entry of this thread's OpenSSL error queue into the
+   *  capture, replacing what it held, and counts them in TlsErrorCounters
+   * @details the queue is left empty so stale errors never show up in a
+   *  later operation; entries past kTlsErrorCapacity are only counted
+   * @return number of entries that were in the queue
+   */
+  size_t Drain() noexcept(true);
+  /**
+   * @brief forgets the captured entries
+   */
+  void Clear() noexcept(true) { this->size = this->dropped = 0; }
+  /**
+   * @brief number of entries kept
+   */
+  size_t Size() const noexcept(true) { return this->size; }
+  /**
+   * @brief entries that were drained but did not fit
+   */
+  size_t Dropped() const noexcept(true) { return this->dropped; }
+  /**
+   * @brief the index-th entry, oldest first
+   */
+  const TlsError& operator[](size_t index) const noexcept(true) {
+    return this->errors[index];
+  }
+  /**
+   * @brief code of the oldest entry, 0 if there is none
+   */
+  unsigned long First() const noexcept(true) {
+    return this->size > 0 ? this->errors[0].code : 0;
+  }
+  /**
+   * @brief writes the entries as "error:...; error:..." (ERR_error_string_n,
+   *  thread safe)
+   * @return length written, the text is always nul terminated
+   */
+  size_t Format(char* buffer, size_t capacity) const noexcept(true);
+
+ private:
+  TlsError errors[kTlsErrorCapacity];  ///< oldest first
+  size_t size{0};                      ///< entries in errors
+  size_t dropped{0};                   ///< entries that did not fit
+};
+
+/**
+ * @class TlsErrorCounters
+ * @brief Lock-free counts of the OpenSSL errors drained by any capture, per
+ *  library and reason
+ */
+class TlsErrorCounters {
+ public:
+  /**
+   * @brief counts one error
+   * @param code value of ERR_get_error
+   */
+  static void Count(unsigned long code) noexcept(true);
+  /**
+   * @brief calls visit with every reason seen and its count; reasons that did
+   *  not fit in kTlsReasonSlots are reported together with code 0
+   */
+  static void ForEach(
+      const std::function<void(unsigned long code, uint64_t count)>& visit)
+      noexcept(false);
+};
+#endif  // TLS_ERRORS_HPP
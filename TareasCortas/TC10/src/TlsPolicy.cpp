@@ -0,0 +1,157 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "TlsPolicy.hpp"
+
+#if defined(__aarch64__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#include <cstring>
+
+// TLS 1.3 suites, in both preference orders
+#define SUITES_AES_FIRST                               \
+  "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:" \
+  "TLS_CHACHA20_POLY1305_SHA256"
+#define SUITES_CHACHA_FIRST                                \
+  "TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:" \
+  "TLS_AES_256_GCM_SHA384"
+// TLS 1.2: forward secret AEAD ciphers only
+#define CIPHERS_AES_FIRST                                                \
+  "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"          \
+  "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"          \
+  "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305"
+#define CIPHERS_CHACHA_FIRST                                             \
+  "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"          \
+  "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"          \
+  "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384"
+// X25519 is the cheapest exchange, P-256 what everybody else supports
+#define GROUPS "X25519:P-256:P-384"
+
+bool TlsPolicy::HasAesHardware() noexcept(true) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(__aarch64__)
+  unsigned long features = getauxval(AT_HWCAP);
+  return (features & HWCAP_AES) && (features & HWCAP_PMULL);
+#else
+  return false;
+#endif
+}
+
+TlsPolicy TlsPolicy::Default() {
+  TlsPolicy policy;
+  bool aes = HasAesHardware();
+  policy.cipherSuites = aes ? SUITES_AES_FIRST : SUITES_CHACHA_FIRST;
+  policy.cipherList = aes ? CIPHERS_AES_FIRST : CIPHERS_CHACHA_FIRST;
+  policy.groups = GROUPS;
+  return policy;
+}
+
+bool TlsPolicy::Named(const char* name, TlsPolicy& policy) {
+  TlsPolicy named = Default();
+  if (strcmp(name, "aes") == 0) {
+    named.cipherSuites = SUITES_AES_FIRST;
+    named.cipherList = CIPHERS_AES_FIRST;
+  } else if (strcmp(name, "chacha") == 0) {
+    named.cipherSuites = SUITES_CHACHA_FIRST;
+    named.cipherList = CIPHERS_CHACHA_FIRST;
+  } else if (strcmp(name, "aes128") == 0) {
+    named.cipherSuites = "TLS_AES_128_GCM_SHA256";
+    named.cipherList = "ECDHE-ECDSA-AES128-GCM-SHA256:"
+                       "ECDHE-RSA-AES128-GCM-SHA256";
+  } else if (strcmp(name, "aes256") == 0) {
+    named.cipherSuites = "TLS_AES_256_GCM_SHA384";
+    named.cipherList = "ECDHE-ECDSA-AES256-GCM-SHA384:"
+                       "ECDHE-RSA-AES256-GCM-SHA384";
+  } else if (strcmp(name, "chacha20") == 0) {
+    named.cipherSuites = "TLS_CHACHA20_POLY1305_SHA256";
+    named.cipherList = "ECDHE-ECDSA-CHACHA20-POLY1305:"
+                       "ECDHE-RSA-CHACHA20-POLY1305";
+  } else if (strcmp(name, "tls13") == 0) {
+    named.minVersion = TLS1_3_VERSION;
+  } else if (strcmp(name, "default") != 0) {
+    return false;
+  }
+  policy = named;
+  return true;
+}
+
+/**
+ * @brief the same calls exist for contexts and connections, with SSL_CTX_
+ *  and SSL_ prefixes
+ */
+template <typename Target, typename Setters>
+static bool applyTo(const TlsPolicy& policy, Target* target,
+                    const Setters& set) {
+  if (!set.minVersion(target, policy.minVersion) ||
+      !set.maxVersion(target, policy.maxVersion)) {
+    return false;
+  }
+  if (!policy.cipherSuites.empty() &&
+      !set.cipherSuites(target, policy.cipherSuites.c_str())) {
+    return false;
+  }
+  if (!policy.cipherList.empty() &&
+      !set.cipherList(target, policy.cipherList.c_str())) {
+    return false;
+  }
+  if (!policy.groups.empty() && !set.groups(target, policy.groups.c_str())) {
+    return false;
+  }
+  const uint64_t preference =
+      SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_PRIORITIZE_CHACHA;
+  if (policy.serverPreference) {
+    set.options(target, preference);
+  } else {
+    set.clearOptions(target, preference);
+  }
+  return true;
+}
+
+bool TlsPolicy::Apply(SSL_CTX* context) const noexcept(true) {
+  struct {
+    int minVersion(SSL_CTX* c, int v) const {
+      return SSL_CTX_set_min_proto_version(c, v);
+    }
+    int maxVersion(SSL_CTX* c, int v) const {
+      return SSL_CTX_set_max_proto_version(c, v);
+    }
+    int cipherSuites(SSL_CTX* c, const char* s) const {
+      return SSL_CTX_set_ciphersuites(c, s);
+    }
+    int cipherList(SSL_CTX* c, const char* s) const {
+      return SSL_CTX_set_cipher_list(c, s);
+    }
+    int groups(SSL_CTX* c, const char* s) const {
+      return SSL_CTX_set1_groups_list(c, s);
+    }
+    void options(SSL_CTX* c, uint64_t o) const { SSL_CTX_set_options(c, o); }
+    void clearOptions(SSL_CTX* c, uint64_t o) const {
+      SSL_CTX_clear_options(c, o);
+    }
+  } setters;
+  return applyTo(*this, context, setters);
+}
+
+bool TlsPolicy::Apply(SSL* ssl) const noexcept(true) {
+  struct {
+    int minVersion(SSL* s, int v) const {
+      return SSL_set_min_proto_version(s, v);
+    }
+    int maxVersion(SSL* s, int v) const {
+      return SSL_set_max_proto_version(s, v);
+    }
+    int cipherSuites(SSL* s, const char* l) const {
+      return SSL_set_ciphersuites(s, l);
+    }
+    int cipherList(SSL* s, const char* l) const {
+      return SSL_set_cipher_list(s, l);
+    }
+    int groups(SSL* s, const char* l) const {
+      return SSL_set1_groups_list(s, l);
+    }
+    void options(SSL* s, uint64_t o) const { SSL_set_options(s, o); }
+    void clearOptions(SSL* s, uint64_t o) const { SSL_clear_options(s, o); }
+  } setters;
+  return applyTo(*this, ssl, setters);
+}
@@ -0,0 +1,59 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file TlsPolicy.hpp
+ * @brief Defines TlsPolicy, the protocol versions, cipher suites and key
+ * exchange groups a TLS context or connection accepts, with defaults chosen
+ * by what the CPU accelerates.
+ */
+#ifndef TLS_POLICY_HPP
+#define TLS_POLICY_HPP
+
+#include <openssl/ssl.h>
+
+#include <string>
+
+/**
+ * @class TlsPolicy
+ * @brief What to negotiate. Empty strings keep the OpenSSL defaults.
+ * @details AES-GCM is the fastest AEAD with AES-NI and carry-less multiply
+ *  (x86) or the ARMv8 crypto extensions; without them ChaCha20-Poly1305 is
+ *  several times faster, so Default() puts it first. With server
+ *  preference on, the server's order decides, except that a client listing
+ *  ChaCha20 first (phones without AES hardware) still gets it.
+ */
+class TlsPolicy {
+ public:
+  int minVersion{TLS1_2_VERSION};  ///< TLS1_2_VERSION or TLS1_3_VERSION
+  int maxVersion{0};               ///< 0 for the highest supported
+  std::string cipherSuites;        ///< TLS 1.3 suites, SSL_set_ciphersuites
+  std::string cipherList;          ///< TLS 1.2 ciphers, SSL_set_cipher_list
+  std::string groups;              ///< key exchange groups, by preference
+  bool serverPreference{true};     ///< the server's order wins
+
+  /**
+   * @brief AES-GCM first if the CPU accelerates it, ChaCha20 first if not
+   */
+  static TlsPolicy Default() noexcept(false);
+  /**
+   * @brief a named policy: "default", "aes" (AES-GCM first), "chacha"
+   *  (ChaCha20 first), "aes128", "aes256" or "chacha20" (that suite only),
+   *  "tls13" (default suites, TLS 1.3 only)
+   * @return false if name is unknown, policy is left unchanged
+   */
+  static bool Named(const char* name, TlsPolicy& policy) noexcept(false);
+  /**
+   * @brief true if the CPU has AES and carry-less multiply instructions
+   */
+  static bool HasAesHardware() noexcept(true);
+  /**
+   * @brief sets the policy on a context, for the connections created later
+   * @return false if OpenSSL rejected part of it (see its error queue)
+   */
+  bool Apply(SSL_CTX* context) const noexcept(true);
+  /**
+   * @brief sets the policy on one connection, before its handshake
+   * @return false if OpenSSL rejected part of it (see its error queue)
+   */
+  bool Apply(SSL* ssl) const noexcept(true);
+};
+#endif  // TLS_POLICY_HPP
@@ -0,0 +1,173 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "Trace.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "ThreadLease.hpp"
+
+static const char* const kPhaseNames[] = {
+    "Accept",  "SSLCreate", "SSLAccept", "SSLRead",
+    "Handler", "SSLWrite",  "Close",
+};
+static_assert(sizeof(kPhaseNames) / sizeof(kPhaseNames[0]) ==
+                  static_cast<size_t>(TracePhase::kCount),
+              "one name per phase");
+
+/**
+ * @brief one event: start and end timestamps, then connection, thread and
+ *  phase packed as 32, 24 and 8 bits. Relaxed atomics, so a dump running
+ *  next to the writer is not a data race.
+ */
+struct TraceSlot {
+  std::atomic<uint64_t> start{0};
+  std::atomic<uint64_t> end{0};
+  std::atomic<uint64_t> tag{0};
+};
+
+/**
+ * @brief events of the threads that lease it, one writer at a time
+ */
+struct alignas(64) TraceRing {
+  std::atomic<bool> leased{false};
+  std::atomic<uint64_t> head{0};  ///< events ever written
+  TraceSlot slots[kTraceRingCapacity];
+};
+static TraceRing rings[kTraceRings];
+static std::atomic<uint64_t> dropped{0};
+
+/**
+ * @brief TraceClock and CLOCK_MONOTONIC read together at startup, to
+ *  convert TSC ticks to time when dumping
+ */
+struct TraceEpoch {
+  uint64_t ticks{TraceClock()};
+  std::chrono::steady_clock::time_point time{std::chrono::steady_clock::now()};
+};
+static const TraceEpoch epoch;
+
+static thread_local TraceRing* threadRing = nullptr;
+static thread_local uint64_t threadId = 0;   ///< 0 until a ring is leased
+static thread_local bool threadHasNoRing = false;
+
+/**
+ * @brief the thread is exiting: later events are dropped
+ */
+static void leaveRing() noexcept {
+  threadRing = nullptr;
+  threadHasNoRing = true;
+}
+
+/**
+ * @brief leases a free ring to the calling thread
+ * @return nullptr if every ring is taken
+ */
+static TraceRing* leaseRing() noexcept(true) {
+  threadId = static_cast<uint64_t>(syscall(SYS_gettid)) & 0xffffff;
+  threadRing = ThreadLease<TraceRing>::Acquire(rings, leaveRing);
+  threadHasNoRing = threadRing == nullptr;
+  return threadRing;
+}
+
+void Tracer::Record(TracePhase phase, uint32_t connection, uint64_t start,
+                    uint64_t end) noexcept(true) {
+  TraceRing* ring = threadRing;
+  if (__builtin_expect(ring == nullptr, 0)) {
+    ring = threadHasNoRing ? nullptr : leaseRing();
+    if (ring == nullptr) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  uint64_t index = ring->head.load(std::memory_order_relaxed);
+  TraceSlot& slot = ring->slots[index % kTraceRingCapacity];
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.end.store(end, std::memory_order_relaxed);
+  slot.tag.store(static_cast<uint64_t>(connection) << 32 | threadId << 8 |
+                     static_cast<uint64_t>(phase),
+                 std::memory_order_relaxed);
+  // publishes the event
+  ring->head.store(index + 1, std::memory_order_release);
+}
+
+uint64_t Tracer::Dropped() noexcept(true) {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief nanoseconds per TraceClock tick
+ */
+static double nanosecondsPerTick() noexcept(true) {
+#if defined(__x86_64__) || defined(__i386__)
+  // a short wait if called right after startup, so the ratio is precise
+  if (std::chrono::steady_clock::now() - epoch.time <
+      std::chrono::milliseconds(10)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  uint64_t ticks = TraceClock();
+  std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(time - epoch.time).count() /
+         static_cast<double>(ticks - epoch.ticks);
+#else
+  return 1.0;
+#endif
+}
+
+std::string Tracer::ChromeJson() {
+  double scale = nanosecondsPerTick() / 1000.0;  // ticks to microseconds
+  std::string json = "{\"traceEvents\":[";
+  char event[256];
+  bool first = true;
+  std::vector<TraceSlot> copy(kTraceRingCapacity);
+  for (TraceRing& ring : rings) {
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t begin = head > kTraceRingCapacity ? head - kTraceRingCapacity : 0;
+    for (uint64_t index = begin; index < head; ++index) {
+      const TraceSlot& slot = ring.slots[index % kTraceRingCapacity];
+      TraceSlot& saved = copy[index % kTraceRingCapacity];
+      saved.start.store(slot.start.load(std::memory_order_relaxed));
+      saved.end.store(slot.end.load(std::memory_order_relaxed));
+      saved.tag.store(slot.tag.load(std::memory_order_relaxed));
+    }
+    // events the writer reached while they were copied may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t headNow = ring.head.load(std::memory_order_relaxed);
+    if (headNow >= kTraceRingCapacity && headNow - kTraceRingCapacity + 1 >
+                                             begin) {
+      begin = headNow - kTraceRingCapacity + 1;
+    }
+    for (uint64_t index = begin; index < head; ++index) {
+      const TraceSlot& slot = copy[index % kTraceRingCapacity];
+      uint64_t start = slot.start.load(std::memory_order_relaxed);
+      uint64_t end = slot.end.load(std::memory_order_relaxed);
+      uint64_t tag = slot.tag.load(std::memory_order_relaxed);
+      size_t phase = tag & 0xff;
+      if (phase >= static_cast<size_t>(TracePhase::kCount)) {
+        continue;
+      }
+      snprintf(event, sizeof(event),
+               "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%lu,"
+               "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"connection\":%lu}}",
+               first ? "" : ",", kPhaseNames[phase], static_cast<int>(getpid()),
+               static_cast<unsigned long>(tag >> 8 & 0xffffff),
+               static_cast<double>(start - epoch.ticks) * scale,
+               static_cast<double>(end - start) * scale,
+               static_cast<unsigned long>(tag >> 32));
+      json += event;
+      first = false;
+    }
+  }
+  snprintf(event, sizeof(event),
+           "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"enabled\":%s,"
+           "\"dropped\":%lu}}\n",
+           Enabled() ? "true" : "false",
+           static_cast<unsigned long>(Dropped()));
+  json += event;
+  return json;
+}
@@ -0,0 +1,124 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file Trace.hpp
+ * @brief Defines the connection lifecycle tracer: every phase of a
+ * connection (accept, SSL creation, handshake, reads, handler, writes,
+ * close) is timestamped into a per-thread ring buffer and can be dumped as
+ * Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+ * @details The TRACE_PHASE macro is compiled only with -DSOCKET_TRACE
+ * ("make clean trace"), without it tracing costs nothing.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <time.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+constexpr size_t kTraceRings = 64;           ///< threads tracing at once
+constexpr size_t kTraceRingCapacity = 4096;  ///< events kept per ring
+
+/**
+ * @brief Phases of a connection, in the order they happen
+ */
+enum class TracePhase : uint8_t {
+  kAccept,     ///< blocked in accept, includes waiting for the client
+  kSslCreate,  ///< SSL structure created for the connection
+  kSslAccept,  ///< TLS handshake
+  kSslRead,    ///< one SSLRead, the first one gives the first request byte
+  kHandler,    ///< requests parsed and answered, without I/O
+  kSslWrite,   ///< one SSLWrite
+  kClose,      ///< close_notify and close
+  kCount       ///< number of phases, not a phase
+};
+
+/**
+ * @brief cheap timestamp: the TSC on x86 (converted to time when dumping,
+ *  assumes an invariant TSC as in every x86 CPU since ~2008), nanoseconds of
+ *  CLOCK_MONOTONIC elsewhere
+ */
+inline uint64_t TraceClock() noexcept(true) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+#endif
+}
+
+/**
+ * @class Tracer
+ * @brief Per-thread lock-free rings of trace events
+ * @details a thread leases a ring the first time it records and gives it
+ *  back when it exits; the next thread keeps appending to it, so events of
+ *  finished connections stay until they are overwritten. Each ring has one
+ *  writer, which stores the event and then publishes it by advancing the
+ *  ring's head. Threads that find every ring taken drop their events.
+ */
+class Tracer {
+ public:
+  /**
+   * @brief appends one event to the calling thread's ring
+   * @param start value of TraceClock when the phase started
+   * @param end value of TraceClock when the phase ended
+   */
+  static void Record(TracePhase phase, uint32_t connection, uint64_t start,
+                     uint64_t end) noexcept(true);
+  /**
+   * @brief every event kept, oldest first per thread, in Chrome trace-event
+   *  format; events overwritten while dumping are left out
+   */
+  static std::string ChromeJson() noexcept(false);
+  /**
+   * @brief events dropped because every ring was taken
+   */
+  static uint64_t Dropped() noexcept(true);
+  /**
+   * @brief true if the server was built with tracing
+   */
+  static constexpr bool Enabled() noexcept(true) {
+#ifdef SOCKET_TRACE
+    return true;
+#else
+    return false;
+#endif
+  }
+};
+
+/**
+ * @class TraceScope
+ * @brief Records the phase from construction to destruction
+ */
+class TraceScope {
+ public:
+  TraceScope(TracePhase phase, uint32_t connection) noexcept(true)
+      : phase(phase), connection(connection), start(TraceClock()) {}
+  ~TraceScope() {
+    Tracer::Record(this->phase, this->connection, this->start, TraceClock());
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  TracePhase phase;     ///< what is being timed
+  uint32_t connection;  ///< connection number given by the server
+  uint64_t start;       ///< TraceClock at construction
+};
+
+#define TRACE_JOIN(left, right) left##right
+#define TRACE_NAME(line) TRACE_JOIN(traceScope, line)
+#ifdef SOCKET_TRACE
+/// times the rest of the enclosing block as phase (a TracePhase enumerator)
+#define TRACE_PHASE(phase, connection) \
+  TraceScope TRACE_NAME(__LINE__)(TracePhase::phase, connection)
+#else
+#define TRACE_PHASE(phase, connection) static_cast<void>(connection)
+#endif
+#endif  // TRACE_HPP
@@ -0,0 +1,50 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "UnixAddress.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include "SocketException.hpp"
+
+/// bytes of sockaddr_un before sun_path
+static constexpr socklen_t kPathOffset = offsetof(sockaddr_un, sun_path);
+
+UnixAddress::UnixAddress() noexcept(true) : length(sizeof(sockaddr_un)) {
+  memset(&this->address, 0, sizeof(this->address));
+  this->address.sun_family = AF_UNIX;
+}
+
+UnixAddress::UnixAddress(const std::string& name) : UnixAddress() {
+  // a path keeps its terminating '\0', an abstract name is exactly its bytes
+  // after the leading '\0' that replaces the '@'
+  bool abstract = !name.empty() && name[0] == '@';
+  size_t bytes = abstract ? name.size() : name.size() + 1;
+  if (name.empty() || bytes > sizeof(this->address.sun_path)) {
+    throw SocketException("Invalid Unix socket name", "UnixAddress",
+                          name.empty() ? EINVAL : ENAMETOOLONG, false);
+  }
+  memcpy(this->address.sun_path, name.c_str(), bytes);
+  if (abstract) {
+    this->address.sun_path[0] = '\0';
+  }
+  this->length = kPathOffset + bytes;
+}
+
+bool UnixAddress::Abstract() const noexcept(true) {
+  return this->length > kPathOffset && this->address.sun_path[0] == '\0';
+}
+
+std::string UnixAddress::Name() const noexcept(false) {
+  if (this->length <= kPathOffset) {
+    return std::string();
+  }
+  size_t bytes = this->length - kPathOffset;
+  if (this->Abstract()) {
+    std::string name(1, '@');
+    name.append(this->address.sun_path + 1, bytes - 1);
+    return name;
+  }
+  return std::string(this->address.sun_path,
+                     strnlen(this->address.sun_path, bytes));
+}
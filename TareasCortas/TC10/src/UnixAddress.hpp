@@ -0,0 +1,74 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file UnixAddress.hpp
+ * @brief Defines UnixAddress, the address of an AF_UNIX socket: a path in
+ * the file system or a name in Linux's abstract namespace.
+ */
+#ifndef UNIX_ADDRESS_HPP
+#define UNIX_ADDRESS_HPP
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+
+/**
+ * @brief tag of the Socket constructor that builds an active AF_UNIX socket
+ */
+struct UnixDomain {};
+inline constexpr UnixDomain kUnixDomain{};
+
+/**
+ * @class UnixAddress
+ * @brief A sockaddr_un and its length.
+ * @details a name that starts with '@' is abstract (as ss and systemd show
+ *  them): it lives only while a socket is bound to it, needs no file and no
+ *  cleanup, and is visible to the processes of the same network namespace.
+ *  Any other name is a path; binding creates the socket file.
+ */
+class UnixAddress {
+ public:
+  /**
+   * @brief empty address, e.g. to be filled by Socket::recvFrom
+   */
+  UnixAddress() noexcept(true);
+  /**
+   * @brief address of name, "@name" for the abstract namespace
+   * @throws SocketException ENAMETOOLONG if it doesn't fit in sun_path
+   *  (107 bytes for a path, 106 for an abstract name)
+   */
+  explicit UnixAddress(const std::string& name) noexcept(false);
+  /**
+   * @brief true for an abstract name
+   */
+  bool Abstract() const noexcept(true);
+  /**
+   * @brief the name as given to the constructor, "@name" if abstract, empty
+   *  for an unbound peer
+   * @throws std::bad_alloc if there is no memory for the string
+   */
+  std::string Name() const noexcept(false);
+  const sockaddr* Data() const noexcept(true) {
+    return reinterpret_cast<const sockaddr*>(&this->address);
+  }
+  sockaddr* Data() noexcept(true) {
+    return reinterpret_cast<sockaddr*>(&this->address);
+  }
+  /**
+   * @brief bytes of Data in use, what bind, connect and sendto take
+   */
+  socklen_t Length() const noexcept(true) { return this->length; }
+  /**
+   * @brief for recvfrom and accept: capacity before, bytes used after
+   */
+  socklen_t* LengthPointer() noexcept(true) { return &this->length; }
+  /**
+   * @brief capacity of Data
+   */
+  static socklen_t Capacity() noexcept(true) { return sizeof(sockaddr_un); }
+
+ private:
+  sockaddr_un address;  ///< sun_path[0] is '\0' for an abstract name
+  socklen_t length;     ///< family plus the bytes of the name
+};
+#endif  // UNIX_ADDRESS_HPP
@@ -0,0 +1,306 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+#include "XmlParser.hpp"
+
+#include <cstring>
+
+static bool isSpace(char byte) {
+  return byte == ' ' || byte == '\t' || byte == '\n' || byte == '\r';
+}
+
+static bool isNameChar(char byte) {
+  return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') ||
+         (byte >= '0' && byte <= '9') || byte == '_' || byte == '-' ||
+         byte == '.' || byte == ':' || static_cast<unsigned char>(byte) >= 0x80;
+}
+
+XmlParser::XmlParser(XmlHandler* handler) noexcept(true) : handler(handler) {}
+
+void XmlParser::Reset() noexcept(true) {
+  this->state = State::kText;
+  this->nameLength = 0;
+  this->textLength = 0;
+  this->textTruncated = false;
+  this->hasChildren = false;
+  this->entityLength = 0;
+  this->depth = 0;
+  this->quote = 0;
+  this->previous = 0;
+  this->dashes = 0;
+  this->error = nullptr;
+}
+
+bool XmlParser::Feed(const char* data, size_t size) noexcept(true) {
+  size_t index = 0;
+  while (index < size && this->state != State::kDone) {
+    if (this->state == State::kError) {
+      return false;
+    }
+    if (this->state == State::kText && this->textLength > 0) {
+      // copy plain character data up to the next markup in one go
+      size_t end = index;
+      while (end < size && data[end] != '<' && data[end] != '&') {
+        ++end;
+      }
+      size_t room = kXmlTextCapacity - this->textLength;
+      size_t run = end - index;
+      if (run > room) {
+        this->textTruncated = true;
+        run = room;
+      }
+      memcpy(this->text + this->textLength, data + index, run);
+      this->textLength += run;
+      index = end;
+      if (index == size) {
+        break;
+      }
+    }
+    this->step(data[index++]);
+  }
+  return this->state != State::kError;
+}
+
+void XmlParser::step(char byte) noexcept(true) {
+  switch (this->state) {
+    case State::kText:
+      if (byte == '<') {
+        this->state = State::kTagStart;
+      } else if (byte == '&') {
+        this->entityLength = 0;
+        this->state = State::kEntity;
+      } else {
+        this->appendText(byte);
+      }
+      break;
+    case State::kEntity:
+      if (byte == ';') {
+        this->state = State::kText;
+        this->decodeEntity();
+      } else if (this->entityLength == sizeof(this->entity)) {
+        this->fail("Entity too long");
+      } else {
+        this->entity[this->entityLength++] = byte;
+      }
+      break;
+    case State::kTagStart:
+      this->nameLength = 0;
+      if (byte == '/') {
+        this->state = State::kEndTag;
+      } else if (byte == '?') {
+        this->previous = 0;
+        this->state = State::kProcessing;
+      } else if (byte == '!') {
+        this->dashes = 0;
+        this->state = State::kBang;
+      } else if (isNameChar(byte)) {
+        this->name[this->nameLength++] = byte;
+        this->state = State::kStartTag;
+      } else {
+        this->fail("Invalid character after '<'");
+      }
+      break;
+    case State::kStartTag:
+      if (isNameChar(byte)) {
+        if (this->nameLength == kXmlNameCapacity) {
+          this->fail("Element name too long");
+        } else {
+          this->name[this->nameLength++] = byte;
+        }
+        break;
+      }
+      this->quote = 0;
+      this->previous = 0;
+      this->state = State::kAttributes;
+      [[fallthrough]];
+    case State::kAttributes:
+      if (this->quote != 0) {
+        if (byte == this->quote) {
+          this->quote = 0;
+          this->previous = byte;
+        }
+      } else if (byte == '"' || byte == '\'') {
+        this->quote = byte;
+      } else if (byte == '>') {
+        this->openElement();
+        if (this->previous == '/' && this->state != State::kError) {
+          this->closeElement();
+        }
+      } else if (!isSpace(byte)) {
+        this->previous = byte;
+      }
+      break;
+    case State::kEndTag:
+      if (isNameChar(byte)) {
+        if (this->nameLength == kXmlNameCapacity) {
+          this->fail("Element name too long");
+        } else {
+          this->name[this->nameLength++] = byte;
+        }
+      } else if (byte == '>' && this->nameLength > 0) {
+        this->closeElement();
+      } else if (isSpace(byte) && this->nameLength > 0) {
+        this->state = State::kEndTagSpace;
+      } else {
+        this->fail("Invalid end tag");
+      }
+      break;
+    case State::kEndTagSpace:
+      if (byte == '>') {
+        this->closeElement();
+      } else if (!isSpace(byte)) {
+        this->fail("Invalid end tag");
+      }
+      break;
+    case State::kBang:
+      if (byte == '-') {
+        if (++this->dashes == 2) {
+          this->dashes = 0;
+          this->state = State::kComment;
+        }
+      } else if (this->dashes > 0 || byte == '[') {
+        this->fail("CDATA sections are not supported");
+      } else {
+        this->state = byte == '>' ? State::kText : State::kDeclaration;
+      }
+      break;
+    case State::kComment:
+      if (byte == '>' && this->dashes >= 2) {
+        this->state = State::kText;
+      }
+      this->dashes = byte == '-' ? this->dashes + 1 : 0;
+      break;
+    case State::kDeclaration:
+      if (byte == '>') {
+        this->state = State::kText;
+      }
+      break;
+    case State::kProcessing:
+      if (byte == '>' && this->previous == '?') {
+        this->state = State::kText;
+      }
+      this->previous = byte;
+      break;
+    case State::kDone:
+    case State::kError:
+      break;
+  }
+}
+
+void XmlParser::appendText(char byte) noexcept(true) {
+  if (this->depth == 0) {
+    if (!isSpace(byte)) {
+      this->fail("Text outside the root element");
+    }
+  } else if (this->textLength == 0 && isSpace(byte)) {
+    // leading whitespace is trimmed
+  } else if (this->textLength < kXmlTextCapacity) {
+    this->text[this->textLength++] = byte;
+  } else {
+    this->textTruncated = true;
+  }
+}
+
+void XmlParser::decodeEntity() noexcept(true) {
+  std::string_view name(this->entity, this->entityLength);
+  if (name == "lt") {
+    this->appendText('<');
+  } else if (name == "gt") {
+    this->appendText('>');
+  } else if (name == "amp") {
+    this->appendText('&');
+  } else if (name == "quot") {
+    this->appendText('"');
+  } else if (name == "apos") {
+    this->appendText('\'');
+  } else if (name.size() > 1 && name[0] == '#') {
+    bool hex = name[1] == 'x';
+    size_t index = hex ? 2 : 1;
+    uint32_t code = 0;
+    if (index == name.size()) {
+      this->fail("Invalid character reference");
+      return;
+    }
+    for (; index < name.size() && code <= 0x10ffff; ++index) {
+      char digit = name[index];
+      if (digit >= '0' && digit <= '9') {
+        code = code * (hex ? 16 : 10) + (digit - '0');
+      } else if (hex && (digit | 0x20) >= 'a' && (digit | 0x20) <= 'f') {
+        code = code * 16 + ((digit | 0x20) - 'a' + 10);
+      } else {
+        code = 0x110000;
+      }
+    }
+    if (code == 0 || code > 0x10ffff) {
+      this->fail("Invalid character reference");
+      return;
+    }
+    // UTF-8
+    if (code < 0x80) {
+      this->appendText(static_cast<char>(code));
+    } else if (code < 0x800) {
+      this->appendText(static_cast<char>(0xc0 | (code >> 6)));
+      this->appendText(static_cast<char>(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+      this->appendText(static_cast<char>(0xe0 | (code >> 12)));
+      this->appendText(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      this->appendText(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+      this->appendText(static_cast<char>(0xf0 | (code >> 18)));
+      this->appendText(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+      this->appendText(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      this->appendText(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+  } else {
+    this->fail("Unknown entity");
+  }
+}
+
+void XmlParser::openElement() noexcept(true) {
+  if (this->depth == kXmlMaxDepth) {
+    this->fail("Elements nested too deep");
+    return;
+  }
+  this->stack[this->depth++] = this->nameHash();
+  this->handler->StartElement(std::string_view(this->name, this->nameLength));
+  this->textLength = 0;
+  this->textTruncated = false;
+  this->hasChildren = false;
+  this->state = State::kText;
+}
+
+void XmlParser::closeElement() noexcept(true) {
+  if (this->depth == 0 || this->stack[this->depth - 1] != this->nameHash()) {
+    this->fail("End tag does not match the open element");
+    return;
+  }
+  --this->depth;
+  while (this->textLength > 0 && isSpace(this->text[this->textLength - 1])) {
+    --this->textLength;
+  }
+  std::string_view value;
+  if (!this->hasChildren) {
+    value = std::string_view(this->text, this->textLength);
+  }
+  this->handler->EndElement(std::string_view(this->name, this->nameLength),
+                            value, this->textTruncated && !this->hasChildren);
+  this->textLength = 0;
+  this->textTruncated = false;
+  this->hasChildren = true;
+  this->state = this->depth == 0 ? State::kDone : State::kText;
+}
+
+void XmlParser::fail(const char* message) noexcept(true) {
+  if (this->error == nullptr) {
+    this->error = message;
+  }
+  this->state = State::kError;
+}
+
+uint64_t XmlParser::nameHash() const noexcept(true) {
+  // FNV-1a, also mixes the length so a prefix never matches
+  uint64_t hash = 14695981039346656037ull ^ this->nameLength;
+  for (size_t index = 0; index < this->nameLength; ++index) {
+    hash ^= static_cast<unsigned char>(this->name[index]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
@@ -0,0 +1,150 @@
+// Copyright 2023 Antonio Badilla Olivas <anthonny.badilla@ucr.ac.cr>.
+/**
+ * @file XmlParser.hpp
+ * @brief Defines an incremental, allocation-free XML tokenizer (SAX style)
+ * that can be fed the pieces returned by successive SSLRead calls.
+ */
+#ifndef XML_PARSER_HPP
+#define XML_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+constexpr size_t kXmlNameCapacity = 64;    ///< longest element name
+constexpr size_t kXmlTextCapacity = 1024;  ///< text kept per element
+constexpr size_t kXmlMaxDepth = 32;        ///< deepest nesting accepted
+
+/**
+ * @class XmlHandler
+ * @brief Receives the events of an XmlParser. The views are only valid
+ *  during the call, copy what must be kept.
+ */
+class XmlHandler {
+ public:
+  virtual ~XmlHandler() = default;
+  /**
+   * @brief an element was opened
+   * @param name element name
+   */
+  virtual void StartElement(std::string_view name) { (void)name; }
+  /**
+   * @brief an element was closed
+   * @param name element name
+   * @param text character data directly inside the element (entities
+   *  decoded, surrounding whitespace trimmed), empty if it had child elements
+   * @param truncated true if the text was longer than kXmlTextCapacity, in
+   *  that case text holds its first kXmlTextCapacity bytes
+   */
+  virtual void EndElement(std::string_view name, std::string_view text,
+                          bool truncated) {
+    (void)name, (void)text, (void)truncated;
+  }
+};
+
+/**
+ * @class XmlParser
+ * @brief Tokenizes a document as its bytes arrive, a byte at a time if need
+ *  be. Only the current element name and text are buffered, in fixed arrays,
+ *  so a field split between two reads is still delivered whole.
+ * @details Supports elements, empty elements, attributes (skipped), the five
+ *  predefined entities and character references, comments, processing
+ *  instructions and declarations (skipped). Parsing stops, successfully,
+ *  when the root element is closed.
+ */
+class XmlParser {
+ public:
+  /**
+   * @brief Constructor for XmlParser
+   * @param handler receives the events, it must outlive the parser
+   */
+  explicit XmlParser(XmlHandler* handler) noexcept(true);
+  /**
+   * @brief parses the next piece of the document
+   * @param data next bytes, they are not referenced after the call
+   * @param size number of bytes
+   * @return false if the document is malformed (see Error())
+   */
+  bool Feed(const char* data, size_t size) noexcept(true);
+  /**
+   * @brief true once the root element has been closed
+   */
+  bool Done() const noexcept(true) { return this->state == State::kDone; }
+  /**
+   * @brief description of the first error, nullptr if there is none
+   */
+  const char* Error() const noexcept(true) { return this->error; }
+  /**
+   * @brief starts a new document with the same handler
+   */
+  void Reset() noexcept(true);
+
+ private:
+  enum class State {
+    kText,         ///< character data
+    kEntity,       ///< after '&' in character data
+    kTagStart,     ///< after '<'
+    kStartTag,     ///< element name of a start tag
+    kAttributes,   ///< after the name of a start tag, until '>'
+    kEndTag,       ///< element name of an end tag
+    kEndTagSpace,  ///< whitespace after the name of an end tag
+    kBang,         ///< after "<!"
+    kComment,      ///< inside "<!--", until "-->"
+    kDeclaration,  ///< inside "<!...", until '>'
+    kProcessing,   ///< inside "<?", until "?>"
+    kDone,         ///< root element closed
+    kError         ///< malformed document
+  };
+  XmlHandler* handler{nullptr};  ///< receives the events
+  State state{State::kText};     ///< where in the grammar the parser is
+  char name[kXmlNameCapacity];   ///< current element name
+  size_t nameLength{0};          ///< bytes in name
+  char text[kXmlTextCapacity];   ///< text of the current element
+  size_t textLength{0};          ///< bytes in text
+  bool textTruncated{false};     ///< true if text did not fit
+  bool hasChildren{false};       ///< current element had child elements
+  char entity[12];               ///< entity name being read
+  size_t entityLength{0};        ///< bytes in entity
+  uint64_t stack[kXmlMaxDepth];  ///< name hashes of the open elements
+  size_t depth{0};               ///< open elements
+  char quote{0};                 ///< quote of the attribute value being read
+  char previous{0};              ///< previous byte, for "/>", "-->" and "?>"
+  int dashes{0};                 ///< consecutive '-' in a comment
+  const char* error{nullptr};    ///< first error
+  /**
+   * @private
+   * @brief processes one byte
+   */
+  void step(char byte) noexcept(true);
+  /**
+   * @private
+   * @brief appends decoded character data to the current text
+   */
+  void appendText(char byte) noexcept(true);
+  /**
+   * @private
+   * @brief decodes the entity just read and appends it to the text
+   */
+  void decodeEntity() noexcept(true);
+  /**
+   * @private
+   * @brief start tag complete, notifies and pushes the element
+   */
+  void openElement() noexcept(true);
+  /**
+   * @private
+   * @brief end tag (or "/>") complete, checks nesting and notifies
+   */
+  void closeElement() noexcept(true);
+  /**
+   * @private
+   * @brief moves to the error state
+   */
+  void fail(const char* message) noexcept(true);
+  /**
+   * @private
+   * @brief hash of the current element name
+   */
+  uint64_t nameHash() const noexcept(true);
+};
+#endif  // XML_PARSER_HPP
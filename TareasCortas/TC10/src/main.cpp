@@ -5,15 +5,55 @@
  *   Socket client/server example with threads
  *
  **/
+#include <signal.h>    // signal
+#include <sys/stat.h>  // stat
+
 #include <cstdio>   // printf
 #include <cstdlib>  // atoi
 #include <cstring>  // strlen, strcmp
+#include <memory>   // unique_ptr
 #include <thread>
 
+#include "CertificateReloader.hpp"
+#include "FigureIndex.hpp"
+#include "FigureServer.hpp"
+#include "Logger.hpp"
+#include "LoginProtocol.hpp"
+#include "MetricsEndpoint.hpp"
+#include "PageCache.hpp"
+#include "SlabAllocator.hpp"
 #include "Socket.hpp"
+#include "XmlParser.hpp"
 
 #define PORT 8080
 
+/**
+ * Answers a login sent as a binary frame (see LoginProtocol.hpp), the first
+ * bytes of the frame were already read while telling it from XML
+ **/
+void BinaryService(Socket* client, const char* received, int bytes) {
+  FrameChannel channel(client, true);
+  channel.Preload(received, bytes);
+  FrameReader reader = channel.Receive();
+  LoginRequest request;
+  LoginResponse response;
+  if (LoginRequest::Decode(reader, request) && request.userName == "piro" &&
+      request.password == "ci0123") {
+    response.status = 0;
+    response.server = "os.ecci.ucr.ac.cr";
+    response.dir = "ci0123";
+    response.name = "Proyecto Integrador Redes y sistemas Operativos";
+    response.nickName = "PIRO";
+    response.description =
+        "Consolidar e integrar los conocimientos de redes y sistemas "
+        "operativos";
+    response.author = "profesores PIRO";
+  }
+  char frame[1024];
+  size_t size = response.Encode(frame, sizeof(frame));
+  channel.Send(frame, size);
+}
+
 void Service(Socket* client) {
   char buf[1024] = {0};
   int bytes;
@@ -25,39 +65,62 @@ void Service(Socket* client) {
 \t<NickName>PIRO</NickName>\n\
 \t<Description>Consolidar e integrar los conocimientos de redes y sistemas operativos</Description>\n\
 \t<Author>profesores PIRO</Author>\n\
-</Body>\n";
-  const char* validMessage =
-      "\n<Body>\n\
-\t<UserName>piro</UserName>\n\
-\t<Password>ci0123</Password>\n\
 </Body>\n";
   try {
     client->SSLAccept();
     client->SSLShowCerts();
-    bytes = client->SSLRead(buf, sizeof(buf));
+    bytes = client->SSLRead(buf, sizeof(buf) - 1);
     buf[bytes] = '\0';
-    printf("Client msg: \"%s\"\n", buf);
-
-    if (!strcmp(validMessage, buf)) {
-      client->SSLWrite(ServerResponse, strlen(ServerResponse));
+    if (bytes > 0 && buf[0] == '\0') {
+      // a binary frame always starts with a 0 byte, XML never does
+      BinaryService(client, buf, bytes);
     } else {
-      client->SSLWrite("Invalid Message", strlen("Invalid Message"));
+      // the login may arrive in several reads, it is parsed as it comes
+      LoginXmlHandler login;
+      XmlParser parser(&login);
+      while (bytes > 0) {
+        Logger::Info("Client msg: \"%s\"", buf);
+        if (!parser.Feed(buf, bytes) || parser.Done()) {
+          break;
+        }
+        bytes = client->SSLRead(buf, sizeof(buf) - 1);
+        buf[bytes > 0 ? bytes : 0] = '\0';
+      }
+      LoginRequest request = login.Request();
+      if (parser.Done() && login.Complete() && request.userName == "piro" &&
+          request.password == "ci0123") {
+        client->SSLWrite(ServerResponse, strlen(ServerResponse));
+      } else {
+        client->SSLWrite("Invalid Message", strlen("Invalid Message"));
+      }
     }
     client->Close();
     delete client;
   } catch (const std::exception& e) {
-    std::cerr << "Server error: " << e.what() << std::endl;
+    Logger::Error("Server error: %s", e.what());
   }
 }
 
 int main(int cuantos, char** argumentos) {
-  if (cuantos != 2) {
-    printf("Uso: %s <1|2>\n", argumentos[0]);
+  if (cuantos < 2) {
+    printf("Uso: %s <1|2|3|4|5> [figures dir|index] [cert file|index] "
+           "[metrics socket|-] [handshake threads]\n",
+           argumentos[0]);
     printf("\t1: Server\n");
     printf("\t2: Client\n");
+    printf("\t3: Server (processes)\n");
+    printf("\t4: Lego figure server (figures dir or index file)\n");
+    printf("\t5: Build figure index (figures dir, index file)\n");
     return 1;
   }
+  // before anything uses OpenSSL, it can't switch allocators afterwards
+  if (getenv("TLS_SLAB_ALLOCATOR") != nullptr &&
+      !SlabAllocator::InstallForOpenSsl()) {
+    Logger::Error("OpenSSL already allocated, slab allocator not used");
+  }
   int mode = std::atoi(argumentos[1]);
+  // a client that goes away while we write must not kill the server
+  signal(SIGPIPE, SIG_IGN);
   if (mode == 1) {
     Socket *server, *client;
     try {
@@ -69,7 +132,7 @@ int main(int cuantos, char** argumentos) {
                      "TrabajoEnClase/TC10/certs/ci0123.pem",
                      true);
       for (int i = 0; i < 2; i++) {
-        std::cout << "Waiting for connection..." << std::endl;
+        Logger::Info("Waiting for connection...");
         client = server->Accept();
         client->SSLCreate(server);
         std::thread worker(Service, client);
@@ -95,6 +158,8 @@ int main(int cuantos, char** argumentos) {
     int bytes;
     std::string hostname = "0:0:0:0:0:0:0:1";  // loopback address for ipv6
     int portnum = PORT;
+    // "./bin/TC10 2 binary" logs in with binary frames instead of XML
+    bool binary = cuantos > 2 && !strcmp(argumentos[2], "binary");
     try {
       client = new Socket('s', true, true);
       sprintf(clientRequest, requestMessage, userName,
@@ -102,11 +167,28 @@ int main(int cuantos, char** argumentos) {
       client->SSLConnect(hostname.c_str(), portnum);
       printf("\n\nConnected with %s encryption\n", client->SSLGetCipher());
       client->SSLShowCerts();  // display any certs
-      client->SSLWrite(clientRequest,
-                       strlen(clientRequest));    // encrypt & send message
-      bytes = client->SSLRead(buf, sizeof(buf));  // get reply & decrypt
-      buf[bytes] = 0;
-      printf("Received: \"%s\"\n", buf);
+      if (binary) {
+        FrameChannel channel(client, true);
+        LoginRequest request{userName, password};
+        channel.Send(clientRequest,
+                     request.Encode(clientRequest, sizeof(clientRequest)));
+        FrameReader reader = channel.Receive();
+        LoginResponse response;
+        if (LoginResponse::Decode(reader, response) && response.status == 0) {
+          printf("Received: %.*s (%.*s)\n",
+                 static_cast<int>(response.name.size()), response.name.data(),
+                 static_cast<int>(response.server.size()),
+                 response.server.data());
+        } else {
+          printf("Received: Invalid Message\n");
+        }
+      } else {
+        client->SSLWrite(clientRequest,
+                         strlen(clientRequest));    // encrypt & send message
+        bytes = client->SSLRead(buf, sizeof(buf) - 1);  // get reply & decrypt
+        buf[bytes] = 0;
+        printf("Received: \"%s\"\n", buf);
+      }
       delete client;
     } catch (const std::exception& e) {
       std::cerr << e.what() << '\n';
@@ -126,12 +208,12 @@ int main(int cuantos, char** argumentos) {
                      "/home/abotresol/Documents/Uni/OS/abadillaolivas_ci-0123/"
                      "TrabajoEnClase/TC10/certs/ci0123.pem");
       for (int i = 0; i < 2; i++) {
-        std::cout << "Waiting for connection..." << std::endl;
+        Logger::Info("Waiting for connection...");
         client = server->Accept();
-        std::cout << "Connection accepted" << std::endl;
-        std::cout << "creating ssl for socket" << std::endl;
+        Logger::Debug("Connection accepted");
+        Logger::Debug("creating ssl for socket");
         client->SSLCreate(server);
-        std::cout << "ssl created, serving client" << std::endl;
+        Logger::Debug("ssl created, serving client");
 
         // Use fork() instead of thread
         pid_t pid = fork();
@@ -150,6 +232,88 @@ int main(int cuantos, char** argumentos) {
       std::cerr << e.what() << '\n';
       return 1;
     }
+  } else if (mode == 4) {
+    const char* figuresDir = cuantos > 2 ? argumentos[2] : "figures";
+    const char* certFile = cuantos > 3 ? argumentos[3] : "certs/ci0123.pem";
+    // e.g. curl --unix-socket /tmp/tc10.metrics http://localhost/metrics
+    const char* metricsPath =
+        cuantos > 4 && strcmp(argumentos[4], "-") != 0 ? argumentos[4]
+                                                       : nullptr;
+    // handshakes on their own threads instead of each connection's thread
+    size_t handshakeThreads = cuantos > 5 ? std::atoi(argumentos[5]) : 0;
+    try {
+      std::unique_ptr<MetricsEndpoint> metrics;
+      if (metricsPath != nullptr) {
+        metrics = std::make_unique<MetricsEndpoint>(metricsPath);
+      }
+      // every page and its compressed variants are built once, here
+      PageCache cache;
+      // a regular file is an index built with mode 5, it is only mapped
+      struct stat figures;
+      size_t pages = stat(figuresDir, &figures) == 0 && S_ISREG(figures.st_mode)
+                         ? cache.LoadIndex(figuresDir)
+                         : cache.LoadDirectory(figuresDir);
+      Logger::Info("%zu figure pages cached", pages);
+      Socket server('s', PORT, certFile, certFile, true);
+      // e.g. TLS_POLICY=chacha, see TlsPolicy::Named
+      const char* policyName = getenv("TLS_POLICY");
+      TlsPolicy policy;
+      if (policyName != nullptr) {
+        if (!TlsPolicy::Named(policyName, policy)) {
+          throw std::invalid_argument("Unknown TLS_POLICY");
+        }
+        server.SSLSetPolicy(policy);
+      }
+      // e.g. TCP_PROFILE=long-lived, see SocketOptions::Named; accepted
+      // connections inherit it
+      const char* profileName = getenv("TCP_PROFILE");
+      if (profileName != nullptr) {
+        SocketOptions profile;
+        if (!SocketOptions::Named(profileName, profile)) {
+          throw std::invalid_argument("Unknown TCP_PROFILE");
+        }
+        server.SetOptions(profile);
+      }
+      // e.g. TCP_FASTOPEN=256: returning clients send their ClientHello in
+      // the SYN (needs net.ipv4.tcp_fastopen=3)
+      const char* fastOpen = getenv("TCP_FASTOPEN");
+      if (fastOpen != nullptr) {
+        SocketOptions options;
+        options.fastOpen = std::atoi(fastOpen);
+        server.SetOptions(options);
+      }
+      if (getenv("TLS_EARLY_DATA") != nullptr) {
+        // figures are only read, a replayed request changes nothing
+        EarlyDataGuard guard;
+        guard.AllowHttpMethod("GET");
+        guard.AllowHttpMethod("HEAD");
+        server.SSLEnableEarlyData(guard);
+      }
+      if (getenv("TLS_LEAN_MEMORY") != nullptr) {
+        // many idle keep-alive clients: no buffers held while idle
+        server.SSLSetMemoryLean();
+      }
+      // a renewed certificate (or SIGHUP) is picked up without a restart
+      CertificateReloader reloader(&server, certFile, certFile);
+      FigureServer figureServer(&server, &cache, 5, 1000, handshakeThreads);
+      figureServer.Run();
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << '\n';
+      return 1;
+    }
+  } else if (mode == 5) {
+    const char* figuresDir = cuantos > 2 ? argumentos[2] : "figures";
+    const char* indexFile = cuantos > 3 ? argumentos[3] : "figures.idx";
+    try {
+      PageCache cache;
+      cache.LoadDirectory(figuresDir);
+      size_t pages = FigureIndex::Build(cache, indexFile);
+      std::cout << pages << " figure pages written to " << indexFile
+                << std::endl;
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << '\n';
+      return 1;
+    }
   }
   return 0;
 }
\ No newline at end of file
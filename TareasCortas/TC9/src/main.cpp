@@ -13,6 +13,7 @@
 #include <iostream>
 #include <thread>
 
+#include "Logger.hpp"
 #include "Socket.hpp"
 
 #define PORT 5678
@@ -29,7 +30,7 @@ void task( Socket * client ) {
    char a[ BUFSIZE ];
 
    client->Read( a, BUFSIZE );	// Read a string from client, data will be limited by BUFSIZE bytes
-   std::cout << "Server received: " << a << std::endl;
+   Logger::Info( "Server received: %s", a );	// Written by the logger thread
    client->Write( a );		// Write it back to client, this is the mirror function
    client->Close();		// Close socket in parent
 